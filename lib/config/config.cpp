@@ -328,6 +328,66 @@ bool Config::setIrLearnPriority(uint16_t priority) {
     return true;
 }
 
+String Config::getIrGroupKey() {
+    return getStringSetting(m_prefGeneral, "irgroup_key", "");
+}
+
+bool Config::setIrGroupKey(const String& value) {
+    if (value.length() > 64) {
+        return false;
+    }
+    if (!m_preferences.begin(m_prefGeneral, false)) {
+        return false;
+    }
+    m_preferences.putString("irgroup_key", value);
+    m_preferences.end();
+
+    return true;
+}
+
+RateLimit Config::getRateLimit() {
+    return {getUShortSetting(m_prefGeneral, "rl_burst", RATE_LIMIT_DEF_BURST),
+            getUShortSetting(m_prefGeneral, "rl_rate", RATE_LIMIT_DEF_RATE)};
+}
+
+bool Config::setRateLimit(RateLimit limit) {
+    if (!m_preferences.begin(m_prefGeneral, false)) {
+        return false;
+    }
+    m_preferences.putUShort("rl_burst", limit.burst);
+    m_preferences.putUShort("rl_rate", limit.rate);
+    m_preferences.end();
+    return true;
+}
+
+RateLimit Config::getIpRateLimit() {
+    return {getUShortSetting(m_prefGeneral, "rl_ip_burst", RATE_LIMIT_DEF_IP_BURST),
+            getUShortSetting(m_prefGeneral, "rl_ip_rate", RATE_LIMIT_DEF_IP_RATE)};
+}
+
+bool Config::setIpRateLimit(RateLimit limit) {
+    if (!m_preferences.begin(m_prefGeneral, false)) {
+        return false;
+    }
+    m_preferences.putUShort("rl_ip_burst", limit.burst);
+    m_preferences.putUShort("rl_ip_rate", limit.rate);
+    m_preferences.end();
+    return true;
+}
+
+bool Config::getGcLearnCompressed() {
+    return getBoolSetting(m_prefGeneral, "gc_learn_comp", false);
+}
+
+bool Config::setGcLearnCompressed(bool compressed) {
+    if (!m_preferences.begin(m_prefGeneral, false)) {
+        return false;
+    }
+    m_preferences.putBool("gc_learn_comp", compressed);
+    m_preferences.end();
+    return true;
+}
+
 // reset config to defaults
 void Config::reset() {
     Log.warn(m_ctx, "Resetting configuration.");
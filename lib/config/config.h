@@ -8,6 +8,7 @@
 #include <nvs_flash.h>
 
 #include "log.h"
+#include "rate_limiter.hpp"
 
 class Config {
  public:
@@ -97,6 +98,26 @@ class Config {
     uint16_t getIrLearnPriority();
     bool     setIrLearnPriority(uint16_t priority);
 
+    // IR group send: shared secret of the dock group. Empty if disabled.
+    String getIrGroupKey();
+    /**
+     * Sets the IR group key. Maximum length is 64 characters. Longer keys are ignored. An empty key disables group
+     * send.
+     *
+     * Returns true if the key was stored.
+     */
+    bool setIrGroupKey(const String& value);
+
+    // Request rate limit of network IR clients per connection and per client IP address. A rate of 0 disables the limit.
+    RateLimit getRateLimit();
+    bool      setRateLimit(RateLimit limit);
+    RateLimit getIpRateLimit();
+    bool      setIpRateLimit(RateLimit limit);
+
+    // Learned IR codes for GlobalCache clients in the compressed iTach sendir format
+    bool getGcLearnCompressed();
+    bool setGcLearnCompressed(bool compressed);
+
     // reset config to defaults
     void reset();
 
@@ -3,6 +3,14 @@
 
 #include "service_api.h"
 
+#include <esp_timer.h>
+#include <lwip/opt.h>
+
+#include <vector>
+
+#include "api_commands.hpp"
+#include "api_request.hpp"
+#include "json_redact.hpp"
 #include "log.h"
 #include "service_mdns.h"
 
@@ -10,30 +18,57 @@ static const char* sources[] = {"WS", "Serial", "BT"};
 
 static const char* msgType = "type";
 static const char* msgTypeDock = "dock";
-static const char* msgId = "id";
 static const char* msgReqId = "req_id";
-static const char* msgCommand = "command";
 static const char* msgMsg = "msg";
 static const char* msgCode = "code";
 static const char* msgError = "error";
 static const char* msgToken = "token";
 static const char* msgWifiPwd = "wifi_password";
+static const char* msgGroupKey = "group_key";
+static const char* msgEncoding = "encoding";
+
+// request fields masked in the log
+static const char* const sensitiveKeys[] = {msgWifiPwd, msgToken, msgGroupKey};
+// maximum length of a logged request, longer requests are truncated
+#define API_LOG_REQUEST_SIZE 512
+// maximum length of a MessagePack response. MessagePack is always smaller than the JSON encoding.
+#define API_MSGPACK_RESPONSE_SIZE 512
 
 API::API(Config* config, State* state, NetworkService* networkService, InfraredService* irService,
-         LedControl* ledControl)
+         IrGroupServer* irGroupServer, LedControl* ledControl, ClientRateLimiter* rateLimiter,
+         GlobalCacheServer* gcServer)
     : m_config(config),
       m_state(state),
       m_networkService(networkService),
       m_irService(irService),
-      m_ledControl(ledControl) {
+      m_irGroupServer(irGroupServer),
+      m_ledControl(ledControl),
+      m_rateLimiter(rateLimiter),
+      m_gcServer(gcServer) {
     assert(m_config);
     assert(m_state);
     assert(m_networkService);
     assert(m_irService);
+    assert(m_irGroupServer);
     assert(m_ledControl);
+    assert(m_rateLimiter);
+    assert(m_gcServer);
 }
 
 void API::init() {
+    m_requestMutex = xSemaphoreCreateMutex();
+    if (m_requestMutex == NULL) {
+        Log.error(m_ctx, "xSemaphoreCreateMutex failed");
+    }
+    int err = m_events.open();
+    if (err) {
+        Log.logf(Log.ERROR, m_ctx, "Event queue creation failed: %d", err);
+    }
+    // A full event queue is fine: the pending events already wake up the API task, which handles all IR responses
+    // and serial input at once.
+    m_irService->onApiResponse([this]() { m_events.post(ApiEvent::IrResponse); });
+    Serial.onReceive([this]() { m_events.post(ApiEvent::SerialInput); });
+
     // initialize the websocket server
     m_webSocketServer.begin();
     m_webSocketServer.onEvent([=](uint8_t num, WStype_t type, uint8_t* payload, size_t length) {
@@ -43,6 +78,12 @@ void API::init() {
                          m_webSocketServer.connectedClients(false));
                 // remove from authenticated clients
                 m_authWsClients.erase(num);
+                m_subscriptions.removeClient(num);
+                m_wsSlowClients.erase(num);
+                if (num < WEBSOCKETS_SERVER_CLIENT_MAX) {
+                    m_wsEncoding[num] = ApiEncoding::Json;
+                    m_wsQueues[num].reset();
+                }
                 break;
 
             case WStype_CONNECTED: {
@@ -50,6 +91,13 @@ void API::init() {
                 Log.logf(Log.DEBUG, m_ctx, "[#%u clients=%u] Connected from %d.%d.%d.%d url: %s", num,
                          m_webSocketServer.connectedClients(false), ip[0], ip[1], ip[2], ip[3],
                          payload);
+                if (num < WEBSOCKETS_SERVER_CLIENT_MAX) {
+                    m_wsRateLimits[num].reset();
+                    m_wsClientIps[num] = ip;
+                    m_wsEncoding[num] = ApiEncoding::Json;
+                    m_wsQueues[num].reset();
+                }
+                m_wsSlowClients.erase(num);
 
                 // send auth request message
                 StaticJsonDocument<200> responseDoc;
@@ -59,11 +107,15 @@ void API::init() {
                 responseDoc["version"] = m_config->getSoftwareVersion();
                 String message;
                 serializeJson(responseDoc, message);
-                m_webSocketServer.sendTXT(num, message);
+                queueWsMessage(num, message.c_str(), message.length(), false, OutboundKind::Response);
             } break;
 
             case WStype_TEXT:
-                processWsRequest(reinterpret_cast<char*>(payload), num);
+                processWsRequest(reinterpret_cast<char*>(payload), length, ApiEncoding::Json, num);
+                break;
+
+            case WStype_BIN:
+                processWsRequest(reinterpret_cast<char*>(payload), length, ApiEncoding::MsgPack, num);
                 break;
 
             case WStype_FRAGMENT_TEXT_START:
@@ -71,487 +123,1009 @@ void API::init() {
                 Log.error(m_ctx, "WebSocket fragments not supported");
                 m_webSocketServer.disconnect(num);
                 break;
-            case WStype_BIN:
-                Log.error(m_ctx, "Binary WebSocket message not supported");
-                m_webSocketServer.disconnect(num);
-                break;
         }
     });
 
-    Log.logf(Log.DEBUG, m_ctx, "Initialized. Running on core: %d", xPortGetCoreID());
+    if (xTaskCreatePinnedToCore(api_task, "API", API_TASK_STACK_SIZE, this, API_TASK_PRIORITY, &m_task,
+                                ARDUINO_RUNNING_CORE) != pdPASS) {
+        Log.error(m_ctx, "Creating API task failed");
+    }
 }
 
-void API::loop() {
-    m_webSocketServer.loop();
+void API::api_task(void* param) {
+    API* api = reinterpret_cast<API*>(param);
+    Log.logf(Log.DEBUG, api->m_ctx, "Initialized. Running on core: %d", xPortGetCoreID());
+
+    while (true) {
+        api->runOnce();
+    }
+}
+
+void API::runOnce() {
+    fd_set readSet;
+    fd_set writeSet;
+    FD_ZERO(&readSet);
+    FD_ZERO(&writeSet);
+    int maxFd = m_webSocketServer.addClientSockets(&readSet, -1);
+    // clients with queued messages wake up the task as soon as they can take more data
+    maxFd = addPendingWsClients(&writeSet, maxFd);
+    if (m_events.wait(&readSet, maxFd, API_POLL_INTERVAL_MS, &writeSet) < 0) {
+        // a client socket was closed in the meantime: the WebSocket server cleans it up
+        vTaskDelay(1);
+    }
+
+    if (m_events.woken(&readSet)) {
+        // events only wake up the task: IR responses and serial input are checked in every iteration, which also
+        // covers data that arrived before an event could be posted
+        ApiEvent event;
+        while (m_events.pop(&event)) {
+        }
+    }
+
+    sendIrResponses();
     handleSerial();
+    publishEvents();
 
-    auto response = m_irService->apiResponse();
-    if (response) {
+    if (m_irTestTimer.running()) {
+        // `ir_test` can be requested from the Bluetooth task as well
+        xSemaphoreTake(m_requestMutex, portMAX_DELAY);
+        if (m_irTestTimer.expired(millis())) {
+            setIrTestLeds(false);
+            Log.debug(m_ctx, "IR Led test ended");
+        }
+        xSemaphoreGive(m_requestMutex);
+    }
+
+    // received data, new connections and handshake timeouts
+    m_webSocketServer.loop();
+    flushWsClients();
+
+    // restart once the response reached the requesting client, or it doesn't take it in time
+    if (m_pendingShutdown != ApiShutdown::None && (!closingWsClients() || m_shutdownTimer.expired(millis()))) {
+        performShutdown(m_pendingShutdown);
+        m_pendingShutdown = ApiShutdown::None;
+    }
+}
+
+void API::sendIrResponses() {
+    // drain the queue: a burst of learned codes or send results must not wait for further loop iterations
+    IrResponse* response;
+    while ((response = m_irService->apiResponse()) != nullptr) {
         Log.debug(m_ctx, "IR response available");
-        // check if response is for a specific client (send IR response), or a learning broadcast
         if (response->clientId >= 0) {
-            m_webSocketServer.sendTXT(response->clientId, response->message);
+            sendWsMessage(response->message, WsClientSet::of(response->clientId), OutboundKind::Response);
+        } else if (response->clientId == IR_CLIENT_LEARN) {
+            sendWsMessage(response->message, subscribers(ApiTopic::IrReceive), OutboundKind::Event);
         } else {
-            m_webSocketServer.broadcastTXT(response->message);
+            // send result of a serial or Bluetooth request
+            sendWsMessage(response->message, m_authWsClients, OutboundKind::Event);
         }
         delete response;
     }
 }
 
-void API::handleSerial() {
-    if (!Serial.available()) {
-        return;
-    }
+void API::setIrTestLeds(bool on) {
+    uint8_t level = on ? HIGH : LOW;
+    digitalWrite(IR_SEND_PIN_INT_SIDE, level);
+#ifdef IR_SEND_PIN_INT_TOP
+    digitalWrite(IR_SEND_PIN_INT_TOP, level);
+#endif
+    digitalWrite(IR_SEND_PIN_EXT_1, level);
+#ifdef IR_SEND_PIN_EXT_2
+    digitalWrite(IR_SEND_PIN_EXT_2, level);
+#endif
+}
 
-    char buffer[1024];
-    auto count = Serial.readBytes(buffer, sizeof(buffer) - 1);
-    if (count > 0) {
-        buffer[count] = '0';  // readBytes doesn't zero-terminate the buffer!
-        processRequest(buffer, Source::Uart, [this](String response) -> void {
-            if (!response.isEmpty()) {
+void API::handleSerial() {
+    auto handler = [this](char* request, size_t length, ApiEncoding encoding) -> void {
+        processRequest(request, length, encoding, Source::Uart, [this, encoding](const char* response, size_t length) {
+            if (length == 0) {
+                return;
+            }
+            if (encoding == ApiEncoding::MsgPack) {
+                // 0xC1 never occurs in UTF-8: the frame can't be mistaken for log output
+                writeResponse(&Serial, response, length, encoding);
+            } else {
                 Log.debug(m_ctx, response);
             }
         });
+    };
+
+    char     request[API_SERIAL_BUFFER_SIZE];
+    uint32_t discarded = m_serialFramer.discarded();
+    m_serialFramer.receive(&Serial, request, sizeof(request), handler);
+    if (m_serialFramer.discarded() != discarded) {
+        Log.logf(Log.WARN, m_ctx, "Discarded serial request exceeding %d bytes", API_SERIAL_BUFFER_SIZE);
     }
 }
 
-void API::processWsRequest(char* request, int id) {
-    auto search = m_authWsClients.find(id);
-    bool authenticated = search != m_authWsClients.end();
+void API::writeResponse(Stream* stream, const char* response, size_t length, ApiEncoding encoding) {
+    if (encoding == ApiEncoding::MsgPack) {
+        uint8_t header[MSGPACK_FRAME_HEADER_SIZE];
+        if (!encodeMsgPackFrameHeader(length, header)) {
+            return;
+        }
+        stream->write(header, sizeof(header));
+        stream->write(reinterpret_cast<const uint8_t*>(response), length);
+    } else {
+        stream->write(reinterpret_cast<const uint8_t*>(response), length);
+        stream->println();
+    }
+    stream->flush();
+}
 
-    auto cb = [this, id](String response) -> void {
-        if (!response.isEmpty()) {
-            m_webSocketServer.sendTXT(id, response);
+void API::processWsRequest(char* request, size_t length, ApiEncoding encoding, int id) {
+    auto cb = [this, id, encoding](const char* response, size_t length) -> void {
+        if (length == 0) {
+            return;
         }
+        queueWsMessage(id, response, length, encoding == ApiEncoding::MsgPack, OutboundKind::Response);
     };
-    processRequest(request, Source::WebSocket, cb, authenticated, id);
+
+    // a closing client only receives its pending messages
+    if (id >= 0 && id < WEBSOCKETS_SERVER_CLIENT_MAX && m_wsQueues[id].closing()) {
+        return;
+    }
+
+    // reject flooding clients before parsing the request
+    if (id >= 0 && id < WEBSOCKETS_SERVER_CLIENT_MAX &&
+        !m_rateLimiter->allow(&m_wsRateLimits[id], m_wsClientIps[id], esp_timer_get_time())) {
+        if (encoding == ApiEncoding::Json) {
+            static const char tooManyRequests[] = "{\"type\":\"dock\",\"code\":429,\"error\":\"Too many requests\"}";
+            cb(tooManyRequests, sizeof(tooManyRequests) - 1);
+        } else {
+            StaticJsonDocument<64> responseDoc;
+            responseDoc[msgType] = msgTypeDock;
+            responseDoc[msgCode] = 429;
+            responseDoc[msgError] = "Too many requests";
+            respond(responseDoc, encoding, cb);
+        }
+        return;
+    }
+
+    processRequest(request, length, encoding, Source::WebSocket, cb, m_authWsClients.contains(id), id);
 }
 
-bool API::processRequest(char* request, Source source, ApiResponseCallbackFunction cb, bool authenticated, int id) {
-    // filter garbage data. First char must be a printable character
-    if (request == NULL || !(request[0] >= 32 && request[0] <= 127)) {
+void API::respond(const JsonDocument& doc, ApiEncoding encoding, const ApiResponseCallbackFunction& cb) {
+    if (encoding == ApiEncoding::MsgPack) {
+        uint8_t buffer[API_MSGPACK_RESPONSE_SIZE];
+        size_t  length = measureMsgPack(doc);
+        if (length > sizeof(buffer)) {
+            Log.logf(Log.ERROR, m_ctx, "MessagePack response too long: %u", length);
+            return;
+        }
+        serializeMsgPack(doc, buffer, sizeof(buffer));
+        cb(reinterpret_cast<const char*>(buffer), length);
+    } else {
+        String message;
+        serializeJson(doc, message);
+        cb(message.c_str(), message.length());
+    }
+}
+
+/// Convert a JSON message to MessagePack.
+static bool jsonToMsgPack(const String& json, std::vector<uint8_t>* msgpack) {
+    // strings are copied into the document: reserve the message length
+    DynamicJsonDocument doc(JSON_OBJECT_SIZE(16) + json.length());
+    if (deserializeJson(doc, json) != DeserializationError::Ok) {
         return false;
     }
+    msgpack->resize(measureMsgPack(doc));
+    serializeMsgPack(doc, msgpack->data(), msgpack->size());
+    return true;
+}
+
+void API::sendWsMessage(const String& msg, WsClientSet clients, OutboundKind kind) {
+    std::vector<uint8_t> msgpack;
+    bool                 converted = false;
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+        if (!clients.contains(num) || !m_webSocketServer.clientIsConnected(num)) {
+            continue;
+        }
+        if (m_wsEncoding[num] == ApiEncoding::Json) {
+            queueWsMessage(num, msg.c_str(), msg.length(), false, kind);
+            continue;
+        }
+        if (!converted) {
+            converted = true;
+            if (!jsonToMsgPack(msg, &msgpack)) {
+                Log.error(m_ctx, "Failed to convert message to MessagePack");
+            }
+        }
+        if (!msgpack.empty()) {
+            queueWsMessage(num, reinterpret_cast<const char*>(msgpack.data()), msgpack.size(), true, kind);
+        }
+    }
+}
 
-    // From the docs: "Use StaticJsonDocument for small documents (below 1KB) and switch to a DynamicJsonDocument if
-    // it’s too large to fit in the stack memory."
-    // Since we use a writeable buffer, ArduinoJson uses zero-copy! Probably 200 is still way too large :-)
-    StaticJsonDocument<200> webSocketJsonDocument;
-    DeserializationError    error = deserializeJson(webSocketJsonDocument, request);
+void API::queueWsMessage(uint8_t num, const char* data, size_t length, bool binary, OutboundKind kind) {
+    // an empty text message would be sent as zero-terminated string
+    if (num >= WEBSOCKETS_SERVER_CLIENT_MAX || length == 0 || m_wsSlowClients.contains(num)) {
+        return;
+    }
+    switch (m_wsQueues[num].push(kind, binary, data, length, millis())) {
+        case OutboundResult::Queued:
+            break;
+        case OutboundResult::Dropped:
+            Log.logf(Log.DEBUG, m_ctx, "[#%u] Dropped event: client doesn't keep up", num);
+            break;
+        case OutboundResult::Overflow:
+            Log.logf(Log.WARN, m_ctx, "[#%u] Response doesn't fit into outbound queue", num);
+            m_wsSlowClients.insert(num);
+            break;
+        case OutboundResult::Closing:
+            // the client is disconnected after its last response
+            break;
+    }
+}
 
-    if (error) {
-        Log.logf(
-            Log.WARN, m_ctx, "Error deserializing JSON: %s. %s", error.c_str(),
-            error.code() == DeserializationError::IncompleteInput || error.code() == DeserializationError::InvalidInput
-                ? request
-                : "");
-        cb("{\"code\": 500}");
-        return false;
+// lwIP reports a socket as writable while more than TCP_SNDLOWAT bytes of its send buffer are free. A queued message
+// frame must fit into it, otherwise the blocking WiFiClient write waits for the client to acknowledge data.
+static_assert(WEBSOCKETS_MAX_HEADER_SIZE + OutboundQueue<API_WS_QUEUE_SIZE>::MAX_MESSAGE_SIZE <= TCP_SNDLOWAT,
+              "API_WS_QUEUE_SIZE exceeds the free send buffer of a writable socket");
+
+// Check if a socket can take more data without blocking
+static bool isWritable(int fd) {
+    fd_set writeSet;
+    FD_ZERO(&writeSet);
+    FD_SET(fd, &writeSet);
+    struct timeval timeout = {0, 0};
+    return select(fd + 1, nullptr, &writeSet, nullptr, &timeout) > 0;
+}
+
+void API::flushWsClients() {
+    uint32_t now = millis();
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+        OutboundQueue<API_WS_QUEUE_SIZE>& queue = m_wsQueues[num];
+        int                               fd = m_webSocketServer.clientSocket(num);
+        if (fd < 0) {
+            continue;
+        }
+        // A writable socket has space for any queued message frame, see the static_assert above. The frame header is
+        // written in front of the message, so the frame is sent in a single write which never waits for the client.
+        while (!queue.empty() && !m_wsSlowClients.contains(num) && isWritable(fd)) {
+            const char* data;
+            size_t      length;
+            bool        binary;
+            char*       payload = m_wsSendBuffer + WEBSOCKETS_MAX_HEADER_SIZE;
+            queue.front(m_wsSendBuffer, &data, &length, &binary);
+            memmove(payload, data, length);
+            if (binary) {
+                m_webSocketServer.sendBIN(num, reinterpret_cast<uint8_t*>(payload), length, true);
+            } else {
+                m_webSocketServer.sendTXT(num, payload, length, true);
+            }
+            queue.pop(now);
+        }
+
+        if (queue.stalledMs(now) > API_WS_STALL_TIMEOUT_MS || queue.droppedSinceSent() >= API_WS_MAX_DROPPED_EVENTS) {
+            m_wsSlowClients.insert(num);
+        }
+        if (m_wsSlowClients.contains(num)) {
+            const OutboundStats& stats = queue.stats();
+            Log.logf(Log.WARN, m_ctx, "[#%u] Disconnecting slow client: queued=%u dropped=%u sent=%u", num,
+                     queue.messages(), stats.droppedEvents, stats.sent);
+            m_wsSlowDisconnects++;
+            // resets the queue in the disconnect event
+            m_webSocketServer.disconnect(num);
+        } else if (queue.drained()) {
+            Log.logf(Log.DEBUG, m_ctx, "[#%u] Closing connection after last message", num);
+            m_webSocketServer.disconnect(num);
+        }
     }
+}
 
-    // response json (sysinfo msg is largest with > 300 chars depending on friendly name)
-    StaticJsonDocument<400> responseDoc;
-    String                  type;
-    if (webSocketJsonDocument.containsKey(msgType)) {
-        type = webSocketJsonDocument[msgType].as<String>();
+int API::addPendingWsClients(fd_set* writeSet, int maxFd) {
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+        int fd = m_wsQueues[num].empty() ? -1 : m_webSocketServer.clientSocket(num);
+        if (fd >= 0) {
+            FD_SET(fd, writeSet);
+            maxFd = fd > maxFd ? fd : maxFd;
+        }
     }
+    return maxFd;
+}
+
+void API::closeWsClient(int num) {
+    if (num < 0 || num >= WEBSOCKETS_SERVER_CLIENT_MAX || !m_webSocketServer.clientIsConnected(num)) {
+        return;
+    }
+    m_wsQueues[num].closeAfterDrain();
+}
 
-    String command;
-    if (webSocketJsonDocument.containsKey(msgCommand)) {
-        command = webSocketJsonDocument[msgCommand].as<String>();
+bool API::closingWsClients() const {
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+        if (m_wsQueues[num].closing()) {
+            return true;
+        }
     }
+    return false;
+}
 
-    // log received data, but filter sensitive information
+void API::shutdown(ApiShutdown action, Source source, int id) {
+    if (source == Source::WebSocket) {
+        closeWsClient(id);
+        m_pendingShutdown = action;
+        m_shutdownTimer.start(millis());
+        return;
+    }
+    // the UART and Bluetooth responses are already written
+    delay(200);
+    performShutdown(action);
+}
+
+void API::performShutdown(ApiShutdown action) {
+    switch (action) {
+        case ApiShutdown::None:
+            break;
+        case ApiShutdown::Reboot:
+            m_state->reboot();
+            break;
+        case ApiShutdown::Reset:
+            m_config->reset();
+            break;
+    }
+}
+
+bool API::processRequest(char* request, size_t length, ApiEncoding encoding, Source source,
+                         ApiResponseCallbackFunction cb, bool authenticated, int id) {
+    xSemaphoreTake(m_requestMutex, portMAX_DELAY);
+    bool result = handleRequest(request, length, encoding, source, cb, authenticated, id);
+    xSemaphoreGive(m_requestMutex);
+    return result;
+}
+
+bool API::handleRequest(char* request, size_t length, ApiEncoding encoding, Source source,
+                        const ApiResponseCallbackFunction& cb, bool authenticated, int id) {
+    // filter garbage data. First char must be a printable character
+    if (request == NULL || length == 0 ||
+        (encoding == ApiEncoding::Json && !(request[0] >= 32 && request[0] <= 127))) {
+        return false;
+    }
+
+    // log received data, but filter sensitive information. This has to be done before parsing the request, since
+    // zero-copy deserialization modifies the buffer.
+    char          logBuffer[API_LOG_REQUEST_SIZE];
+    JsonLogBuffer logRequest(logBuffer, sizeof(logBuffer));
     if (Log.getFilterLevel() == UCLog::Level::DEBUG) {
-        auto filtered = DynamicJsonDocument(webSocketJsonDocument);
-        if (webSocketJsonDocument.containsKey(msgWifiPwd)) {
-            filtered[msgWifiPwd] = "****";
+        if (encoding == ApiEncoding::MsgPack) {
+            Log.logf(Log.DEBUG, m_ctx, "%s request: MessagePack, %u bytes", sources[source], length);
+        } else {
+            redactJson(request, length, sensitiveKeys, sizeof(sensitiveKeys) / sizeof(sensitiveKeys[0]),
+                       &logRequest);
+            Log.logf(Log.DEBUG, m_ctx, "%s request: %s", sources[source], logRequest.c_str());
         }
-        if (webSocketJsonDocument.containsKey(msgToken)) {
-            filtered[msgToken] = "****";
+    }
+
+    // The known request fields are extracted in a single pass. Since we use a writeable buffer, string values are
+    // zero-copy views into the request.
+    ApiRequest    fields;
+    ApiParseError error = encoding == ApiEncoding::MsgPack
+                              ? parseApiRequestMsgPack(reinterpret_cast<uint8_t*>(request), length, &fields)
+                              : parseApiRequest(request, &fields);
+
+    if (error != ApiParseError::Ok) {
+        bool logInput = encoding == ApiEncoding::Json &&
+                        (error == ApiParseError::IncompleteInput || error == ApiParseError::InvalidInput);
+        if (logInput && logRequest.length() == 0) {
+            // best effort: the parser may already have modified the buffer
+            redactJson(request, strlen(request), sensitiveKeys, sizeof(sensitiveKeys) / sizeof(sensitiveKeys[0]),
+                       &logRequest);
         }
-        String jsonStr;
-        serializeJson(filtered, jsonStr);
-        Log.logf(Log.DEBUG, m_ctx, "%s request: %s", sources[source], jsonStr.c_str());
+        Log.logf(Log.WARN, m_ctx, "Error deserializing %s: %s. %s", apiEncodingName(encoding),
+                 apiParseErrorName(error), logInput ? logRequest.c_str() : "");
+        StaticJsonDocument<32> errorDoc;
+        errorDoc[msgCode] = 500;
+        respond(errorDoc, encoding, cb);
+        return false;
+    }
+
+    // response json (sysinfo msg is largest with > 300 chars depending on friendly name, get_ir_config has the most
+    // fields)
+    StaticJsonDocument<512> responseDoc;
+    const char*             type = fields.getString(ApiField::Type);
+    const char*             command = fields.getString(ApiField::Command);
+    if (command == nullptr) {
+        command = "";
     }
 
     // AUTHENTICATION TO THE API
-    if (type == "auth") {
-        String message;
+    if (type && strcmp(type, "auth") == 0) {
         responseDoc[msgType] = "authentication";
-        if (webSocketJsonDocument.containsKey(msgId)) {
-            responseDoc[msgReqId] = webSocketJsonDocument[msgId].as<int>();
+        if (fields.has(ApiField::Id)) {
+            responseDoc[msgReqId] = fields.getInt<int>(ApiField::Id);
         }
-        if (webSocketJsonDocument[msgToken].as<String>() == m_config->getToken()) {
+        // message encoding of the connection: as requested, otherwise the encoding of the auth request
+        ApiEncoding clientEncoding = encoding;
+        if (fields.has(ApiField::Encoding) &&
+            !parseApiEncoding(fields.getString(ApiField::Encoding), &clientEncoding)) {
+            responseDoc[msgCode] = 400;
+            responseDoc[msgError] = "Unsupported encoding";
+            respond(responseDoc, encoding, cb);
+            return false;
+        }
+        const char* token = fields.getString(ApiField::Token, "");
+        if (m_config->getToken() == token) {
             // token ok
             responseDoc[msgCode] = 200;
+            responseDoc[msgEncoding] = apiEncodingName(clientEncoding);
 
             if (source == WebSocket) {
                 // add client to authorized clients
                 m_authWsClients.insert(id);
+                if (id >= 0 && id < WEBSOCKETS_SERVER_CLIENT_MAX) {
+                    m_wsEncoding[id] = clientEncoding;
+                }
             }
 
-            serializeJson(responseDoc, message);
-            cb(message);
+            respond(responseDoc, encoding, cb);
             return true;
         } else {
             // invalid token: disconnect
             responseDoc[msgCode] = 401;
             responseDoc[msgError] = "Invalid token";
-            serializeJson(responseDoc, message);
-            cb(message);
-            delay(100);
+            respond(responseDoc, encoding, cb);
             if (source == WebSocket) {
-                m_webSocketServer.disconnect(id);
+                closeWsClient(id);
             }
             return false;
         }
     }
 
-    if (!type.isEmpty()) {
+    if (type && *type) {
         responseDoc[msgType] = type;
     }
-    if (!command.isEmpty()) {
+    if (*command) {
         responseDoc[msgMsg] = command;
     }
-    if (webSocketJsonDocument.containsKey(msgId)) {
-        responseDoc[msgReqId] = webSocketJsonDocument[msgId].as<int>();
+    if (fields.has(ApiField::Id)) {
+        responseDoc[msgReqId] = fields.getInt<int>(ApiField::Id);
     }
     // default response code
     responseDoc[msgCode] = 200;
 
-    // Allowed non-authorized commands to the dock
-    if (type == msgTypeDock) {
-        // Get system information
-        if (command == "get_sysinfo") {
-            responseDoc["name"] = m_config->getFriendlyName();
-            responseDoc["hostname"] = m_config->getHostName();
-            responseDoc["model"] = m_config->getModel();
-            responseDoc["revision"] = m_config->getRevision();
-            responseDoc["version"] = m_config->getSoftwareVersion();
-            responseDoc["serial"] = m_config->getSerial();
-            responseDoc["led_brightness"] = m_config->getLedBrightness();
-#if defined(ETH_STATUS_LED)
-            responseDoc["eth_led_brightness"] = m_config->getEthLedBrightness();
-#endif
-            responseDoc["ir_learning"] = m_irService->isIrLearning();
-            responseDoc["ethernet"] = m_networkService->isEthConnected();
-            responseDoc["wifi"] = m_networkService->isWifiEnabled();
-            responseDoc["ssid"] = m_config->getWifiSsid();
-            responseDoc["uptime"] = String(m_state->getUptime());
-            responseDoc["sntp"] = m_config->isNtpEnabled();
-
-            String message;
-            serializeJson(responseDoc, message);
-            cb(message);
-            return true;
-        }
-    }
+    const ApiCommandInfo& info = apiCommandInfo(findApiCommand(command));
+    bool                  isDock = type && strcmp(type, msgTypeDock) == 0;
 
-    // Authorized COMMANDS TO THE DOCK
-    if (!authenticated) {
+    // only public commands to the dock are allowed without authorization
+    if (!authenticated && !(isDock && (info.flags & API_CMD_PUBLIC))) {
         Log.info(m_ctx, "Cannot execute command: WS connection not authorized");
         responseDoc[msgCode] = 401;
-        String message;
-        serializeJson(responseDoc, message);
-        cb(message);
+        respond(responseDoc, encoding, cb);
         return false;
     }
 
-    if (type != msgTypeDock) {
+    if (!isDock) {
         Log.info(m_ctx, "Ignoring message with invalid type field");
         responseDoc[msgCode] = 400;
-    } else if (command.isEmpty() && webSocketJsonDocument[msgMsg].as<String>() == "ping") {
+    } else if (*command == '\0' && strcmp(fields.getString(ApiField::Msg, ""), "ping") == 0) {
         Log.debug(m_ctx, "Sending heartbeat");
         responseDoc.remove(msgCode);
         responseDoc[msgMsg] = "pong";
-    } else if (command == "set_config") {
-        bool field = false;
-        bool ok = false;
-
-        if (webSocketJsonDocument.containsKey("friendly_name")) {
-            field = true;
-            String dockFriendlyName = webSocketJsonDocument["friendly_name"].as<String>();
-            m_config->setFriendlyName(dockFriendlyName);
-            // retrieve from config again, since it could be adjusted
-            MdnsService.addFriendlyName(m_config->getFriendlyName());
-            ok = true;
-        }
-        if (webSocketJsonDocument.containsKey(msgToken)) {
-            field = true;
-            String token = webSocketJsonDocument[msgToken].as<String>();
-            if (token.isEmpty() || token.length() > 40) {
-                responseDoc[msgError] = "Token length must be 4..40";
-            } else {
-                ok = m_config->setToken(token);
-            }
-        }
-        if (!(field && !ok) &&
-            (webSocketJsonDocument.containsKey("ssid") || webSocketJsonDocument.containsKey(msgWifiPwd))) {
-            String ssid = webSocketJsonDocument["ssid"].as<String>();
-            String pass = webSocketJsonDocument[msgWifiPwd].as<String>();
+    } else if (info.command == ApiCommand::Unknown) {
+        responseDoc[msgCode] = 400;
+        responseDoc[msgError] = *command ? "Unsupported command" : "Missing command field";
+    } else if (!isApiCommandAllowed(info, 1 << source, true)) {
+        Log.logf(Log.INFO, m_ctx, "Command %s not allowed from %s", command, sources[source]);
+        responseDoc[msgCode] = 403;
+        responseDoc[msgError] = "Command not allowed";
+    } else {
+        switch (info.command) {
+            case ApiCommand::GetSysinfo:
+                responseDoc["name"] = m_config->getFriendlyName();
+                responseDoc["hostname"] = m_config->getHostName();
+                responseDoc["model"] = m_config->getModel();
+                responseDoc["revision"] = m_config->getRevision();
+                responseDoc["version"] = m_config->getSoftwareVersion();
+                responseDoc["serial"] = m_config->getSerial();
+                responseDoc["led_brightness"] = m_config->getLedBrightness();
+#if defined(ETH_STATUS_LED)
+                responseDoc["eth_led_brightness"] = m_config->getEthLedBrightness();
+#endif
+                responseDoc["ir_learning"] = m_irService->isIrLearning();
+                responseDoc["ethernet"] = m_networkService->isEthConnected();
+                responseDoc["wifi"] = m_networkService->isWifiEnabled();
+                responseDoc["ssid"] = m_config->getWifiSsid();
+                responseDoc["uptime"] = String(m_state->getUptime());
+                responseDoc["sntp"] = m_config->isNtpEnabled();
+                break;
+            case ApiCommand::SetConfig: {
+                bool field = false;
+                bool ok = false;
 
-            if (m_config->setWifi(ssid, pass)) {
-                Log.logf(Log.DEBUG, m_ctx, "Saving SSID: %s", ssid.c_str());
+                if (fields.has(ApiField::FriendlyName)) {
+                    field = true;
+                    String dockFriendlyName = String(fields.getString(ApiField::FriendlyName, ""));
+                    m_config->setFriendlyName(dockFriendlyName);
+                    // retrieve from config again, since it could be adjusted
+                    MdnsService.addFriendlyName(m_config->getFriendlyName());
+                    ok = true;
+                }
+                if (fields.has(ApiField::Token)) {
+                    field = true;
+                    const char* token = fields.getString(ApiField::Token, "");
+                    size_t      tokenLength = strlen(token);
+                    if (tokenLength == 0 || tokenLength > 40) {
+                        responseDoc[msgError] = "Token length must be 4..40";
+                    } else {
+                        ok = m_config->setToken(token);
+                    }
+                }
+                if (!(field && !ok) && (fields.has(ApiField::Ssid) || fields.has(ApiField::WifiPassword))) {
+                    const char* ssid = fields.getString(ApiField::Ssid, "");
+                    const char* pass = fields.getString(ApiField::WifiPassword, "");
 
-                String message;
-                responseDoc["reboot"] = true;
-                serializeJson(responseDoc, message);
-                cb(message);
-                delay(200);
-                if (source == Source::WebSocket) {
-                    m_webSocketServer.disconnect(id);
-                }
-
-                m_state->reboot();
-                // Log.debug(m_ctx, "Disconnecting any current WiFi connections.");
-                // WiFi.disconnect();
-                // delay(1000);
-                // Log.debug(m_ctx, "Connecting to provided WiFi credentials.");
-                // WifiService::getInstance()->connect(ssid, pass);
-                return true;
-            } else {
-                responseDoc[msgError] = "Invalid SSID or password";
+                    if (m_config->setWifi(ssid, pass)) {
+                        Log.logf(Log.DEBUG, m_ctx, "Saving SSID: %s", ssid);
+
+                        responseDoc["reboot"] = true;
+                        respond(responseDoc, encoding, cb);
+                        shutdown(ApiShutdown::Reboot, source, id);
+                        // Log.debug(m_ctx, "Disconnecting any current WiFi connections.");
+                        // WiFi.disconnect();
+                        // delay(1000);
+                        // Log.debug(m_ctx, "Connecting to provided WiFi credentials.");
+                        // WifiService::getInstance()->connect(ssid, pass);
+                        return true;
+                    } else {
+                        responseDoc[msgError] = "Invalid SSID or password";
+                    }
+                }
+
+                if (!ok) {
+                    responseDoc[msgCode] = 400;
+                }
+                break;
             }
-        }
+            case ApiCommand::SetBrightness: {
+                bool ok = false;
+                if (fields.has(ApiField::StatusLed)) {
+                    m_state->setState(States::LED_SETUP);
+                    int brightness = fields.getInt<int>(ApiField::StatusLed);
+                    Log.logf(Log.DEBUG, m_ctx, "Set LED brightness: %d", brightness);
+                    // set new value
+                    m_ledControl->setLedMaxBrightness(brightness);
+                    // persist value
+                    m_config->setLedBrightness(brightness);
+                    ok = true;
+                }
+                if (fields.has(ApiField::EthLed)) {
+                    int brightness = fields.getInt<int>(ApiField::EthLed);
+                    Log.logf(Log.DEBUG, m_ctx, "Set ETH brightness: %d", brightness);
+                    // set new value if ethernet link is up
+                    if (m_networkService->isEthLinkUp()) {
+                        m_ledControl->setEthLedBrightness(brightness);
+                    }
+                    // persist value
+                    m_config->setEthLedBrightness(brightness);
+                    ok = true;
+                }
+                if (!ok) {
+                    responseDoc[msgCode] = 400;
+                }
+                break;
+            }
+            case ApiCommand::TestMode: {
+                bool ok = m_config->setTestMode(true);
 
-        if (!ok) {
-            responseDoc[msgCode] = 400;
-        }
-    } else if (command == "set_brightness") {
-        bool ok = false;
-        if (webSocketJsonDocument.containsKey("status_led")) {
-            m_state->setState(States::LED_SETUP);
-            int brightness = webSocketJsonDocument["status_led"].as<int>();
-            Log.logf(Log.DEBUG, m_ctx, "Set LED brightness: %d", brightness);
-            // set new value
-            m_ledControl->setLedMaxBrightness(brightness);
-            // persist value
-            m_config->setLedBrightness(brightness);
-            ok = true;
-        }
-        if (webSocketJsonDocument.containsKey("eth_led")) {
-            int brightness = webSocketJsonDocument["eth_led"].as<int>();
-            Log.logf(Log.DEBUG, m_ctx, "Set ETH brightness: %d", brightness);
-            // set new value if ethernet link is up
-            if (m_networkService->isEthLinkUp()) {
-                m_ledControl->setEthLedBrightness(brightness);
+                if (!ok) {
+                    responseDoc[msgCode] = 400;
+                }
+                break;
             }
-            // persist value
-            m_config->setEthLedBrightness(brightness);
-            ok = true;
-        }
-        if (!ok) {
-            responseDoc[msgCode] = 400;
-        }
-    } else if (command == "test_mode") {
-        bool ok = m_config->setTestMode(true);
+            case ApiCommand::RgbTest: {
+                if (m_state->getState() != States::TEST_LED_RED && m_state->getState() != States::TEST_LED_GREEN &&
+                    m_state->getState() != States::TEST_LED_BLUE) {
+                    m_prevState = m_state->getState();
+                }
 
-        if (!ok) {
-            responseDoc[msgCode] = 400;
-        }
-    } else if (command == "rgb_test") {
-        if (m_state->getState() != States::TEST_LED_RED && m_state->getState() != States::TEST_LED_GREEN &&
-            m_state->getState() != States::TEST_LED_BLUE) {
-            m_prevState = m_state->getState();
-        }
+                Log.debug(m_ctx, "Led test start");
+                const char* color = fields.getString(ApiField::Color, "");
+                // set led to red
+                if (strcmp(color, "red") == 0) {
+                    m_state->setState(States::TEST_LED_RED);
+                }
 
-        Log.debug(m_ctx, "Led test start");
-        // set led to red
-        if (webSocketJsonDocument["color"].as<String>() == "red") {
-            m_state->setState(States::TEST_LED_RED);
-        }
+                // set led to green
+                if (strcmp(color, "green") == 0) {
+                    m_state->setState(States::TEST_LED_GREEN);
+                }
 
-        // set led to green
-        if (webSocketJsonDocument["color"].as<String>() == "green") {
-            m_state->setState(States::TEST_LED_GREEN);
-        }
+                // set led to blue
+                if (strcmp(color, "blue") == 0) {
+                    m_state->setState(States::TEST_LED_BLUE);
+                }
+                break;
+            }
+            case ApiCommand::RgbTestStop:
+                m_state->setState(m_prevState);
+                Log.debug(m_ctx, "Led test stop");
+                break;
+            case ApiCommand::IrTest:
+                Log.debug(m_ctx, "IR Led test start");
+                setIrTestLeds(true);
+                // switched off by the API task
+                m_irTestTimer.start(millis());
+                break;
+            case ApiCommand::IrSend: {
+                Log.debug(m_ctx, "IR Send");
 
-        // set led to blue
-        if (webSocketJsonDocument["color"].as<String>() == "blue") {
-            m_state->setState(States::TEST_LED_BLUE);
-        }
+                // views into the request buffer: the code is only copied once into the IR send message
+                const char* code = fields.getString(ApiField::Code);
+                size_t      codeLength = fields.getStringLength(ApiField::Code);
+                const char* format = fields.getString(ApiField::Format, "");
+                uint16_t    response = 400;
+                // MessagePack request: the code can be an array of numbers instead of the code text
+                MsgPackUintReader codeValues;
+                bool              binaryCode = getMsgPackArray(fields, ApiField::Code, &codeValues);
 
-    } else if (command == "rgb_test_stop") {
-        m_state->setState(m_prevState);
-        Log.debug(m_ctx, "Led test stop");
-    } else if (command == "ir_test") {
-        Log.debug(m_ctx, "IR Led test start");
-        digitalWrite(IR_SEND_PIN_INT_SIDE, HIGH);
-#ifdef IR_SEND_PIN_INT_TOP
-        digitalWrite(IR_SEND_PIN_INT_TOP, HIGH);
-#endif
-        digitalWrite(IR_SEND_PIN_EXT_1, HIGH);
-#ifdef IR_SEND_PIN_EXT_2
-        digitalWrite(IR_SEND_PIN_EXT_2, HIGH);
-#endif
-        delay(2500);
-        digitalWrite(IR_SEND_PIN_INT_SIDE, LOW);
-#ifdef IR_SEND_PIN_INT_TOP
-        digitalWrite(IR_SEND_PIN_INT_TOP, LOW);
-#endif
-        digitalWrite(IR_SEND_PIN_EXT_1, LOW);
-#ifdef IR_SEND_PIN_EXT_2
-        digitalWrite(IR_SEND_PIN_EXT_2, LOW);
-#endif
-        Log.debug(m_ctx, "IR Led test ended");
-    } else if (command == "ir_send") {
-        Log.debug(m_ctx, "IR Send");
-
-        String   code = webSocketJsonDocument["code"].as<String>();
-        String   format = webSocketJsonDocument["format"].as<String>();
-        bool     success = false;
-        uint16_t response = 400;
-
-        if (!code.isEmpty() && !format.isEmpty()) {
-            uint16_t repeat = webSocketJsonDocument["repeat"].as<uint16_t>();
-            bool     intSide = webSocketJsonDocument["int_side"].as<bool>();
-            bool     intTop = webSocketJsonDocument["int_top"].as<bool>();
-            bool     ext1 = webSocketJsonDocument["ext1"].as<bool>();
-            bool     ext2 = webSocketJsonDocument["ext2"].as<bool>();
-
-            // default outputs if not specified
-            if (!(intSide || intTop || ext1 || ext2)) {
-                intSide = ext1 = ext2 = true;
-            }
+                if ((codeLength || binaryCode) && *format) {
+                    uint16_t repeat = fields.getInt<uint16_t>(ApiField::Repeat);
+                    bool     intSide = fields.getBool(ApiField::IntSide);
+                    bool     intTop = fields.getBool(ApiField::IntTop);
+                    bool     ext1 = fields.getBool(ApiField::Ext1);
+                    bool     ext2 = fields.getBool(ApiField::Ext2);
 
-            int reqId = webSocketJsonDocument[msgId].as<int>();
-            response = m_irService->send(id, reqId, code, format, repeat, intSide, intTop, ext1, ext2);
-            if (response == 0) {
-                // asynchronous reply
-                return true;
+                    // default outputs if not specified
+                    if (!(intSide || intTop || ext1 || ext2)) {
+                        intSide = ext1 = ext2 = true;
+                    }
+
+                    // optional absolute send time in microseconds since the Unix epoch (UTC)
+                    int64_t sendAt = fields.getInt<int64_t>(ApiField::SendAt);
+
+                    // optional priority class: normal, high, preempt
+                    IrSendPriority priority;
+                    if (parseIrSendPriority(fields.getString(ApiField::Priority), &priority)) {
+                        bool resume = fields.getBool(ApiField::Resume);
+                        int  reqId = fields.getInt<int>(ApiField::Id);
+                        if (binaryCode) {
+                            response = m_irService->send(id, reqId, parseIrFormat(format), codeValues, repeat,
+                                                         intSide, intTop, ext1, ext2, sendAt, priority, resume);
+                        } else {
+                            response = m_irService->send(id, reqId, code, codeLength, format, repeat, intSide,
+                                                         intTop, ext1, ext2, 0, sendAt, priority, resume);
+                        }
+                        if (response == 0) {
+                            // asynchronous reply
+                            return true;
+                        }
+                    }
+                }
+                responseDoc[msgCode] = response;
+                break;
             }
-        }
-        responseDoc[msgCode] = response;
-    } else if (command == "ir_stop") {
-        m_irService->stopSend();
-        responseDoc[msgCode] = 200;
-    } else if (command == "ir_receive_on") {
-        m_irService->startIrLearn();
-        Log.debug(m_ctx, "IR Receive on");
-    } else if (command == "ir_receive_off") {
-        m_irService->stopIrLearn();
-        Log.debug(m_ctx, "IR Receive off");
-    } else if (command == "remote_charged") {
-        m_state->setState(States::NORMAL_FULLYCHARGED);
-    } else if (command == "remote_lowbattery") {
-        m_state->setState(States::NORMAL_LOWBATTERY);
-    } else if (command == "remote_normal") {
-        m_state->setState(States::NORMAL);
-    } else if (command == "identify") {
-        m_state->setState(States::IDENTIFY);
-    } else if (command == "set_logging") {
-        bool ok = false;
-        if (webSocketJsonDocument.containsKey("log_level")) {
-            uint16_t level = webSocketJsonDocument["log_level"].as<uint16_t>();
-            if (level >= 0 && level <= 7) {
-                auto logLevel = static_cast<UCLog::Level>(level);
-                ok = m_config->setLogLevel(logLevel);
-                Log.setFilterLevel(logLevel);
+            case ApiCommand::IrSendGroup: {
+                Log.debug(m_ctx, "IR Send group");
+
+                const char* code = fields.getString(ApiField::Code);
+                size_t      codeLength = fields.getStringLength(ApiField::Code);
+                const char* format = fields.getString(ApiField::Format, "");
+                uint16_t    response = 400;
+
+                if (codeLength && *format) {
+                    uint16_t repeat = fields.getInt<uint16_t>(ApiField::Repeat);
+                    uint8_t  outputs = 0;
+                    if (fields.getBool(ApiField::IntSide)) {
+                        outputs |= IR_GROUP_INT_SIDE;
+                    }
+                    if (fields.getBool(ApiField::IntTop)) {
+                        outputs |= IR_GROUP_INT_TOP;
+                    }
+                    if (fields.getBool(ApiField::Ext1)) {
+                        outputs |= IR_GROUP_EXT_1;
+                    }
+                    if (fields.getBool(ApiField::Ext2)) {
+                        outputs |= IR_GROUP_EXT_2;
+                    }
+                    // default outputs if not specified
+                    if (outputs == 0) {
+                        outputs = IR_GROUP_INT_SIDE | IR_GROUP_EXT_1 | IR_GROUP_EXT_2;
+                    }
+
+                    // optional absolute send time, otherwise `delay` milliseconds from now
+                    int64_t  sendAt = fields.getInt<int64_t>(ApiField::SendAt);
+                    uint32_t delayMs = fields.getInt<uint32_t>(ApiField::Delay, IR_GROUP_DEFAULT_DELAY_MS);
+
+                    // submit locally first: the other docks only get codes this dock sends as well
+                    response = m_irGroupServer->prepare(format, codeLength, &sendAt, delayMs);
+                    if (response == 0) {
+                        int reqId = fields.getInt<int>(ApiField::Id);
+                        response = m_irService->send(id, reqId, code, codeLength, format, repeat,
+                                                     outputs & IR_GROUP_INT_SIDE, outputs & IR_GROUP_INT_TOP,
+                                                     outputs & IR_GROUP_EXT_1, outputs & IR_GROUP_EXT_2, 0, sendAt);
+                    }
+                    if (response == 0) {
+                        uint16_t groupResponse =
+                            m_irGroupServer->send(code, codeLength, format, repeat, outputs, &sendAt, delayMs);
+                        if (groupResponse) {
+                            // the local send can't be revoked anymore, the reply only covers this dock
+                            Log.logf(Log.WARN, m_ctx, "Group send failed, sending only locally: %d", groupResponse);
+                        }
+                        // asynchronous reply
+                        return true;
+                    }
+                }
+                responseDoc[msgCode] = response;
+                break;
             }
-        }
-        if (webSocketJsonDocument.containsKey("syslog_server")) {
-            String   server = webSocketJsonDocument["syslog_server"].as<String>();
-            uint16_t port = webSocketJsonDocument["syslog_port"].as<uint16_t>();
-            ok = m_config->setSyslogServer(server, port);
-        }
-        if (webSocketJsonDocument.containsKey("syslog_enabled")) {
-            bool syslog = webSocketJsonDocument["syslog_enabled"].as<bool>();
-            m_config->enableSyslog(syslog);
-            if (syslog) {
-                Log.enableSyslog(m_config->getHostName(), m_config->getSyslogServer(), m_config->getSyslogServerPort());
-            } else {
-                Log.enableSyslog(false);
+            case ApiCommand::IrStop:
+                m_irService->stopSend();
+                responseDoc[msgCode] = 200;
+                break;
+            case ApiCommand::IrReceiveOn:
+                // the requesting client receives the learned codes without subscribing
+                if (source == WebSocket) {
+                    m_subscriptions.subscribe(id, apiTopicBit(ApiTopic::IrReceive));
+                }
+                m_irService->startIrLearn();
+                Log.debug(m_ctx, "IR Receive on");
+                break;
+            case ApiCommand::IrReceiveOff:
+                m_irService->stopIrLearn();
+                Log.debug(m_ctx, "IR Receive off");
+                break;
+            case ApiCommand::RemoteCharged:
+                m_state->setState(States::NORMAL_FULLYCHARGED);
+                break;
+            case ApiCommand::RemoteLowBattery:
+                m_state->setState(States::NORMAL_LOWBATTERY);
+                break;
+            case ApiCommand::RemoteNormal:
+                m_state->setState(States::NORMAL);
+                break;
+            case ApiCommand::Identify:
+                m_state->setState(States::IDENTIFY);
+                break;
+            case ApiCommand::SetLogging: {
+                bool ok = false;
+                if (fields.has(ApiField::LogLevel)) {
+                    uint16_t level = fields.getInt<uint16_t>(ApiField::LogLevel);
+                    if (level >= 0 && level <= 7) {
+                        auto logLevel = static_cast<UCLog::Level>(level);
+                        ok = m_config->setLogLevel(logLevel);
+                        Log.setFilterLevel(logLevel);
+                    }
+                }
+                if (fields.has(ApiField::SyslogServer)) {
+                    String   server = String(fields.getString(ApiField::SyslogServer, ""));
+                    uint16_t port = fields.getInt<uint16_t>(ApiField::SyslogPort);
+                    ok = m_config->setSyslogServer(server, port);
+                }
+                if (fields.has(ApiField::SyslogEnabled)) {
+                    bool syslog = fields.getBool(ApiField::SyslogEnabled);
+                    m_config->enableSyslog(syslog);
+                    if (syslog) {
+                        Log.enableSyslog(m_config->getHostName(), m_config->getSyslogServer(),
+                                         m_config->getSyslogServerPort());
+                    } else {
+                        Log.enableSyslog(false);
+                    }
+                }
+                responseDoc[msgCode] = ok ? 200 : 400;
+                break;
             }
-        }
-        responseDoc[msgCode] = ok ? 200 : 400;
-    } else if (command == "set_sntp") {
-        bool ok = true;
-        if (webSocketJsonDocument.containsKey("sntp_server1") || webSocketJsonDocument.containsKey("sntp_server2")) {
-            String server1 = webSocketJsonDocument["sntp_server1"].as<String>();
-            String server2 = webSocketJsonDocument["sntp_server2"].as<String>();
-            if (!m_config->setNtpServer(server1, server2)) {
-                ok = false;
+            case ApiCommand::SetSntp: {
+                bool ok = true;
+                if (fields.has(ApiField::SntpServer1) || fields.has(ApiField::SntpServer2)) {
+                    String server1 = String(fields.getString(ApiField::SntpServer1, ""));
+                    String server2 = String(fields.getString(ApiField::SntpServer2, ""));
+                    if (!m_config->setNtpServer(server1, server2)) {
+                        ok = false;
+                    }
+                }
+                if (fields.has(ApiField::SntpEnabled)) {
+                    bool enabled = fields.getBool(ApiField::SntpEnabled);
+                    if (!m_config->enableNtp(enabled)) {
+                        ok = false;
+                    }
+                }
+                responseDoc[msgCode] = ok ? 200 : 400;
+                break;
             }
-        }
-        if (webSocketJsonDocument.containsKey("sntp_enabled")) {
-            bool enabled = webSocketJsonDocument["sntp_enabled"].as<bool>();
-            if (!m_config->enableNtp(enabled)) {
-                ok = false;
+            case ApiCommand::Reboot: {
+                Log.warn(m_ctx, "Rebooting");
+                responseDoc["reboot"] = true;
+                respond(responseDoc, encoding, cb);
+                shutdown(ApiShutdown::Reboot, source, id);
+                return true;
             }
-        }
-        responseDoc[msgCode] = ok ? 200 : 400;
-    } else if (command == "reboot") {
-        Log.warn(m_ctx, "Rebooting");
-        String message;
-        responseDoc["reboot"] = true;
-        serializeJson(responseDoc, message);
-        cb(message);
-        delay(200);
-        if (source == Source::WebSocket) {
-            m_webSocketServer.disconnect(id);
-        }
-        m_state->reboot();
-        return true;
-    } else if (command == "reset") {
-        Log.warn(m_ctx, "Reset");
-        String message;
-        responseDoc["reboot"] = true;
-        serializeJson(responseDoc, message);
-        cb(message);
-        delay(200);
-        if (source == Source::WebSocket) {
-            m_webSocketServer.disconnect(id);
-        }
-        m_config->reset();
-        return true;
-    } else if (command == "set_ir_config") {
-        bool ok = true;
-        if (webSocketJsonDocument.containsKey("irlearn_core")) {
-            uint16_t value = webSocketJsonDocument["irlearn_core"].as<uint16_t>();
-            if (!m_config->setIrLearnCore(value)) {
-                ok = false;
+            case ApiCommand::Reset: {
+                Log.warn(m_ctx, "Reset");
+                responseDoc["reboot"] = true;
+                respond(responseDoc, encoding, cb);
+                shutdown(ApiShutdown::Reset, source, id);
+                return true;
             }
-        }
-        if (webSocketJsonDocument.containsKey("irlearn_prio")) {
-            uint16_t value = webSocketJsonDocument["irlearn_prio"].as<uint16_t>();
-            if (!m_config->setIrLearnPriority(value)) {
-                ok = false;
+            case ApiCommand::SetIrConfig: {
+                bool ok = true;
+                if (fields.has(ApiField::IrlearnCore)) {
+                    uint16_t value = fields.getInt<uint16_t>(ApiField::IrlearnCore);
+                    if (!m_config->setIrLearnCore(value)) {
+                        ok = false;
+                    }
+                }
+                if (fields.has(ApiField::IrlearnPrio)) {
+                    uint16_t value = fields.getInt<uint16_t>(ApiField::IrlearnPrio);
+                    if (!m_config->setIrLearnPriority(value)) {
+                        ok = false;
+                    }
+                    m_irService->setIrLearnPriority(value);
+                }
+                if (fields.has(ApiField::IrsendCore)) {
+                    uint16_t value = fields.getInt<uint16_t>(ApiField::IrsendCore);
+                    if (!m_config->setIrSendCore(value)) {
+                        ok = false;
+                    }
+                }
+                if (fields.has(ApiField::IrsendPrio)) {
+                    uint16_t value = fields.getInt<uint16_t>(ApiField::IrsendPrio);
+                    if (!m_config->setIrSendPriority(value)) {
+                        ok = false;
+                    }
+                    m_irService->setIrSendPriority(value);
+                }
+                if (fields.has(ApiField::GroupKey)) {
+                    String value = String(fields.getString(ApiField::GroupKey, ""));
+                    if (m_config->setIrGroupKey(value)) {
+                        m_irGroupServer->setGroupKey(value);
+                    } else {
+                        ok = false;
+                    }
+                }
+                if (fields.has(ApiField::RatelimitBurst) || fields.has(ApiField::RatelimitRate)) {
+                    RateLimit limit = m_rateLimiter->connectionLimit();
+                    limit.burst = fields.getInt(ApiField::RatelimitBurst, limit.burst);
+                    limit.rate = fields.getInt(ApiField::RatelimitRate, limit.rate);
+                    if (m_config->setRateLimit(limit)) {
+                        m_rateLimiter->setConnectionLimit(limit);
+                    } else {
+                        ok = false;
+                    }
+                }
+                if (fields.has(ApiField::RatelimitIpBurst) || fields.has(ApiField::RatelimitIpRate)) {
+                    RateLimit limit = m_rateLimiter->ipLimit();
+                    limit.burst = fields.getInt(ApiField::RatelimitIpBurst, limit.burst);
+                    limit.rate = fields.getInt(ApiField::RatelimitIpRate, limit.rate);
+                    if (m_config->setIpRateLimit(limit)) {
+                        m_rateLimiter->setIpLimit(limit);
+                    } else {
+                        ok = false;
+                    }
+                }
+                if (fields.has(ApiField::GcLearnCompressed)) {
+                    bool value = fields.getBool(ApiField::GcLearnCompressed);
+                    if (m_config->setGcLearnCompressed(value)) {
+                        m_irService->setGlobalCacheLearnFormat(value);
+                    } else {
+                        ok = false;
+                    }
+                }
+                responseDoc[msgCode] = ok ? 200 : 500;
+                break;
             }
-            m_irService->setIrLearnPriority(value);
-        }
-        if (webSocketJsonDocument.containsKey("irsend_core")) {
-            uint16_t value = webSocketJsonDocument["irsend_core"].as<uint16_t>();
-            if (!m_config->setIrSendCore(value)) {
-                ok = false;
+            case ApiCommand::GetIrConfig: {
+                responseDoc["irlearn_core"] = m_config->getIrLearnCore();
+                responseDoc["irlearn_prio"] = m_config->getIrLearnPriority();
+                responseDoc["irsend_core"] = m_config->getIrSendCore();
+                responseDoc["irsend_prio"] = m_config->getIrSendPriority();
+                responseDoc["group_enabled"] = m_irGroupServer->isEnabled();
+                RateLimit limit = m_rateLimiter->connectionLimit();
+                responseDoc["ratelimit_burst"] = limit.burst;
+                responseDoc["ratelimit_rate"] = limit.rate;
+                limit = m_rateLimiter->ipLimit();
+                responseDoc["ratelimit_ip_burst"] = limit.burst;
+                responseDoc["ratelimit_ip_rate"] = limit.rate;
+                RateLimitStats stats = m_rateLimiter->stats();
+                responseDoc["throttled_conn"] = stats.throttledConnection;
+                responseDoc["throttled_ip"] = stats.throttledIp;
+                TcpLoopStats gcStats = m_gcServer->connectionStats();
+                responseDoc["gc_connections"] = gcStats.accepted - gcStats.closed;
+                responseDoc["gc_peak_connections"] = gcStats.peakConnections;
+                responseDoc["gc_accepted"] = gcStats.accepted;
+                responseDoc["gc_evicted"] = gcStats.evicted;
+                responseDoc["gc_rejected"] = gcStats.rejected;
+                responseDoc["gc_learn_compressed"] = m_config->getGcLearnCompressed();
+                break;
             }
-        }
-        if (webSocketJsonDocument.containsKey("irsend_prio")) {
-            uint16_t value = webSocketJsonDocument["irsend_prio"].as<uint16_t>();
-            if (!m_config->setIrSendPriority(value)) {
-                ok = false;
+            case ApiCommand::Subscribe:
+            case ApiCommand::Unsubscribe: {
+                uint8_t topics;
+                if (id < 0 || !parseApiTopics(fields.getString(ApiField::Topics), &topics)) {
+                    responseDoc[msgCode] = 400;
+                    responseDoc[msgError] = "Invalid topics";
+                    break;
+                }
+                if (info.command == ApiCommand::Subscribe) {
+                    m_subscriptions.subscribe(id, topics);
+                } else {
+                    m_subscriptions.unsubscribe(id, topics);
+                }
+                char subscribed[48];
+                formatApiTopics(m_subscriptions.topics(id), subscribed, sizeof(subscribed));
+                responseDoc["topics"] = subscribed;
+                responseDoc[msgCode] = 200;
+                break;
             }
-            m_irService->setIrSendPriority(value);
+            case ApiCommand::Unknown:
+                break;
         }
-        responseDoc[msgCode] = ok ? 200 : 500;
-    } else if (command == "get_ir_config") {
-        responseDoc["irlearn_core"] = m_config->getIrLearnCore();
-        responseDoc["irlearn_prio"] = m_config->getIrLearnPriority();
-        responseDoc["irsend_core"] = m_config->getIrSendCore();
-        responseDoc["irsend_prio"] = m_config->getIrSendPriority();
-    } else {
-        responseDoc[msgCode] = 400;
-        responseDoc[msgError] = command.isEmpty() ? "Missing command field" : "Unsupported command";
     }
 
-    String message;
-    serializeJson(responseDoc, message);
-    cb(message);
+    respond(responseDoc, encoding, cb);
     return true;
 }
 
 void API::sendMessage(String msg) {
-    for (auto iter = m_authWsClients.begin(); iter != m_authWsClients.end(); ++iter) {
-        m_webSocketServer.sendTXT((*iter), msg);
+    sendWsMessage(msg, m_authWsClients, OutboundKind::Event);
+}
+
+void API::publish(ApiTopic topic, const JsonDocument& event) {
+    WsClientSet          clients = subscribers(topic);
+    String               json;
+    std::vector<uint8_t> msgpack;
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+        if (!clients.contains(num) || !m_webSocketServer.clientIsConnected(num)) {
+            continue;
+        }
+        if (m_wsEncoding[num] == ApiEncoding::Json) {
+            if (json.isEmpty()) {
+                serializeJson(event, json);
+            }
+            queueWsMessage(num, json.c_str(), json.length(), false, OutboundKind::Event);
+        } else {
+            if (msgpack.empty()) {
+                msgpack.resize(measureMsgPack(event));
+                serializeMsgPack(event, msgpack.data(), msgpack.size());
+            }
+            queueWsMessage(num, reinterpret_cast<const char*>(msgpack.data()), msgpack.size(), true,
+                           OutboundKind::Event);
+        }
+    }
+}
+
+void API::publishEvents() {
+    States state = m_state->getState();
+    if (state != m_publishedState) {
+        m_publishedState = state;
+        if (!subscribers(ApiTopic::State).empty()) {
+            StaticJsonDocument<96> event;
+            event[msgType] = "event";
+            event[msgMsg] = "state";
+            event["state"] = static_cast<int>(state);
+            publish(ApiTopic::State, event);
+        }
+    }
+
+    if (m_metricsTimer.expired(millis()) && !subscribers(ApiTopic::Metrics).empty()) {
+        StaticJsonDocument<1024> event;
+        event[msgType] = "event";
+        event[msgMsg] = "metrics";
+        event["uptime"] = m_state->getUptime();
+        event["free_heap"] = ESP.getFreeHeap();
+        event["ws_clients"] = m_webSocketServer.connectedClients(false);
+        event["ir_learning"] = m_irService->isIrLearning();
+        RateLimitStats stats = m_rateLimiter->stats();
+        event["throttled_conn"] = stats.throttledConnection;
+        event["throttled_ip"] = stats.throttledIp;
+        TcpLoopStats gcStats = m_gcServer->connectionStats();
+        event["gc_connections"] = gcStats.accepted - gcStats.closed;
+        event["gc_rejected"] = gcStats.rejected;
+        event["ws_slow_disconnects"] = m_wsSlowDisconnects;
+        JsonArray queues = event.createNestedArray("ws_queues");
+        for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+            if (!m_webSocketServer.clientIsConnected(num)) {
+                continue;
+            }
+            const OutboundQueue<API_WS_QUEUE_SIZE>& queue = m_wsQueues[num];
+            JsonObject                              client = queues.createNestedObject();
+            client["client"] = num;
+            client["queued"] = queue.messages();
+            client["queued_bytes"] = queue.bytes();
+            client["peak_bytes"] = queue.stats().peakBytes;
+            client["sent"] = queue.stats().sent;
+            client["dropped"] = queue.stats().droppedEvents;
+        }
+        publish(ApiTopic::Metrics, event);
     }
 }
@@ -6,16 +6,102 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <WebSocketsServer.h>
+#include <api_topics.hpp>
 #include <config.h>
+#include <event_queue.hpp>
+#include <globalcache_server.h>
+#include <interval_timer.hpp>
+#include <ir_group_server.h>
 #include <led_control.h>
+#include <msgpack.hpp>
+#include <outbound_queue.hpp>
+#include <rate_limiter.hpp>
+#include <request_framer.hpp>
 #include <service_ir.h>
 #include <service_network.h>
 #include <state.h>
 
-#include <unordered_set>
+// API task: runs above the Arduino loop task, so slow or blocking services can't delay API requests
+#define API_TASK_STACK_SIZE 8192
+#define API_TASK_PRIORITY 2
+// Maximum wait time of the API task. The WebSocket server socket and data already buffered in a WiFiClient can't be
+// waited for: new connections and buffered messages are polled in this interval.
+#define API_POLL_INTERVAL_MS 10
+#define API_EVENT_QUEUE_SIZE 8
+// Receive buffer and maximum request length of the UART and Bluetooth transports
+#define API_SERIAL_BUFFER_SIZE 1024
+// Interval of the `metrics` topic events
+#define API_METRICS_INTERVAL_MS 10000
+// Duration of the `ir_test` command with all IR LEDs on
+#define API_IR_TEST_DURATION_MS 2500
+// Outbound message queue per WebSocket client. Events may use half of it, see `OutboundQueue`. The queue size also
+// limits the message size: a message and its WebSocket frame header must fit into the free send buffer of a writable
+// socket, see `API::flushWsClients`.
+#define API_WS_QUEUE_SIZE 2048
+// Slow consumer policy: a client is disconnected if it didn't take a queued message for this time, if this many events
+// were dropped since it took the last message, or if a response doesn't fit into its queue.
+#define API_WS_STALL_TIMEOUT_MS 5000
+#define API_WS_MAX_DROPPED_EVENTS 20
+// Maximum wait time for the response to a WebSocket reboot or reset request to be sent before the dock restarts
+#define API_SHUTDOWN_TIMEOUT_MS 2000
 
-// Callback function for the API response message
-typedef std::function<void(String)> ApiResponseCallbackFunction;
+// Callback function for the API response message: JSON text, or MessagePack data if the request was MessagePack
+typedef std::function<void(const char* response, size_t length)> ApiResponseCallbackFunction;
+
+typedef ClientSet<WEBSOCKETS_SERVER_CLIENT_MAX> WsClientSet;
+
+// Restart of the dock after the response to the requesting client has been sent
+enum class ApiShutdown : uint8_t {
+    None,
+    Reboot,
+    // reset the configuration and reboot
+    Reset,
+};
+
+// Events waking up the API task, in addition to received WebSocket data
+enum class ApiEvent : uint8_t {
+    IrResponse,
+    SerialInput,
+};
+
+// WebSocket server exposing the client sockets, to wait for received data and send buffer space with `select()`
+class ApiWebSocketServer : public WebSocketsServer {
+ public:
+    explicit ApiWebSocketServer(uint16_t port) : WebSocketsServer(port) {}
+
+    /**
+     * Get the socket of a client.
+     *
+     * @return -1 if the client isn't connected.
+     */
+    int clientSocket(uint8_t num) {
+        if (num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+            return -1;
+        }
+        WSclient_t& client = _clients[num];
+        if (client.status == WSC_NOT_CONNECTED || client.tcp == nullptr || !client.tcp->connected()) {
+            return -1;
+        }
+        return client.tcp->fd();
+    }
+
+    /**
+     * Add the sockets of the connected clients to a `select()` read set.
+     *
+     * @param maxFd highest socket in `readSet`, -1 if empty.
+     * @return the highest socket in `readSet` including the client sockets.
+     */
+    int addClientSockets(fd_set* readSet, int maxFd) {
+        for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+            int fd = clientSocket(i);
+            if (fd >= 0) {
+                FD_SET(fd, readSet);
+                maxFd = fd > maxFd ? fd : maxFd;
+            }
+        }
+        return maxFd;
+    }
+};
 
 class API {
  public:
@@ -25,40 +111,119 @@ class API {
         Bluetooth = 2,
     };
     explicit API(Config* config, State* state, NetworkService* networkService, InfraredService* irService,
-                 LedControl* ledControl);
+                 IrGroupServer* irGroupServer, LedControl* ledControl, ClientRateLimiter* rateLimiter,
+                 GlobalCacheServer* gcServer);
     virtual ~API() {}
 
+    /**
+     * Start the WebSocket server and the API task.
+     *
+     * The API task handles WebSocket clients, serial requests and IR responses. It sleeps until one of them has an
+     * event, instead of being polled from the Arduino loop.
+     */
     void init();
-    void loop();
 
     /**
      * Process an API request.
-     * 
-     * The buffer must contain a JSON message and must be writeable for the ArduinoJson library to use zero-copy
-    */
-    bool processRequest(char* request, Source source, ApiResponseCallbackFunction cb, bool authenticated = true,
-                        int id = -1);
+     *
+     * The buffer must contain a JSON or MessagePack message and must be writeable: the request fields are zero-copy
+     * views into it. A JSON message must be zero-terminated. The response is sent in the encoding of the request.
+     * Can be called from any task, requests are processed one at a time.
+     */
+    bool processRequest(char* request, size_t length, ApiEncoding encoding, Source source,
+                        ApiResponseCallbackFunction cb, bool authenticated = true, int id = -1);
 
     /**
-     * Send a message to all authenticated clients
+     * Send a message to all authenticated clients. Must be called from the API task.
      */
     void sendMessage(String msg);
 
+    /**
+     * Write an API response to a serial transport: a JSON response terminated by a newline, or a MessagePack response
+     * with a frame header.
+     */
+    static void writeResponse(Stream* stream, const char* response, size_t length, ApiEncoding encoding);
+
  private:
+    static void api_task(void* param);
+    // wait for and handle the next events
+    void runOnce();
+    bool handleRequest(char* request, size_t length, ApiEncoding encoding, Source source,
+                       const ApiResponseCallbackFunction& cb, bool authenticated, int id);
+    // process all complete requests received on the UART. Never blocks.
     void handleSerial();
-    // writeable buffer required to use ArduinoJson zero-copy
-    void processWsRequest(char* request, int id);
+    // send all queued IR responses
+    void sendIrResponses();
+    // writeable buffer required for zero-copy request parsing
+    void processWsRequest(char* request, size_t length, ApiEncoding encoding, int id);
+    // serialize a response document in the request encoding
+    void respond(const JsonDocument& doc, ApiEncoding encoding, const ApiResponseCallbackFunction& cb);
+    // send a JSON message to WebSocket clients in their negotiated encoding. The message is converted to MessagePack
+    // at most once.
+    void sendWsMessage(const String& msg, WsClientSet clients, OutboundKind kind);
+    // queue a message to a WebSocket client. Never blocks, the message is sent by `flushWsClients`.
+    void queueWsMessage(uint8_t num, const char* data, size_t length, bool binary, OutboundKind kind);
+    // send the queued messages of all clients which can take more data without blocking, and disconnect slow clients
+    void flushWsClients();
+    // add the sockets of the clients with queued messages to a `select()` write set
+    int addPendingWsClients(fd_set* writeSet, int maxFd);
+    // disconnect a WebSocket client once its queued messages are sent, e.g. after its last response. Never blocks.
+    void closeWsClient(int num);
+    // check if a WebSocket client is waiting to be disconnected after its queued messages
+    bool closingWsClients() const;
+    // reboot or reset after the response has been sent. A WebSocket response is only queued: the API task restarts the
+    // dock once the requesting client is disconnected, see `API_SHUTDOWN_TIMEOUT_MS`.
+    void shutdown(ApiShutdown action, Source source, int id);
+    void performShutdown(ApiShutdown action);
+    // send an event to the authenticated subscribers of a topic. The event is serialized at most once per encoding.
+    void publish(ApiTopic topic, const JsonDocument& event);
+    // authenticated subscribers of a topic
+    WsClientSet subscribers(ApiTopic topic) const { return m_subscriptions.subscribers(topic) & m_authWsClients; }
+    // send state change and metrics events
+    void publishEvents();
+    // switch all IR LEDs on or off for the `ir_test` command
+    static void setIrTestLeds(bool on);
+
+    ApiWebSocketServer                               m_webSocketServer = ApiWebSocketServer(Config::API_port);
+    WsClientSet                                      m_authWsClients;
+    TopicSubscriptions<WEBSOCKETS_SERVER_CLIENT_MAX> m_subscriptions;
+    // request rate limit and IP address per WebSocket client
+    TokenBucket                                      m_wsRateLimits[WEBSOCKETS_SERVER_CLIENT_MAX];
+    uint32_t                                         m_wsClientIps[WEBSOCKETS_SERVER_CLIENT_MAX] = {};
+    // message encoding per WebSocket client, negotiated at authentication
+    ApiEncoding                                      m_wsEncoding[WEBSOCKETS_SERVER_CLIENT_MAX] = {};
+    // outbound messages per WebSocket client, sent when the client socket can take more data
+    OutboundQueue<API_WS_QUEUE_SIZE>                 m_wsQueues[WEBSOCKETS_SERVER_CLIENT_MAX];
+    // slow clients to disconnect in the next flush
+    WsClientSet                                      m_wsSlowClients;
+    uint32_t                                         m_wsSlowDisconnects = 0;
+    // queued message being sent, with space for the WebSocket frame header in front of it
+    char                                             m_wsSendBuffer[WEBSOCKETS_MAX_HEADER_SIZE + API_WS_QUEUE_SIZE];
 
-    WebSocketsServer            m_webSocketServer = WebSocketsServer(Config::API_port);
-    std::unordered_set<uint8_t> m_authWsClients;
+    Config*            m_config;
+    State*             m_state;
+    NetworkService*    m_networkService;
+    InfraredService*   m_irService;
+    IrGroupServer*     m_irGroupServer;
+    LedControl*        m_ledControl;
+    ClientRateLimiter* m_rateLimiter;
+    GlobalCacheServer* m_gcServer;
 
-    Config*          m_config;
-    State*           m_state;
-    NetworkService*  m_networkService;
-    InfraredService* m_irService;
-    LedControl*      m_ledControl;
+    States        m_prevState;
+    // last state sent to the `state` topic
+    States        m_publishedState = States::NOT_SET;
+    IntervalTimer m_metricsTimer = IntervalTimer(API_METRICS_INTERVAL_MS);
+    // switches the IR LEDs off after `ir_test` without blocking the API task
+    OneShotTimer  m_irTestTimer = OneShotTimer(API_IR_TEST_DURATION_MS);
+    // restart requested by a WebSocket client, performed by the API task
+    ApiShutdown   m_pendingShutdown = ApiShutdown::None;
+    OneShotTimer  m_shutdownTimer = OneShotTimer(API_SHUTDOWN_TIMEOUT_MS);
 
-    States m_prevState;
+    TaskHandle_t                                     m_task = nullptr;
+    SocketEventQueue<ApiEvent, API_EVENT_QUEUE_SIZE> m_events;
+    // serializes requests from the API task and the Bluetooth service
+    SemaphoreHandle_t                                m_requestMutex = nullptr;
+    RequestFramer<API_SERIAL_BUFFER_SIZE>            m_serialFramer;
 
     const char* m_ctx = "API";
 };
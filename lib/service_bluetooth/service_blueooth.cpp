@@ -30,7 +30,6 @@ void BluetoothService::init() {
     m_bluetooth.register_callback(Bt_Status);
 
     if (m_bluetooth.begin(m_config->getHostName())) {
-        m_bluetooth.setTimeout(500);
         Log.info(m_ctx, "Initialized. Ready for setup.");
     } else {
         Log.error(m_ctx, "Failed to initialize.");
@@ -38,23 +37,31 @@ void BluetoothService::init() {
 }
 
 void BluetoothService::handle() {
-    if (!m_bluetooth.available()) {
+    if (!m_bluetooth.hasClient()) {
+        // drop a partial request of a disconnected client
+        m_framer.clear();
         return;
     }
 
-    // Hackish but simple: rely on single line json messages terminated by newline.
-    // Avoids writing a parser with proper curly brackets handling...
-    // TODO(zehnm) recheck ArduinoJson library if it supports streaming input
-    char buffer[1024];
-    auto count = m_bluetooth.readBytesUntil('\n', buffer, sizeof(buffer) - 1);
-    if (count > 0) {
-        buffer[count] = '0';  // readBytesUntil doesn't zero-terminate the buffer!
-        m_api->processRequest(buffer, API::Bluetooth, [this](String response) -> void {
-            Log.logf(Log.DEBUG, m_ctx, "Sending response: '%s'", response.c_str());
-            if (!response.isEmpty()) {
-                m_bluetooth.println(response);
-                m_bluetooth.flush();
-            }
-        });
+    auto handler = [this](char *request, size_t length, ApiEncoding encoding) -> void {
+        m_api->processRequest(request, length, encoding, API::Bluetooth,
+                              [this, encoding](const char *response, size_t length) -> void {
+                                  if (length == 0) {
+                                      return;
+                                  }
+                                  if (encoding == ApiEncoding::Json) {
+                                      Log.logf(Log.DEBUG, m_ctx, "Sending response: '%s'", response);
+                                  }
+                                  API::writeResponse(&m_bluetooth, response, length, encoding);
+                              });
+    };
+
+    // JSON requests are single lines terminated by a newline, MessagePack requests are length-prefixed. Only the
+    // available data is read: a slow phone must not stall the main loop.
+    char     request[API_SERIAL_BUFFER_SIZE];
+    uint32_t discarded = m_framer.discarded();
+    m_framer.receive(&m_bluetooth, request, sizeof(request), handler);
+    if (m_framer.discarded() != discarded) {
+        Log.logf(Log.WARN, m_ctx, "Discarded request exceeding %d bytes", API_SERIAL_BUFFER_SIZE);
     }
 }
@@ -6,6 +6,7 @@
 #include <Arduino.h>
 #include <BluetoothSerial.h>
 #include <config.h>
+#include <request_framer.hpp>
 #include <service_api.h>
 #include <state.h>
 
@@ -15,13 +16,15 @@ class BluetoothService {
     virtual ~BluetoothService() {}
 
     void init();
+    // process all complete requests received from the connected client. Never blocks.
     void handle();
 
  private:
-    BluetoothSerial m_bluetooth;
-    State*          m_state;
-    Config*         m_config;
-    API*            m_api;
+    BluetoothSerial                       m_bluetooth;
+    RequestFramer<API_SERIAL_BUFFER_SIZE> m_framer;
+    State*                                m_state;
+    Config*                               m_config;
+    API*                                  m_api;
 
     String m_receivedData;
     bool   m_interestingData = false;
@@ -4,20 +4,23 @@
 #pragma once
 
 #include "config.h"
+#include "rate_limiter.hpp"
 #include "service_ir.h"
 #include "state.h"
+#include "tcp_event_loop.hpp"
 
-/// GlobalCache iTach device emulation
+class GCServer;
+class GCSink;
+
+/// GlobalCache iTach device emulation: connects the portable `GCServer` to the IR service and device state.
 class GlobalCacheServer {
  public:
-    GlobalCacheServer(State *state, InfraredService *irService, Config *config);
+    GlobalCacheServer(State *state, InfraredService *irService, Config *config, ClientRateLimiter *rateLimiter);
 
- private:
-    static void tcp_server_task(void *pvParameters);
-    static void socket_task(void *pvParameters);
-    static void beacon_task(void *param);
+    /// @brief Get the client connection churn counters. Can be called from any task.
+    TcpLoopStats connectionStats() const;
 
-    State           *m_state;
-    InfraredService *m_irService;
-    Config          *m_config;
+ private:
+    GCSink   *m_sink;
+    GCServer *m_server;
 };
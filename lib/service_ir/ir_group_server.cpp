@@ -0,0 +1,173 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Arduino.h required before lwIP headers, see globalcache_server.cpp
+#include <Arduino.h>
+#include <esp_system.h>
+#include <freertos/task.h>
+#include <sys/time.h>
+
+#include "ir_group_server.h"
+#include "ir_schedule.hpp"
+#include "log.h"
+
+static const char *TAG_GROUP = "GRP";
+
+IrGroupServer::IrGroupServer(InfraredService *irService, Config *config) : m_irService(irService) {
+    m_mutex = xSemaphoreCreateMutex();
+    esp_read_mac(m_sender, ESP_MAC_WIFI_STA);
+    m_seq = esp_random();
+    setGroupKey(config->getIrGroupKey());
+
+    xTaskCreatePinnedToCore(group_task,  // task function
+                            "IR group",  // task name
+                            4000,        // stack size
+                            this,        // task parameter
+                            3,           // task priority
+                            NULL,        // Task handle to keep track of created task
+                            0);          // core
+}
+
+void IrGroupServer::setGroupKey(const String &key) {
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    m_enabled = !key.isEmpty();
+    m_key = irGroupKey(key.c_str());
+    xSemaphoreGive(m_mutex);
+}
+
+bool IrGroupServer::isEnabled() {
+    IrGroupKey key;
+    return getKey(&key);
+}
+
+bool IrGroupServer::getKey(IrGroupKey *key) {
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    bool enabled = m_enabled;
+    *key = m_key;
+    xSemaphoreGive(m_mutex);
+    return enabled;
+}
+
+uint16_t IrGroupServer::prepare(const char *format, size_t codeLength, int64_t *sendAt, uint32_t delayMs) {
+    IrGroupKey key;
+    if (!getKey(&key) || !m_ready) {
+        return 503;
+    }
+
+    if (irGroupFormat(format) == 0 || codeLength == 0 || codeLength > kIrGroupMaxCodeLen) {
+        return 400;
+    }
+
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t now = static_cast<int64_t>(tv.tv_sec) * 1000000LL + tv.tv_usec;
+    if (*sendAt == 0) {
+        *sendAt = now + static_cast<int64_t>(delayMs) * 1000;
+    }
+    switch (checkSendAt(*sendAt, now)) {
+        case ScheduleCheck::OK:
+            break;
+        case ScheduleCheck::CLOCK_NOT_SET:
+            return 503;
+        default:
+            return 400;
+    }
+    return 0;
+}
+
+uint16_t IrGroupServer::send(const char *code, size_t codeLength, const char *format, uint16_t repeat,
+                             uint8_t outputs, int64_t *sendAt, uint32_t delayMs) {
+    if (code == nullptr) {
+        return 400;
+    }
+    uint16_t response = prepare(format, codeLength, sendAt, delayMs);
+    if (response) {
+        return response;
+    }
+
+    IrGroupMessage msg;
+    memcpy(msg.sender, m_sender, kIrGroupSenderLen);
+    msg.seq = m_seq++;
+    msg.sendAt = *sendAt;
+    msg.repeat = repeat;
+    msg.outputs = outputs;
+    msg.format = irGroupFormat(format);
+    msg.code = code;
+    msg.codeLen = codeLength;
+
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    size_t len = m_enabled ? irGroupEncode(m_key, msg, m_sendBuffer, sizeof(m_sendBuffer)) : 0;
+    bool   sent = false;
+    if (len) {
+        sent = m_socket.send(m_sendBuffer, len);
+        // retransmission: UDP multicast isn't acknowledged on WiFi
+        sent |= m_socket.send(m_sendBuffer, len);
+    }
+    xSemaphoreGive(m_mutex);
+
+    if (!sent) {
+        Log.logf(Log.ERROR, TAG_GROUP, "Error sending group message: errno %d", errno);
+        return 500;
+    }
+
+    return 0;
+}
+
+void IrGroupServer::group_task(void *param) {
+    IrGroupServer *srv = reinterpret_cast<IrGroupServer *>(param);
+
+    // Joining the multicast group fails without an active network interface
+    int err;
+    while ((err = srv->m_socket.open(IR_GROUP_PORT, IR_GROUP_ADDR)) != 0) {
+        Log.logf(Log.DEBUG, TAG_GROUP, "Unable to join multicast group: errno %d", err);
+        vTaskDelay(pdMS_TO_TICKS(10000));
+    }
+    srv->m_ready = true;
+    Log.logf(Log.INFO, TAG_GROUP, "Joined multicast group %s:%d", IR_GROUP_ADDR, IR_GROUP_PORT);
+
+    IrGroupSeqFilter<> filter;
+    uint8_t           *buf = new uint8_t[kIrGroupMaxPacketLen];
+
+    while (true) {
+        int len = srv->m_socket.receive(buf, kIrGroupMaxPacketLen, -1);
+        if (len < 0) {
+            Log.logf(Log.ERROR, TAG_GROUP, "Error receiving group message: errno %d", errno);
+            vTaskDelay(pdMS_TO_TICKS(1000));
+            continue;
+        }
+
+        IrGroupKey key;
+        if (!srv->getKey(&key)) {
+            continue;
+        }
+
+        IrGroupMessage msg;
+        auto           result = irGroupDecode(key, buf, len, &msg);
+        if (result != IrGroupResult::OK) {
+            // other groups share the same multicast address
+            if (result != IrGroupResult::WRONG_GROUP) {
+                Log.logf(Log.WARN, TAG_GROUP, "Ignoring invalid group message: %d", static_cast<int>(result));
+            }
+            continue;
+        }
+        if (memcmp(msg.sender, srv->m_sender, kIrGroupSenderLen) == 0 || !filter.accept(msg.sender, msg.seq)) {
+            // own message or retransmission
+            continue;
+        }
+        const char *format = irGroupFormatName(msg.format);
+        if (format == nullptr) {
+            Log.logf(Log.WARN, TAG_GROUP, "Ignoring group message with unsupported format: %d", msg.format);
+            continue;
+        }
+
+        uint16_t response = srv->m_irService->send(IR_CLIENT_GROUP, msg.seq, msg.code, msg.codeLen, format, msg.repeat,
+                                                   msg.outputs & IR_GROUP_INT_SIDE, msg.outputs & IR_GROUP_INT_TOP,
+                                                   msg.outputs & IR_GROUP_EXT_1, msg.outputs & IR_GROUP_EXT_2, 0,
+                                                   msg.sendAt);
+        if (response) {
+            Log.logf(Log.WARN, TAG_GROUP, "Group send %u from %02X%02X%02X%02X%02X%02X failed: %d", msg.seq,
+                     msg.sender[0], msg.sender[1], msg.sender[2], msg.sender[3], msg.sender[4], msg.sender[5],
+                     response);
+        }
+    }
+}
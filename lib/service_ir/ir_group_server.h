@@ -0,0 +1,79 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "config.h"
+#include "ir_group.hpp"
+#include "service_ir.h"
+
+/// Default lead time of a group send if no absolute send time is given. Must cover the WiFi multicast latency: an
+/// access point buffers multicast frames until the next DTIM beacon if a client is in power save mode.
+#define IR_GROUP_DEFAULT_DELAY_MS 250
+
+/// Synchronized IR send across multiple docks with UDP multicast.
+///
+/// All docks configured with the same group key form a group. A group send request on one dock is forwarded to all
+/// other docks in the group with an absolute send time, and every dock sends the IR code at that time using the
+/// scheduled IR send. Requires synchronized clocks with SNTP.
+class IrGroupServer {
+ public:
+    IrGroupServer(InfraredService *irService, Config *config);
+
+    /// @brief Set the shared group key. An empty key disables group send and ignores all received messages.
+    void setGroupKey(const String &key);
+    bool isEnabled();
+
+    /**
+     * Validate a group send request and determine its send time, before the IR code is submitted locally.
+     *
+     * @param format IR code format: "hex", "pronto" or "gc".
+     * @param codeLength length of the IR code.
+     * @param sendAt in/out parameter: absolute send time in microseconds since the Unix epoch (UTC). If 0, the send
+     *               time is set to the current time plus `delayMs`.
+     * @param delayMs lead time in milliseconds if `sendAt` is 0.
+     * @return 0 if the request can be forwarded with `send`, otherwise a HTTP like error code.
+     */
+    uint16_t prepare(const char *format, size_t codeLength, int64_t *sendAt,
+                     uint32_t delayMs = IR_GROUP_DEFAULT_DELAY_MS);
+
+    /**
+     * Forward an IR code to all other docks in the group.
+     *
+     * Should only be called after the IR code has been accepted by the local IR service, otherwise the other docks
+     * send a code this dock doesn't. The datagram is transmitted twice to mitigate packet loss, receivers ignore
+     * duplicates.
+     *
+     * @param code IR code to send, doesn't need to be zero-terminated.
+     * @param codeLength length of the IR code.
+     * @param format IR code format: "hex", "pronto" or "gc".
+     * @param repeat IR repeat count.
+     * @param outputs bitmask of `IrGroupOutput` values.
+     * @param sendAt in/out parameter: absolute send time in microseconds since the Unix epoch (UTC). If 0, the send
+     *               time is set to the current time plus `delayMs`.
+     * @param delayMs lead time in milliseconds if `sendAt` is 0.
+     * @return 0 if successful, otherwise a HTTP like error code.
+     */
+    uint16_t send(const char *code, size_t codeLength, const char *format, uint16_t repeat, uint8_t outputs,
+                  int64_t *sendAt, uint32_t delayMs = IR_GROUP_DEFAULT_DELAY_MS);
+
+ private:
+    static void group_task(void *param);
+
+    bool getKey(IrGroupKey *key);
+
+    InfraredService  *m_irService;
+    IrGroupSocket     m_socket;
+    // protects the key and the send buffer
+    SemaphoreHandle_t m_mutex;
+    IrGroupKey        m_key;
+    bool              m_enabled = false;
+    volatile bool     m_ready = false;
+    /// Sender identification: MAC address, same as used in the host name and GlobalCache beacon
+    uint8_t           m_sender[kIrGroupSenderLen];
+    uint16_t          m_seq;
+    uint8_t           m_sendBuffer[kIrGroupMaxPacketLen];
+};
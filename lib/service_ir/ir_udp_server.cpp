@@ -0,0 +1,112 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "ir_udp_server.h"
+
+// Arduino.h required before lwIP headers, see globalcache_server.cpp
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <lwip/sockets.h>
+#include <sys/time.h>
+
+#include "ir_udp.hpp"
+#include "log.h"
+
+static const char *TAG_UDP = "UDP";
+
+/// Minimum interval to reload the API token after an authentication failure
+#define TOKEN_RELOAD_INTERVAL_MS 5000
+
+static int64_t wallClockUs() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return static_cast<int64_t>(tv.tv_sec) * 1000000LL + tv.tv_usec;
+}
+
+IrUdpServer::IrUdpServer(InfraredService *irService, Config *config) : m_irService(irService), m_config(config) {
+    xTaskCreatePinnedToCore(udp_task,  // task function
+                            "IR UDP",  // task name
+                            4000,      // stack size
+                            this,      // task parameter
+                            4,         // task priority: above GC server, latency matters
+                            NULL,      // Task handle to keep track of created task
+                            0);        // core
+}
+
+void IrUdpServer::udp_task(void *param) {
+    IrUdpServer *srv = reinterpret_cast<IrUdpServer *>(param);
+
+    int socket_fd = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (socket_fd < 0) {
+        Log.logf(Log.ERROR, TAG_UDP, "socket call failed: errno %d", errno);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(struct sockaddr_in));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_ANY);
+    sa.sin_port = htons(IR_UDP_PORT);
+    if (bind(socket_fd, (struct sockaddr *)&sa, sizeof(struct sockaddr_in)) == -1) {
+        Log.logf(Log.ERROR, TAG_UDP, "Bind to port number %d failed: errno %d", IR_UDP_PORT, errno);
+        close(socket_fd);
+        vTaskDelete(NULL);
+        return;
+    }
+    Log.logf(Log.INFO, TAG_UDP, "Socket bound, port %d", IR_UDP_PORT);
+
+    IrUdpHandler handler([srv](const IrUdpCommand &cmd) -> uint16_t {
+        const char *format = irGroupFormatName(cmd.format);
+        if (format == nullptr) {
+            return 400;
+        }
+        // same default outputs as the WebSocket API
+        uint8_t outputs = cmd.outputs ? cmd.outputs : IR_GROUP_INT_SIDE | IR_GROUP_EXT_1 | IR_GROUP_EXT_2;
+        return srv->m_irService->send(IR_CLIENT_UDP, cmd.seq, cmd.code, cmd.codeLen, format, cmd.repeat,
+                                      outputs & IR_GROUP_INT_SIDE, outputs & IR_GROUP_INT_TOP,
+                                      outputs & IR_GROUP_EXT_1, outputs & IR_GROUP_EXT_2);
+    });
+    handler.setToken(srv->m_config->getToken().c_str());
+    unsigned long tokenLoaded = millis();
+
+    // replay protection relies on the wall clock: commands are only accepted once SNTP set the time
+    while (!handler.start(wallClockUs())) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+    Log.info(TAG_UDP, "Accepting commands");
+
+    // static buffer: datagram is larger than the task stack can afford
+    static uint8_t buf[kIrUdpMaxPacketLen];
+    uint8_t        ack[kIrUdpAckLen];
+
+    while (true) {
+        struct sockaddr_in source;
+        socklen_t          sourceLen = sizeof(source);
+        int len = recvfrom(socket_fd, buf, sizeof(buf), 0, (struct sockaddr *)&source, &sourceLen);
+        if (len < 0) {
+            Log.logf(Log.ERROR, TAG_UDP, "recvfrom failed: errno %d", errno);
+            vTaskDelay(pdMS_TO_TICKS(1000));
+            continue;
+        }
+
+        IrUdpResult result;
+        int64_t     now = wallClockUs();
+        size_t      ackLen = handler.handle(buf, len, now, ack, sizeof(ack), &result);
+        if (result == IrUdpResult::BAD_MAC && millis() - tokenLoaded > TOKEN_RELOAD_INTERVAL_MS) {
+            // token might have been changed with the WebSocket API
+            handler.setToken(srv->m_config->getToken().c_str());
+            tokenLoaded = millis();
+            ackLen = handler.handle(buf, len, now, ack, sizeof(ack), &result);
+        }
+
+        if (ackLen) {
+            sendto(socket_fd, ack, ackLen, 0, (struct sockaddr *)&source, sourceLen);
+        }
+        if (result != IrUdpResult::OK) {
+            Log.logf(Log.DEBUG, TAG_UDP, "Datagram from %s not sent: %d", inet_ntoa(source.sin_addr),
+                     static_cast<int>(result));
+        }
+    }
+}
@@ -0,0 +1,22 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include "config.h"
+#include "service_ir.h"
+
+/// Fire-and-forget UDP IR command port, see ir_udp.hpp for the datagram format.
+///
+/// Datagrams are authenticated with a key derived from the API token and fed into the same IR send queue as the
+/// WebSocket API and the GlobalCache server.
+class IrUdpServer {
+ public:
+    IrUdpServer(InfraredService *irService, Config *config);
+
+ private:
+    static void udp_task(void *param);
+
+    InfraredService *m_irService;
+    Config          *m_config;
+};
@@ -8,14 +8,17 @@
 #include <IRtimer.h>
 #include <IRutils.h>
 
+#include <sys/time.h>
+
 #include <cstdio>
+#include <utility>
 
 #include "IRrecv.h"
 #include "IRremoteESP8266.h"  // https://platformio.org/lib/show/1089/IRremoteESP8266
 #include "IRsend.h"
 #include "ir_codes.hpp"
+#include "ir_schedule.hpp"
 #include "log.h"
-#include "util_types.h"
 
 const char *irLog = "IR";
 const char *irLogSend = "IRSEND";
@@ -24,6 +27,7 @@ const char *irLogLearn = "IRLEARN";
 const int IR_LEARNING_BIT = BIT0;
 const int IR_REPEAT_BIT = BIT1;
 const int IR_REPEAT_STOP_BIT = BIT2;
+const int IR_PREEMPT_BIT = BIT3;
 
 // good explanation of IRrecv parameters:
 // https://github.com/crankyoldgit/IRremoteESP8266/blob/master/examples/IRrecvDumpV3/IRrecvDumpV3.ino
@@ -33,10 +37,32 @@ const uint8_t  kTimeout = 15;       // Milli-Seconds.
 const uint16_t kFrequency = 38000;  // in Hz. e.g. 38kHz.
 // Set the smallest sized "UNKNOWN" message packets we actually care about.
 const uint16_t kMinUnknownSize = 12;
+// Trailing gap of a learned GlobalCache code: the capture only tells that the gap is longer than kTimeout.
+const uint32_t kGcLearnGapUs = 40000;
+// Maximum size of a learned GlobalCache code message. Longer codes can't be sent back to the GlobalCache server.
+const uint16_t kGcLearnCodeSize = 1024;
+
+/// Current wall clock time in microseconds since the Unix epoch (UTC).
+static int64_t wallClockUs() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return static_cast<int64_t>(tv.tv_sec) * 1000000LL + tv.tv_usec;
+}
+
+/// Clock for scheduled IR sending with `waitUntil`.
+/// The high resolution timer is used for the busy-wait phase. Yielding is done with the event group to allow aborting
+/// a scheduled send with `stopSend`, or interrupting it with a preempting command.
+struct IrSendClock {
+    EventGroupHandle_t eventgroup;
+
+    int64_t nowUs() { return esp_timer_get_time(); }
 
-// we got a mess with the hpp files / project structure. Since we need a rewrite, keep on hacking 🙈
-extern bool    send_string_to_socket(const int socket, const char *buf);
-extern uint8_t parseGcRequest(const char *request, GCMsg *msg);
+    bool sleepMs(uint32_t ms) {
+        auto bits = xEventGroupWaitBits(eventgroup, IR_REPEAT_STOP_BIT | IR_PREEMPT_BIT, pdFALSE, pdFALSE,
+                                        pdMS_TO_TICKS(ms));
+        return bits & (IR_REPEAT_STOP_BIT | IR_PREEMPT_BIT);
+    }
+};
 
 void InfraredService::init(uint16_t sendCore, uint16_t sendPriority, uint16_t learnCore, uint16_t learnPriority,
                            State *state) {
@@ -47,9 +73,9 @@ void InfraredService::init(uint16_t sendCore, uint16_t sendPriority, uint16_t le
 
     m_state = state;
 
-    m_queue = xQueueCreate(1, sizeof(struct IRSendMessage *));
-    if (m_queue == nullptr) {
-        Log.error(irLog, "xQueueCreate failed");
+    m_sendMutex = xSemaphoreCreateMutex();
+    if (m_sendMutex == nullptr) {
+        Log.error(irLog, "xSemaphoreCreateMutex failed");
         return;
     }
     m_eventgroup = xEventGroupCreate();
@@ -57,11 +83,6 @@ void InfraredService::init(uint16_t sendCore, uint16_t sendPriority, uint16_t le
         Log.error(irLog, "xEventGroupCreate failed");
         return;
     }
-    m_apiResponseQueue = xQueueCreate(5, sizeof(struct IrResponse *));
-    if (m_queue == nullptr) {
-        Log.error(irLog, "API response queue creation failed");
-        return;
-    }
 
     if (sendCore > 1) {
         sendCore = 1;
@@ -136,16 +157,12 @@ bool InfraredService::isIrLearning() {
 }
 
 struct IrResponse *InfraredService::apiResponse() {
-    if (m_apiResponseQueue == nullptr) {
-        return nullptr;
-    }
-
     struct IrResponse *pIrMsg;
-    if (xQueueReceive(m_apiResponseQueue, &(pIrMsg), 0) == pdTRUE) {
+    while ((pIrMsg = m_apiResponseQueue.pop()) != nullptr) {
         if (pIrMsg->clientId == IR_CLIENT_GC) {
             // should not happen
             delete pIrMsg;
-            return nullptr;
+            continue;
         }
 
         return pIrMsg;
@@ -154,48 +171,121 @@ struct IrResponse *InfraredService::apiResponse() {
     return nullptr;
 }
 
-uint16_t InfraredService::sendGlobalCache(int16_t clientId, uint32_t msgId, const char *sendir, int socket) {
-    // module is always 1 (emulating an iTach device)
-    if (strncmp(sendir, "sendir,1:", 9) != 0) {
-        return 2;  // invalid module address
-    }
+void InfraredService::onApiResponse(ApiResponseHandler handler) {
+    m_apiResponseQueue.onPush(handler);
+}
 
-    // ID
-    char *next = strchr(sendir + 9, ',');
-    if (next == NULL) {
-        return 4;  // invalid ID
+void InfraredService::onGlobalCacheResponse(GcResponseHandler handler) {
+    m_gcResponseHandler = handler;
+}
+
+void InfraredService::onGlobalCacheLearned(GcLearnHandler handler) {
+    m_gcLearnHandler = handler;
+}
+
+void InfraredService::setGlobalCacheLearnFormat(bool compressed) {
+    m_gcLearnCompressed = compressed;
+}
+
+uint16_t InfraredService::sendGlobalCache(int16_t clientId, GCIrCode *code, uint32_t connection) {
+    if (code == nullptr || !code->isValid()) {
+        return 400;
     }
-    auto port = atoi(sendir + 9);
-    if (port < 1 || port > 15) {
-        return 3;  // invalid port address
+    if (!m_sendMutex || !m_eventgroup) {
+        return 500;
+    }
+    if (isIrLearning()) {
+        return 503;  // service unavailable
     }
 
-    // frequency
-    next = strchr(next + 1, ',');
-    if (next == NULL) {
-        return 5;  // invalid frequency
+    uint8_t  port = code->port;
+    uint32_t pin_mask = outputPinMask(port & 1, port & 8, port & 2, port & 4);
+    if (pin_mask == 0) {
+        return 400;
     }
-    // repeat
-    next = strchr(next + 1, ',');
-    if (next == NULL) {
-        return 6;  // invalid repeat
+
+    // take over the parsed code: no further parsing or copying until it's sent
+    struct IRSendMessage *pxMessage = m_messagePool.acquire();
+    if (pxMessage == nullptr) {
+        return 500;
     }
+    pxMessage->clientId = clientId;
+    pxMessage->msgId = code->id;
+    pxMessage->format = IRFormat::GLOBAL_CACHE;
+    pxMessage->gcCode = std::move(*code);
+    pxMessage->repeat = pxMessage->gcCode.repeat();
+    pxMessage->pin_mask = pin_mask;
+    pxMessage->gcConnection = connection;
+    pxMessage->sendAt = 0;
 
-    int16_t repeat = atoi(next + 1);
-    if (repeat < 1 || repeat > 50) {
-        return 6;  // invalid repeat
+    return submit(pxMessage, IrSendPriority::NORMAL, false);
+}
+
+uint16_t InfraredService::send(int16_t clientId, uint32_t msgId, const char *code, size_t codeLength,
+                               const char *format, uint16_t repeat, bool internal_side, bool internal_top,
+                               bool external_1, bool external_2, uint32_t gcConnection, int64_t sendAt,
+                               IrSendPriority priority, bool resumePreempted) {
+    uint32_t pin_mask = outputPinMask(internal_side, internal_top, external_1, external_2);
+    IRFormat irFormat = parseIrFormat(format);
+    uint16_t result = checkSend(pin_mask, irFormat, sendAt);
+    if (result) {
+        return result;
     }
 
-    String code = sendir;
-    String format = "gc";
+    // pooled message: the code buffers are reused, no allocation in the common case
+    struct IRSendMessage *pxMessage = m_messagePool.acquire();
+    if (pxMessage == nullptr) {
+        return 500;
+    }
+    pxMessage->clientId = clientId;
+    pxMessage->msgId = msgId;
+    pxMessage->repeat = repeat;
+    pxMessage->pin_mask = pin_mask;
+    pxMessage->gcConnection = gcConnection;
+    pxMessage->sendAt = sendAt;
+
+    int memError;
+    if (!setIrSendCode(pxMessage, irFormat, code, codeLength, &memError)) {
+        rebootIfMemError(memError);
+        m_messagePool.release(pxMessage);
+        return 400;
+    }
 
-    return send(clientId, msgId, code, format, repeat, port & 1, port & 8, port & 2, port & 4, socket);
+    return submit(pxMessage, priority, resumePreempted);
 }
 
-uint16_t InfraredService::send(int16_t clientId, uint32_t msgId, const String &code, const String &format,
+uint16_t InfraredService::send(int16_t clientId, uint32_t msgId, IRFormat format, MsgPackUintReader values,
                                uint16_t repeat, bool internal_side, bool internal_top, bool external_1,
-                               bool external_2, int gcCocket) {
-    if (!m_queue || !m_eventgroup) {
+                               bool external_2, int64_t sendAt, IrSendPriority priority, bool resumePreempted) {
+    uint32_t pin_mask = outputPinMask(internal_side, internal_top, external_1, external_2);
+    uint16_t result = checkSend(pin_mask, format, sendAt);
+    if (result) {
+        return result;
+    }
+
+    struct IRSendMessage *pxMessage = m_messagePool.acquire();
+    if (pxMessage == nullptr) {
+        return 500;
+    }
+    pxMessage->clientId = clientId;
+    pxMessage->msgId = msgId;
+    pxMessage->repeat = repeat;
+    pxMessage->pin_mask = pin_mask;
+    pxMessage->gcConnection = 0;
+    pxMessage->sendAt = sendAt;
+
+    int memError;
+    if (!setIrSendValues(pxMessage, format, values, &memError)) {
+        rebootIfMemError(memError);
+        m_messagePool.release(pxMessage);
+        return 400;
+    }
+
+    return submit(pxMessage, priority, resumePreempted);
+}
+
+uint16_t InfraredService::checkSend(uint32_t pinMask, IRFormat format, int64_t sendAt) {
+    if (!m_sendMutex || !m_eventgroup) {
         return 500;
     }
 
@@ -203,6 +293,25 @@ uint16_t InfraredService::send(int16_t clientId, uint32_t msgId, const String &c
         return 503;  // service unavailable
     }
 
+    if (pinMask == 0 || format == IRFormat::UNKNOWN) {
+        return 400;
+    }
+
+    if (sendAt) {
+        switch (checkSendAt(sendAt, wallClockUs())) {
+            case ScheduleCheck::OK:
+                break;
+            case ScheduleCheck::CLOCK_NOT_SET:
+                Log.warn(irLog, "Cannot schedule IR send: clock not synchronized");
+                return 503;  // service unavailable
+            default:
+                return 400;
+        }
+    }
+    return 0;
+}
+
+uint32_t InfraredService::outputPinMask(bool internal_side, bool internal_top, bool external_1, bool external_2) {
     uint32_t pin_mask = 0;
     if (internal_side) {
         pin_mask |= (1UL << IR_SEND_PIN_INT_SIDE);
@@ -221,57 +330,51 @@ uint16_t InfraredService::send(int16_t clientId, uint32_t msgId, const String &c
         pin_mask |= (1UL << IR_SEND_PIN_EXT_2);
     }
 #endif
-    if (pin_mask == 0) {
-        return 400;
-    }
+    return pin_mask;
+}
 
-    IRFormat irFormat;
-    if (format == "hex") {
-        irFormat = IRFormat::UNFOLDED_CIRCLE;
-    } else if (format == "pronto") {
-        irFormat = IRFormat::PRONTO;
-    } else if (format == "gc") {
-        irFormat = IRFormat::GLOBAL_CACHE;
-    } else {
-        return 400;
+/// Check if two IR send commands have the same IR code.
+static bool isSameCode(const IRSendMessage *a, const IRSendMessage *b) {
+    if (a->format != b->format) {
+        return false;
     }
+    if (a->format == IRFormat::GLOBAL_CACHE) {
+        return a->gcCode == b->gcCode;
+    }
+    return a->hexCode == b->hexCode && a->message == b->message;
+}
 
-    bool sending = uxQueueMessagesWaiting(m_queue) > 0;
+uint16_t InfraredService::submit(struct IRSendMessage *pxMessage, IrSendPriority priority, bool resumePreempted) {
+    xSemaphoreTake(m_sendMutex, portMAX_DELAY);
+    bool sending = m_scheduler.isBusy();
 
     // #65 handle IR repeat if it's the same command. This is a very simple, initial implementation (ignore repeat val)
-    if (sending && repeat > 0 && m_currentSendCode == code) {
-        Log.logf(Log.DEBUG, irLog, "detected IR repeat for last IR send command (%d)", repeat);
+    // A scheduled send is never treated as repeat.
+    if (sending && pxMessage->repeat > 0 && pxMessage->sendAt == 0 && m_scheduler.current() &&
+        isSameCode(m_scheduler.current(), pxMessage)) {
+        xSemaphoreGive(m_sendMutex);
+        Log.logf(Log.DEBUG, irLog, "detected IR repeat for last IR send command (%d)", pxMessage->repeat);
         xEventGroupSetBits(m_eventgroup, IR_REPEAT_BIT);
+        m_messagePool.release(pxMessage);
 
         return 202;  // accepted IR repeat
     }
 
-    // try to save an allocation if still sending an IR code
-    if (sending) {
+    if ((sending && priority == IrSendPriority::NORMAL) ||
+        !m_scheduler.submit(pxMessage, priority, resumePreempted)) {
+        // priority class busy
+        xSemaphoreGive(m_sendMutex);
+        m_messagePool.release(pxMessage);
         return 429;  // too many requests
     }
-
-    // new code, clear repeat flags
-    xEventGroupClearBits(m_eventgroup, IR_REPEAT_BIT | IR_REPEAT_STOP_BIT);
-
-    struct IRSendMessage *pxMessage = new IRSendMessage();
-    pxMessage->clientId = clientId;
-    pxMessage->msgId = msgId;
-    pxMessage->format = irFormat;
-    pxMessage->message = code;
-    pxMessage->repeat = repeat;
-    pxMessage->pin_mask = pin_mask;
-    pxMessage->gcSocket = gcCocket;
-
-    if (xQueueSendToBack(m_queue, reinterpret_cast<void *>(&pxMessage), 0) == errQUEUE_FULL) {
-        // This should never happen with the pre-check!
-        delete pxMessage;
-        return 429;
+    if (m_scheduler.preemptRequested()) {
+        // wake up a waiting scheduled send
+        xEventGroupSetBits(m_eventgroup, IR_PREEMPT_BIT);
     }
+    xSemaphoreGive(m_sendMutex);
 
-    Log.debug(irLog, "queued IRSendMessage");
-
-    m_currentSendCode = code;
+    Log.logf(Log.DEBUG, irLog, "queued IRSendMessage: priority=%d", static_cast<int>(priority));
+    xTaskNotifyGive(m_ir_task);
 
     // 0 = asynchronous reply from the the IR send task
     return 0;
@@ -304,8 +407,8 @@ void InfraredService::send_ir_f(void *param) {
     }
 
     InfraredService *ir = reinterpret_cast<InfraredService *>(param);
-    if (ir->m_queue == nullptr || ir->m_apiResponseQueue == nullptr) {
-        Log.error(irLogSend, "terminated: input or output queue missing");
+    if (ir->m_sendMutex == nullptr) {
+        Log.error(irLogSend, "terminated: send mutex missing");
         return;
     }
 
@@ -335,10 +438,12 @@ void InfraredService::send_ir_f(void *param) {
     uint16_t              repeatLimit;
     int                   repeat;
     int                   repeatCount;
+    bool                  preempted;
     EventGroupHandle_t    eventgroup = ir->m_eventgroup;
+    IrSendClock           clock = {eventgroup};
 
     // reference required to persist values during callbacks (also initialization is further down!)
-    auto repeatCallback = [&repeatLimit, &repeat, &repeatCount, eventgroup]() -> bool {
+    auto repeatCallback = [&repeatLimit, &repeat, &repeatCount, &preempted, eventgroup, ir]() -> bool {
         // commented out log statements: depending on IR format this is very time critical!
         // Log.debug(irLogSend, "in callback!");
 
@@ -348,6 +453,10 @@ void InfraredService::send_ir_f(void *param) {
             // abort immediately
             repeat = 0;
             Log.debug(irLogSend, "stopping repeat");
+        } else if (repeat > 0 && ir->m_scheduler.preemptRequested()) {
+            // end after the current frame, the remaining repeats are kept for resuming
+            preempted = true;
+            return false;
         } else if (bits & IR_REPEAT_BIT) {
             // reset repeat count and start counting down again
             Log.logf(Log.DEBUG, irLogSend, "continue repeat: %d -> %d", repeat, repeatLimit);
@@ -366,17 +475,25 @@ void InfraredService::send_ir_f(void *param) {
 
     // start the IR sending task
     while (true) {
-        // Peek a message on the created queue.
-        if (xQueuePeek(ir->m_queue, &(pIrMsg), portMAX_DELAY) == pdFALSE) {
-            // timeout
+        xSemaphoreTake(ir->m_sendMutex, portMAX_DELAY);
+        pIrMsg = ir->m_scheduler.next();
+        xSemaphoreGive(ir->m_sendMutex);
+
+        if (pIrMsg == nullptr) {
+            // wait for `send` to submit a new command
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
             continue;
         }
-        // pIrMsg now points to the struct IRSendMessage variable, but the item still remains on the queue.
-        // This blocks the sender from queuing more messages and notify the client with a "busy error".
+        // The message remains in the scheduler until finished. This blocks the sender from submitting more messages
+        // of the same priority class and notify the client with a "busy error".
+
+        // new code, clear repeat flags
+        xEventGroupClearBits(eventgroup, IR_REPEAT_BIT | IR_REPEAT_STOP_BIT | IR_PREEMPT_BIT);
 
         Log.logf(Log.DEBUG, irLogSend, "new command: id=%d, format=%d, repeat=%d", pIrMsg->msgId, pIrMsg->format,
                  pIrMsg->repeat);
 
+        preempted = false;
         // Activate continuous IR repeat
         if (pIrMsg->repeat > 0) {
             // set lambda reference variables
@@ -392,11 +509,34 @@ void InfraredService::send_ir_f(void *param) {
             Log.error(irLogSend, "failed to set PinMask");
         }
 
+        // Scheduled send: convert wall clock target time to the high resolution timer. SNTP adjustments during the wait
+        // are ignored.
+        bool    aborted = false;
+        int64_t late = 0;
+        if (pIrMsg->sendAt) {
+            int64_t target = pIrMsg->sendAt - wallClockUs() + esp_timer_get_time();
+            aborted = !waitUntil(clock, target, &late);
+            if (aborted && ir->m_scheduler.preemptRequested()) {
+                // nothing sent yet: a resumed command waits again for its send time
+                aborted = false;
+                preempted = true;
+                repeat = pIrMsg->repeat + 1;
+            }
+        }
+
         bool success = false;
-        switch (pIrMsg->format) {
+        switch (aborted || preempted ? IRFormat::UNKNOWN : pIrMsg->format) {
             case IRFormat::UNFOLDED_CIRCLE: {
-                IRHexData data;
-                if (buildIRHexData(pIrMsg->message, &data)) {
+                IRHexData        data;
+                const IrHexCode &hex = pIrMsg->hexCode;
+                if (hex.protocol) {
+                    // binary request: already validated in `send`
+                    data.protocol = static_cast<decode_type_t>(hex.protocol);
+                    data.command = hex.command;
+                    data.bits = hex.bits;
+                    data.repeat = hex.repeat;
+                }
+                if (hex.protocol || buildIRHexData(pIrMsg->message.c_str(), &data)) {
                     // Override repeat in code
                     // Note: if only `data.repeat > 1`: some codes have to be sent twice for a single command,
                     // i.e. it's not a repeat indicator yet!
@@ -411,15 +551,14 @@ void InfraredService::send_ir_f(void *param) {
             }
             case IRFormat::PRONTO: {
                 // #60 use space as default separator
-                char separator = ' ';
-                if (pIrMsg->message.indexOf(separator) < 1) {
+                char        separator = ' ';
+                const char *msg = pIrMsg->message.c_str();
+                const char *firstSeparator = strchr(msg, separator);
+                if (firstSeparator == nullptr || firstSeparator == msg) {
                     // fallback to old comma (dock version <= 0.6.0)
                     separator = ',';
                 }
 
-                // operate directly on the underlaying message buffer: avoid String allocations from using
-                // "message.substring"!
-                auto      msg = pIrMsg->message.c_str();
                 uint16_t  count;
                 int       memError;
                 uint16_t *code_array = prontoBufferToArray(msg, separator, &count, &memError);
@@ -436,65 +575,96 @@ void InfraredService::send_ir_f(void *param) {
                 break;
             }
             case IRFormat::GLOBAL_CACHE: {
-                // UNDER DEVELOPMENT
-                uint16_t  count;
-                int       memError;
-                uint16_t *code_array = globalCacheBufferToArray(pIrMsg->message.c_str(), &count, &memError);
-                if (!(code_array == NULL || count == 0)) {
+                // already parsed and validated in `send` / `sendGlobalCache`
+                GCIrCode &code = pIrMsg->gcCode;
+                if (code.isValid()) {
                     // Override repeat in code
                     if (pIrMsg->repeat > 0) {
-                        code_array[1] = pIrMsg->repeat;
+                        code.data[GC_IR_REPEAT_INDEX] = pIrMsg->repeat;
                     }
-                    irsend.sendGC(code_array, count);
+                    irsend.sendGC(code.data, code.count);
                     success = true;
-                    free(code_array);
                 } else {
-                    Log.warn(irLogSend, "failed to parse GC code");
-                    rebootIfMemError(memError);
+                    Log.warn(irLogSend, "invalid GC code");
                 }
                 break;
             }
             default:
-                Log.error(irLogSend, "Invalid IR format");
+                if (!(aborted || preempted)) {
+                    Log.error(irLogSend, "Invalid IR format");
+                }
         }
 
         irsend.setRepeatCallback(nullptr);
 
-        // quick & dirty hack (TODO callback function or a dedicated queue)
-        if (pIrMsg->clientId == IR_CLIENT_GC && pIrMsg->gcSocket > 0) {
-            char    response[24];
-            uint8_t module = 1;
-            uint8_t port = 1;
-            GCMsg   req;
-            if (parseGcRequest(pIrMsg->message.c_str(), &req) == 0) {
-                module = req.module;
-                port = req.port;
+        if (aborted) {
+            Log.info(irLogSend, "scheduled IR send aborted");
+        } else if (preempted) {
+            Log.logf(Log.DEBUG, irLogSend, "preempted: id=%d, remaining repeats=%d", pIrMsg->msgId, repeat);
+            if (pIrMsg->repeat > 0) {
+                // a resumed command starts with sending the code, followed by the remaining repeats
+                pIrMsg->repeat = repeat - 1;
             }
-            snprintf(response, sizeof(response), "completeir,%d:%d,%d\r", module, port, pIrMsg->msgId);
-            send_string_to_socket(pIrMsg->gcSocket, response);
-        } else {
-            StaticJsonDocument<100> responseDoc;
-            responseDoc["type"] = "dock";
-            responseDoc["msg"] = "ir_send";
-            responseDoc["req_id"] = pIrMsg->msgId;
-            responseDoc["code"] = success ? 200 : 400;
+        } else if (pIrMsg->sendAt) {
+            Log.logf(Log.DEBUG, irLogSend, "scheduled IR send: started %lld us late", late);
+        }
 
-            struct IrResponse *response = new IrResponse();
-            response->clientId = pIrMsg->clientId;
-            serializeJson(responseDoc, response->message);
+        xSemaphoreTake(ir->m_sendMutex, portMAX_DELAY);
+        struct IRSendMessage *cancelled = ir->m_scheduler.finish(preempted);
+        // a stop request also ends a preempted command
+        struct IRSendMessage *stopped = nullptr;
+        if (xEventGroupGetBits(eventgroup) & IR_REPEAT_STOP_BIT) {
+            stopped = ir->m_scheduler.cancelSuspended();
+        }
+        xSemaphoreGive(ir->m_sendMutex);
 
-            Log.logf(Log.DEBUG, irLogSend, "queuing response: success=%s", success ? "true" : "false");
+        if (!preempted) {
+            // 409: scheduled send aborted with a stop request
+            ir->sendResponse(pIrMsg, aborted ? 409 : (success ? 200 : 400));
+            ir->m_messagePool.release(pIrMsg);
+        }
+        // 409: interrupted by a preempting command, or stopped while suspended
+        if (cancelled) {
+            ir->sendResponse(cancelled, 409);
+            ir->m_messagePool.release(cancelled);
+        }
+        if (stopped) {
+            ir->sendResponse(stopped, 409);
+            ir->m_messagePool.release(stopped);
+        }
+    }
+}
 
-            if (xQueueSendToBack(ir->m_apiResponseQueue, reinterpret_cast<void *>(&response), pdMS_TO_TICKS(10)) ==
-                errQUEUE_FULL) {
-                Log.error(irLogSend, "Error sending ir_send response to API clients: queue full");
-                delete response;
-            }
+void InfraredService::sendResponse(struct IRSendMessage *msg, uint16_t code) {
+    if (msg->clientId == IR_CLIENT_GC && msg->gcConnection > 0) {
+        char response[32];
+        snprintf(response, sizeof(response), "completeir,%d:%d,%u\r", msg->gcCode.module, msg->gcCode.port,
+                 msg->gcCode.id);
+        // non-blocking: the GlobalCache server writes the response in its own task
+        if (m_gcResponseHandler) {
+            m_gcResponseHandler(msg->gcConnection, response);
         }
+    } else if (msg->clientId == IR_CLIENT_GROUP || msg->clientId == IR_CLIENT_UDP) {
+        // no response channel
+        Log.logf(Log.DEBUG, irLogSend, "%s send %u: code=%d", msg->clientId == IR_CLIENT_GROUP ? "group" : "UDP",
+                 msg->msgId, code);
+    } else {
+        StaticJsonDocument<100> responseDoc;
+        responseDoc["type"] = "dock";
+        responseDoc["msg"] = "ir_send";
+        responseDoc["req_id"] = msg->msgId;
+        responseDoc["code"] = code;
 
-        // all done, release queue (reset works because of queue length 1)
-        delete pIrMsg;
-        xQueueReset(ir->m_queue);
+        struct IrResponse *response = new IrResponse();
+        response->clientId = msg->clientId;
+        serializeJson(responseDoc, response->message);
+
+        // the queue owns the response: deleted if the queue is full, otherwise by the API task
+        Log.logf(Log.DEBUG, irLogSend, "queuing response: code=%d", code);
+
+        if (!m_apiResponseQueue.push(response)) {
+            Log.error(irLogSend, "Error sending ir_send response to API clients: queue full");
+        }
     }
 }
 
@@ -505,8 +675,8 @@ void InfraredService::learn_ir_f(void *param) {
     }
 
     InfraredService *ir = reinterpret_cast<InfraredService *>(param);
-    if (ir->m_eventgroup == nullptr || ir->m_apiResponseQueue == nullptr) {
-        Log.error(irLogLearn, "terminated: input or output queue missing");
+    if (ir->m_eventgroup == nullptr) {
+        Log.error(irLogLearn, "terminated: input queue missing");
         return;
     }
 
@@ -520,6 +690,9 @@ void InfraredService::learn_ir_f(void *param) {
 
     EventBits_t    bits;
     decode_results results;
+    // GlobalCache conversion buffers: learned codes are converted without allocating memory
+    static uint16_t gcData[kCaptureBufferSize + GC_IR_TIMING_INDEX + 1];
+    static char     gcCode[kGcLearnCodeSize];
     // start the IR learning task
     while (true) {
         // wait until learning is requested
@@ -594,15 +767,25 @@ void InfraredService::learn_ir_f(void *param) {
             responseDoc["ir_code"] = code;
 
             struct IrResponse *response = new IrResponse();
-            response->clientId = -1;  // broadcast
+            response->clientId = IR_CLIENT_LEARN;
             serializeJson(responseDoc, response->message);
+            // the queue owns the response: deleted if the queue is full, otherwise by the API task
+            Log.logf(Log.INFO, irLogLearn, "Sending message to API clients: %s", response->message.c_str());
 
-            if (xQueueSendToBack(ir->m_apiResponseQueue, reinterpret_cast<void *>(&response), pdMS_TO_TICKS(10)) ==
-                errQUEUE_FULL) {
+            if (!ir->m_apiResponseQueue.push(response)) {
                 Log.error(irLogLearn, "Error sending learned IR code to API clients: queue full");
-                delete response;
-            } else {
-                Log.logf(Log.INFO, irLogLearn, "Sending message to API clients: %s", response->message.c_str());
+            }
+
+            // GlobalCache clients with an enabled IR learner: raw capture without the leading gap in sendir format
+            if (ir->m_gcLearnHandler && results.rawlen > 1) {
+                uint16_t count = convertToGcTimings(results.rawbuf + 1, results.rawlen - 1, kRawTick, kFrequency,
+                                                    kGcLearnGapUs, gcData, sizeof(gcData) / sizeof(gcData[0]));
+                if (encodeGcSendir(1, 0, gcData, count, ir->m_gcLearnCompressed, gcCode, sizeof(gcCode))) {
+                    ir->m_gcLearnHandler(gcCode);
+                } else {
+                    Log.logf(Log.WARN, irLogLearn, "Learned code too long for GlobalCache clients (%d values)",
+                             results.rawlen);
+                }
             }
         }
 
@@ -5,10 +5,31 @@
 
 #include <Arduino.h>
 
+#include <functional>
+
 #include "board.h"
+#include "gc_ir_code.hpp"
+#include "ir_message.hpp"
+#include "ir_response_queue.hpp"
+#include "ir_send_scheduler.hpp"
+#include "msgpack.hpp"
 #include "state.h"
 
 #define IR_CLIENT_GC -2
+#define IR_CLIENT_GROUP -3
+#define IR_CLIENT_UDP -4
+// learned IR code for the API clients subscribed to the `ir_receive` topic
+#define IR_CLIENT_LEARN -5
+
+// Maximum number of pending API response messages: IR send results and learned IR codes
+#define IR_API_RESPONSE_QUEUE_SIZE 8
+
+/// GlobalCache response for a client connection of the GlobalCache server
+typedef std::function<void(uint32_t connection, const char *response)> GcResponseHandler;
+/// Learned IR code as GlobalCache `sendir` message for the GlobalCache server
+typedef std::function<void(const char *code)> GcLearnHandler;
+/// Notification of a new API response message, see `InfraredService::apiResponse`
+typedef std::function<void()> ApiResponseHandler;
 
 struct IrResponse {
     int16_t clientId;
@@ -29,26 +50,89 @@ class InfraredService {
     void setIrSendPriority(uint16_t priority);
     void setIrLearnPriority(uint16_t priority);
 
-    uint16_t sendGlobalCache(int16_t clientId, uint32_t msgId, const char *sendir, int socket = 0);
+    /**
+     * Asynchronously send a parsed GlobalCache IR code.
+     *
+     * The module:port address of the code selects the outputs, the ID is returned in the `completeir` response.
+     *
+     * @param clientId the client identifier to associate the response message.
+     * @param code parsed IR code. The code is moved into the send queue, `code` is empty afterwards.
+     * @param connection Optional connection identifier if message was received from the GlobalCache TCP server
+     */
+    uint16_t sendGlobalCache(int16_t clientId, GCIrCode *code, uint32_t connection = 0);
+
+    /**
+     * Set the handler for GlobalCache `completeir` responses. Must be set before sending GlobalCache codes.
+     *
+     * The handler is called from the IR send task and must not block.
+     */
+    void onGlobalCacheResponse(GcResponseHandler handler);
+
+    /**
+     * Set the handler for learned IR codes in the GlobalCache `sendir` format. Must be set before learning.
+     *
+     * The handler is called from the IR learn task and must not block.
+     */
+    void onGlobalCacheLearned(GcLearnHandler handler);
+
+    /**
+     * Set the handler to wake up the API client when a response message has been queued. Must be set before sending
+     * or learning IR codes.
+     *
+     * The handler is called from the IR send and learn tasks and must not block.
+     */
+    void onApiResponse(ApiResponseHandler handler);
+
+    /**
+     * Set the `sendir` format of learned IR codes for the GlobalCache server.
+     *
+     * @param compressed true to use the compressed iTach format, false for plain timing values.
+     */
+    void setGlobalCacheLearnFormat(bool compressed);
 
     /**
      * Asynchronously send an IR code on the 2nd core.
      *
-     * If there's still an IR code being sent, error 429 (too many requests) is returned.
+     * If there's still an IR code being sent, error 429 (too many requests) is returned, unless a higher priority
+     * class is used.
      *
      * @param clientId the WebSocket client identifier to associate the response message.
      * @param msgId the client send request message identifier to associate the response message with.
-     * @param code  IR code to send, either PRONTO or HEX (UnfoldedCircle) format.
-     * @param format IR code format: "pronto" or "hex"
+     * @param code  IR code to send in PRONTO, HEX (UnfoldedCircle) or GlobalCache format. Doesn't need to be
+     *              zero-terminated, the code is copied into a pooled message buffer.
+     * @param codeLength length of the IR code.
+     * @param format IR code format: "pronto", "hex" or "gc"
      * @param repeat IR repeat count
      * @param internal_side Send IR signal on internal LEDs
      * @param internal_top Send IR signal on internal top LED
      * @param external_1 Send IR signal on external 1 emitter port
      * @param external_2 Send IR signal on external 2 emitter port
-     * @param gcSocket Optional TCP socket if message was received from the GlobalCache TCP server
+     * @param gcConnection Optional connection identifier if message was received from the GlobalCache TCP server
+     * @param sendAt Optional absolute send time in microseconds since the Unix epoch (UTC). Requires a synchronized
+     *               clock with SNTP. The IR send task is blocked until the code has been sent.
+     * @param priority Priority class: a high priority code is sent after the active one, a preempting code
+     *                 interrupts the active code at the end of the current IR frame.
+     * @param resumePreempted Only for a preempting code: resume the interrupted code afterwards with the remaining
+     *                        repeats. Otherwise the interrupted code is cancelled with error 409.
      */
-    uint16_t send(int16_t clientId, uint32_t msgId, const String &code, const String &format, uint16_t repeat,
-                  bool internal_side, bool internal_top, bool external_1, bool external_2, int gcCocket = 0);
+    uint16_t send(int16_t clientId, uint32_t msgId, const char *code, size_t codeLength, const char *format,
+                  uint16_t repeat, bool internal_side, bool internal_top, bool external_1, bool external_2,
+                  uint32_t gcConnection = 0, int64_t sendAt = 0, IrSendPriority priority = IrSendPriority::NORMAL,
+                  bool resumePreempted = false);
+
+    /**
+     * Asynchronously send an IR code from a binary encoded request, without parsing code text.
+     *
+     * Same as the text variant of `send`, but the code is given as list of numbers, see `setIrSendValues`:
+     * - UNFOLDED_CIRCLE: protocol, command, bits, repeat
+     * - GLOBAL_CACHE: frequency, repeat, offset, followed by the on/off timings
+     *
+     * @param format IR code format: only UNFOLDED_CIRCLE and GLOBAL_CACHE are supported.
+     * @param values IR code values of a parsed MessagePack request. The request buffer must be valid during the call.
+     */
+    uint16_t send(int16_t clientId, uint32_t msgId, IRFormat format, MsgPackUintReader values, uint16_t repeat,
+                  bool internal_side, bool internal_top, bool external_1, bool external_2, int64_t sendAt = 0,
+                  IrSendPriority priority = IrSendPriority::NORMAL, bool resumePreempted = false);
 
     void stopSend();
 
@@ -59,7 +143,8 @@ class InfraredService {
     /**
      * Retrieve the next pending API response message.
      *
-     * A response message is either an asynchronous result of an IR send request, or a learned IR code.
+     * A response message is either an asynchronous result of an IR send request, or a learned IR code. Call until
+     * NULL is returned to drain the queue, the handler set with `onApiResponse` signals new messages.
      *
      * @return NULL if no message pending, otherwise a pointer to an IrResponse struct.
      *         The client is responsible to delete the struct after use!
@@ -72,10 +157,19 @@ class InfraredService {
     InfraredService(const InfraredService &) = delete;  // no copying
     InfraredService &operator=(const InfraredService &) = delete;
 
-    static void rebootIfMemError(int memError);
+    static void     rebootIfMemError(int memError);
+    static uint32_t outputPinMask(bool internal_side, bool internal_top, bool external_1, bool external_2);
+
+    // Check the common send preconditions. Returns 0 if the code can be sent, the error code otherwise.
+    uint16_t checkSend(uint32_t pinMask, IRFormat format, int64_t sendAt);
+
+    // Submit a new command to the IR send task. Takes ownership of the message.
+    uint16_t submit(struct IRSendMessage *msg, IrSendPriority priority, bool resumePreempted);
 
     // IR sending task
     static void send_ir_f(void *param);
+    // Send the result of an IR send command to the originating client
+    void sendResponse(struct IRSendMessage *msg, uint16_t code);
 
     // IR learning task
     static void learn_ir_f(void *param);
@@ -86,13 +180,18 @@ class InfraredService {
     TaskHandle_t m_ir_task = nullptr;
     // IR learning task handle for `learn_ir_f`
     TaskHandle_t m_learn_task = nullptr;
-    // IR send input queue
-    QueueHandle_t m_queue = nullptr;
+    // Send messages, released by the IR send task after sending
+    IrMessagePool<> m_messagePool;
+    // IR send input: active, pending and preempted commands. Protected by `m_sendMutex`.
+    IrSendScheduler<IRSendMessage> m_scheduler;
+    SemaphoreHandle_t              m_sendMutex = nullptr;
     // Output queue for API response messages
-    QueueHandle_t m_apiResponseQueue = nullptr;
-
-    // Current IR code which is being sent. Used to check for IR repeat commands.
-    String m_currentSendCode;
+    IrResponseQueue<IrResponse, IR_API_RESPONSE_QUEUE_SIZE> m_apiResponseQueue;
+    // Response output for GlobalCache server clients
+    GcResponseHandler m_gcResponseHandler;
+    // Learned IR code output for GlobalCache server clients
+    GcLearnHandler m_gcLearnHandler;
+    bool           m_gcLearnCompressed = false;
 
     State *m_state = nullptr;
 };
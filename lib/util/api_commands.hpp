@@ -0,0 +1,116 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Command table of the dock API: maps command names to command identifiers with their access restrictions.
+// Make sure this file also compiles natively and all functions are covered by unit tests.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/// Command is allowed from the WebSocket API
+#define API_CMD_SRC_WS 0x01
+/// Command is allowed from the serial port
+#define API_CMD_SRC_UART 0x02
+/// Command is allowed from Bluetooth
+#define API_CMD_SRC_BT 0x04
+#define API_CMD_SRC_ALL (API_CMD_SRC_WS | API_CMD_SRC_UART | API_CMD_SRC_BT)
+/// Command is allowed without authentication
+#define API_CMD_PUBLIC 0x80
+
+// clang-format off
+/// All API commands: identifier, command name, access flags.
+/// A new command only needs to be added here, the compiler rejects names with a hash collision.
+#define API_COMMANDS(X)                                                        \
+    X(GetSysinfo,       "get_sysinfo",       API_CMD_PUBLIC | API_CMD_SRC_ALL) \
+    X(SetConfig,        "set_config",        API_CMD_SRC_ALL)                  \
+    X(SetBrightness,    "set_brightness",    API_CMD_SRC_ALL)                  \
+    X(TestMode,         "test_mode",         API_CMD_SRC_ALL)                  \
+    X(RgbTest,          "rgb_test",          API_CMD_SRC_ALL)                  \
+    X(RgbTestStop,      "rgb_test_stop",     API_CMD_SRC_ALL)                  \
+    X(IrTest,           "ir_test",           API_CMD_SRC_ALL)                  \
+    X(IrSend,           "ir_send",           API_CMD_SRC_ALL)                  \
+    X(IrSendGroup,      "ir_send_group",     API_CMD_SRC_ALL)                  \
+    X(IrStop,           "ir_stop",           API_CMD_SRC_ALL)                  \
+    X(IrReceiveOn,      "ir_receive_on",     API_CMD_SRC_ALL)                  \
+    X(IrReceiveOff,     "ir_receive_off",    API_CMD_SRC_ALL)                  \
+    X(RemoteCharged,    "remote_charged",    API_CMD_SRC_ALL)                  \
+    X(RemoteLowBattery, "remote_lowbattery", API_CMD_SRC_ALL)                  \
+    X(RemoteNormal,     "remote_normal",     API_CMD_SRC_ALL)                  \
+    X(Identify,         "identify",          API_CMD_SRC_ALL)                  \
+    X(SetLogging,       "set_logging",       API_CMD_SRC_ALL)                  \
+    X(SetSntp,          "set_sntp",          API_CMD_SRC_ALL)                  \
+    X(Reboot,           "reboot",            API_CMD_SRC_ALL)                  \
+    X(Reset,            "reset",             API_CMD_SRC_ALL)                  \
+    X(SetIrConfig,      "set_ir_config",     API_CMD_SRC_ALL)                  \
+    X(GetIrConfig,      "get_ir_config",     API_CMD_SRC_ALL)                  \
+    X(Subscribe,        "subscribe",         API_CMD_SRC_WS)                   \
+    X(Unsubscribe,      "unsubscribe",       API_CMD_SRC_WS)
+// clang-format on
+
+/// API command identifier
+enum class ApiCommand : uint8_t {
+    Unknown = 0,
+#define API_COMMAND_ENUM(id, name, flags) id,
+    API_COMMANDS(API_COMMAND_ENUM)
+#undef API_COMMAND_ENUM
+};
+
+/// @brief API command table entry.
+struct ApiCommandInfo {
+    const char *name;
+    ApiCommand  command;
+    /// Allowed sources `API_CMD_SRC_*` and `API_CMD_PUBLIC`
+    uint8_t     flags;
+};
+
+/// Command table in order of `ApiCommand`
+static const ApiCommandInfo API_COMMAND_TABLE[] = {
+    {"", ApiCommand::Unknown, 0},
+#define API_COMMAND_ENTRY(id, name, flags) {name, ApiCommand::id, flags},
+    API_COMMANDS(API_COMMAND_ENTRY)
+#undef API_COMMAND_ENTRY
+};
+
+/// @brief FNV-1a hash of a command name. Usable at compile time for `switch` labels.
+constexpr uint32_t apiCommandHash(const char *name, uint32_t hash = 2166136261u) {
+    return *name ? apiCommandHash(name + 1, (hash ^ static_cast<uint8_t>(*name)) * 16777619u) : hash;
+}
+
+/// @brief Get the table entry of a command.
+inline const ApiCommandInfo &apiCommandInfo(ApiCommand command) {
+    size_t index = static_cast<size_t>(command);
+    return API_COMMAND_TABLE[index < sizeof(API_COMMAND_TABLE) / sizeof(API_COMMAND_TABLE[0]) ? index : 0];
+}
+
+/// @brief Find a command by name with a single hash calculation and string compare.
+/// @param name command name, may be null.
+/// @return `ApiCommand::Unknown` if the command doesn't exist.
+inline ApiCommand findApiCommand(const char *name) {
+    if (name == nullptr) {
+        return ApiCommand::Unknown;
+    }
+    ApiCommand command;
+    switch (apiCommandHash(name)) {
+#define API_COMMAND_CASE(id, name, flags) \
+    case apiCommandHash(name):            \
+        command = ApiCommand::id;         \
+        break;
+        API_COMMANDS(API_COMMAND_CASE)
+#undef API_COMMAND_CASE
+        default:
+            return ApiCommand::Unknown;
+    }
+    // different name with the same hash
+    return strcmp(name, apiCommandInfo(command).name) == 0 ? command : ApiCommand::Unknown;
+}
+
+/// @brief Check if a command may be executed.
+/// @param info command table entry.
+/// @param source source flag of the request `API_CMD_SRC_*`.
+/// @param authenticated true if the client is authenticated.
+inline bool isApiCommandAllowed(const ApiCommandInfo &info, uint8_t source, bool authenticated) {
+    return (info.flags & source) && (authenticated || (info.flags & API_CMD_PUBLIC));
+}
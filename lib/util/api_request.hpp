@@ -0,0 +1,575 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Single pass JSON tokenizer for the fixed schema of dock API requests. Extracts the known request fields into a typed
+// request struct without building a document.
+// Make sure this file also compiles natively and all functions are covered by unit tests.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <limits>
+
+#include "api_commands.hpp"
+
+/// Maximum nesting depth of objects and arrays, including the root object. Same as the ArduinoJson default.
+#define API_REQUEST_NESTING_LIMIT 10
+
+// clang-format off
+/// All known request fields: identifier, key. Other keys are skipped.
+#define API_REQUEST_FIELDS(X)                   \
+    X(Type,              "type")                \
+    X(Id,                "id")                  \
+    X(Command,           "command")             \
+    X(Msg,               "msg")                 \
+    X(Token,             "token")               \
+    X(Encoding,          "encoding")            \
+    X(FriendlyName,      "friendly_name")       \
+    X(Ssid,              "ssid")                \
+    X(WifiPassword,      "wifi_password")       \
+    X(StatusLed,         "status_led")          \
+    X(EthLed,            "eth_led")             \
+    X(Color,             "color")               \
+    X(Code,              "code")                \
+    X(Format,            "format")              \
+    X(Repeat,            "repeat")              \
+    X(IntSide,           "int_side")            \
+    X(IntTop,            "int_top")             \
+    X(Ext1,              "ext1")                \
+    X(Ext2,              "ext2")                \
+    X(SendAt,            "send_at")             \
+    X(Priority,          "priority")            \
+    X(Resume,            "resume")              \
+    X(Delay,             "delay")               \
+    X(LogLevel,          "log_level")           \
+    X(SyslogServer,      "syslog_server")       \
+    X(SyslogPort,        "syslog_port")         \
+    X(SyslogEnabled,     "syslog_enabled")      \
+    X(SntpServer1,       "sntp_server1")        \
+    X(SntpServer2,       "sntp_server2")        \
+    X(SntpEnabled,       "sntp_enabled")        \
+    X(IrlearnCore,       "irlearn_core")        \
+    X(IrlearnPrio,       "irlearn_prio")        \
+    X(IrsendCore,        "irsend_core")         \
+    X(IrsendPrio,        "irsend_prio")         \
+    X(GroupKey,          "group_key")           \
+    X(RatelimitBurst,    "ratelimit_burst")     \
+    X(RatelimitRate,     "ratelimit_rate")      \
+    X(RatelimitIpBurst,  "ratelimit_ip_burst")  \
+    X(RatelimitIpRate,   "ratelimit_ip_rate")   \
+    X(GcLearnCompressed, "gc_learn_compressed") \
+    X(Topics,            "topics")
+// clang-format on
+
+/// API request field identifier
+enum class ApiField : uint8_t {
+#define API_FIELD_ENUM(id, key) id,
+    API_REQUEST_FIELDS(API_FIELD_ENUM)
+#undef API_FIELD_ENUM
+    Count
+};
+
+static_assert(static_cast<size_t>(ApiField::Count) <= 64, "field presence is stored in a 64 bit mask");
+
+/// Field keys in order of `ApiField`
+static const char *const API_FIELD_KEYS[] = {
+#define API_FIELD_KEY(id, key) key,
+    API_REQUEST_FIELDS(API_FIELD_KEY)
+#undef API_FIELD_KEY
+};
+
+enum class ApiValueType : uint8_t {
+    Null = 0,
+    Bool,
+    Integer,
+    Float,
+    String,
+    Object,
+    Array,
+};
+
+/// Parse result. The names match the ArduinoJson `DeserializationError` codes.
+enum class ApiParseError : uint8_t {
+    Ok = 0,
+    EmptyInput,
+    IncompleteInput,
+    InvalidInput,
+    TooDeep,
+};
+
+inline const char *apiParseErrorName(ApiParseError error) {
+    switch (error) {
+        case ApiParseError::Ok:
+            return "Ok";
+        case ApiParseError::EmptyInput:
+            return "EmptyInput";
+        case ApiParseError::IncompleteInput:
+            return "IncompleteInput";
+        case ApiParseError::InvalidInput:
+            return "InvalidInput";
+        case ApiParseError::TooDeep:
+            return "TooDeep";
+    }
+    return "InvalidInput";
+}
+
+/// @brief Value of a request field. Strings point into the parsed request buffer.
+struct ApiValue {
+    union {
+        /// String, or the first element of a MessagePack array. Null for other arrays and objects.
+        const char *str;
+        int64_t     integer;
+        double      real;
+        bool        boolean;
+    };
+    /// String length, or number of MessagePack array elements
+    uint32_t     length;
+    ApiValueType type;
+};
+
+/// @brief Known fields of an API request.
+///
+/// Accessors return the default value if a field is missing or has a different type. Numbers are only converted if
+/// they fit into the requested type, floating point numbers are truncated. Booleans are also accepted as numbers and
+/// numbers as booleans, strings are never converted.
+class ApiRequest {
+ public:
+    ApiRequest() = default;
+
+    ApiRequest(const ApiRequest &) = delete;  // no copying
+    ApiRequest &operator=(const ApiRequest &) = delete;
+
+    /// @brief Check if a field is present, regardless of its type and value.
+    bool has(ApiField field) const { return m_present & bit(field); }
+
+    /// @brief Get the type of a field. Only valid if the field is present.
+    ApiValueType type(ApiField field) const { return m_values[static_cast<size_t>(field)].type; }
+
+    /// @brief Get the raw value of a field.
+    /// @return nullptr if the field is missing.
+    const ApiValue *value(ApiField field) const { return has(field) ? &m_values[static_cast<size_t>(field)] : nullptr; }
+
+    /// @brief Get a zero-terminated string field.
+    const char *getString(ApiField field, const char *defaultValue = nullptr) const {
+        const ApiValue *value = get(field, ApiValueType::String);
+        return value ? value->str : defaultValue;
+    }
+
+    /// @brief Get the length of a string field, 0 if it's not a string.
+    size_t getStringLength(ApiField field) const {
+        const ApiValue *value = get(field, ApiValueType::String);
+        return value ? value->length : 0;
+    }
+
+    /// @brief Get an integer field, or the default value if it doesn't fit into `T`.
+    template <typename T>
+    T getInt(ApiField field, T defaultValue = 0) const {
+        if (!has(field)) {
+            return defaultValue;
+        }
+        const ApiValue &value = m_values[static_cast<size_t>(field)];
+        switch (value.type) {
+            case ApiValueType::Integer:
+                return inRange<T>(value.integer) ? static_cast<T>(value.integer) : defaultValue;
+            case ApiValueType::Float:
+                if (value.real > -9.2e18 && value.real < 9.2e18 && inRange<T>(static_cast<int64_t>(value.real))) {
+                    return static_cast<T>(value.real);
+                }
+                return defaultValue;
+            case ApiValueType::Bool:
+                return value.boolean ? 1 : 0;
+            default:
+                return defaultValue;
+        }
+    }
+
+    /// @brief Get a boolean field. Numbers other than 0 are true.
+    bool getBool(ApiField field, bool defaultValue = false) const {
+        if (!has(field)) {
+            return defaultValue;
+        }
+        const ApiValue &value = m_values[static_cast<size_t>(field)];
+        switch (value.type) {
+            case ApiValueType::Bool:
+                return value.boolean;
+            case ApiValueType::Integer:
+                return value.integer != 0;
+            case ApiValueType::Float:
+                return value.real != 0;
+            default:
+                return defaultValue;
+        }
+    }
+
+    /// @brief Remove all fields.
+    void clear() { m_present = 0; }
+
+    /// @brief Set a field value. Used by the tokenizer, a repeated key replaces the previous value.
+    void set(ApiField field, const ApiValue &value) {
+        m_values[static_cast<size_t>(field)] = value;
+        m_present |= bit(field);
+    }
+
+ private:
+    static uint64_t bit(ApiField field) { return 1ULL << static_cast<uint8_t>(field); }
+
+    template <typename T>
+    static bool inRange(int64_t value) {
+        if (std::numeric_limits<T>::is_signed) {
+            return value >= static_cast<int64_t>(std::numeric_limits<T>::min()) &&
+                   value <= static_cast<int64_t>(std::numeric_limits<T>::max());
+        }
+        return value >= 0 && static_cast<uint64_t>(value) <= static_cast<uint64_t>(std::numeric_limits<T>::max());
+    }
+
+    const ApiValue *get(ApiField field, ApiValueType type) const {
+        const ApiValue *value = &m_values[static_cast<size_t>(field)];
+        return has(field) && value->type == type ? value : nullptr;
+    }
+
+    uint64_t m_present = 0;
+    ApiValue m_values[static_cast<size_t>(ApiField::Count)];
+};
+
+/// @brief Find a request field by key with a single hash calculation and string compare.
+/// @param key key, doesn't need to be zero-terminated.
+/// @param length key length.
+/// @return `ApiField::Count` if the key is unknown.
+inline ApiField findApiField(const char *key, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ static_cast<uint8_t>(key[i])) * 16777619u;
+    }
+    ApiField field;
+    switch (hash) {
+#define API_FIELD_CASE(id, key) \
+    case apiCommandHash(key):   \
+        field = ApiField::id;   \
+        break;
+        API_REQUEST_FIELDS(API_FIELD_CASE)
+#undef API_FIELD_CASE
+        default:
+            return ApiField::Count;
+    }
+    // different key with the same hash
+    const char *name = API_FIELD_KEYS[static_cast<size_t>(field)];
+    return strlen(name) == length && memcmp(name, key, length) == 0 ? field : ApiField::Count;
+}
+
+inline char *skipApiWhitespace(char *pos) {
+    while (*pos == ' ' || *pos == '\t' || *pos == '\r' || *pos == '\n') {
+        pos++;
+    }
+    return pos;
+}
+
+inline int apiHexDigit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/// @brief Read the 4 hex digits of a `\u` escape sequence.
+/// @return the code unit, or -1 if invalid.
+inline int32_t parseApiUnicodeEscape(const char *pos) {
+    int32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = apiHexDigit(pos[i]);
+        if (digit < 0) {
+            return -1;
+        }
+        value = value << 4 | digit;
+    }
+    return value;
+}
+
+/// @brief Parse a JSON string in place: escape sequences are decoded and the string is zero-terminated.
+/// @param pos position of the opening quote, set to the position after the closing quote.
+/// @param str start of the decoded string.
+/// @param length length of the decoded string.
+inline ApiParseError parseApiString(char **pos, char **str, uint32_t *length) {
+    char *read = *pos + 1;
+    char *write = read;
+    *str = read;
+    while (true) {
+        char c = *read;
+        if (c == '\0') {
+            return ApiParseError::IncompleteInput;
+        }
+        if (c == '"') {
+            break;
+        }
+        if (static_cast<uint8_t>(c) < 0x20) {
+            return ApiParseError::InvalidInput;
+        }
+        if (c != '\\') {
+            *write++ = *read++;
+            continue;
+        }
+        c = read[1];
+        read += 2;
+        switch (c) {
+            case '"':
+            case '\\':
+            case '/':
+                *write++ = c;
+                break;
+            case 'b':
+                *write++ = '\b';
+                break;
+            case 'f':
+                *write++ = '\f';
+                break;
+            case 'n':
+                *write++ = '\n';
+                break;
+            case 'r':
+                *write++ = '\r';
+                break;
+            case 't':
+                *write++ = '\t';
+                break;
+            case 'u': {
+                if (strnlen(read, 4) < 4) {
+                    return ApiParseError::IncompleteInput;
+                }
+                int32_t cp = parseApiUnicodeEscape(read);
+                if (cp < 0) {
+                    return ApiParseError::InvalidInput;
+                }
+                read += 4;
+                if (cp >= 0xD800 && cp < 0xDC00) {
+                    // high surrogate: must be followed by the low surrogate
+                    if (strnlen(read, 6) < 6) {
+                        return ApiParseError::IncompleteInput;
+                    }
+                    int32_t low = read[0] == '\\' && read[1] == 'u' ? parseApiUnicodeEscape(read + 2) : -1;
+                    if (low < 0xDC00 || low >= 0xE000) {
+                        return ApiParseError::InvalidInput;
+                    }
+                    read += 6;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                } else if (cp >= 0xDC00 && cp < 0xE000) {
+                    return ApiParseError::InvalidInput;
+                }
+                // UTF-8 encoding is never longer than the escape sequence
+                if (cp < 0x80) {
+                    *write++ = static_cast<char>(cp);
+                } else if (cp < 0x800) {
+                    *write++ = static_cast<char>(0xC0 | cp >> 6);
+                    *write++ = static_cast<char>(0x80 | (cp & 0x3F));
+                } else if (cp < 0x10000) {
+                    *write++ = static_cast<char>(0xE0 | cp >> 12);
+                    *write++ = static_cast<char>(0x80 | (cp >> 6 & 0x3F));
+                    *write++ = static_cast<char>(0x80 | (cp & 0x3F));
+                } else {
+                    *write++ = static_cast<char>(0xF0 | cp >> 18);
+                    *write++ = static_cast<char>(0x80 | (cp >> 12 & 0x3F));
+                    *write++ = static_cast<char>(0x80 | (cp >> 6 & 0x3F));
+                    *write++ = static_cast<char>(0x80 | (cp & 0x3F));
+                }
+                break;
+            }
+            case '\0':
+                return ApiParseError::IncompleteInput;
+            default:
+                return ApiParseError::InvalidInput;
+        }
+    }
+    *write = '\0';
+    *length = write - *str;
+    *pos = read + 1;
+    return ApiParseError::Ok;
+}
+
+/// @brief Parse a JSON number.
+/// @param pos start of the number, set to the position after the number.
+inline ApiParseError parseApiNumber(char **pos, ApiValue *value) {
+    char *start = *pos;
+    char *p = start;
+    bool  negative = *p == '-';
+    if (negative) {
+        p++;
+    }
+    if (*p < '0' || *p > '9') {
+        return *p ? ApiParseError::InvalidInput : ApiParseError::IncompleteInput;
+    }
+    // integer part: leading zeros are not allowed
+    uint64_t magnitude = 0;
+    bool     overflow = false;
+    if (*p == '0') {
+        p++;
+    } else {
+        while (*p >= '0' && *p <= '9') {
+            uint8_t digit = *p++ - '0';
+            if (magnitude > (UINT64_MAX - digit) / 10) {
+                overflow = true;
+            } else {
+                magnitude = magnitude * 10 + digit;
+            }
+        }
+    }
+    bool isFloat = false;
+    if (*p == '.') {
+        isFloat = true;
+        p++;
+        if (*p < '0' || *p > '9') {
+            return *p ? ApiParseError::InvalidInput : ApiParseError::IncompleteInput;
+        }
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+    if (*p == 'e' || *p == 'E') {
+        isFloat = true;
+        p++;
+        if (*p == '+' || *p == '-') {
+            p++;
+        }
+        if (*p < '0' || *p > '9') {
+            return *p ? ApiParseError::InvalidInput : ApiParseError::IncompleteInput;
+        }
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+    uint64_t limit = negative ? static_cast<uint64_t>(INT64_MAX) + 1 : INT64_MAX;
+    if (isFloat || overflow || magnitude > limit) {
+        value->type = ApiValueType::Float;
+        value->real = strtod(start, nullptr);
+    } else {
+        value->type = ApiValueType::Integer;
+        value->integer = negative ? static_cast<int64_t>(0 - magnitude) : static_cast<int64_t>(magnitude);
+    }
+    *pos = p;
+    return ApiParseError::Ok;
+}
+
+/// @brief Parse the literals `true`, `false` and `null`.
+inline ApiParseError parseApiLiteral(char **pos, ApiValue *value) {
+    static const char *const literals[] = {"true", "false", "null"};
+    for (uint8_t i = 0; i < 3; i++) {
+        size_t len = strlen(literals[i]);
+        size_t n = strnlen(*pos, len);
+        if (strncmp(*pos, literals[i], n) != 0) {
+            continue;
+        }
+        if (n < len) {
+            return ApiParseError::IncompleteInput;
+        }
+        *pos += len;
+        value->type = i == 2 ? ApiValueType::Null : ApiValueType::Bool;
+        value->boolean = i == 0;
+        return ApiParseError::Ok;
+    }
+    return ApiParseError::InvalidInput;
+}
+
+/// @brief Parse a JSON value. Object members are only stored in `request` at nesting level 1.
+/// @param pos start of the value, set to the position after the value.
+/// @param depth nesting depth of the value.
+inline ApiParseError parseApiValue(char **pos, uint8_t depth, ApiValue *value, ApiRequest *request) {
+    char *p = *pos;
+    if (*p == '"') {
+        char        *str;
+        ApiParseError err = parseApiString(&p, &str, &value->length);
+        if (err != ApiParseError::Ok) {
+            return err;
+        }
+        value->type = ApiValueType::String;
+        value->str = str;
+        *pos = p;
+        return ApiParseError::Ok;
+    }
+    if (*p == '-' || (*p >= '0' && *p <= '9')) {
+        return parseApiNumber(pos, value);
+    }
+    if (*p != '{' && *p != '[') {
+        return *p ? parseApiLiteral(pos, value) : ApiParseError::IncompleteInput;
+    }
+    if (depth > API_REQUEST_NESTING_LIMIT) {
+        return ApiParseError::TooDeep;
+    }
+
+    bool isObject = *p == '{';
+    char close = isObject ? '}' : ']';
+    value->type = isObject ? ApiValueType::Object : ApiValueType::Array;
+    value->str = nullptr;
+    value->length = 0;
+    p = skipApiWhitespace(p + 1);
+    if (*p == close) {
+        *pos = p + 1;
+        return ApiParseError::Ok;
+    }
+    while (true) {
+        ApiField field = ApiField::Count;
+        if (isObject) {
+            if (*p != '"') {
+                return *p ? ApiParseError::InvalidInput : ApiParseError::IncompleteInput;
+            }
+            char        *key;
+            uint32_t     keyLength;
+            ApiParseError err = parseApiString(&p, &key, &keyLength);
+            if (err != ApiParseError::Ok) {
+                return err;
+            }
+            if (depth == 1 && request) {
+                field = findApiField(key, keyLength);
+            }
+            p = skipApiWhitespace(p);
+            if (*p != ':') {
+                return *p ? ApiParseError::InvalidInput : ApiParseError::IncompleteInput;
+            }
+            p = skipApiWhitespace(p + 1);
+        }
+        ApiValue      member;
+        ApiParseError err = parseApiValue(&p, depth + 1, &member, request);
+        if (err != ApiParseError::Ok) {
+            return err;
+        }
+        if (field != ApiField::Count) {
+            request->set(field, member);
+        }
+        p = skipApiWhitespace(p);
+        if (*p == close) {
+            *pos = p + 1;
+            return ApiParseError::Ok;
+        }
+        if (*p != ',') {
+            return *p ? ApiParseError::InvalidInput : ApiParseError::IncompleteInput;
+        }
+        p = skipApiWhitespace(p + 1);
+    }
+}
+
+/// @brief Parse an API request in place and extract the known fields.
+///
+/// Like ArduinoJson with a writable buffer, string values are decoded in the request buffer and zero-terminated, so
+/// the buffer is modified and must outlive the request. Unknown fields and nested values are validated and skipped.
+/// A root value other than an object is valid but has no fields. Characters after the root value are ignored.
+///
+/// @param json zero-terminated request, modified while parsing.
+/// @param request parsed fields. Cleared first, and may be incomplete if an error is returned.
+inline ApiParseError parseApiRequest(char *json, ApiRequest *request) {
+    request->clear();
+    if (json == nullptr) {
+        return ApiParseError::EmptyInput;
+    }
+    char *pos = skipApiWhitespace(json);
+    if (*pos == '\0') {
+        return ApiParseError::EmptyInput;
+    }
+    ApiValue root;
+    return parseApiValue(&pos, 1, &root, *pos == '{' ? request : nullptr);
+}
@@ -0,0 +1,206 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Event topics of the WebSocket API and the subscribed clients of each topic.
+// Make sure this file also compiles natively and all functions are covered by unit tests.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// clang-format off
+/// All event topics: identifier, topic name
+#define API_TOPICS(X)                \
+    X(IrReceive, "ir_receive")       \
+    X(State,     "state")            \
+    X(Metrics,   "metrics")
+// clang-format on
+
+/// Event topic identifier
+enum class ApiTopic : uint8_t {
+#define API_TOPIC_ENUM(id, name) id,
+    API_TOPICS(API_TOPIC_ENUM)
+#undef API_TOPIC_ENUM
+    Count
+};
+
+/// Topic names in order of `ApiTopic`
+static const char *const API_TOPIC_NAMES[] = {
+#define API_TOPIC_NAME(id, name) name,
+    API_TOPICS(API_TOPIC_NAME)
+#undef API_TOPIC_NAME
+};
+
+static_assert(static_cast<size_t>(ApiTopic::Count) <= 8, "topics are stored in an 8 bit mask");
+
+/// @brief Bit of a topic in a topic mask.
+inline uint8_t apiTopicBit(ApiTopic topic) {
+    return 1 << static_cast<uint8_t>(topic);
+}
+
+/// @brief Parse a comma separated list of topic names, e.g. `ir_receive,state`.
+/// @param list topic names. Spaces around the names are ignored.
+/// @param topics returns the topic mask, see `apiTopicBit`.
+/// @return false if a topic name is unknown or the list is null.
+inline bool parseApiTopics(const char *list, uint8_t *topics) {
+    if (list == nullptr) {
+        return false;
+    }
+    uint8_t mask = 0;
+    while (*list) {
+        while (*list == ' ') {
+            list++;
+        }
+        const char *end = list;
+        while (*end && *end != ',' && *end != ' ') {
+            end++;
+        }
+        size_t length = end - list;
+        size_t i = 0;
+        for (; i < static_cast<size_t>(ApiTopic::Count); i++) {
+            if (strlen(API_TOPIC_NAMES[i]) == length && strncmp(API_TOPIC_NAMES[i], list, length) == 0) {
+                mask |= 1 << i;
+                break;
+            }
+        }
+        if (i == static_cast<size_t>(ApiTopic::Count)) {
+            return false;
+        }
+        while (*end == ' ') {
+            end++;
+        }
+        if (*end == ',') {
+            end++;
+            if (*end == 0) {
+                return false;
+            }
+        } else if (*end) {
+            return false;
+        }
+        list = end;
+    }
+    *topics = mask;
+    return true;
+}
+
+/// @brief Write a topic mask as comma separated list of topic names.
+/// @return false if the buffer is too small.
+inline bool formatApiTopics(uint8_t topics, char *buffer, size_t size) {
+    if (size == 0) {
+        return false;
+    }
+    size_t pos = 0;
+    buffer[0] = 0;
+    for (size_t i = 0; i < static_cast<size_t>(ApiTopic::Count); i++) {
+        if (!(topics & (1 << i))) {
+            continue;
+        }
+        size_t length = strlen(API_TOPIC_NAMES[i]);
+        if (pos + (pos ? 1 : 0) + length >= size) {
+            return false;
+        }
+        if (pos) {
+            buffer[pos++] = ',';
+        }
+        memcpy(buffer + pos, API_TOPIC_NAMES[i], length + 1);
+        pos += length;
+    }
+    return true;
+}
+
+/// @brief Set of client numbers `0..N-1`, stored in a bitmap.
+template <size_t N>
+class ClientSet {
+    static_assert(N <= 32, "clients are stored in a 32 bit mask");
+
+ public:
+    static ClientSet of(uint8_t client) {
+        ClientSet set;
+        set.insert(client);
+        return set;
+    }
+    /// All clients `0..N-1`
+    static ClientSet all() {
+        ClientSet set;
+        set.m_bits = static_cast<uint32_t>((1ULL << N) - 1);
+        return set;
+    }
+
+    /// @brief Add a client. Invalid client numbers are ignored.
+    void insert(uint8_t client) {
+        if (client < N) {
+            m_bits |= 1UL << client;
+        }
+    }
+    void erase(uint8_t client) {
+        if (client < N) {
+            m_bits &= ~(1UL << client);
+        }
+    }
+    bool contains(uint8_t client) const { return client < N && (m_bits & (1UL << client)); }
+    bool empty() const { return m_bits == 0; }
+    void clear() { m_bits = 0; }
+
+    size_t size() const {
+        size_t   count = 0;
+        uint32_t bits = m_bits;
+        for (; bits; bits &= bits - 1) {
+            count++;
+        }
+        return count;
+    }
+
+    /// @brief Clients contained in both sets.
+    ClientSet operator&(const ClientSet &other) const {
+        ClientSet set;
+        set.m_bits = m_bits & other.m_bits;
+        return set;
+    }
+
+ private:
+    uint32_t m_bits = 0;
+};
+
+/// @brief Topic subscriptions of `N` clients. Not synchronized.
+template <size_t N>
+class TopicSubscriptions {
+ public:
+    /// @brief Subscribe a client to the topics of a topic mask, in addition to its current topics.
+    void subscribe(uint8_t client, uint8_t topics) {
+        for (size_t i = 0; i < static_cast<size_t>(ApiTopic::Count); i++) {
+            if (topics & (1 << i)) {
+                m_subscribers[i].insert(client);
+            }
+        }
+    }
+
+    /// @brief Unsubscribe a client from the topics of a topic mask.
+    void unsubscribe(uint8_t client, uint8_t topics) {
+        for (size_t i = 0; i < static_cast<size_t>(ApiTopic::Count); i++) {
+            if (topics & (1 << i)) {
+                m_subscribers[i].erase(client);
+            }
+        }
+    }
+
+    /// @brief Remove all subscriptions of a client, e.g. after it disconnected.
+    void removeClient(uint8_t client) { unsubscribe(client, 0xFF); }
+
+    /// @brief Topic mask of a client.
+    uint8_t topics(uint8_t client) const {
+        uint8_t mask = 0;
+        for (size_t i = 0; i < static_cast<size_t>(ApiTopic::Count); i++) {
+            if (m_subscribers[i].contains(client)) {
+                mask |= 1 << i;
+            }
+        }
+        return mask;
+    }
+
+    const ClientSet<N> &subscribers(ApiTopic topic) const { return m_subscribers[static_cast<size_t>(topic)]; }
+
+ private:
+    ClientSet<N> m_subscribers[static_cast<size_t>(ApiTopic::Count)];
+};
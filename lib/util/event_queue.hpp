@@ -0,0 +1,186 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Bounded event queue for a task waiting on sockets with `select()`. Posting an event from another task wakes up the
+// waiting task through a loopback UDP socket. Works with lwIP and POSIX sockets.
+// Make sure this file also compiles natively and all functions are covered by unit tests.
+
+#pragma once
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <mutex>
+
+/// @brief Fixed size queue of events posted from any task to a single task waiting with `select()`.
+///
+/// Only the first event posted to an empty queue sends a wake-up datagram, the waiting task processes all queued
+/// events at once. Posting never blocks.
+template <typename T, size_t N>
+class SocketEventQueue {
+    static_assert(N > 0, "queue size must be at least 1");
+
+ public:
+    SocketEventQueue() = default;
+    ~SocketEventQueue() { close(); }
+
+    SocketEventQueue(const SocketEventQueue &) = delete;  // no copying
+    SocketEventQueue &operator=(const SocketEventQueue &) = delete;
+
+    /// @brief Create the loopback UDP sockets to wake up the waiting task. Events can only be posted while open.
+    /// @return errno value of the failed operation, 0 if successful.
+    int open() {
+        close();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_wakeFd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        m_wakeSendFd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        int err = 0;
+        if (m_wakeFd < 0 || m_wakeSendFd < 0) {
+            err = errno ? errno : -1;
+        } else {
+            memset(&m_wakeAddr, 0, sizeof(m_wakeAddr));
+            m_wakeAddr.sin_family = AF_INET;
+            m_wakeAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            m_wakeAddr.sin_port = 0;  // any free port
+            socklen_t len = sizeof(m_wakeAddr);
+            if (bind(m_wakeFd, reinterpret_cast<struct sockaddr *>(&m_wakeAddr), sizeof(m_wakeAddr)) != 0 ||
+                getsockname(m_wakeFd, reinterpret_cast<struct sockaddr *>(&m_wakeAddr), &len) != 0) {
+                err = errno ? errno : -1;
+            }
+        }
+        if (err) {
+            closeSockets();
+            return err;
+        }
+        int flags = fcntl(m_wakeFd, F_GETFL, 0);
+        fcntl(m_wakeFd, F_SETFL, flags | O_NONBLOCK);
+        return 0;
+    }
+
+    /// @brief Close the wake sockets and discard all pending events.
+    void close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        closeSockets();
+        m_head = 0;
+        m_count = 0;
+    }
+
+    bool isOpen() const { return m_wakeFd >= 0; }
+
+    /// @brief Post an event from any task. Never blocks.
+    /// @return false if the queue is full or not open.
+    bool post(const T &event) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_wakeSendFd < 0 || m_count >= N) {
+            return false;
+        }
+        m_events[(m_head + m_count) % N] = event;
+        m_count++;
+        if (m_count == 1) {
+            // wake up the waiting task. Only required for the first event, the task processes all queued events.
+            char wake = 0;
+            sendto(m_wakeSendFd, &wake, 1, MSG_DONTWAIT, reinterpret_cast<struct sockaddr *>(&m_wakeAddr),
+                   sizeof(m_wakeAddr));
+        }
+        return true;
+    }
+
+    /// @brief Get the next event. Must only be called from the waiting task.
+    /// @return false if there are no more events.
+    bool pop(T *event) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_count == 0) {
+            return false;
+        }
+        *event = m_events[m_head];
+        m_head = (m_head + 1) % N;
+        m_count--;
+        return true;
+    }
+
+    /// @brief Number of queued events.
+    size_t pending() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_count;
+    }
+
+    /// @brief Add the wake socket to the read set of a `select()` call.
+    /// @param maxFd highest socket in `readSet`, -1 if empty.
+    /// @return the highest socket in `readSet` including the wake socket.
+    int addTo(fd_set *readSet, int maxFd) const {
+        if (m_wakeFd < 0) {
+            return maxFd;
+        }
+        FD_SET(m_wakeFd, readSet);
+        return m_wakeFd > maxFd ? m_wakeFd : maxFd;
+    }
+
+    /// @brief Check if the task has been woken up after a `select()` call, and reset the wake-up. All queued events
+    ///        must be processed with `pop` afterwards.
+    bool woken(const fd_set *readSet) {
+        if (m_wakeFd < 0 || !FD_ISSET(m_wakeFd, readSet)) {
+            return false;
+        }
+        char    buf[16];
+        ssize_t len;
+        do {
+            len = recv(m_wakeFd, buf, sizeof(buf), 0);
+        } while (len > 0);
+        return true;
+    }
+
+    /// @brief Wait for posted events, readable or writable sockets.
+    /// @param readSet sockets to wait for, may be empty. Contains the readable sockets afterwards. Events are pending
+    ///        if `woken` returns true.
+    /// @param maxFd highest socket in `readSet` and `writeSet`, -1 if empty.
+    /// @param timeoutMs maximum wait time in milliseconds, negative value to wait forever.
+    /// @param writeSet optional sockets to wait for until they can send data, e.g. with pending outbound messages.
+    ///        Contains the writable sockets afterwards.
+    /// @return number of ready sockets including the wake socket, 0 if timed out, negative value on error.
+    int wait(fd_set *readSet, int maxFd, int timeoutMs, fd_set *writeSet = nullptr) {
+        maxFd = addTo(readSet, maxFd);
+        struct timeval  tv;
+        struct timeval *timeout = nullptr;
+        if (timeoutMs >= 0) {
+            tv.tv_sec = timeoutMs / 1000;
+            tv.tv_usec = (timeoutMs % 1000) * 1000;
+            timeout = &tv;
+        }
+        int ready = select(maxFd + 1, readSet, writeSet, nullptr, timeout);
+        if (ready <= 0) {
+            FD_ZERO(readSet);
+            if (writeSet) {
+                FD_ZERO(writeSet);
+            }
+        }
+        return ready;
+    }
+
+ private:
+    void closeSockets() {
+        if (m_wakeFd >= 0) {
+            ::close(m_wakeFd);
+            m_wakeFd = -1;
+        }
+        if (m_wakeSendFd >= 0) {
+            ::close(m_wakeSendFd);
+            m_wakeSendFd = -1;
+        }
+    }
+
+    // Protects the events and the send socket
+    std::mutex         m_mutex;
+    T                  m_events[N];
+    size_t             m_head = 0;
+    size_t             m_count = 0;
+    int                m_wakeFd = -1;
+    int                m_wakeSendFd = -1;
+    struct sockaddr_in m_wakeAddr;
+};
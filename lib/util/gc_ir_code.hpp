@@ -0,0 +1,486 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Parsed GlobalCache sendir IR code.
+// Make sure this file also compiles natively and all functions are covered by unit tests.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Index of the frequency value in `GCIrCode::data`.
+#define GC_IR_FREQ_INDEX 0
+/// Index of the repeat value in `GCIrCode::data`.
+#define GC_IR_REPEAT_INDEX 1
+/// Index of the offset value in `GCIrCode::data`.
+#define GC_IR_OFFSET_INDEX 2
+/// Index of the first timing value in `GCIrCode::data`.
+#define GC_IR_TIMING_INDEX 3
+/// Maximum number of symbols in the compressed format: A..O
+#define GC_IR_MAX_SYMBOLS 15
+
+/// @brief GlobalCache IR code, parsed once from a `sendir` request and passed on in binary form until it's sent.
+///
+/// Owns the timing data. Not copyable, only movable. The data buffer is reused when parsing another code into the
+/// same object, if it's large enough.
+struct GCIrCode {
+    /// Module address, always 1
+    uint8_t   module = 0;
+    /// Connector address 1..15
+    uint8_t   port = 0;
+    /// Command ID, returned in the `completeir` response
+    uint16_t  id = 0;
+    /// Number of values in `data`
+    uint16_t  count = 0;
+    /// Frequency, repeat, offset, followed by the on/off timing pairs. This is the buffer layout of `IRsend::sendGC`.
+    uint16_t *data = nullptr;
+    /// Allocated number of values in `data`
+    uint16_t  capacity = 0;
+
+    GCIrCode() = default;
+    ~GCIrCode() { free(data); }
+
+    GCIrCode(const GCIrCode &) = delete;  // no copying
+    GCIrCode &operator=(const GCIrCode &) = delete;
+
+    GCIrCode(GCIrCode &&other) { *this = static_cast<GCIrCode &&>(other); }
+    GCIrCode &operator=(GCIrCode &&other) {
+        if (this != &other) {
+            free(data);
+            module = other.module;
+            port = other.port;
+            id = other.id;
+            count = other.count;
+            data = other.data;
+            capacity = other.capacity;
+            other.count = 0;
+            other.data = nullptr;
+            other.capacity = 0;
+        }
+        return *this;
+    }
+
+    bool      isValid() const { return data != nullptr && count > GC_IR_TIMING_INDEX; }
+    uint16_t  frequency() const { return isValid() ? data[GC_IR_FREQ_INDEX] : 0; }
+    uint16_t  repeat() const { return isValid() ? data[GC_IR_REPEAT_INDEX] : 0; }
+    uint16_t  offset() const { return isValid() ? data[GC_IR_OFFSET_INDEX] : 0; }
+    /// Number of on/off timing values.
+    uint16_t  timingCount() const { return isValid() ? count - GC_IR_TIMING_INDEX : 0; }
+    uint16_t *timings() const { return isValid() ? data + GC_IR_TIMING_INDEX : nullptr; }
+
+    /// @brief Compare address, ID and IR code data.
+    bool operator==(const GCIrCode &other) const {
+        return module == other.module && port == other.port && id == other.id && count == other.count &&
+               (count == 0 || memcmp(data, other.data, count * sizeof(uint16_t)) == 0);
+    }
+    bool operator!=(const GCIrCode &other) const { return !(*this == other); }
+};
+
+/// @brief Parse an unsigned decimal number terminated by a comma or the end of the string.
+/// @param str number to parse. Updated to point to the character after the number and separator.
+/// @param max maximum allowed value.
+/// @param value parsed value.
+/// @return false if the number is invalid or out of range.
+inline bool parseGcNumber(const char **str, uint32_t max, uint32_t *value) {
+    const char *c = *str;
+    if (*c < '0' || *c > '9') {
+        return false;
+    }
+    uint32_t number = 0;
+    while (*c >= '0' && *c <= '9') {
+        number = number * 10 + (*c - '0');
+        if (number > max) {
+            return false;
+        }
+        c++;
+    }
+    if (*c == ',') {
+        c++;
+    } else if (*c != 0) {
+        return false;
+    }
+    *value = number;
+    *str = c;
+    return true;
+}
+
+/// @brief Parse a GlobalCache IR code into its binary representation.
+///
+/// The full iTach request message and the short form without module address and ID is supported:
+/// - `sendir,<module>:<port>,<ID>,<freq>,<repeat>,<offset>,<on1>,<off1>,...,<onN>,<offN>`
+/// - `<freq>,<repeat>,<offset>,<on1>,<off1>,...,<onN>,<offN>`: module and port are set to 1, ID to 0.
+///
+/// The timings may be in the compressed iTach format: every unique on/off pair is assigned a letter from `A` to `O` in
+/// order of appearance. Subsequent occurrences of the pair can be replaced by the letter. The comma separator before
+/// and after a letter is optional, e.g. `...,22,22,22,65,BBBCCB,22,1527`.
+///
+/// @param request IR code string **without** terminating carriage return.
+/// @param code the parsed IR code. Only valid if successful.
+/// @param memError optional memory allocation error indicator. Set to 1 if memory allocation failed.
+/// @return 0 if successful, iTach error code otherwise.
+inline uint8_t parseGcIrCode(const char *request, GCIrCode *code, int *memError = NULL) {
+    if (memError) {
+        *memError = 0;
+    }
+    if (request == nullptr || code == nullptr) {
+        return 1;  // invalid command
+    }
+
+    // keep the data buffer for reuse
+    code->module = 0;
+    code->port = 0;
+    code->id = 0;
+    code->count = 0;
+    const char *current = request;
+    uint32_t    value;
+
+    if (strncmp(current, "sendir,", 7) == 0) {
+        current += 7;
+        // <module>:<port>
+        if (!(current[0] == '1' && current[1] == ':')) {
+            return 2;  // invalid module address
+        }
+        current += 2;
+        if (!parseGcNumber(&current, 15, &value) || value < 1) {
+            return 3;  // invalid connector address
+        }
+        code->module = 1;
+        code->port = value;
+        if (!parseGcNumber(&current, UINT16_MAX, &value)) {
+            return 4;  // invalid ID
+        }
+        code->id = value;
+    } else {
+        code->module = 1;
+        code->port = 1;
+    }
+
+    // count the remaining values to allocate the exact amount of required memory: every number is one value, every
+    // compression symbol a pair of values
+    uint32_t count = 0;
+    for (const char *c = current; *c; c++) {
+        if (*c >= '0' && *c <= '9') {
+            if (c == current || c[-1] < '0' || c[-1] > '9') {
+                count++;
+            }
+        } else if (*c >= 'A' && *c <= 'O') {
+            count += 2;
+        }
+    }
+    if (count <= GC_IR_TIMING_INDEX) {
+        return 8;  // invalid pulse count
+    }
+    if (count > UINT16_MAX) {
+        return 20;  // above on/off pair limit
+    }
+    if (code->capacity < count) {
+        free(code->data);
+        code->data = reinterpret_cast<uint16_t *>(malloc(count * sizeof(uint16_t)));
+        code->capacity = code->data ? count : 0;
+        if (code->data == nullptr) {
+            if (memError) {
+                *memError = 1;
+            }
+            return 1;
+        }
+    }
+    uint16_t *data = code->data;
+    code->count = count;
+
+    // IRsend::sendGC only supports 16 bit frequencies
+    if (!parseGcNumber(&current, UINT16_MAX, &value) || value < 15000) {
+        return 5;  // invalid frequency
+    }
+    data[GC_IR_FREQ_INDEX] = value;
+    if (!parseGcNumber(&current, 50, &value) || value < 1) {
+        return 6;  // invalid repeat
+    }
+    data[GC_IR_REPEAT_INDEX] = value;
+    if (!parseGcNumber(&current, UINT16_MAX, &value)) {
+        return 7;  // invalid offset
+    }
+    data[GC_IR_OFFSET_INDEX] = value;
+
+    // index of the first value of each unique pair for the compression symbols
+    uint16_t symbols[GC_IR_MAX_SYMBOLS];
+    uint8_t  symbolCount = 0;
+    uint16_t i = GC_IR_TIMING_INDEX;
+    while (*current) {
+        char c = *current;
+        if (c >= 'A' && c <= 'O') {
+            if ((i - GC_IR_TIMING_INDEX) % 2) {
+                return 21;  // symbol odd boundary
+            }
+            uint8_t symbol = c - 'A';
+            if (symbol >= symbolCount) {
+                return 22;  // undefined symbol
+            }
+            data[i] = data[symbols[symbol]];
+            data[i + 1] = data[symbols[symbol] + 1];
+            i += 2;
+            current++;
+        } else {
+            if (c < '0' || c > '9') {
+                return 9;  // invalid pulse data
+            }
+            value = 0;
+            while (*current >= '0' && *current <= '9') {
+                value = value * 10 + (*current - '0');
+                if (value > UINT16_MAX) {
+                    return 9;
+                }
+                current++;
+            }
+            if (value == 0) {
+                return 9;
+            }
+            data[i++] = value;
+
+            // new unique pair defines the next symbol
+            uint16_t pairStart = i - 2;
+            if ((i - GC_IR_TIMING_INDEX) % 2 == 0 && symbolCount < GC_IR_MAX_SYMBOLS) {
+                uint8_t s = 0;
+                while (s < symbolCount &&
+                       !(data[symbols[s]] == data[pairStart] && data[symbols[s] + 1] == data[pairStart + 1])) {
+                    s++;
+                }
+                if (s == symbolCount) {
+                    symbols[symbolCount++] = pairStart;
+                }
+            }
+        }
+        if (*current == ',') {
+            current++;
+            if (*current == 0) {
+                return 9;  // trailing separator
+            }
+        }
+    }
+
+    uint16_t timings = count - GC_IR_TIMING_INDEX;
+    if (timings % 2) {
+        return 10;  // uneven amount of on/off statements
+    }
+    // offset is the 1-based index of the on-value where a repeated code starts
+    uint16_t offset = data[GC_IR_OFFSET_INDEX];
+    if (offset % 2 == 0 || offset >= timings) {
+        return 7;  // invalid offset
+    }
+
+    return 0;
+}
+
+/// @brief Set a GlobalCache IR code from a list of numbers, e.g. a binary encoded request, without text parsing.
+///
+/// The values have the short form layout of `parseGcIrCode`: `<freq>,<repeat>,<offset>,<on1>,<off1>,...`. Module and
+/// port are set to 1, ID to 0. The same validation rules and error codes apply.
+///
+/// @param values reader with a `uint32_t size()` and `bool next(uint64_t *value)` method. `next` returns false for an
+///        invalid value.
+/// @param code the IR code. Only valid if successful.
+/// @param memError optional memory allocation error indicator. Set to 1 if memory allocation failed.
+/// @return 0 if successful, iTach error code otherwise.
+template <typename Reader>
+uint8_t setGcIrValues(Reader values, GCIrCode *code, int *memError = NULL) {
+    if (memError) {
+        *memError = 0;
+    }
+    if (code == nullptr) {
+        return 1;  // invalid command
+    }
+
+    // keep the data buffer for reuse
+    code->module = 1;
+    code->port = 1;
+    code->id = 0;
+    code->count = 0;
+
+    uint32_t count = values.size();
+    if (count <= GC_IR_TIMING_INDEX) {
+        return 8;  // invalid pulse count
+    }
+    if (count > UINT16_MAX) {
+        return 20;  // above on/off pair limit
+    }
+    if (code->capacity < count) {
+        free(code->data);
+        code->data = reinterpret_cast<uint16_t *>(malloc(count * sizeof(uint16_t)));
+        code->capacity = code->data ? count : 0;
+        if (code->data == nullptr) {
+            if (memError) {
+                *memError = 1;
+            }
+            return 1;
+        }
+    }
+    uint16_t *data = code->data;
+    code->count = count;
+
+    uint64_t value;
+    if (!values.next(&value) || value < 15000 || value > UINT16_MAX) {
+        return 5;  // invalid frequency
+    }
+    data[GC_IR_FREQ_INDEX] = value;
+    if (!values.next(&value) || value < 1 || value > 50) {
+        return 6;  // invalid repeat
+    }
+    data[GC_IR_REPEAT_INDEX] = value;
+    if (!values.next(&value) || value > UINT16_MAX) {
+        return 7;  // invalid offset
+    }
+    data[GC_IR_OFFSET_INDEX] = value;
+    for (uint32_t i = GC_IR_TIMING_INDEX; i < count; i++) {
+        if (!values.next(&value) || value == 0 || value > UINT16_MAX) {
+            return 9;  // invalid pulse data
+        }
+        data[i] = value;
+    }
+
+    uint16_t timings = count - GC_IR_TIMING_INDEX;
+    if (timings % 2) {
+        return 10;  // uneven amount of on/off statements
+    }
+    uint16_t offset = data[GC_IR_OFFSET_INDEX];
+    if (offset % 2 == 0 || offset >= timings) {
+        return 7;  // invalid offset
+    }
+
+    return 0;
+}
+
+/// @brief Append a number to a string buffer.
+/// @return false if the buffer is too small.
+inline bool appendGcNumber(char *buf, size_t size, size_t *pos, uint16_t value) {
+    char   digits[5];
+    size_t len = 0;
+    do {
+        digits[len++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    if (*pos + len >= size) {
+        return false;
+    }
+    while (len) {
+        buf[(*pos)++] = digits[--len];
+    }
+    buf[*pos] = 0;
+    return true;
+}
+
+/// @brief Create a GlobalCache `sendir` request message without allocating memory.
+/// @param port connector address.
+/// @param id command ID.
+/// @param data frequency, repeat, offset, followed by the on/off timing values. Same layout as `GCIrCode::data`.
+/// @param count number of values in `data`.
+/// @param compress use the compressed iTach format: repeated on/off pairs are replaced by letters.
+/// @param buf output buffer, zero-terminated if successful.
+/// @param size size of the output buffer.
+/// @return length of the message without zero-terminator, 0 if the data is invalid or the buffer too small.
+inline size_t encodeGcSendir(uint8_t port, uint16_t id, const uint16_t *data, uint16_t count, bool compress, char *buf,
+                             size_t size) {
+    if (data == nullptr || count <= GC_IR_TIMING_INDEX || buf == nullptr) {
+        return 0;
+    }
+    int len = snprintf(buf, size, "sendir,1:%u,%u,%u,%u,%u", port, id, data[GC_IR_FREQ_INDEX],
+                       data[GC_IR_REPEAT_INDEX], data[GC_IR_OFFSET_INDEX]);
+    if (len < 0 || static_cast<size_t>(len) >= size) {
+        return 0;
+    }
+
+    size_t          pos = len;
+    const uint16_t *timings = data + GC_IR_TIMING_INDEX;
+    uint16_t        timingCount = count - GC_IR_TIMING_INDEX;
+    uint16_t        pairs[GC_IR_MAX_SYMBOLS];  // index of each unique pair
+    uint8_t         symbolCount = 0;
+    bool            lastSymbol = false;
+    for (uint16_t i = 0; i < timingCount; i += 2) {
+        uint8_t s = symbolCount;
+        if (compress && i + 1 < timingCount) {
+            for (s = 0; s < symbolCount; s++) {
+                if (timings[pairs[s]] == timings[i] && timings[pairs[s] + 1] == timings[i + 1]) {
+                    break;
+                }
+            }
+        }
+        if (s < symbolCount) {
+            // letters are written without separator
+            if (pos + 2 >= size) {
+                return 0;
+            }
+            if (!lastSymbol) {
+                buf[pos++] = ',';
+            }
+            buf[pos++] = 'A' + s;
+            buf[pos] = 0;
+            lastSymbol = true;
+            continue;
+        }
+        if (compress && symbolCount < GC_IR_MAX_SYMBOLS) {
+            pairs[symbolCount++] = i;
+        }
+        for (uint16_t j = i; j < i + 2 && j < timingCount; j++) {
+            if (pos + 1 >= size) {
+                return 0;
+            }
+            buf[pos++] = ',';
+            if (!appendGcNumber(buf, size, &pos, timings[j])) {
+                return 0;
+            }
+        }
+        lastSymbol = false;
+    }
+
+    return pos;
+}
+
+/// @brief Create a GlobalCache `sendir` request message from a parsed IR code.
+/// @param code IR code. The module address is always 1.
+/// @param compress use the compressed iTach format: repeated on/off pairs are replaced by letters.
+/// @param buf output buffer, zero-terminated if successful.
+/// @param size size of the output buffer.
+/// @return length of the message without zero-terminator, 0 if the code is invalid or the buffer too small.
+inline size_t encodeGcIrCode(const GCIrCode &code, bool compress, char *buf, size_t size) {
+    if (!code.isValid()) {
+        return 0;
+    }
+    return encodeGcSendir(code.port, code.id, code.data, code.count, compress, buf, size);
+}
+
+/// @brief Convert a captured IR signal into GlobalCache code values without allocating memory.
+///
+/// The mark and space durations are converted into carrier cycles. A trailing gap is appended if the capture ends with
+/// a mark, since the receiver can only tell that the gap is longer than its timeout. Repeat and offset are set to 1.
+/// @param raw captured mark and space durations in `tickUs` units, starting with the first mark.
+/// @param rawCount number of values in `raw`.
+/// @param tickUs duration of a `raw` unit in microseconds.
+/// @param frequency carrier frequency in Hz.
+/// @param gapUs trailing gap in microseconds.
+/// @param data output buffer: frequency, repeat, offset, followed by the on/off timings. Same layout as `GCIrCode::data`.
+/// @param size number of values in the `data` buffer, at least `rawCount + 4`.
+/// @return number of values written to `data`, 0 if the capture is empty or the buffer too small.
+inline uint16_t convertToGcTimings(const volatile uint16_t *raw, uint16_t rawCount, uint16_t tickUs, uint16_t frequency,
+                                   uint32_t gapUs, uint16_t *data, uint16_t size) {
+    uint32_t count = GC_IR_TIMING_INDEX + rawCount + (rawCount % 2);
+    if (raw == nullptr || data == nullptr || rawCount == 0 || frequency == 0 || count > size) {
+        return 0;
+    }
+    data[GC_IR_FREQ_INDEX] = frequency;
+    data[GC_IR_REPEAT_INDEX] = 1;
+    data[GC_IR_OFFSET_INDEX] = 1;
+
+    for (uint32_t i = 0; i < count - GC_IR_TIMING_INDEX; i++) {
+        uint64_t us = i < rawCount ? static_cast<uint64_t>(raw[i]) * tickUs : gapUs;
+        // round to the nearest number of carrier cycles
+        uint64_t cycles = (us * frequency + 500000) / 1000000;
+        if (cycles == 0) {
+            cycles = 1;
+        } else if (cycles > UINT16_MAX) {
+            cycles = UINT16_MAX;
+        }
+        data[GC_IR_TIMING_INDEX + i] = cycles;
+    }
+    return count;
+}
@@ -0,0 +1,574 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// GlobalCache iTach TCP server and AMXB beacon, independent of the IR service.
+// Make sure this file also compiles natively and all functions are covered by unit tests.
+
+#pragma once
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(ESP_PLATFORM)
+#include <lwip/sockets.h>
+#else
+#include <netinet/tcp.h>
+#endif
+
+#include <atomic>
+#include <mutex>
+
+#include "gc_ir_code.hpp"
+#include "globalcache.hpp"
+#include "platform.hpp"
+#include "rate_limiter.hpp"
+#include "string_util.hpp"
+#include "tcp_event_loop.hpp"
+
+#define GC_TCP_PORT 4998
+#define GC_MAX_CLIENTS 8
+/// Minimum idle time of a client connection to be closed if a new client connects and all connections are in use
+#define GC_EVICT_IDLE_MS 5000
+#define GC_KEEPALIVE_IDLE 5
+#define GC_KEEPALIVE_INTERVAL 5
+#define GC_KEEPALIVE_COUNT 3
+
+#define GC_BEACON_PORT 9131
+#define GC_BEACON_ADDR "239.255.250.250"
+#define GC_BEACON_INTERVAL_MS 30000
+/// Maximum size of the AMXB beacon message
+#define GC_BEACON_SIZE 250
+/// AMXB beacon message: UUID, model, version, IP address, serial number
+#define GC_BEACON_FORMAT                                                                 \
+    "AMXB<-UUID=%s><-SDKClass=Utility><-Make=Unfolded Circle><-Model=%s><-Revision=%s>" \
+    "<-Config-URL=http://%s><-PCB_PN=%s><-Status=Ready>"
+/// Maximum size of a learned IR code message. Longer codes couldn't be sent back by a client.
+#define GC_LEARN_CODE_SIZE TCP_RX_BUFFER_SIZE
+
+static_assert(GC_LEARN_CODE_SIZE <= TCP_TX_BUFFER_SIZE, "a learned code must fit into an empty output buffer");
+
+typedef TcpEventLoop<GC_MAX_CLIENTS> GCEventLoop;
+
+/// @brief Device functions used by the GlobalCache server.
+///
+/// All functions are called from the server task, except `localIp` which is called from the beacon task.
+class GCSink {
+ public:
+    virtual ~GCSink() {}
+
+    /// @brief Queue an IR code for sending.
+    /// @param code parsed IR code. Taken over if the code is queued.
+    /// @param connection client connection to post the `completeir` response to with `GCServer::post`.
+    /// @return 0 if queued, 202 for an accepted repeat, iTach error code 1..99, 500 for an invalid parameter, 429 or
+    ///         503 if busy.
+    virtual uint16_t sendIr(GCIrCode *code, uint32_t connection) = 0;
+    virtual void     stopIr() = 0;
+    virtual void     startIrLearn() = 0;
+    virtual void     stopIrLearn() = 0;
+    /// @brief Start or stop the device identification, e.g. a blinking LED.
+    virtual void     identify(bool enable) = 0;
+    /// @brief Get the IPv4 address announced in the beacon.
+    /// @return false if there's no network connection.
+    virtual bool     localIp(char *buf, size_t size) { return platformLocalIp(buf, size); }
+};
+
+/// @brief Device information reported to GlobalCache clients.
+struct GCDeviceInfo {
+    /// Firmware version. GlobalCache iHelp doesn't like dots in version string, or device doesn't show up!
+    char    version[20];
+    /// MAC address without separators
+    char    mac[13];
+    char    model[16];
+    char    serial[32];
+    /// Beacon UUID, must be prefixed with `<NAME>_` and must not contain a dash, or the device doesn't show up in iHelp!
+    char    uuid[40];
+    /// Number of IR outputs
+    uint8_t irPorts;
+    bool    ethernet;
+};
+
+// the beacon fits the longest zero-terminated device information and a dotted IPv4 address of up to 15 characters
+static_assert(sizeof(GC_BEACON_FORMAT) - 10 + sizeof(GCDeviceInfo::uuid) + sizeof(GCDeviceInfo::model) +
+                      sizeof(GCDeviceInfo::version) + sizeof(GCDeviceInfo::serial) - 4 + 15 <=
+                  GC_BEACON_SIZE,
+              "GC_BEACON_SIZE too small for the beacon message");
+
+/// @brief GlobalCache iTach device emulation: TCP server on port 4998 and AMXB beacon.
+///
+/// All client connections are handled by a single event loop task. IR codes are parsed once and passed on in binary
+/// form to the `GCSink`. Completions are posted back to the client connection with `post` from any task.
+///
+/// Learned IR codes are pushed with `postLearned` to all clients which enabled the IR learner with `get_IRL`.
+class GCServer {
+ public:
+    /// @param sink device functions.
+    /// @param info device information, copied.
+    /// @param rateLimiter request rate limiter, may be shared with other servers.
+    GCServer(GCSink *sink, const GCDeviceInfo &info, ClientRateLimiter *rateLimiter)
+        : m_sink(sink),
+          m_info(info),
+          m_rateLimiter(rateLimiter),
+          m_running(false),
+          m_beaconRunning(false),
+          m_beaconAddr(inet_addr(GC_BEACON_ADDR)),
+          m_beaconPort(GC_BEACON_PORT),
+          m_beaconLocalPort(GC_BEACON_PORT),
+          m_learnerCount(0),
+          m_learnedPending(false) {
+        memset(m_learners, 0, sizeof(m_learners));
+        // reconnecting clients replace dead connections instead of waiting for the TCP keepalive timeout
+        m_loop.setEviction(true, GC_EVICT_IDLE_MS);
+        m_loop.onOpen([](TcpConnection &conn) {
+            int keepAlive = 1;
+            int keepIdle = GC_KEEPALIVE_IDLE;
+            int keepInterval = GC_KEEPALIVE_INTERVAL;
+            int keepCount = GC_KEEPALIVE_COUNT;
+            setsockopt(conn.fd, SOL_SOCKET, SO_KEEPALIVE, &keepAlive, sizeof(int));
+            setsockopt(conn.fd, IPPROTO_TCP, TCP_KEEPIDLE, &keepIdle, sizeof(int));
+            setsockopt(conn.fd, IPPROTO_TCP, TCP_KEEPINTVL, &keepInterval, sizeof(int));
+            setsockopt(conn.fd, IPPROTO_TCP, TCP_KEEPCNT, &keepCount, sizeof(int));
+            PLATFORM_LOGF(INFO, GC_TAG, "[%d] Socket accepted client: %s", conn.fd, conn.addr);
+        });
+        m_loop.onClose([this](TcpConnection &conn) {
+            if (removeLearner(conn.id) && m_learnerCount == 0) {
+                m_sink->stopIrLearn();
+            }
+            PLATFORM_LOGF(INFO, GC_TAG, "[%d] Connection closed", conn.fd);
+        });
+        m_loop.onReceive([this](TcpConnection &conn, size_t len) { return handleRequest(conn, len); });
+    }
+    ~GCServer() { stop(); }
+
+    GCServer(const GCServer &) = delete;  // no copying
+    GCServer &operator=(const GCServer &) = delete;
+
+    /// @brief Start listening and the server task.
+    /// @param port TCP port.
+    /// @param bindAddr optional IPv4 address to bind to, e.g. 127.0.0.1 for testing. Default: any.
+    /// @param core CPU core of the server task.
+    /// @param priority priority of the server task.
+    /// @return errno value of the failed operation, 0 if successful.
+    int start(uint16_t port = GC_TCP_PORT, const char *bindAddr = nullptr, int core = 0, uint8_t priority = 3) {
+        if (m_running) {
+            return 0;
+        }
+        int err = m_loop.listen(port, bindAddr, GC_MAX_CLIENTS);
+        if (err != 0) {
+            PLATFORM_LOGF(ERROR, GC_TAG, "Error starting server: errno %d", err);
+            return err;
+        }
+        PLATFORM_LOGF(INFO, GC_TAG, "Socket bound, port %d", port);
+        m_running = true;
+        // request processing runs in this task
+        if (!platformCreateTask(serverTask, "GC server", 6000, this, priority, core)) {
+            m_running = false;
+            m_loop.stop();
+            return -1;
+        }
+        return 0;
+    }
+
+    /// @brief Set the destination of the AMXB beacon. Must be called before `startBeacon`, e.g. for testing.
+    /// @param addr IPv4 destination address.
+    /// @param port UDP destination port.
+    /// @param localPort UDP source port, 0 for any.
+    void setBeaconTarget(const char *addr, uint16_t port, uint16_t localPort) {
+        m_beaconAddr = inet_addr(addr);
+        m_beaconPort = port;
+        m_beaconLocalPort = localPort;
+    }
+
+    /// @brief Start the AMXB beacon task, announcing the device every 30 seconds and after a network change.
+    bool startBeacon(int core = 0, uint8_t priority = 2) {
+        if (m_beaconRunning) {
+            return true;
+        }
+        m_beaconRunning = true;
+        if (!platformCreateTask(beaconTask, "GC beacon", 4000, this, priority, core)) {
+            m_beaconRunning = false;
+            return false;
+        }
+        return true;
+    }
+
+    /// @brief Stop the server and beacon task, and close all client connections. Blocks until the tasks ended.
+    void stop() {
+        if (m_running) {
+            m_running = false;
+            // wake up the event loop
+            m_loop.post(0, "");
+            m_serverStopped.take(5000);
+        }
+        if (m_beaconRunning) {
+            m_beaconRunning = false;
+            m_beaconWake.give();
+            m_beaconStopped.take(5000);
+        }
+    }
+
+    /// @brief Send a response message to a client from any task, e.g. the `completeir` message. Never blocks.
+    /// @return false if the message was dropped.
+    bool post(uint32_t connection, const char *response) {
+        if (!m_loop.post(connection, response)) {
+            PLATFORM_LOGF(WARN, GC_TAG, "Dropped response for connection %u: %s", connection, response);
+            return false;
+        }
+        return true;
+    }
+
+    /// @brief Announce the device immediately, e.g. after a link-up or a new IP address. Can be called from any task.
+    ///
+    /// The beacon message is only created again if the IP address changed.
+    void networkChanged() { m_beaconWake.give(); }
+
+    /// @brief Send a learned IR code to all clients with an enabled IR learner from any task. Never blocks.
+    ///
+    /// The code is copied and sent by the server task. A code not yet sent is replaced by a newer one.
+    /// @param code `sendir` message without terminator.
+    /// @return false if there's no client with an enabled IR learner, or the code is too long.
+    bool postLearned(const char *code) {
+        size_t len = strlen(code);
+        if (m_learnerCount == 0 || len + 2 > GC_LEARN_CODE_SIZE) {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_learnMutex);
+            memcpy(m_learnedCode, code, len);
+            m_learnedCode[len] = '\r';
+            m_learnedCode[len + 1] = 0;
+            m_learnedPending = true;
+        }
+        // wake up the event loop
+        m_loop.post(0, "");
+        return true;
+    }
+
+    /// @brief Check if a client enabled the IR learner. Can be called from any task, e.g. to skip converting a code.
+    bool hasLearners() const { return m_learnerCount > 0; }
+
+    /// @brief Get the client connection churn counters. Can be called from any task.
+    TcpLoopStats connectionStats() const { return m_loop.stats(); }
+
+    /// @brief Create the AMXB beacon message.
+    /// @param buf output buffer.
+    /// @param size size of the output buffer, at least `GC_BEACON_SIZE`.
+    /// @param ip IPv4 address of the device for the configuration URL.
+    /// @return message length, 0 if the buffer is too small.
+    size_t formatBeacon(char *buf, size_t size, const char *ip) const {
+        // the buffer always fits the longest device information and IP address
+        if (size < GC_BEACON_SIZE) {
+            return 0;
+        }
+        int len = snprintf(buf, size, GC_BEACON_FORMAT, m_info.uuid, m_info.model, m_info.version, ip, m_info.serial);
+        return (len < 0 || static_cast<size_t>(len) >= size) ? 0 : len;
+    }
+
+ private:
+    static constexpr const char *GC_TAG = "GC";
+
+    /// @brief Event loop task handling all client connections.
+    static void serverTask(void *param) {
+        GCServer *gc = reinterpret_cast<GCServer *>(param);
+        while (gc->m_running) {
+            if (gc->m_loop.runOnce(-1) < 0) {
+                PLATFORM_LOGF(ERROR, GC_TAG, "Error occurred during select: errno %d", errno);
+                platformDelayMs(1000);
+            }
+            gc->deliverLearned();
+        }
+        gc->m_loop.stop();
+        gc->m_serverStopped.give();
+        platformExitTask();
+    }
+
+    /// @brief AMXB beacon advertisement.
+    static void beaconTask(void *param) {
+        GCServer *gc = reinterpret_cast<GCServer *>(param);
+
+        // Simple UDP broadcast functionality with BSD socket
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0) {
+            PLATFORM_LOGF(ERROR, "GCB", "socket call failed: %d", fd);
+        } else {
+            struct sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_ANY);
+            addr.sin_port = htons(gc->m_beaconLocalPort);
+            if (bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1) {
+                PLATFORM_LOGF(ERROR, "GCB", "Bind to port number %d failed: errno %d", gc->m_beaconLocalPort, errno);
+            } else {
+                gc->runBeacon(fd);
+            }
+            ::close(fd);
+        }
+
+        gc->m_beaconStopped.give();
+        platformExitTask();
+    }
+
+    /// @brief Announce the device until the beacon is stopped.
+    ///
+    /// The beacon message is created once per IP address and sent every interval, or immediately after a network
+    /// change. Without network connection the task sleeps until the next network change or interval.
+    void runBeacon(int fd) {
+        struct sockaddr_in dest;
+        memset(&dest, 0, sizeof(dest));
+        dest.sin_family = AF_INET;
+        dest.sin_addr.s_addr = m_beaconAddr;
+        dest.sin_port = htons(m_beaconPort);
+
+        char   beacon[GC_BEACON_SIZE];
+        size_t beaconLen = 0;
+        char   beaconIp[16] = "";
+        while (m_beaconRunning) {
+            char ip[16];
+            if (!m_sink->localIp(ip, sizeof(ip))) {
+                beaconIp[0] = 0;
+                beaconLen = 0;
+            } else if (strcmp(ip, beaconIp) != 0) {
+                snprintf(beaconIp, sizeof(beaconIp), "%s", ip);
+                beaconLen = formatBeacon(beacon, sizeof(beacon), beaconIp);
+                PLATFORM_LOGF(DEBUG, "GCB", "Beacon for IP address %s", beaconIp);
+            }
+            if (beaconLen) {
+                sendto(fd, beacon, beaconLen, 0, reinterpret_cast<struct sockaddr *>(&dest), sizeof(dest));
+            }
+            m_beaconWake.take(GC_BEACON_INTERVAL_MS);
+        }
+    }
+
+    /// @brief Process a client request message.
+    /// @param conn client connection, `conn.rx` contains a single request message.
+    /// @param len message length.
+    /// @return false if the connection should be closed.
+    bool handleRequest(TcpConnection &conn, size_t len) {
+        // reject flooding clients before any parsing or logging
+        if (m_rateLimiter && !m_rateLimiter->allow(&conn.rateLimit, conn.ip, platformMicros())) {
+            return reply(conn, "busyir\r");
+        }
+
+        char *rx_buffer = conn.rx;
+        PLATFORM_LOGF(DEBUG, GC_TAG, "[%d] Received %d bytes: %s", conn.fd, static_cast<int>(len), rx_buffer);
+
+        // find message terminator
+        char *end = strchr(rx_buffer, '\r');
+        if (end == NULL) {
+            // error: code too long, the event loop only hands over messages without carriage return if the buffer is
+            // full
+            const char *msg = (strncmp(rx_buffer, "sendir,", 7) == 0) ? "ERR 020\r" : "ERR 016\r";
+            return reply(conn, msg);
+        }
+        *end = 0;
+
+        // find start of message, skip all non graphical representation characters, e.g. a line feed after the
+        // carriage return of the previous message: https://en.cppreference.com/w/c/string/byte/isgraph
+        char *request = rx_buffer;
+        while (request != end && !isgraph(*request)) {
+            request++;
+        }
+        if (request == end) {
+            // ignore, no error (as iTach device)
+            return true;
+        }
+
+        // IR codes are parsed only once and passed on in binary form
+        if (strncmp(request, "sendir,", 7) == 0) {
+            return handleSendIr(conn, request);
+        }
+
+        GCMsg req;
+        auto  result = parseGcRequest(request, &req);
+        if (result) {
+            char buf[24];
+            // global cache iTach error code
+            snprintf(buf, sizeof(buf), "ERR_1:1,%03d\r", result);
+            return reply(conn, buf);
+        }
+
+        if (strcmp(req.command, "stopir") == 0) {
+            m_sink->stopIr();
+            // echo request including the terminator
+            *end = '\r';
+            return reply(conn, request);
+        } else if (strcmp(req.command, "getdevices") == 0) {
+            if (m_info.ethernet && !reply(conn, "device,0,0 ETHERNET\r")) {
+                return false;
+            }
+            char msg[64];
+            snprintf(msg, sizeof(msg), "device,0,0 WIFI\rdevice,1,%d IR\rendlistdevices\r", m_info.irPorts);
+            return reply(conn, msg);
+        } else if (strcmp(req.command, "getversion") == 0) {
+            char version[24];
+            snprintf(version, sizeof(version), "%s\r", m_info.version);
+            return reply(conn, version);
+        } else if (strcmp(req.command, "getmac") == 0) {
+            // command discovered with iHelp
+            char mac[30];
+            snprintf(mac, sizeof(mac), "MACaddress,%s\r", m_info.mac);
+            return reply(conn, mac);
+        } else if (strcmp(req.command, "blink") == 0) {
+            if (req.param) {
+                if (strcmp(req.param, "1") == 0) {
+                    m_sink->identify(true);
+                } else if (strcmp(req.param, "0") == 0) {
+                    m_sink->identify(false);
+                }
+            } else {
+                m_sink->identify(true);
+            }
+        } else if (strcmp(req.command, "get_IRL") == 0) {
+            addLearner(conn.id);
+            m_sink->startIrLearn();
+            return reply(conn, "IR Learner Enabled\r");
+        } else if (strcmp(req.command, "stop_IRL") == 0) {
+            // keep learning for the other clients
+            if (removeLearner(conn.id) && m_learnerCount == 0) {
+                m_sink->stopIrLearn();
+            }
+            return reply(conn, "IR Learner Disabled\r");
+        } else {
+            // Command unrecognized
+            char buf[24];
+            snprintf(buf, sizeof(buf), "ERR_%d:%d,001\r", req.module, req.port);
+            return reply(conn, buf);
+        }
+
+        return true;
+    }
+
+    /// @brief Process a sendir request.
+    /// @param conn client connection.
+    /// @param request request message without terminator.
+    /// @return false if the connection should be closed.
+    bool handleSendIr(TcpConnection &conn, const char *request) {
+        GCIrCode code;
+        uint16_t result = parseGcIrCode(request, &code);
+        if (result == 0) {
+            result = m_sink->sendIr(&code, conn.id);
+            PLATFORM_LOGF(DEBUG, GC_TAG, "[%d] sendIr result: %d", conn.fd, result);
+        }
+
+        // module and port are only set if they could be parsed
+        uint8_t     module = code.module ? code.module : 1;
+        uint8_t     port = code.port ? code.port : 1;
+        char        buf[24];
+        const char *msg = nullptr;
+        if (result == 0 || result == 200) {
+            // OK, async completion posted to the connection (code 200 shouldn't be used anymore)
+        } else if (result == 202) {
+            // accepted IR repeat. Original iTach device doesn't send a reply, so we do the same!
+        } else if (result > 0 && result < 100) {
+            // global cache iTach error code
+            snprintf(buf, sizeof(buf), "ERR_%d:%d,%03d\r", module, port, result);
+            msg = buf;
+        } else if (result == 500) {
+            // invalid parameter
+            snprintf(buf, sizeof(buf), "ERR_%d:%d,023\r", module, port);
+            msg = buf;
+        } else if (result == 429 || result == 503) {
+            msg = "busyir\r";
+        } else {
+            // invalid command (unknown)
+            snprintf(buf, sizeof(buf), "ERR_%d:%d,001\r", module, port);
+            msg = buf;
+        }
+
+        if (msg) {
+            return reply(conn, msg);
+        }
+        return true;
+    }
+
+    /// @brief Enable sending learned IR codes to a client.
+    void addLearner(uint32_t connectionId) {
+        uint32_t *free = nullptr;
+        for (size_t i = 0; i < GC_MAX_CLIENTS; i++) {
+            if (m_learners[i] == connectionId) {
+                return;
+            }
+            if (m_learners[i] == 0 && free == nullptr) {
+                free = &m_learners[i];
+            }
+        }
+        // there's a slot for every connection
+        if (free) {
+            *free = connectionId;
+            m_learnerCount++;
+        }
+    }
+
+    /// @brief Disable sending learned IR codes to a client.
+    /// @return false if the client didn't enable the IR learner.
+    bool removeLearner(uint32_t connectionId) {
+        for (size_t i = 0; i < GC_MAX_CLIENTS; i++) {
+            if (m_learners[i] == connectionId && connectionId != 0) {
+                m_learners[i] = 0;
+                m_learnerCount--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// @brief Send a pending learned IR code to all clients with an enabled IR learner.
+    void deliverLearned() {
+        std::lock_guard<std::mutex> lock(m_learnMutex);
+        if (!m_learnedPending) {
+            return;
+        }
+        m_learnedPending = false;
+        size_t len = strlen(m_learnedCode);
+        for (size_t i = 0; i < GC_MAX_CLIENTS; i++) {
+            TcpConnection *conn = m_learners[i] ? m_loop.connection(m_learners[i]) : nullptr;
+            if (conn == nullptr) {
+                continue;
+            }
+            if (len > conn->outgoing.available()) {
+                // the client doesn't keep up: a learned code is optional, unlike pending replies
+                PLATFORM_LOGF(WARN, GC_TAG, "[%d] Output pending, dropping learned code", conn->fd);
+                continue;
+            }
+            if (!m_loop.send(*conn, m_learnedCode, len)) {
+                PLATFORM_LOGF(WARN, GC_TAG, "[%d] Error sending learned code, closing connection", conn->fd);
+                m_loop.close(*conn);
+            }
+        }
+    }
+
+    /// @brief Send a reply to a client without blocking.
+    /// @param conn client connection.
+    /// @param msg zero-terminated message.
+    /// @return false if the client doesn't read its data and the connection should be closed.
+    bool reply(TcpConnection &conn, const char *msg) {
+        if (!m_loop.send(conn, msg, strlen(msg))) {
+            PLATFORM_LOGF(WARN, GC_TAG, "[%d] Error sending reply, closing connection", conn.fd);
+            return false;
+        }
+        return true;
+    }
+
+    GCSink              *m_sink;
+    GCDeviceInfo         m_info;
+    ClientRateLimiter   *m_rateLimiter;
+    GCEventLoop          m_loop;
+    std::atomic<bool>    m_running;
+    std::atomic<bool>    m_beaconRunning;
+    PlatformSemaphore    m_serverStopped;
+    PlatformSemaphore    m_beaconStopped;
+    /// Interrupts the beacon interval for stopping or a network change
+    PlatformSemaphore    m_beaconWake;
+    /// Beacon destination address in network byte order
+    uint32_t             m_beaconAddr;
+    uint16_t             m_beaconPort;
+    uint16_t             m_beaconLocalPort;
+    /// Connection identifiers of the clients with an enabled IR learner, 0 if unused. Only used in the server task.
+    uint32_t             m_learners[GC_MAX_CLIENTS];
+    std::atomic<uint8_t> m_learnerCount;
+    /// Learned IR code message with terminator, protected by `m_learnMutex`
+    std::mutex           m_learnMutex;
+    char                 m_learnedCode[GC_LEARN_CODE_SIZE];
+    bool                 m_learnedPending;
+};
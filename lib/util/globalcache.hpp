@@ -7,8 +7,8 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdlib.h>
 
-#include <algorithm>
 #include <cstring>
 
 #include "util_types.h"
@@ -27,7 +27,7 @@
 /// - stopir,<module>:<port>
 /// - get_IRL
 /// - stop_IRL
-uint8_t parseGcRequest(const char *request, GCMsg *msg) {
+inline uint8_t parseGcRequest(const char *request, GCMsg *msg) {
     if (request == nullptr || msg == nullptr) {
         return false;
     }
@@ -41,20 +41,20 @@ uint8_t parseGcRequest(const char *request, GCMsg *msg) {
         if (cmdLen >= len) {
             return 1;  // command name too long: unknown command
         }
-        auto count = std::min(len, cmdLen);
-        strncpy(msg->command, request, count);
-        msg->command[count] = 0;
+        memcpy(msg->command, request, cmdLen);
+        msg->command[cmdLen] = 0;
         msg->module = 0;
         msg->port = 0;
         msg->param = nullptr;
         return 0;
     }
 
-    if ((next - request) >= len) {
+    size_t cmdLen = next - request;
+    if (cmdLen >= len) {
         return 1;  // command name too long: unknown command
     }
-    strncpy(msg->command, request, next - request);
-    msg->command[next - request] = 0;
+    memcpy(msg->command, request, cmdLen);
+    msg->command[cmdLen] = 0;
 
     // check for:  <module>:<port>,<param(s)>
     const char *current = next + 1;
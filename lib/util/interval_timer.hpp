@@ -0,0 +1,73 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Periodic and one-shot timers for services running in a loop, based on a millisecond clock like `millis()`.
+// Make sure this file also compiles natively and all functions are covered by unit tests.
+
+#pragma once
+
+#include <stdint.h>
+
+/// @brief Interval timer handling the 32 bit millisecond clock overflow.
+///
+/// A missed interval isn't caught up: the next interval starts when the expiry is detected.
+class IntervalTimer {
+ public:
+    explicit IntervalTimer(uint32_t intervalMs) : m_interval(intervalMs) {}
+
+    uint32_t interval() const { return m_interval; }
+
+    /// @brief Check if the interval elapsed and restart it if so. Always expires on the first call.
+    bool expired(uint32_t nowMs) {
+        if (m_started && nowMs - m_start < m_interval) {
+            return false;
+        }
+        m_start = nowMs;
+        m_started = true;
+        return true;
+    }
+
+    /// @brief Time until the timer expires, 0 if it's already expired.
+    uint32_t remaining(uint32_t nowMs) const {
+        if (!m_started) {
+            return 0;
+        }
+        uint32_t elapsed = nowMs - m_start;
+        return elapsed < m_interval ? m_interval - elapsed : 0;
+    }
+
+ private:
+    uint32_t m_interval;
+    uint32_t m_start = 0;
+    bool     m_started = false;
+};
+
+/// @brief One-shot timer handling the 32 bit millisecond clock overflow, e.g. to end an action without blocking.
+class OneShotTimer {
+ public:
+    explicit OneShotTimer(uint32_t durationMs) : m_duration(durationMs) {}
+
+    /// @brief Start the timer, or restart it if it's already running.
+    void start(uint32_t nowMs) {
+        m_start = nowMs;
+        m_running = true;
+    }
+
+    void stop() { m_running = false; }
+
+    bool running() const { return m_running; }
+
+    /// @brief Check if the running timer elapsed, and stop it if so. Only returns true once per start.
+    bool expired(uint32_t nowMs) {
+        if (!m_running || nowMs - m_start < m_duration) {
+            return false;
+        }
+        m_running = false;
+        return true;
+    }
+
+ private:
+    uint32_t m_duration;
+    uint32_t m_start = 0;
+    bool     m_running = false;
+};
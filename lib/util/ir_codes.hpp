@@ -6,25 +6,12 @@
 
 #pragma once
 
-#include <Arduino.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
-enum class IRFormat {
-    UNKNOWN = 0,
-    UNFOLDED_CIRCLE = 1,
-    PRONTO = 2,
-    GLOBAL_CACHE = 3,
-};
-
-struct IRSendMessage {
-    int16_t  clientId;
-    uint32_t msgId;
-    IRFormat format;
-    String   message;
-    uint16_t repeat;
-    uint32_t pin_mask;
-    // TCP socket of message if received from the GlobalCache server, 0 otherwise.
-    int gcSocket;
-};
+#include "ir_message.hpp"
 
 struct IRHexData {
     decode_type_t protocol;
@@ -33,7 +20,7 @@ struct IRHexData {
     uint16_t      repeat;
 };
 
-u_long parseULong(const char *number, int *error = NULL, int base = 10) {
+unsigned long parseULong(const char *number, int *error = NULL, int base = 10) {
     if (number == NULL) {
         if (error != NULL) {
             *error = 1;
@@ -41,7 +28,7 @@ u_long parseULong(const char *number, int *error = NULL, int base = 10) {
         return 0;
     }
     char  *end;
-    u_long value = strtoul(number, &end, base);
+    unsigned long value = strtoul(number, &end, base);
     if (end == number || *end != '\0' || errno == ERANGE) {
         if (error != NULL) {
             *error = 1;
@@ -53,28 +40,45 @@ u_long parseULong(const char *number, int *error = NULL, int base = 10) {
     return value;
 }
 
-bool buildIRHexData(const String &message, IRHexData *data) {
+// Copy the text between `start` and `end` as zero-terminated string into `buf`.
+bool copyIRCodeField(const char *start, const char *end, char *buf, size_t size) {
+    size_t len = end - start;
+    if (len >= size) {
+        return false;
+    }
+    memcpy(buf, start, len);
+    buf[len] = 0;
+    return true;
+}
+
+bool buildIRHexData(const char *message, IRHexData *data) {
     // Format is: "<protocol>;<hex-ir-code>;<bits>;<repeat-count>" e.g. "4;0x640C;15;0"
-    const int firstIndex = message.indexOf(';');
-    const int secondIndex = message.indexOf(';', firstIndex + 1);
-    const int thirdIndex = message.indexOf(';', secondIndex + 1);
+    if (message == NULL) {
+        return false;
+    }
+    const char *first = strchr(message, ';');
+    const char *second = first ? strchr(first + 1, ';') : NULL;
+    const char *third = second ? strchr(second + 1, ';') : NULL;
 
-    if (firstIndex == -1 || secondIndex == -1 || thirdIndex == -1) {
+    if (third == NULL) {
         return false;
     }
 
-    data->protocol = static_cast<decode_type_t>(message.substring(0, firstIndex).toInt());
+    data->protocol = static_cast<decode_type_t>(atol(message));
     if (data->protocol == 0) {
         return false;
     }
 
-    String commandStr = message.substring(firstIndex + 1, secondIndex).c_str();
+    // fields are copied to the stack, the message isn't modified
+    char field[24];
+    if (!copyIRCodeField(first + 1, second, field, sizeof(field))) {
+        return false;
+    }
 
-    const char *str = commandStr.c_str();
-    char       *end;
+    char *end;
     errno = 0;
-    uint64_t command = strtoull(str, &end, 16);
-    if (command == 0 && end == str) {
+    uint64_t command = strtoull(field, &end, 16);
+    if (command == 0 && end == field) {
         // str was not a number
         return false;
     } else if (command == UINT64_MAX && errno) {
@@ -86,9 +90,11 @@ bool buildIRHexData(const String &message, IRHexData *data) {
     }
     data->command = command;
 
-    int    error;
-    String number = message.substring(secondIndex + 1, thirdIndex);
-    u_long value = parseULong(number.c_str(), &error, 10);
+    int error;
+    if (!copyIRCodeField(second + 1, third, field, sizeof(field))) {
+        return false;
+    }
+    unsigned long value = parseULong(field, &error, 10);
     if (error || value > 0xFFFF) {
         return false;
     }
@@ -97,8 +103,7 @@ bool buildIRHexData(const String &message, IRHexData *data) {
         return false;
     }
 
-    number = message.substring(thirdIndex + 1);
-    value = parseULong(number.c_str(), &error, 10);
+    value = parseULong(third + 1, &error, 10);
     if (error || value > 0xFFFF || value > 20) {
         return false;
     }
@@ -0,0 +1,406 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Multi-dock IR group send protocol over local UDP multicast.
+// Make sure this file also compiles natively and all functions are covered by unit tests.
+//
+// A dock receiving an `ir_send_group` API request sends one datagram to the multicast group. All docks configured with
+// the same group key send the contained IR code at the shared target time. Datagram layout, all values big endian:
+//
+// | Offset | Size | Field                                                                  |
+// |--------|------|------------------------------------------------------------------------|
+// | 0      | 3    | Magic: `UCG`                                                           |
+// | 3      | 1    | Protocol version: 1                                                    |
+// | 4      | 4    | Group identifier, derived from the group key                           |
+// | 8      | 6    | Sender identifier: MAC address of the dock, same as in the AMXB beacon |
+// | 14     | 2    | Sequence number                                                        |
+// | 16     | 8    | Target send time in microseconds since the Unix epoch (UTC)            |
+// | 24     | 2    | IR repeat count                                                        |
+// | 26     | 1    | Output mask, see `IrGroupOutput`                                       |
+// | 27     | 1    | IR code format, see `IRFormat`                                         |
+// | 28     | 2    | Code length n                                                          |
+// | 30     | n    | IR code                                                                |
+// | 30 + n | 8    | SipHash-2-4 MAC over all previous bytes, keyed with the group key      |
+
+#pragma once
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "siphash.hpp"
+
+#define IR_GROUP_PORT 9132
+#define IR_GROUP_ADDR "239.255.250.251"
+
+const uint8_t  kIrGroupVersion = 1;
+const size_t   kIrGroupHeaderLen = 30;
+const size_t   kIrGroupMacLen = 8;
+const size_t   kIrGroupMaxCodeLen = 1400;
+const size_t   kIrGroupMaxPacketLen = kIrGroupHeaderLen + kIrGroupMaxCodeLen + kIrGroupMacLen;
+const size_t   kIrGroupSenderLen = 6;
+const uint64_t kIrGroupKeyContext = 0x5543442d47524f55ULL;  // "UCD-GROU"
+
+/// Output bit mask of an IR group message. Same bit order as the GlobalCache port address.
+enum IrGroupOutput {
+    IR_GROUP_INT_SIDE = 1,
+    IR_GROUP_EXT_1 = 2,
+    IR_GROUP_EXT_2 = 4,
+    IR_GROUP_INT_TOP = 8,
+};
+
+enum class IrGroupResult {
+    OK = 0,
+    TOO_SHORT,
+    BAD_MAGIC,
+    BAD_VERSION,
+    WRONG_GROUP,
+    BAD_LENGTH,
+    BAD_MAC,
+    /// encoding only: code too long or output buffer too small
+    TOO_LONG,
+};
+
+/// Keys derived from the shared group secret.
+struct IrGroupKey {
+    uint32_t   groupId;
+    SipHashKey mac;
+};
+
+/// IR group message
+struct IrGroupMessage {
+    uint8_t  sender[kIrGroupSenderLen];
+    uint16_t seq;
+    int64_t  sendAt;
+    uint16_t repeat;
+    uint8_t  outputs;
+    uint8_t  format;
+    /// IR code. Not zero-terminated! Points into the datagram buffer after decoding.
+    const char *code;
+    uint16_t    codeLen;
+};
+
+/// @brief Derive the group identifier and MAC key from a shared group secret.
+inline IrGroupKey irGroupKey(const char *secret) {
+    IrGroupKey key;
+    key.mac = sipDeriveKey(secret, kIrGroupKeyContext);
+    // the group id is public: derive it from the MAC key, so it doesn't reveal anything about the secret
+    uint8_t zero = 0;
+    key.groupId = static_cast<uint32_t>(sipHash24(key.mac, &zero, 1));
+    return key;
+}
+
+inline void irGroupPut16(uint8_t *p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v & 0xFF;
+}
+
+inline void irGroupPut32(uint8_t *p, uint32_t v) {
+    irGroupPut16(p, v >> 16);
+    irGroupPut16(p + 2, v & 0xFFFF);
+}
+
+inline void irGroupPut64(uint8_t *p, uint64_t v) {
+    irGroupPut32(p, v >> 32);
+    irGroupPut32(p + 4, v & 0xFFFFFFFF);
+}
+
+inline uint16_t irGroupGet16(const uint8_t *p) {
+    return (static_cast<uint16_t>(p[0]) << 8) | p[1];
+}
+
+inline uint32_t irGroupGet32(const uint8_t *p) {
+    return (static_cast<uint32_t>(irGroupGet16(p)) << 16) | irGroupGet16(p + 2);
+}
+
+inline uint64_t irGroupGet64(const uint8_t *p) {
+    return (static_cast<uint64_t>(irGroupGet32(p)) << 32) | irGroupGet32(p + 4);
+}
+
+/// @brief Encode an IR group message into a datagram.
+/// @param key group key.
+/// @param msg message to encode.
+/// @param buf output buffer.
+/// @param size size of output buffer.
+/// @return length of the datagram, 0 if the code is too long or the output buffer too small.
+inline size_t irGroupEncode(const IrGroupKey &key, const IrGroupMessage &msg, uint8_t *buf, size_t size) {
+    size_t len = kIrGroupHeaderLen + msg.codeLen + kIrGroupMacLen;
+    if (msg.codeLen > kIrGroupMaxCodeLen || len > size || (msg.codeLen && msg.code == nullptr)) {
+        return 0;
+    }
+
+    buf[0] = 'U';
+    buf[1] = 'C';
+    buf[2] = 'G';
+    buf[3] = kIrGroupVersion;
+    irGroupPut32(buf + 4, key.groupId);
+    memcpy(buf + 8, msg.sender, kIrGroupSenderLen);
+    irGroupPut16(buf + 14, msg.seq);
+    irGroupPut64(buf + 16, static_cast<uint64_t>(msg.sendAt));
+    irGroupPut16(buf + 24, msg.repeat);
+    buf[26] = msg.outputs;
+    buf[27] = msg.format;
+    irGroupPut16(buf + 28, msg.codeLen);
+    memcpy(buf + kIrGroupHeaderLen, msg.code, msg.codeLen);
+
+    size_t macOffset = kIrGroupHeaderLen + msg.codeLen;
+    irGroupPut64(buf + macOffset, sipHash24(key.mac, buf, macOffset));
+
+    return len;
+}
+
+/// @brief Decode and authenticate an IR group datagram.
+/// @param key group key.
+/// @param buf received datagram.
+/// @param len length of the datagram.
+/// @param msg output message. The code field points into `buf`.
+inline IrGroupResult irGroupDecode(const IrGroupKey &key, const uint8_t *buf, size_t len, IrGroupMessage *msg) {
+    if (buf == nullptr || len < kIrGroupHeaderLen + kIrGroupMacLen) {
+        return IrGroupResult::TOO_SHORT;
+    }
+    if (buf[0] != 'U' || buf[1] != 'C' || buf[2] != 'G') {
+        return IrGroupResult::BAD_MAGIC;
+    }
+    if (buf[3] != kIrGroupVersion) {
+        return IrGroupResult::BAD_VERSION;
+    }
+    // cheap check first: other groups on the same multicast address are common
+    if (irGroupGet32(buf + 4) != key.groupId) {
+        return IrGroupResult::WRONG_GROUP;
+    }
+    uint16_t codeLen = irGroupGet16(buf + 28);
+    if (codeLen > kIrGroupMaxCodeLen || kIrGroupHeaderLen + codeLen + kIrGroupMacLen != len) {
+        return IrGroupResult::BAD_LENGTH;
+    }
+    size_t   macOffset = kIrGroupHeaderLen + codeLen;
+    uint64_t mac = irGroupGet64(buf + macOffset);
+    if (mac != sipHash24(key.mac, buf, macOffset)) {
+        return IrGroupResult::BAD_MAC;
+    }
+
+    memcpy(msg->sender, buf + 8, kIrGroupSenderLen);
+    msg->seq = irGroupGet16(buf + 14);
+    msg->sendAt = static_cast<int64_t>(irGroupGet64(buf + 16));
+    msg->repeat = irGroupGet16(buf + 24);
+    msg->outputs = buf[26];
+    msg->format = buf[27];
+    msg->codeLen = codeLen;
+    msg->code = reinterpret_cast<const char *>(buf + kIrGroupHeaderLen);
+
+    return IrGroupResult::OK;
+}
+
+/// @brief Duplicate filter for IR group messages.
+/// Senders transmit every message more than once to compensate for lost datagrams. The last few sequence numbers of
+/// each sender are remembered, which also works if a sender restarts its sequence after a reboot.
+/// Replayed old messages are rejected by the receiver with the target time check.
+template <size_t SENDERS = 16, size_t HISTORY = 8>
+class IrGroupSeqFilter {
+ public:
+    IrGroupSeqFilter() { memset(m_entries, 0, sizeof(m_entries)); }
+
+    /// @brief Check if a message hasn't been seen before and remember it.
+    /// @return true if the message is new, false if it is a duplicate.
+    bool accept(const uint8_t *sender, uint16_t seq) {
+        m_clock++;
+        Entry *entry = nullptr;
+        Entry *oldest = &m_entries[0];
+        for (size_t i = 0; i < SENDERS; i++) {
+            if (m_entries[i].used && memcmp(m_entries[i].sender, sender, kIrGroupSenderLen) == 0) {
+                entry = &m_entries[i];
+                break;
+            }
+            if (!m_entries[i].used || (oldest->used && m_entries[i].lastUsed < oldest->lastUsed)) {
+                oldest = &m_entries[i];
+            }
+        }
+
+        if (entry == nullptr) {
+            entry = oldest;
+            memset(entry, 0, sizeof(Entry));
+            entry->used = true;
+            memcpy(entry->sender, sender, kIrGroupSenderLen);
+        } else {
+            for (size_t i = 0; i < entry->count; i++) {
+                if (entry->seq[i] == seq) {
+                    entry->lastUsed = m_clock;
+                    return false;
+                }
+            }
+        }
+
+        entry->seq[entry->next] = seq;
+        entry->next = (entry->next + 1) % HISTORY;
+        if (entry->count < HISTORY) {
+            entry->count++;
+        }
+        entry->lastUsed = m_clock;
+        return true;
+    }
+
+ private:
+    struct Entry {
+        bool     used;
+        uint8_t  sender[kIrGroupSenderLen];
+        uint16_t seq[HISTORY];
+        size_t   next;
+        size_t   count;
+        uint32_t lastUsed;
+    };
+
+    Entry    m_entries[SENDERS];
+    uint32_t m_clock = 0;
+};
+
+/// @brief UDP multicast socket for IR group messages. Works with lwIP and POSIX sockets.
+class IrGroupSocket {
+ public:
+    IrGroupSocket() = default;
+    ~IrGroupSocket() { close(); }
+
+    IrGroupSocket(const IrGroupSocket &) = delete;  // no copying
+    IrGroupSocket &operator=(const IrGroupSocket &) = delete;
+
+    /// @brief Open the socket and join the multicast group.
+    /// @param port UDP port.
+    /// @param groupAddr multicast group address.
+    /// @param ifaceAddr optional IPv4 address of the network interface, e.g. 127.0.0.1 for testing. Default: any.
+    /// @return errno value of the failed operation, 0 if successful.
+    int open(uint16_t port, const char *groupAddr, const char *ifaceAddr = nullptr) {
+        close();
+
+        m_fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (m_fd < 0) {
+            return errno;
+        }
+
+        int opt = 1;
+        setsockopt(m_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+#ifdef SO_REUSEPORT
+        // multiple host instances on the same machine. Not supported by lwIP, ignore errors.
+        setsockopt(m_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+#endif
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port);
+        if (bind(m_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+            return closeWithError();
+        }
+
+        struct in_addr iface;
+        iface.s_addr = ifaceAddr ? inet_addr(ifaceAddr) : htonl(INADDR_ANY);
+
+        struct ip_mreq mreq;
+        memset(&mreq, 0, sizeof(mreq));
+        mreq.imr_multiaddr.s_addr = inet_addr(groupAddr);
+        mreq.imr_interface = iface;
+        if (setsockopt(m_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+            return closeWithError();
+        }
+
+        // local network only
+        uint8_t ttl = 1;
+        setsockopt(m_fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+        // required for multiple instances on the same host. A dock ignores its own messages with the sender id.
+        uint8_t loop = 1;
+        setsockopt(m_fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+        if (ifaceAddr) {
+            setsockopt(m_fd, IPPROTO_IP, IP_MULTICAST_IF, &iface, sizeof(iface));
+        }
+
+        memset(&m_group, 0, sizeof(m_group));
+        m_group.sin_family = AF_INET;
+        m_group.sin_addr.s_addr = mreq.imr_multiaddr.s_addr;
+        m_group.sin_port = htons(port);
+
+        return 0;
+    }
+
+    /// @brief Send a datagram to the multicast group.
+    /// @return true if successful.
+    bool send(const uint8_t *buf, size_t len) {
+        if (m_fd < 0) {
+            return false;
+        }
+        return sendto(m_fd, buf, len, 0, reinterpret_cast<struct sockaddr *>(&m_group), sizeof(m_group)) ==
+               static_cast<ssize_t>(len);
+    }
+
+    /// @brief Receive a datagram.
+    /// @param buf receive buffer.
+    /// @param size size of receive buffer.
+    /// @param timeoutMs maximum wait time in milliseconds, negative value to wait forever.
+    /// @return number of received bytes, 0 if timed out, negative value on error.
+    int receive(uint8_t *buf, size_t size, int timeoutMs) {
+        if (m_fd < 0) {
+            return -1;
+        }
+        if (timeoutMs >= 0) {
+            fd_set readSet;
+            FD_ZERO(&readSet);
+            FD_SET(m_fd, &readSet);
+            struct timeval tv;
+            tv.tv_sec = timeoutMs / 1000;
+            tv.tv_usec = (timeoutMs % 1000) * 1000;
+            int ready = select(m_fd + 1, &readSet, nullptr, nullptr, &tv);
+            if (ready <= 0) {
+                return ready;
+            }
+        }
+        return recv(m_fd, buf, size, 0);
+    }
+
+    void close() {
+        if (m_fd >= 0) {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    bool isOpen() const { return m_fd >= 0; }
+
+ private:
+    int closeWithError() {
+        int err = errno;
+        close();
+        return err ? err : -1;
+    }
+
+    int                m_fd = -1;
+    struct sockaddr_in m_group;
+};
+
+/// @brief Get the IR send API format name of an IR group message format. Values are the same as in `IRFormat`.
+/// @return format name, nullptr if unknown.
+inline const char *irGroupFormatName(uint8_t format) {
+    switch (format) {
+        case 1:
+            return "hex";
+        case 2:
+            return "pronto";
+        case 3:
+            return "gc";
+        default:
+            return nullptr;
+    }
+}
+
+/// @brief Get the IR group message format of an IR send API format name. Values are the same as in `IRFormat`.
+/// @return format value, 0 if unknown.
+inline uint8_t irGroupFormat(const char *name) {
+    for (uint8_t format = 1; format <= 3; format++) {
+        if (name && strcmp(name, irGroupFormatName(format)) == 0) {
+            return format;
+        }
+    }
+    return 0;
+}
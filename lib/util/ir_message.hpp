@@ -0,0 +1,257 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// IR send messages passed from the API tasks to the IR send task, and a message pool to send without heap allocations.
+// Make sure this file also compiles natively and all functions are covered by unit tests.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <new>
+
+#include "gc_ir_code.hpp"
+
+/// Number of pooled IR send messages: the scheduler slots, the messages finished by the send task and one message
+/// being submitted per sending task. More messages are allocated on the heap.
+#define IR_MESSAGE_POOL_SIZE 12
+/// Maximum code buffer size kept by a released message. Larger buffers are freed.
+#define IR_MESSAGE_KEEP_SIZE 1024
+
+enum class IRFormat {
+    UNKNOWN = 0,
+    UNFOLDED_CIRCLE = 1,
+    PRONTO = 2,
+    GLOBAL_CACHE = 3,
+};
+
+/// @brief Get the format of an IR send API format name: `hex`, `pronto` or `gc`.
+/// @return `IRFormat::UNKNOWN` if the name is invalid or null.
+inline IRFormat parseIrFormat(const char *name) {
+    if (name == nullptr) {
+        return IRFormat::UNKNOWN;
+    }
+    if (strcmp(name, "hex") == 0) {
+        return IRFormat::UNFOLDED_CIRCLE;
+    }
+    if (strcmp(name, "pronto") == 0) {
+        return IRFormat::PRONTO;
+    }
+    if (strcmp(name, "gc") == 0) {
+        return IRFormat::GLOBAL_CACHE;
+    }
+    return IRFormat::UNKNOWN;
+}
+
+/// @brief UNFOLDED_CIRCLE IR code in binary form, set from a binary encoded request instead of the code text.
+struct IrHexCode {
+    /// IRremoteESP8266 protocol number, 0 if the code is stored as text
+    uint16_t protocol = 0;
+    uint16_t bits = 0;
+    uint16_t repeat = 0;
+    uint64_t command = 0;
+
+    bool operator==(const IrHexCode &other) const {
+        return protocol == other.protocol && bits == other.bits && repeat == other.repeat && command == other.command;
+    }
+};
+
+/// @brief Zero-terminated IR code text. The buffer is only reallocated if a longer code is assigned.
+class IrCodeBuffer {
+ public:
+    IrCodeBuffer() = default;
+    ~IrCodeBuffer() { free(m_data); }
+
+    IrCodeBuffer(const IrCodeBuffer &) = delete;  // no copying
+    IrCodeBuffer &operator=(const IrCodeBuffer &) = delete;
+
+    /// @brief Copy a code into the buffer.
+    /// @param code code text, doesn't need to be zero-terminated.
+    /// @param length length of the code.
+    /// @return false if memory allocation failed. The buffer is empty afterwards.
+    bool assign(const char *code, size_t length) {
+        if (length >= m_capacity) {
+            free(m_data);
+            m_data = reinterpret_cast<char *>(malloc(length + 1));
+            m_capacity = m_data ? length + 1 : 0;
+            if (m_data == nullptr) {
+                m_length = 0;
+                return false;
+            }
+        }
+        if (length) {
+            memcpy(m_data, code, length);
+        }
+        m_data[length] = 0;
+        m_length = length;
+        return true;
+    }
+
+    /// @brief Clear the code and free the buffer if it's larger than `maxCapacity`.
+    void clear(size_t maxCapacity) {
+        if (m_capacity > maxCapacity) {
+            free(m_data);
+            m_data = nullptr;
+            m_capacity = 0;
+        }
+        if (m_data) {
+            m_data[0] = 0;
+        }
+        m_length = 0;
+    }
+
+    const char *c_str() const { return m_data ? m_data : ""; }
+    size_t      length() const { return m_length; }
+    size_t      capacity() const { return m_capacity; }
+
+    bool operator==(const IrCodeBuffer &other) const {
+        return m_length == other.m_length && memcmp(c_str(), other.c_str(), m_length) == 0;
+    }
+
+ private:
+    char  *m_data = nullptr;
+    size_t m_capacity = 0;
+    size_t m_length = 0;
+};
+
+struct IRSendMessage {
+    int16_t      clientId;
+    uint32_t     msgId;
+    IRFormat     format;
+    // IR code for UNFOLDED_CIRCLE and PRONTO formats, the original text for GLOBAL_CACHE
+    IrCodeBuffer message;
+    // Parsed IR code for GLOBAL_CACHE format
+    GCIrCode     gcCode;
+    // Binary IR code for UNFOLDED_CIRCLE format, if `protocol` is set. Otherwise the code is in `message`.
+    IrHexCode    hexCode;
+    uint16_t     repeat;
+    uint32_t     pin_mask;
+    // GlobalCache server connection identifier if received from the GlobalCache server, 0 otherwise.
+    uint32_t     gcConnection;
+    // Scheduled send time in microseconds since the Unix epoch (UTC), 0 to send immediately.
+    int64_t      sendAt;
+};
+
+/// @brief Set the IR code of a message. GlobalCache codes are parsed into `gcCode`. The message buffers are reused.
+/// @param code IR code text, doesn't need to be zero-terminated.
+/// @param length length of the code.
+/// @param memError optional memory allocation error indicator. Set to 1 if memory allocation failed.
+/// @return false if the code is empty, invalid or memory allocation failed.
+inline bool setIrSendCode(IRSendMessage *msg, IRFormat format, const char *code, size_t length, int *memError = NULL) {
+    if (memError) {
+        *memError = 0;
+    }
+    if (code == nullptr || length == 0 || format == IRFormat::UNKNOWN) {
+        return false;
+    }
+    msg->format = format;
+    msg->hexCode.protocol = 0;
+    if (!msg->message.assign(code, length)) {
+        if (memError) {
+            *memError = 1;
+        }
+        return false;
+    }
+    if (format == IRFormat::GLOBAL_CACHE) {
+        return parseGcIrCode(msg->message.c_str(), &msg->gcCode, memError) == 0;
+    }
+    msg->gcCode.count = 0;
+    return true;
+}
+
+/// @brief Set the IR code of a message from a list of numbers, e.g. a binary encoded request, without text parsing.
+///
+/// - UNFOLDED_CIRCLE: `<protocol>,<command>,<bits>,<repeat>`, same values as the `hex` text format. Set in `hexCode`.
+/// - GLOBAL_CACHE: `<freq>,<repeat>,<offset>,<on1>,<off1>,...`, see `setGcIrValues`. Set in `gcCode`.
+///
+/// The text buffer `message` is cleared. PRONTO codes are not supported.
+/// @param values reader with a `uint32_t size()` and `bool next(uint64_t *value)` method.
+/// @param memError optional memory allocation error indicator. Set to 1 if memory allocation failed.
+/// @return false if the code is invalid or memory allocation failed.
+template <typename Reader>
+bool setIrSendValues(IRSendMessage *msg, IRFormat format, Reader values, int *memError = NULL) {
+    if (memError) {
+        *memError = 0;
+    }
+    msg->format = format;
+    msg->message.clear(IR_MESSAGE_KEEP_SIZE);
+    msg->hexCode.protocol = 0;
+    msg->gcCode.count = 0;
+    if (format == IRFormat::GLOBAL_CACHE) {
+        return setGcIrValues(values, &msg->gcCode, memError) == 0;
+    }
+    if (format != IRFormat::UNFOLDED_CIRCLE || values.size() != 4) {
+        return false;
+    }
+    // same limits as `buildIRHexData`
+    uint64_t protocol, command, bits, repeat;
+    if (!values.next(&protocol) || !values.next(&command) || !values.next(&bits) || !values.next(&repeat) ||
+        protocol == 0 || protocol > UINT16_MAX || bits == 0 || bits > UINT16_MAX || repeat > 20) {
+        return false;
+    }
+    msg->hexCode.protocol = protocol;
+    msg->hexCode.command = command;
+    msg->hexCode.bits = bits;
+    msg->hexCode.repeat = repeat;
+    return true;
+}
+
+/// @brief Fixed pool of IR send messages, shared between the sending tasks and the IR send task without locking.
+///
+/// Released messages keep their code buffers up to `IR_MESSAGE_KEEP_SIZE` bytes, so sending a code doesn't allocate
+/// memory once a message has been used for a code of the same size. If the pool is exhausted, messages are allocated
+/// on the heap and deleted on release.
+template <uint8_t N = IR_MESSAGE_POOL_SIZE>
+class IrMessagePool {
+    static_assert(N > 0 && N <= 32, "pool size must be 1..32");
+
+ public:
+    IrMessagePool() = default;
+
+    IrMessagePool(const IrMessagePool &) = delete;  // no copying
+    IrMessagePool &operator=(const IrMessagePool &) = delete;
+
+    /// @brief Get an unused message. All fields must be set by the caller.
+    /// @return nullptr if the pool is exhausted and heap allocation failed.
+    IRSendMessage *acquire() {
+        uint32_t free = m_free.load(std::memory_order_relaxed);
+        while (free) {
+            uint32_t bit = free & (~free + 1);
+            if (m_free.compare_exchange_weak(free, free & ~bit, std::memory_order_acquire,
+                                             std::memory_order_relaxed)) {
+                return &m_messages[__builtin_ctz(bit)];
+            }
+        }
+        return new (std::nothrow) IRSendMessage();
+    }
+
+    /// @brief Return a message to the pool, or delete it if it was allocated on the heap.
+    void release(IRSendMessage *msg) {
+        if (msg == nullptr) {
+            return;
+        }
+        if (msg < m_messages || msg >= m_messages + N) {
+            deleteMessage(msg);
+            return;
+        }
+        msg->message.clear(IR_MESSAGE_KEEP_SIZE);
+        if (msg->gcCode.capacity * sizeof(uint16_t) > IR_MESSAGE_KEEP_SIZE) {
+            msg->gcCode = GCIrCode();
+        }
+        m_free.fetch_or(1UL << (msg - m_messages), std::memory_order_release);
+    }
+
+    /// @brief Number of unused pooled messages.
+    uint8_t available() const { return __builtin_popcount(m_free.load(std::memory_order_relaxed)); }
+
+ private:
+    // Not inlined: cold path, and the compiler would otherwise assume a pooled message could be deleted
+    __attribute__((noinline)) static void deleteMessage(IRSendMessage *msg) { delete msg; }
+
+    IRSendMessage         m_messages[N];
+    std::atomic<uint32_t> m_free{N == 32 ? 0xFFFFFFFFUL : (1UL << N) - 1};
+};
@@ -0,0 +1,101 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Queue of IR send results and learned IR codes from the IR tasks to the API task.
+// Make sure this file also compiles natively and all functions are covered by unit tests.
+
+#pragma once
+
+#include <stddef.h>
+
+#include <functional>
+#include <mutex>
+
+/// @brief Bounded queue of heap allocated responses, pushed from any task and drained by a single consumer task.
+///
+/// Pushing never blocks: the IR send and learn tasks must not wait for the API task. The queue takes ownership of a
+/// pushed response, a response which doesn't fit into the queue is deleted.
+template <typename T, size_t N>
+class IrResponseQueue {
+    static_assert(N > 0, "queue size must be at least 1");
+
+ public:
+    /// Notification of a newly queued response, called from the pushing task.
+    typedef std::function<void()> WakeHandler;
+
+    IrResponseQueue() = default;
+    ~IrResponseQueue() { clear(); }
+
+    IrResponseQueue(const IrResponseQueue &) = delete;  // no copying
+    IrResponseQueue &operator=(const IrResponseQueue &) = delete;
+
+    /// @brief Set the handler to wake up the consumer. Must be set before responses are pushed.
+    void onPush(WakeHandler handler) { m_wakeHandler = handler; }
+
+    /// @brief Queue a response and wake up the consumer. Never blocks.
+    /// @param response heap allocated response, owned by the queue afterwards.
+    /// @return false if the queue is full and the response has been deleted.
+    bool push(T *response) {
+        if (response == nullptr) {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_count >= N) {
+                delete response;
+                m_dropped++;
+                return false;
+            }
+            m_responses[(m_head + m_count) % N] = response;
+            m_count++;
+        }
+        if (m_wakeHandler) {
+            m_wakeHandler();
+        }
+        return true;
+    }
+
+    /// @brief Take the next response. The caller is responsible to delete it after use.
+    /// @return nullptr if the queue is empty.
+    T *pop() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_count == 0) {
+            return nullptr;
+        }
+        T *response = m_responses[m_head];
+        m_head = (m_head + 1) % N;
+        m_count--;
+        return response;
+    }
+
+    /// @brief Number of queued responses.
+    size_t pending() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_count;
+    }
+
+    /// @brief Number of responses deleted because the queue was full.
+    size_t dropped() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_dropped;
+    }
+
+    /// @brief Delete all queued responses.
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (m_count > 0) {
+            delete m_responses[m_head];
+            m_head = (m_head + 1) % N;
+            m_count--;
+        }
+    }
+
+ private:
+    WakeHandler m_wakeHandler;
+    // Protects the queued responses and counters
+    std::mutex  m_mutex;
+    T          *m_responses[N];
+    size_t      m_head = 0;
+    size_t      m_count = 0;
+    size_t      m_dropped = 0;
+};
@@ -0,0 +1,87 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Helper functions for sending IR codes at an absolute point in time.
+// Make sure this file also compiles natively and all functions are covered by unit tests.
+
+#pragma once
+
+#include <stdint.h>
+
+/// Earliest plausible wall clock time: 2023-01-01T00:00:00Z in microseconds since the Unix epoch.
+/// The dock doesn't have a battery buffered RTC, anything older means that SNTP hasn't synchronized the clock yet.
+const int64_t kMinPlausibleEpochUs = 1672531200LL * 1000000LL;
+/// Maximum time a scheduled IR send may lie in the future. The IR send task is blocked while waiting!
+const int64_t kMaxScheduleAheadUs = 60LL * 1000000LL;
+/// Maximum time a scheduled IR send may lie in the past. Late requests within this window are sent immediately.
+const int64_t kMaxScheduleLateUs = 50LL * 1000LL;
+/// Remaining time before the target which is busy-waited instead of yielding to the scheduler.
+/// Must be larger than one FreeRTOS tick, since `vTaskDelay` might oversleep up to one tick.
+const int64_t kScheduleSpinUs = 2000;
+
+enum class ScheduleCheck {
+    OK = 0,
+    /// Wall clock isn't set, e.g. SNTP disabled or not yet synchronized
+    CLOCK_NOT_SET = 1,
+    /// Target time is too far in the past
+    TOO_LATE = 2,
+    /// Target time is too far in the future
+    TOO_FAR = 3,
+};
+
+/// @brief Validate a scheduled send time.
+/// @param sendAtUs target time in microseconds since the Unix epoch (UTC).
+/// @param nowUs current wall clock time in microseconds since the Unix epoch (UTC).
+inline ScheduleCheck checkSendAt(int64_t sendAtUs, int64_t nowUs) {
+    if (nowUs < kMinPlausibleEpochUs) {
+        return ScheduleCheck::CLOCK_NOT_SET;
+    }
+    if (sendAtUs < nowUs - kMaxScheduleLateUs) {
+        return ScheduleCheck::TOO_LATE;
+    }
+    if (sendAtUs > nowUs + kMaxScheduleAheadUs) {
+        return ScheduleCheck::TOO_FAR;
+    }
+    return ScheduleCheck::OK;
+}
+
+/// @brief Wait until the given target time is reached.
+///
+/// The wait is split into a coarse phase, yielding the CPU with `Clock::sleepMs`, and a short busy-wait phase of at
+/// most `kScheduleSpinUs` to achieve sub-millisecond accuracy. The function never returns before the target time,
+/// unless the wait is aborted.
+///
+/// The Clock type must provide:
+/// - `int64_t nowUs()`: monotonic time in microseconds.
+/// - `bool sleepMs(uint32_t ms)`: yield for at least the given time. Return true to abort the wait.
+///
+/// @param clock clock implementation.
+/// @param targetUs target time in the same time base as `Clock::nowUs`.
+/// @param lateUs optional output parameter: difference between target and actual return time in microseconds.
+/// @return false if the wait has been aborted, true if the target time has been reached.
+template <typename Clock>
+bool waitUntil(Clock &clock, int64_t targetUs, int64_t *lateUs = nullptr) {
+    int64_t now = clock.nowUs();
+    int64_t remaining = targetUs - now;
+
+    while (remaining > kScheduleSpinUs) {
+        uint32_t sleepMs = static_cast<uint32_t>((remaining - kScheduleSpinUs) / 1000);
+        if (sleepMs == 0) {
+            break;
+        }
+        if (clock.sleepMs(sleepMs)) {
+            return false;
+        }
+        now = clock.nowUs();
+        remaining = targetUs - now;
+    }
+
+    while (now < targetUs) {
+        now = clock.nowUs();
+    }
+
+    if (lateUs) {
+        *lateUs = now - targetUs;
+    }
+    return true;
+}
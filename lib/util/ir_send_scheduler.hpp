@@ -0,0 +1,166 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Priority handling of IR send commands.
+// Make sure this file also compiles natively and all functions are covered by unit tests.
+
+#pragma once
+
+#include <string.h>
+
+#include <atomic>
+
+/// Priority class of an IR send command.
+enum class IrSendPriority {
+    /// Only accepted if no other command is active.
+    NORMAL = 0,
+    /// Queued after the active command, which is not interrupted.
+    HIGH = 1,
+    /// Interrupts the active command at the end of its current IR frame.
+    PREEMPT = 2,
+};
+
+/// @brief Parse a priority name: `normal`, `high` or `preempt`.
+/// @param name priority name. Null or empty value is parsed as `NORMAL`.
+/// @return false if the name is invalid.
+inline bool parseIrSendPriority(const char *name, IrSendPriority *priority) {
+    if (name == nullptr || name[0] == 0 || strcmp(name, "normal") == 0) {
+        *priority = IrSendPriority::NORMAL;
+    } else if (strcmp(name, "high") == 0) {
+        *priority = IrSendPriority::HIGH;
+    } else if (strcmp(name, "preempt") == 0) {
+        *priority = IrSendPriority::PREEMPT;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/// @brief Scheduler of IR send commands with priority classes and preemption.
+///
+/// There's one active command, one pending command of a higher priority class, and one suspended command which has
+/// been interrupted by a preempting command and is resumed afterwards.
+///
+/// The scheduler doesn't own the messages and isn't synchronized: `submit`, `next` and `finish` must be protected by
+/// the caller. Only `preemptRequested` may be called without lock from the IR send repeat callback.
+///
+/// Send task usage:
+/// 1. `next()` returns the next command to send.
+/// 2. While sending, `preemptRequested()` is checked between IR frames. If set, the command is ended early.
+/// 3. `finish(interrupted)` returns the interrupted command if it has to be cancelled.
+template <typename T>
+class IrSendScheduler {
+ public:
+    /// @brief Submit a new command.
+    /// @param msg command to send.
+    /// @param priority priority class.
+    /// @param resumePreempted only for `PREEMPT`: resume the interrupted command afterwards, otherwise cancel it.
+    /// @return false if the command can't be accepted, i.e. the priority class is busy.
+    bool submit(T *msg, IrSendPriority priority, bool resumePreempted = false) {
+        if (msg == nullptr) {
+            return false;
+        }
+        switch (priority) {
+            case IrSendPriority::NORMAL:
+                if (isBusy()) {
+                    return false;
+                }
+                break;
+            case IrSendPriority::HIGH:
+            case IrSendPriority::PREEMPT:
+                if (m_pending.msg) {
+                    return false;
+                }
+                if (m_current.msg == nullptr && m_next.msg == nullptr && m_suspended.msg == nullptr) {
+                    // idle: nothing to queue behind or preempt
+                    break;
+                }
+                m_pending = {msg, priority, resumePreempted};
+                updatePreempt();
+                return true;
+        }
+
+        if (m_current.msg == nullptr && m_next.msg == nullptr) {
+            m_next = {msg, priority, resumePreempted};
+            return true;
+        }
+        return false;
+    }
+
+    /// @brief Check if the active command has to end after the current IR frame.
+    bool preemptRequested() const { return m_preempt; }
+
+    /// @brief Get the next command to send and make it the active command.
+    /// @return nullptr if nothing to send or a command is still active.
+    T *next() {
+        if (m_current.msg) {
+            return nullptr;
+        }
+        if (m_next.msg) {
+            m_current = m_next;
+            m_next = {};
+        } else if (m_pending.msg) {
+            m_current = m_pending;
+            m_pending = {};
+        } else if (m_suspended.msg) {
+            m_current = m_suspended;
+            m_suspended = {};
+        }
+        updatePreempt();
+        return m_current.msg;
+    }
+
+    /// @brief Finish the active command.
+    /// @param interrupted true if the command ended early because of a preemption request.
+    /// @return command to cancel: the interrupted command if it's not resumed, or a displaced suspended command.
+    ///         The caller is responsible for it. nullptr otherwise.
+    T *finish(bool interrupted) {
+        Slot done = m_current;
+        m_current = {};
+        m_preempt = false;
+
+        if (!interrupted || done.msg == nullptr) {
+            return nullptr;
+        }
+        if (!m_pending.resume) {
+            return done.msg;
+        }
+        // only one command can be suspended: the older one is cancelled
+        T *displaced = m_suspended.msg;
+        m_suspended = done;
+        return displaced;
+    }
+
+    /// @brief Remove the suspended command, e.g. after a stop request.
+    /// @return the removed command. The caller is responsible for it.
+    T *cancelSuspended() {
+        T *msg = m_suspended.msg;
+        m_suspended = {};
+        return msg;
+    }
+
+    /// @brief Check if a command is active, pending or suspended.
+    bool isBusy() const { return m_current.msg || m_next.msg || m_pending.msg || m_suspended.msg; }
+
+    /// @brief Get the active command.
+    T *current() const { return m_current.msg; }
+
+ private:
+    void updatePreempt() {
+        m_preempt = m_current.msg && m_pending.msg && m_pending.priority == IrSendPriority::PREEMPT &&
+                    m_current.priority != IrSendPriority::PREEMPT;
+    }
+
+    struct Slot {
+        T             *msg;
+        IrSendPriority priority;
+        bool           resume;
+    };
+
+    /// Accepted command while idle, waiting to be picked up by the send task
+    Slot              m_next = {};
+    Slot              m_current = {};
+    Slot              m_pending = {};
+    Slot              m_suspended = {};
+    std::atomic<bool> m_preempt{false};
+};
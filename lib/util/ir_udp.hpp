@@ -0,0 +1,420 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Fire-and-forget UDP IR command protocol.
+// Make sure this file also compiles natively and all functions are covered by unit tests.
+//
+// One datagram carries one IR send command. There is no connection setup and no framing: the datagram is
+// authenticated, checked for replays and queued in the IR service. An acknowledgement is only sent if requested.
+// Replays are detected with the authenticated send time, which requires SNTP on the dock and the client, and with the
+// sequence numbers of the recently active clients, see `IrUdpReplayWindow`.
+// Command datagram layout, all values big endian:
+//
+// | Offset | Size | Field                                                                         |
+// |--------|------|-------------------------------------------------------------------------------|
+// | 0      | 3    | Magic: `UCI`                                                                  |
+// | 3      | 1    | Protocol version: 2                                                           |
+// | 4      | 1    | Flags, see `IrUdpFlags`                                                       |
+// | 5      | 4    | Client identifier: random value chosen by the client at startup               |
+// | 9      | 4    | Sequence number, incremented for every new command                            |
+// | 13     | 8    | Send time: microseconds since the Unix epoch (UTC)                            |
+// | 21     | 1    | Output mask, see `IrGroupOutput`                                              |
+// | 22     | 1    | IR code format, see `IRFormat`: UC hex code id, PRONTO or GlobalCache timings |
+// | 23     | 2    | IR repeat count                                                               |
+// | 25     | 2    | Code length n                                                                 |
+// | 27     | n    | IR code                                                                       |
+// | 27 + n | 8    | SipHash-2-4 MAC over all previous bytes, keyed with the API token             |
+//
+// Acknowledgement datagram layout, sent back to the source address if requested with `IR_UDP_FLAG_ACK`:
+//
+// | Offset | Size | Field                                                                          |
+// |--------|------|--------------------------------------------------------------------------------|
+// | 0      | 3    | Magic: `UCA`                                                                   |
+// | 3      | 1    | Protocol version: 2                                                            |
+// | 4      | 4    | Client identifier of the command                                               |
+// | 8      | 4    | Sequence number of the command                                                 |
+// | 12     | 2    | Status code: 200 queued, 208 duplicate, 408 stale, otherwise error code        |
+// | 14     | 8    | SipHash-2-4 MAC over all previous bytes, keyed with the API token              |
+//
+// Datagrams failing authentication are silently dropped, so the port can't be abused for reflection.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <functional>
+
+#include "ir_group.hpp"
+#include "ir_schedule.hpp"
+#include "siphash.hpp"
+
+#define IR_UDP_PORT 947
+
+const uint8_t  kIrUdpVersion = 2;
+const size_t   kIrUdpHeaderLen = 27;
+const size_t   kIrUdpMacLen = 8;
+const size_t   kIrUdpAckLen = 22;
+const size_t   kIrUdpMaxCodeLen = 1400;
+const size_t   kIrUdpMaxPacketLen = kIrUdpHeaderLen + kIrUdpMaxCodeLen + kIrUdpMacLen;
+const uint64_t kIrUdpKeyContext = 0x5543442d55445049ULL;  // "UCD-UDPI"
+/// Maximum difference between the send time of a command and the wall clock of the dock. Older commands are rejected,
+/// so a captured datagram can only be replayed within this time, while its client is kept in the replay window.
+const int64_t  kIrUdpMaxClockSkewUs = 2LL * 1000000LL;
+
+enum IrUdpFlags {
+    /// Request an acknowledgement datagram
+    IR_UDP_FLAG_ACK = 1,
+};
+
+enum class IrUdpResult {
+    OK = 0,
+    TOO_SHORT,
+    BAD_MAGIC,
+    BAD_VERSION,
+    BAD_LENGTH,
+    BAD_MAC,
+    /// Retransmission of an already processed command
+    DUPLICATE,
+    /// Sequence number outside of the replay window
+    REPLAY,
+    /// Send time outside of the accepted clock skew, or before the replay window started
+    STALE,
+    /// Wall clock of the dock isn't set, e.g. SNTP not yet synchronized: freshness can't be checked
+    CLOCK_NOT_SET,
+    /// All replay window entries are used by clients which sent a command within the accepted clock skew
+    BUSY,
+    /// Authenticated, but the IR service rejected the command
+    REJECTED,
+};
+
+/// IR send command
+struct IrUdpCommand {
+    uint8_t  flags;
+    uint32_t clientId;
+    uint32_t seq;
+    /// Send time in microseconds since the Unix epoch (UTC)
+    int64_t  sentAt;
+    uint8_t  outputs;
+    uint8_t  format;
+    uint16_t repeat;
+    /// IR code. Not zero-terminated! Points into the datagram buffer after decoding.
+    const char *code;
+    uint16_t    codeLen;
+};
+
+/// @brief Derive the datagram MAC key from the API token.
+inline SipHashKey irUdpKey(const char *token) {
+    return sipDeriveKey(token, kIrUdpKeyContext);
+}
+
+/// @brief Encode an IR send command into a datagram.
+/// @return length of the datagram, 0 if the code is too long or the output buffer too small.
+inline size_t irUdpEncodeCommand(const SipHashKey &key, const IrUdpCommand &cmd, uint8_t *buf, size_t size) {
+    size_t len = kIrUdpHeaderLen + cmd.codeLen + kIrUdpMacLen;
+    if (cmd.codeLen > kIrUdpMaxCodeLen || len > size || (cmd.codeLen && cmd.code == nullptr)) {
+        return 0;
+    }
+
+    buf[0] = 'U';
+    buf[1] = 'C';
+    buf[2] = 'I';
+    buf[3] = kIrUdpVersion;
+    buf[4] = cmd.flags;
+    irGroupPut32(buf + 5, cmd.clientId);
+    irGroupPut32(buf + 9, cmd.seq);
+    irGroupPut64(buf + 13, static_cast<uint64_t>(cmd.sentAt));
+    buf[21] = cmd.outputs;
+    buf[22] = cmd.format;
+    irGroupPut16(buf + 23, cmd.repeat);
+    irGroupPut16(buf + 25, cmd.codeLen);
+    memcpy(buf + kIrUdpHeaderLen, cmd.code, cmd.codeLen);
+
+    size_t macOffset = kIrUdpHeaderLen + cmd.codeLen;
+    irGroupPut64(buf + macOffset, sipHash24(key, buf, macOffset));
+
+    return len;
+}
+
+/// @brief Decode and authenticate an IR send command datagram.
+/// @param cmd output command. The code field points into `buf`.
+inline IrUdpResult irUdpDecodeCommand(const SipHashKey &key, const uint8_t *buf, size_t len, IrUdpCommand *cmd) {
+    if (buf == nullptr || len < kIrUdpHeaderLen + kIrUdpMacLen) {
+        return IrUdpResult::TOO_SHORT;
+    }
+    if (buf[0] != 'U' || buf[1] != 'C' || buf[2] != 'I') {
+        return IrUdpResult::BAD_MAGIC;
+    }
+    if (buf[3] != kIrUdpVersion) {
+        return IrUdpResult::BAD_VERSION;
+    }
+    uint16_t codeLen = irGroupGet16(buf + 25);
+    if (codeLen > kIrUdpMaxCodeLen || kIrUdpHeaderLen + codeLen + kIrUdpMacLen != len) {
+        return IrUdpResult::BAD_LENGTH;
+    }
+    size_t macOffset = kIrUdpHeaderLen + codeLen;
+    if (irGroupGet64(buf + macOffset) != sipHash24(key, buf, macOffset)) {
+        return IrUdpResult::BAD_MAC;
+    }
+
+    cmd->flags = buf[4];
+    cmd->clientId = irGroupGet32(buf + 5);
+    cmd->seq = irGroupGet32(buf + 9);
+    cmd->sentAt = static_cast<int64_t>(irGroupGet64(buf + 13));
+    cmd->outputs = buf[21];
+    cmd->format = buf[22];
+    cmd->repeat = irGroupGet16(buf + 23);
+    cmd->codeLen = codeLen;
+    cmd->code = reinterpret_cast<const char *>(buf + kIrUdpHeaderLen);
+
+    return IrUdpResult::OK;
+}
+
+/// @brief Encode an acknowledgement datagram.
+/// @return length of the datagram, 0 if the output buffer is too small.
+inline size_t irUdpEncodeAck(const SipHashKey &key, uint32_t clientId, uint32_t seq, uint16_t status, uint8_t *buf,
+                             size_t size) {
+    if (size < kIrUdpAckLen) {
+        return 0;
+    }
+    buf[0] = 'U';
+    buf[1] = 'C';
+    buf[2] = 'A';
+    buf[3] = kIrUdpVersion;
+    irGroupPut32(buf + 4, clientId);
+    irGroupPut32(buf + 8, seq);
+    irGroupPut16(buf + 12, status);
+    irGroupPut64(buf + 14, sipHash24(key, buf, 14));
+    return kIrUdpAckLen;
+}
+
+/// @brief Decode and authenticate an acknowledgement datagram.
+inline IrUdpResult irUdpDecodeAck(const SipHashKey &key, const uint8_t *buf, size_t len, uint32_t *clientId,
+                                  uint32_t *seq, uint16_t *status) {
+    if (buf == nullptr || len < kIrUdpAckLen) {
+        return IrUdpResult::TOO_SHORT;
+    }
+    if (buf[0] != 'U' || buf[1] != 'C' || buf[2] != 'A') {
+        return IrUdpResult::BAD_MAGIC;
+    }
+    if (buf[3] != kIrUdpVersion) {
+        return IrUdpResult::BAD_VERSION;
+    }
+    if (len != kIrUdpAckLen) {
+        return IrUdpResult::BAD_LENGTH;
+    }
+    if (irGroupGet64(buf + 14) != sipHash24(key, buf, 14)) {
+        return IrUdpResult::BAD_MAC;
+    }
+    *clientId = irGroupGet32(buf + 4);
+    *seq = irGroupGet32(buf + 8);
+    *status = irGroupGet16(buf + 12);
+    return IrUdpResult::OK;
+}
+
+/// @brief Replay protection with the send time of a command and a sliding window of the last 64 sequence numbers per
+///        client.
+///
+/// Only commands sent within `kIrUdpMaxClockSkewUs` of the current time are accepted. Within that time, the sequence
+/// numbers of a client are checked: they may arrive out of order within the window. A client is only evicted from the
+/// table once all of its accepted commands are stale, otherwise a new client is rejected with BUSY. The window only
+/// accepts commands sent after it has been started: datagrams captured before a reboot can't be replayed.
+/// Only authenticated datagrams are passed to the window, so only legitimate clients can fill the table.
+template <size_t CLIENTS = 8>
+class IrUdpReplayWindow {
+ public:
+    /// @brief Start accepting commands, once the wall clock is set. Commands sent before `nowUs` plus the accepted
+    ///        clock skew are rejected.
+    /// @param nowUs current wall clock time in microseconds since the Unix epoch (UTC).
+    /// @return false if the wall clock isn't set.
+    bool start(int64_t nowUs) {
+        if (nowUs < kMinPlausibleEpochUs) {
+            return false;
+        }
+        m_acceptFromUs = nowUs + kIrUdpMaxClockSkewUs;
+        return true;
+    }
+
+    bool started() const { return m_acceptFromUs != 0; }
+
+    /// @param sentAtUs authenticated send time of the command in microseconds since the Unix epoch (UTC).
+    /// @param nowUs current wall clock time in microseconds since the Unix epoch (UTC).
+    /// @return OK for a new sequence number, DUPLICATE if already seen, REPLAY if older than the window, STALE if the
+    ///         send time isn't accepted, CLOCK_NOT_SET if not started, BUSY if the client table is full.
+    IrUdpResult check(uint32_t clientId, uint32_t seq, int64_t sentAtUs, int64_t nowUs) {
+        if (!started() || nowUs < kMinPlausibleEpochUs) {
+            return IrUdpResult::CLOCK_NOT_SET;
+        }
+        if (sentAtUs < m_acceptFromUs || sentAtUs < nowUs - kIrUdpMaxClockSkewUs ||
+            sentAtUs > nowUs + kIrUdpMaxClockSkewUs) {
+            return IrUdpResult::STALE;
+        }
+
+        m_clock++;
+        Entry *entry = find(clientId);
+        if (entry == nullptr) {
+            entry = evict(nowUs);
+            if (entry == nullptr) {
+                return IrUdpResult::BUSY;
+            }
+            entry->clientId = clientId;
+            entry->used = true;
+            entry->highest = seq;
+            entry->window = 1;
+            entry->lastUsed = m_clock;
+            entry->lastSentAt = sentAtUs;
+            return IrUdpResult::OK;
+        }
+
+        entry->lastUsed = m_clock;
+        if (seq > entry->highest) {
+            uint32_t shift = seq - entry->highest;
+            entry->window = shift >= 64 ? 1 : (entry->window << shift) | 1;
+            entry->highest = seq;
+            accepted(entry, sentAtUs);
+            return IrUdpResult::OK;
+        }
+
+        uint32_t offset = entry->highest - seq;
+        if (offset >= 64) {
+            return IrUdpResult::REPLAY;
+        }
+        uint64_t bit = 1ULL << offset;
+        if (entry->window & bit) {
+            return IrUdpResult::DUPLICATE;
+        }
+        entry->window |= bit;
+        accepted(entry, sentAtUs);
+        return IrUdpResult::OK;
+    }
+
+ private:
+    struct Entry {
+        bool     used;
+        uint32_t clientId;
+        uint32_t highest;
+        uint64_t window;
+        uint32_t lastUsed;
+        /// Latest send time of an accepted command
+        int64_t  lastSentAt;
+    };
+
+    static void accepted(Entry *entry, int64_t sentAtUs) {
+        if (sentAtUs > entry->lastSentAt) {
+            entry->lastSentAt = sentAtUs;
+        }
+    }
+
+    Entry *find(uint32_t clientId) {
+        for (size_t i = 0; i < CLIENTS; i++) {
+            if (m_entries[i].used && m_entries[i].clientId == clientId) {
+                return &m_entries[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // Get a free entry or the least recently used client without fresh commands, nullptr if there is none
+    Entry *evict(int64_t nowUs) {
+        Entry *oldest = nullptr;
+        for (size_t i = 0; i < CLIENTS; i++) {
+            if (!m_entries[i].used) {
+                return &m_entries[i];
+            }
+            if (m_entries[i].lastSentAt >= nowUs - kIrUdpMaxClockSkewUs) {
+                // replays of this client would still be accepted without its sequence numbers
+                continue;
+            }
+            if (oldest == nullptr || m_entries[i].lastUsed < oldest->lastUsed) {
+                oldest = &m_entries[i];
+            }
+        }
+        return oldest;
+    }
+
+    Entry    m_entries[CLIENTS] = {};
+    uint32_t m_clock = 0;
+    int64_t  m_acceptFromUs = 0;
+};
+
+/// Send function of an authenticated command: returns 0 if the IR code has been queued, otherwise an error code.
+typedef std::function<uint16_t(const IrUdpCommand &cmd)> IrUdpSendFunction;
+
+/// @brief Transport independent handler of IR command datagrams.
+class IrUdpHandler {
+ public:
+    explicit IrUdpHandler(IrUdpSendFunction sendFn) : m_sendFn(sendFn) {}
+
+    void setToken(const char *token) { m_key = irUdpKey(token); }
+
+    /// @brief Start accepting commands once the wall clock is set, see `IrUdpReplayWindow::start`.
+    /// @return false if the wall clock isn't set.
+    bool start(int64_t nowUs) { return m_window.start(nowUs); }
+
+    /// @brief Process a received datagram.
+    /// @param in received datagram.
+    /// @param len length of the datagram.
+    /// @param nowUs current wall clock time in microseconds since the Unix epoch (UTC).
+    /// @param ack output buffer for the acknowledgement, at least `kIrUdpAckLen` bytes.
+    /// @param ackSize size of the output buffer.
+    /// @param result optional processing result.
+    /// @return length of the acknowledgement to send back, 0 if no reply.
+    size_t handle(const uint8_t *in, size_t len, int64_t nowUs, uint8_t *ack, size_t ackSize,
+                  IrUdpResult *result = nullptr) {
+        IrUdpCommand cmd;
+        IrUdpResult  res = irUdpDecodeCommand(m_key, in, len, &cmd);
+        uint16_t     status = 0;
+
+        if (res == IrUdpResult::OK) {
+            res = m_window.check(cmd.clientId, cmd.seq, cmd.sentAt, nowUs);
+        }
+        if (res == IrUdpResult::OK) {
+            status = m_sendFn(cmd);
+            if (status == 0) {
+                status = 200;
+                m_stats.queued++;
+            } else {
+                res = IrUdpResult::REJECTED;
+                m_stats.rejected++;
+            }
+        } else if (res == IrUdpResult::DUPLICATE) {
+            // acknowledgement got lost and client retransmitted
+            status = 208;
+            m_stats.duplicates++;
+        } else if (res == IrUdpResult::STALE) {
+            // replayed datagram, or the client's clock isn't synchronized
+            status = 408;
+            m_stats.stale++;
+        } else if (res == IrUdpResult::CLOCK_NOT_SET || res == IrUdpResult::BUSY) {
+            status = 503;
+            m_stats.rejected++;
+        } else {
+            m_stats.invalid++;
+        }
+
+        if (result) {
+            *result = res;
+        }
+        if (status == 0 || !(cmd.flags & IR_UDP_FLAG_ACK)) {
+            return 0;
+        }
+        return irUdpEncodeAck(m_key, cmd.clientId, cmd.seq, status, ack, ackSize);
+    }
+
+    struct Stats {
+        uint32_t queued;
+        uint32_t rejected;
+        uint32_t duplicates;
+        uint32_t stale;
+        uint32_t invalid;
+    };
+
+    const Stats &stats() const { return m_stats; }
+
+ private:
+    IrUdpSendFunction   m_sendFn;
+    SipHashKey          m_key = irUdpKey("");
+    IrUdpReplayWindow<> m_window;
+    Stats               m_stats = {};
+};
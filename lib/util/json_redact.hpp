@@ -0,0 +1,242 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Streaming JSON redaction for logging: copies a JSON message and masks the values of sensitive keys on the fly.
+// Make sure this file also compiles natively and all functions are covered by unit tests.
+
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+
+/// Replacement of a masked value
+#define JSON_REDACTED_VALUE "\"****\""
+/// Marker appended to a truncated message by `JsonLogBuffer`
+#define JSON_TRUNCATED_MARKER "..."
+
+/// @brief Fixed size output for `redactJson`. The text is always zero-terminated and truncated if it doesn't fit.
+class JsonLogBuffer {
+ public:
+    /// @param buf output buffer, at least `sizeof(JSON_TRUNCATED_MARKER)` bytes.
+    JsonLogBuffer(char *buf, size_t size) : m_buf(buf), m_size(size) {
+        if (m_size) {
+            m_buf[0] = 0;
+        }
+    }
+
+    void write(const char *data, size_t len) {
+        if (m_truncated || m_size == 0) {
+            return;
+        }
+        if (len > m_size - 1 - m_len) {
+            // fill the buffer and end it with the marker to show that the message is incomplete
+            size_t marker = sizeof(JSON_TRUNCATED_MARKER) - 1;
+            size_t keep = m_size - 1 > marker ? m_size - 1 - marker : 0;
+            if (m_len < keep) {
+                memcpy(m_buf + m_len, data, keep - m_len);
+            }
+            m_len = m_size - 1;
+            memcpy(m_buf + keep, JSON_TRUNCATED_MARKER, m_len - keep);
+            m_buf[m_len] = 0;
+            m_truncated = true;
+            return;
+        }
+        memcpy(m_buf + m_len, data, len);
+        m_len += len;
+        m_buf[m_len] = 0;
+    }
+
+    const char *c_str() const { return m_buf; }
+    size_t      length() const { return m_len; }
+    bool        truncated() const { return m_truncated; }
+
+ private:
+    char  *m_buf;
+    size_t m_size;
+    size_t m_len = 0;
+    bool   m_truncated = false;
+};
+
+/// @brief Skip a JSON string starting at the opening quote.
+/// @return position after the closing quote, or `end` if the string isn't terminated.
+inline const char *skipJsonString(const char *pos, const char *end) {
+    for (pos++; pos < end; pos++) {
+        if (*pos == '\\') {
+            pos++;
+        } else if (*pos == '"') {
+            return pos + 1;
+        }
+    }
+    return end;
+}
+
+inline const char *skipJsonWhitespace(const char *pos, const char *end) {
+    while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r' || *pos == '\n')) {
+        pos++;
+    }
+    return pos;
+}
+
+/// @brief Skip a JSON value: string, number, literal, object or array.
+/// @return position after the value.
+inline const char *skipJsonValue(const char *pos, const char *end) {
+    if (pos >= end) {
+        return end;
+    }
+    if (*pos == '"') {
+        return skipJsonString(pos, end);
+    }
+    if (*pos == '{' || *pos == '[') {
+        int depth = 0;
+        while (pos < end) {
+            char c = *pos;
+            if (c == '"') {
+                pos = skipJsonString(pos, end);
+                continue;
+            }
+            if (c == '{' || c == '[') {
+                depth++;
+            } else if (c == '}' || c == ']') {
+                if (--depth == 0) {
+                    return pos + 1;
+                }
+            }
+            pos++;
+        }
+        return end;
+    }
+    // number or literal
+    while (pos < end && *pos != ',' && *pos != '}' && *pos != ']' && *pos != ' ' && *pos != '\t' && *pos != '\r' &&
+           *pos != '\n') {
+        pos++;
+    }
+    return pos;
+}
+
+inline int jsonHexDigit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/// @brief Compare the raw content of a JSON string with an ASCII text. Escape sequences are decoded like the API
+///        request parser does, e.g. `to\u006ben` equals `token`.
+/// @param start first character after the opening quote.
+/// @param end position of the closing quote.
+inline bool jsonStringEquals(const char *start, const char *end, const char *text) {
+    const char *pos = start;
+    while (pos < end) {
+        char c = *pos++;
+        if (c == '\\') {
+            if (pos >= end) {
+                return false;
+            }
+            c = *pos++;
+            switch (c) {
+                case '"':
+                case '\\':
+                case '/':
+                    break;
+                case 'b':
+                    c = '\b';
+                    break;
+                case 'f':
+                    c = '\f';
+                    break;
+                case 'n':
+                    c = '\n';
+                    break;
+                case 'r':
+                    c = '\r';
+                    break;
+                case 't':
+                    c = '\t';
+                    break;
+                case 'u': {
+                    if (end - pos < 4) {
+                        return false;
+                    }
+                    int codePoint = 0;
+                    for (int i = 0; i < 4; i++) {
+                        int digit = jsonHexDigit(pos[i]);
+                        if (digit < 0) {
+                            return false;
+                        }
+                        codePoint = (codePoint << 4) | digit;
+                    }
+                    pos += 4;
+                    if (codePoint == 0 || codePoint > 0x7F) {
+                        // can't match an ASCII text
+                        return false;
+                    }
+                    c = static_cast<char>(codePoint);
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        if (*text != c) {
+            return false;
+        }
+        text++;
+    }
+    return *text == 0;
+}
+
+/// @brief Copy a JSON message to `out` and replace the values of sensitive keys with `"****"`.
+///
+/// The message is processed in a single pass without parsing it into a document or allocating memory. Keys are
+/// matched at any nesting level and after decoding escape sequences, the whole value is masked even if it's an object
+/// or array. Invalid JSON is copied on a best effort basis.
+///
+/// @param json JSON message, doesn't need to be zero-terminated.
+/// @param len length of the message.
+/// @param keys names of the sensitive keys.
+/// @param keyCount number of keys.
+/// @param out output with a `write(const char *data, size_t len)` method.
+template <typename Writer>
+void redactJson(const char *json, size_t len, const char *const *keys, size_t keyCount, Writer *out) {
+    if (json == nullptr) {
+        return;
+    }
+    const char *end = json + len;
+    const char *pos = json;
+    // start of the text not yet written
+    const char *pending = json;
+    while (pos < end) {
+        if (*pos != '"') {
+            pos++;
+            continue;
+        }
+        const char *keyStart = pos + 1;
+        pos = skipJsonString(pos, end);
+        const char *keyEnd = pos - 1;
+        const char *next = skipJsonWhitespace(pos, end);
+        if (next >= end || *next != ':' || keyEnd < keyStart) {
+            // not an object key
+            continue;
+        }
+        bool sensitive = false;
+        for (size_t i = 0; i < keyCount && !sensitive; i++) {
+            sensitive = keys[i] && jsonStringEquals(keyStart, keyEnd, keys[i]);
+        }
+        pos = next + 1;
+        if (!sensitive) {
+            continue;
+        }
+        const char *value = skipJsonWhitespace(pos, end);
+        out->write(pending, value - pending);
+        out->write(JSON_REDACTED_VALUE, sizeof(JSON_REDACTED_VALUE) - 1);
+        pos = skipJsonValue(value, end);
+        pending = pos;
+    }
+    out->write(pending, end - pending);
+}
@@ -0,0 +1,338 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// MessagePack encoding of API requests: single pass decoder into the typed request struct, and message framing for
+// the serial transports.
+// Make sure this file also compiles natively and all functions are covered by unit tests.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "api_request.hpp"
+
+/// Start byte of a MessagePack message on the UART and Bluetooth transports, followed by the message length as 16 bit
+/// big endian number and the message. 0xC1 is never used in MessagePack and can't start a JSON message.
+#define MSGPACK_FRAME_MARKER 0xC1
+#define MSGPACK_FRAME_HEADER_SIZE 3
+#define MSGPACK_FRAME_MAX_LENGTH 0xFFFF
+
+/// @brief API message encoding.
+enum class ApiEncoding : uint8_t {
+    Json = 0,
+    MsgPack = 1,
+};
+
+/// @brief Get the encoding of an `encoding` field value: `json` or `msgpack`.
+/// @return false if the name is invalid or null.
+inline bool parseApiEncoding(const char *name, ApiEncoding *encoding) {
+    if (name == nullptr) {
+        return false;
+    }
+    if (strcmp(name, "json") == 0) {
+        *encoding = ApiEncoding::Json;
+        return true;
+    }
+    if (strcmp(name, "msgpack") == 0) {
+        *encoding = ApiEncoding::MsgPack;
+        return true;
+    }
+    return false;
+}
+
+inline const char *apiEncodingName(ApiEncoding encoding) {
+    return encoding == ApiEncoding::MsgPack ? "msgpack" : "json";
+}
+
+/// @brief Write the frame header of a MessagePack message for the serial transports.
+/// @param header buffer of `MSGPACK_FRAME_HEADER_SIZE` bytes.
+/// @return false if the message is too long.
+inline bool encodeMsgPackFrameHeader(size_t length, uint8_t *header) {
+    if (length > MSGPACK_FRAME_MAX_LENGTH) {
+        return false;
+    }
+    header[0] = MSGPACK_FRAME_MARKER;
+    header[1] = length >> 8;
+    header[2] = length & 0xFF;
+    return true;
+}
+
+/// @brief Read the frame header of a MessagePack message.
+/// @param data received data.
+/// @param available number of received bytes.
+/// @param length message length after the header.
+/// @return false if the data doesn't start with a complete frame header.
+inline bool decodeMsgPackFrameHeader(const uint8_t *data, size_t available, uint16_t *length) {
+    if (available < MSGPACK_FRAME_HEADER_SIZE || data[0] != MSGPACK_FRAME_MARKER) {
+        return false;
+    }
+    *length = data[1] << 8 | data[2];
+    return true;
+}
+
+/// @brief Read a big endian number of 1, 2, 4 or 8 bytes.
+inline uint64_t readMsgPackNumber(const uint8_t *data, uint8_t size) {
+    uint64_t value = 0;
+    for (uint8_t i = 0; i < size; i++) {
+        value = value << 8 | data[i];
+    }
+    return value;
+}
+
+/// @brief Sequential reader of the unsigned integer elements of a MessagePack array in a parsed request.
+class MsgPackUintReader {
+ public:
+    MsgPackUintReader() = default;
+    /// @param elements first element of an array validated by `parseApiRequestMsgPack`.
+    MsgPackUintReader(const uint8_t *elements, uint32_t count) : m_pos(elements), m_remaining(count), m_size(count) {}
+
+    /// @brief Number of array elements.
+    uint32_t size() const { return m_size; }
+
+    /// @brief Read the next element.
+    /// @return false if there are no more elements, or the element isn't an unsigned integer.
+    bool next(uint64_t *value) {
+        if (m_remaining == 0) {
+            return false;
+        }
+        uint8_t format = *m_pos;
+        if (format <= 0x7F) {
+            *value = format;
+            m_pos++;
+        } else if (format >= 0xCC && format <= 0xD3) {
+            // uint 8..64 and int 8..64
+            uint8_t  size = 1 << (format & 0x03);
+            uint64_t number = readMsgPackNumber(m_pos + 1, size);
+            if (format >= 0xD0 && (number >> (size * 8 - 1)) & 1) {
+                return false;  // negative
+            }
+            *value = number;
+            m_pos += 1 + size;
+        } else {
+            return false;
+        }
+        m_remaining--;
+        return true;
+    }
+
+ private:
+    const uint8_t *m_pos = nullptr;
+    uint32_t       m_remaining = 0;
+    uint32_t       m_size = 0;
+};
+
+/// @brief Get a reader for a field with an array value of a MessagePack request.
+/// @return false if the field is missing or not a MessagePack array.
+inline bool getMsgPackArray(const ApiRequest &request, ApiField field, MsgPackUintReader *reader) {
+    const ApiValue *value = request.value(field);
+    if (value == nullptr || value->type != ApiValueType::Array || value->str == nullptr) {
+        return false;
+    }
+    *reader = MsgPackUintReader(reinterpret_cast<const uint8_t *>(value->str), value->length);
+    return true;
+}
+
+/// @brief Check if the remaining data is long enough.
+inline ApiParseError checkMsgPackLength(size_t pos, size_t needed, size_t length) {
+    return needed <= length - pos ? ApiParseError::Ok : ApiParseError::IncompleteInput;
+}
+
+/// @brief Parse a MessagePack value. Map entries are only stored in `request` at nesting level 1.
+/// @param pos position of the value, set to the position after the value.
+/// @param depth nesting depth of the value.
+/// @param terminate zero-terminate a string value in place. The string is moved over its header.
+inline ApiParseError parseMsgPackValue(uint8_t *data, size_t length, size_t *pos, uint8_t depth, bool terminate,
+                                       ApiValue *value, ApiRequest *request) {
+    if (*pos >= length) {
+        return ApiParseError::IncompleteInput;
+    }
+    size_t  p = *pos;
+    uint8_t format = data[p];
+
+    // header size and length of strings, arrays and maps
+    uint8_t  header = 1;
+    uint32_t count = 0;
+    if (format <= 0x7F || format >= 0xE0) {
+        value->type = ApiValueType::Integer;
+        value->integer = static_cast<int8_t>(format);
+        *pos = p + 1;
+        return ApiParseError::Ok;
+    } else if (format <= 0x8F) {
+        value->type = ApiValueType::Object;
+        count = format & 0x0F;
+    } else if (format <= 0x9F) {
+        value->type = ApiValueType::Array;
+        count = format & 0x0F;
+    } else if (format <= 0xBF) {
+        value->type = ApiValueType::String;
+        count = format & 0x1F;
+    } else {
+        switch (format) {
+            case 0xC0:
+                value->type = ApiValueType::Null;
+                *pos = p + 1;
+                return ApiParseError::Ok;
+            case 0xC2:
+            case 0xC3:
+                value->type = ApiValueType::Bool;
+                value->boolean = format == 0xC3;
+                *pos = p + 1;
+                return ApiParseError::Ok;
+            case 0xC4:  // bin 8, 16, 32
+            case 0xC5:
+            case 0xC6:
+                header = 1 + (1 << (format - 0xC4));
+                value->type = ApiValueType::String;
+                break;
+            case 0xCA:  // float 32
+            case 0xCB: {
+                uint8_t size = format == 0xCA ? 4 : 8;
+                if (checkMsgPackLength(p + 1, size, length) != ApiParseError::Ok) {
+                    return ApiParseError::IncompleteInput;
+                }
+                uint64_t bits = readMsgPackNumber(data + p + 1, size);
+                if (size == 4) {
+                    uint32_t bits32 = bits;
+                    float    f;
+                    memcpy(&f, &bits32, sizeof(f));
+                    value->real = f;
+                } else {
+                    memcpy(&value->real, &bits, sizeof(value->real));
+                }
+                value->type = ApiValueType::Float;
+                *pos = p + 1 + size;
+                return ApiParseError::Ok;
+            }
+            case 0xCC:  // uint 8..64
+            case 0xCD:
+            case 0xCE:
+            case 0xCF:
+            case 0xD0:  // int 8..64
+            case 0xD1:
+            case 0xD2:
+            case 0xD3: {
+                uint8_t size = 1 << (format & 0x03);
+                if (checkMsgPackLength(p + 1, size, length) != ApiParseError::Ok) {
+                    return ApiParseError::IncompleteInput;
+                }
+                uint64_t number = readMsgPackNumber(data + p + 1, size);
+                if (format >= 0xD0) {
+                    // sign extension
+                    uint8_t shift = 64 - size * 8;
+                    value->integer = static_cast<int64_t>(number << shift) >> shift;
+                    value->type = ApiValueType::Integer;
+                } else if (number > static_cast<uint64_t>(INT64_MAX)) {
+                    value->real = static_cast<double>(number);
+                    value->type = ApiValueType::Float;
+                } else {
+                    value->integer = number;
+                    value->type = ApiValueType::Integer;
+                }
+                *pos = p + 1 + size;
+                return ApiParseError::Ok;
+            }
+            case 0xD9:  // str 8, 16, 32
+            case 0xDA:
+            case 0xDB:
+                header = 1 + (1 << (format - 0xD9));
+                value->type = ApiValueType::String;
+                break;
+            case 0xDC:  // array 16, 32
+            case 0xDD:
+                header = format == 0xDC ? 3 : 5;
+                value->type = ApiValueType::Array;
+                break;
+            case 0xDE:  // map 16, 32
+            case 0xDF:
+                header = format == 0xDE ? 3 : 5;
+                value->type = ApiValueType::Object;
+                break;
+            default:
+                // 0xC1 is never used, extension types are not supported
+                return ApiParseError::InvalidInput;
+        }
+        if (checkMsgPackLength(p, header, length) != ApiParseError::Ok) {
+            return ApiParseError::IncompleteInput;
+        }
+        count = readMsgPackNumber(data + p + 1, header - 1);
+    }
+
+    if (value->type == ApiValueType::String) {
+        if (checkMsgPackLength(p + header, count, length) != ApiParseError::Ok) {
+            return ApiParseError::IncompleteInput;
+        }
+        if (terminate) {
+            memmove(data + p, data + p + header, count);
+            data[p + count] = 0;
+            value->str = reinterpret_cast<const char *>(data + p);
+        } else {
+            value->str = reinterpret_cast<const char *>(data + p + header);
+        }
+        value->length = count;
+        *pos = p + header + count;
+        return ApiParseError::Ok;
+    }
+
+    // array or map: every element needs at least one byte
+    if (depth > API_REQUEST_NESTING_LIMIT) {
+        return ApiParseError::TooDeep;
+    }
+    p += header;
+    bool isMap = value->type == ApiValueType::Object;
+    if (checkMsgPackLength(p, isMap ? count * 2ULL : count, length) != ApiParseError::Ok) {
+        return ApiParseError::IncompleteInput;
+    }
+    value->str = isMap ? nullptr : reinterpret_cast<const char *>(data + p);
+    value->length = isMap ? 0 : count;
+    for (uint32_t i = 0; i < count; i++) {
+        ApiField field = ApiField::Count;
+        if (isMap) {
+            ApiValue      key;
+            ApiParseError err = parseMsgPackValue(data, length, &p, depth + 1, false, &key, nullptr);
+            if (err != ApiParseError::Ok) {
+                return err;
+            }
+            if (key.type != ApiValueType::String) {
+                return ApiParseError::InvalidInput;
+            }
+            if (depth == 1 && request) {
+                field = findApiField(key.str, key.length);
+            }
+        }
+        ApiValue      element;
+        ApiParseError err =
+            parseMsgPackValue(data, length, &p, depth + 1, field != ApiField::Count, &element, request);
+        if (err != ApiParseError::Ok) {
+            return err;
+        }
+        if (field != ApiField::Count) {
+            request->set(field, element);
+        }
+    }
+    *pos = p;
+    return ApiParseError::Ok;
+}
+
+/// @brief Parse a MessagePack API request in place and extract the known fields.
+///
+/// The request uses the same map keys and values as a JSON request. Strings and binary data can be used for string
+/// fields. String values of known fields are moved over their header and zero-terminated, so the buffer is modified
+/// and must outlive the request. Arrays of known fields can be read with `getMsgPackArray`. Unknown entries are
+/// validated and skipped. A root value other than a map is valid but has no fields. Map keys must be strings,
+/// extension types are invalid. Data after the root value is ignored.
+///
+/// @param data MessagePack request, modified while parsing.
+/// @param length request length.
+/// @param request parsed fields. Cleared first, and may be incomplete if an error is returned.
+inline ApiParseError parseApiRequestMsgPack(uint8_t *data, size_t length, ApiRequest *request) {
+    request->clear();
+    if (data == nullptr || length == 0) {
+        return ApiParseError::EmptyInput;
+    }
+    size_t   pos = 0;
+    ApiValue root;
+    bool     isMap = (data[0] >= 0x80 && data[0] <= 0x8F) || data[0] == 0xDE || data[0] == 0xDF;
+    return parseMsgPackValue(data, length, &pos, 1, false, &root, isMap ? request : nullptr);
+}
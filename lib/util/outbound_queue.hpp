@@ -0,0 +1,167 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Bounded outbound message queue of a client connection, with a slow consumer policy.
+// Make sure this file also compiles natively and all functions are covered by unit tests.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ring_buffer.hpp"
+
+/// Kind of an outbound message, see `OutboundQueue::push`.
+enum class OutboundKind : uint8_t {
+    /// Response to a client request: never dropped
+    Response,
+    /// Unsolicited event: dropped if the client doesn't keep up
+    Event,
+};
+
+enum class OutboundResult : uint8_t {
+    Queued,
+    /// An event was dropped because the client doesn't keep up
+    Dropped,
+    /// A response doesn't fit into the queue: the client should be disconnected
+    Overflow,
+    /// The queue is closing after its pending messages, see `OutboundQueue::closeAfterDrain`: the message is discarded
+    Closing,
+};
+
+struct OutboundStats {
+    uint32_t sent = 0;
+    uint32_t droppedEvents = 0;
+    /// Highest number of queued bytes, including the message headers
+    size_t   peakBytes = 0;
+};
+
+/// @brief Queue of outbound messages with a capacity of `N` bytes. Not synchronized.
+///
+/// Messages are queued with `push` and sent with `front` and `pop` whenever the connection can take more data, so a
+/// slow client never blocks the sender. Events may only use half of the queue, the other half is reserved for
+/// responses.
+template <size_t N>
+class OutboundQueue {
+ public:
+    /// Queued bytes per message in addition to the message data: flags and 16 bit length
+    static constexpr size_t HEADER_SIZE = 3;
+    /// Longest message which fits into the empty queue. Longer messages are always dropped or overflow the queue.
+    static constexpr size_t MAX_MESSAGE_SIZE = N - HEADER_SIZE;
+    /// Maximum queued bytes before events are dropped. An event is always queued if the queue is empty.
+    static constexpr size_t EVENT_LIMIT = N / 2;
+
+    static_assert(N > HEADER_SIZE && N <= 0xFFFF, "invalid queue size");
+
+    /// @brief Queue a message.
+    /// @param kind responses are kept as long as they fit into the queue, events are dropped above `EVENT_LIMIT`.
+    /// @param binary binary or text message.
+    /// @param nowMs current time in milliseconds, see `stalledMs`.
+    OutboundResult push(OutboundKind kind, bool binary, const char *data, size_t length, uint32_t nowMs) {
+        if (m_closing) {
+            return OutboundResult::Closing;
+        }
+        size_t required = HEADER_SIZE + length;
+        bool   fits = required <= m_buffer.available();
+        if (kind == OutboundKind::Event && (!fits || (!empty() && m_buffer.size() + required > EVENT_LIMIT))) {
+            m_stats.droppedEvents++;
+            m_droppedSinceSent++;
+            return OutboundResult::Dropped;
+        }
+        if (!fits) {
+            return OutboundResult::Overflow;
+        }
+
+        if (empty()) {
+            m_progressMs = nowMs;
+        }
+        char header[HEADER_SIZE] = {static_cast<char>(binary ? FLAG_BINARY : 0), static_cast<char>(length >> 8),
+                                    static_cast<char>(length & 0xFF)};
+        m_buffer.write(header, HEADER_SIZE);
+        m_buffer.write(data, length);
+        m_messages++;
+        if (m_buffer.size() > m_stats.peakBytes) {
+            m_stats.peakBytes = m_buffer.size();
+        }
+        return OutboundResult::Queued;
+    }
+
+    /// @brief Get the next message without removing it.
+    /// @param scratch buffer of at least `N` bytes, only used if the message wraps around the end of the queue.
+    /// @param data returns the message data, valid until the queue is modified.
+    /// @return false if the queue is empty.
+    bool front(char *scratch, const char **data, size_t *length, bool *binary) const {
+        if (empty()) {
+            return false;
+        }
+        uint8_t header[HEADER_SIZE];
+        m_buffer.peek(reinterpret_cast<char *>(header), HEADER_SIZE);
+        *binary = header[0] & FLAG_BINARY;
+        *length = (header[1] << 8) | header[2];
+
+        size_t      contiguous;
+        const char *ptr = m_buffer.readPtr(&contiguous);
+        if (contiguous >= HEADER_SIZE + *length) {
+            *data = ptr + HEADER_SIZE;
+        } else {
+            m_buffer.peek(scratch, HEADER_SIZE + *length);
+            *data = scratch + HEADER_SIZE;
+        }
+        return true;
+    }
+
+    /// @brief Remove the next message after it has been sent.
+    void pop(uint32_t nowMs) {
+        if (empty()) {
+            return;
+        }
+        uint8_t header[HEADER_SIZE];
+        m_buffer.read(reinterpret_cast<char *>(header), HEADER_SIZE);
+        m_buffer.read(nullptr, (header[1] << 8) | header[2]);
+        m_messages--;
+        m_stats.sent++;
+        m_droppedSinceSent = 0;
+        m_progressMs = nowMs;
+    }
+
+    bool   empty() const { return m_messages == 0; }
+    /// Number of queued messages.
+    size_t messages() const { return m_messages; }
+    /// Number of queued bytes, including the message headers.
+    size_t bytes() const { return m_buffer.size(); }
+
+    /// @brief Time since the last sent message while messages are pending, e.g. to disconnect a stuck client.
+    /// @return 0 if the queue is empty.
+    uint32_t stalledMs(uint32_t nowMs) const { return empty() ? 0 : nowMs - m_progressMs; }
+
+    /// @brief Number of dropped events since the last sent message.
+    uint32_t droppedSinceSent() const { return m_droppedSinceSent; }
+
+    const OutboundStats &stats() const { return m_stats; }
+
+    /// @brief Stop queuing messages and close the connection once the pending messages are sent, e.g. after the last
+    ///        response to a client. Messages pushed afterwards are discarded.
+    void closeAfterDrain() { m_closing = true; }
+    bool closing() const { return m_closing; }
+    /// @brief Check if a closing queue sent all pending messages: the connection can be closed now.
+    bool drained() const { return m_closing && empty(); }
+
+    /// @brief Discard all messages and reset the statistics, e.g. for a new connection.
+    void reset() {
+        m_buffer.clear();
+        m_messages = 0;
+        m_droppedSinceSent = 0;
+        m_closing = false;
+        m_stats = OutboundStats();
+    }
+
+ private:
+    static constexpr uint8_t FLAG_BINARY = 0x01;
+
+    RingBuffer<N> m_buffer;
+    size_t        m_messages = 0;
+    uint32_t      m_progressMs = 0;
+    uint32_t      m_droppedSinceSent = 0;
+    bool          m_closing = false;
+    OutboundStats m_stats;
+};
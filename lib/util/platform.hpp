@@ -0,0 +1,180 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Thin portability layer for network services: tasks, semaphores, time, IP lookup and logging.
+// Uses FreeRTOS and the Arduino network interfaces on the device, and POSIX threads and interfaces on the host to run
+// the services natively.
+// Make sure this file also compiles natively and all functions are covered by unit tests.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#if defined(ESP_PLATFORM)
+// Arduino.h must be included before lwIP: https://github.com/espressif/arduino-esp32/issues/6760
+#include <Arduino.h>
+#include <ETH.h>
+#include <WiFi.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include "log.h"
+#else
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <netinet/in.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+/// Task function, the parameter is passed on from `platformCreateTask`.
+typedef void (*PlatformTaskFunction)(void *param);
+
+#if defined(ESP_PLATFORM)
+
+#define PLATFORM_LOGF(level, tag, ...) Log.logf(UCLog::level, tag, __VA_ARGS__)
+
+/// @brief Start a task.
+/// @param core CPU core on the device, ignored on the host.
+/// @return false if the task couldn't be created.
+inline bool platformCreateTask(PlatformTaskFunction function, const char *name, uint32_t stackSize, void *param,
+                               uint8_t priority, int core) {
+    return xTaskCreatePinnedToCore(function, name, stackSize, param, priority, NULL, core) == pdPASS;
+}
+
+/// @brief End the calling task. Must be called at the end of a task function.
+inline void platformExitTask() {
+    vTaskDelete(NULL);
+}
+
+inline void platformDelayMs(uint32_t ms) {
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+/// Monotonic time in microseconds.
+inline int64_t platformMicros() {
+    return esp_timer_get_time();
+}
+
+/// @brief Get the IPv4 address of the active network interface: Ethernet if connected, otherwise WiFi.
+/// @param buf output buffer for the dotted IP address, at least 16 bytes.
+/// @return false if there's no IP address.
+inline bool platformLocalIp(char *buf, size_t size) {
+    IPAddress noIP;
+    IPAddress ip = ETH.localIP();
+    if (ip == noIP) {
+        ip = WiFi.localIP();
+        if (ip == noIP) {
+            return false;
+        }
+    }
+    snprintf(buf, size, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+    return true;
+}
+
+/// @brief Binary semaphore, e.g. to wait for a task to be started or stopped.
+class PlatformSemaphore {
+ public:
+    PlatformSemaphore() : m_handle(xSemaphoreCreateBinary()) {}
+    ~PlatformSemaphore() { vSemaphoreDelete(m_handle); }
+
+    PlatformSemaphore(const PlatformSemaphore &) = delete;  // no copying
+    PlatformSemaphore &operator=(const PlatformSemaphore &) = delete;
+
+    void give() { xSemaphoreGive(m_handle); }
+    /// @return false if timed out.
+    bool take(uint32_t timeoutMs) { return xSemaphoreTake(m_handle, pdMS_TO_TICKS(timeoutMs)) == pdTRUE; }
+
+ private:
+    SemaphoreHandle_t m_handle;
+};
+
+#else  // host
+
+// Logging is disabled on the host unless PLATFORM_VERBOSE is defined. The arguments are still format checked.
+#ifdef PLATFORM_VERBOSE
+#define PLATFORM_VERBOSE_LOG true
+#else
+#define PLATFORM_VERBOSE_LOG false
+#endif
+#define PLATFORM_LOGF(level, tag, ...)        \
+    do {                                      \
+        if (PLATFORM_VERBOSE_LOG) {           \
+            printf("[" #level "] %s: ", tag); \
+            printf(__VA_ARGS__);              \
+            printf("\n");                     \
+        }                                     \
+    } while (0)
+
+inline bool platformCreateTask(PlatformTaskFunction function, const char * /* name */, uint32_t /* stackSize */,
+                               void *param, uint8_t /* priority */, int /* core */) {
+    std::thread(function, param).detach();
+    return true;
+}
+
+inline void platformExitTask() {}
+
+inline void platformDelayMs(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+inline int64_t platformMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/// Returns the address of the first IPv4 interface which is up and isn't a loopback interface.
+inline bool platformLocalIp(char *buf, size_t size) {
+    struct ifaddrs *interfaces;
+    if (getifaddrs(&interfaces) != 0) {
+        return false;
+    }
+    bool found = false;
+    for (struct ifaddrs *ifa = interfaces; ifa && !found; ifa = ifa->ifa_next) {
+        if (ifa->ifa_addr == nullptr || ifa->ifa_addr->sa_family != AF_INET || !(ifa->ifa_flags & IFF_UP) ||
+            (ifa->ifa_flags & IFF_LOOPBACK)) {
+            continue;
+        }
+        const struct sockaddr_in *addr = reinterpret_cast<const struct sockaddr_in *>(ifa->ifa_addr);
+        found = inet_ntop(AF_INET, &addr->sin_addr, buf, size) != nullptr;
+    }
+    freeifaddrs(interfaces);
+    return found;
+}
+
+class PlatformSemaphore {
+ public:
+    PlatformSemaphore() = default;
+
+    PlatformSemaphore(const PlatformSemaphore &) = delete;  // no copying
+    PlatformSemaphore &operator=(const PlatformSemaphore &) = delete;
+
+    void give() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_given = true;
+        m_cv.notify_one();
+    }
+    bool take(uint32_t timeoutMs) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_cv.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this]() { return m_given; })) {
+            return false;
+        }
+        m_given = false;
+        return true;
+    }
+
+ private:
+    std::mutex              m_mutex;
+    std::condition_variable m_cv;
+    bool                    m_given = false;
+};
+
+#endif
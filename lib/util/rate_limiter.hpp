@@ -0,0 +1,215 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Token bucket request rate limiting for network clients.
+// Make sure this file also compiles natively and all functions are covered by unit tests.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+
+/// Maximum number of tracked client IP addresses
+#define RATE_LIMIT_MAX_SOURCES 16
+
+/// Default per connection limit: burst size and sustained requests per second
+#define RATE_LIMIT_DEF_BURST 20
+#define RATE_LIMIT_DEF_RATE 10
+/// Default per client IP limit over all connections: burst size and sustained requests per second
+#define RATE_LIMIT_DEF_IP_BURST 40
+#define RATE_LIMIT_DEF_IP_RATE 20
+
+/// One token in micro tokens: allows refilling with integer math for every elapsed microsecond
+#define RATE_LIMIT_TOKEN 1000000LL
+
+/// @brief Rate limit configuration.
+struct RateLimit {
+    /// Maximum number of requests in a burst, i.e. the bucket size.
+    uint16_t burst;
+    /// Sustained number of requests per second, i.e. the refill rate. 0 disables the limit.
+    uint16_t rate;
+
+    bool isEnabled() const { return rate > 0 && burst > 0; }
+};
+
+/// @brief Token bucket state of a single client. A new bucket is full.
+class TokenBucket {
+ public:
+    /// @brief Reset to a full bucket, e.g. for a new connection.
+    void reset() { m_lastUs = -1; }
+
+    /// @brief Refill the bucket for the elapsed time since the last call.
+    /// @param limit bucket size and refill rate.
+    /// @param nowUs current monotonic time in microseconds.
+    void refill(const RateLimit &limit, int64_t nowUs) {
+        int64_t capacity = limit.burst * RATE_LIMIT_TOKEN;
+        if (m_lastUs < 0 || nowUs < m_lastUs) {
+            m_tokens = capacity;
+        } else {
+            // one token per second and request: elapsed microseconds * rate = micro tokens
+            int64_t elapsed = nowUs - m_lastUs;
+            if (elapsed > capacity) {
+                // avoid overflow after a long idle time, the bucket is full anyway
+                m_tokens = capacity;
+            } else {
+                m_tokens += elapsed * limit.rate;
+                if (m_tokens > capacity) {
+                    m_tokens = capacity;
+                }
+            }
+        }
+        m_lastUs = nowUs;
+    }
+
+    /// @brief Check if a request is allowed. Call `refill` before.
+    bool hasToken() const { return m_tokens >= RATE_LIMIT_TOKEN; }
+
+    /// @brief Consume a token. Call `refill` and `hasToken` before.
+    void take() { m_tokens -= RATE_LIMIT_TOKEN; }
+
+    /// @brief Refill the bucket and take a token if available.
+    /// @return true if the request is allowed.
+    bool tryTake(const RateLimit &limit, int64_t nowUs) {
+        refill(limit, nowUs);
+        if (!hasToken()) {
+            return false;
+        }
+        take();
+        return true;
+    }
+
+    /// Time of the last refill, -1 if unused
+    int64_t lastUs() const { return m_lastUs; }
+
+ private:
+    /// Available micro tokens
+    int64_t m_tokens = 0;
+    int64_t m_lastUs = -1;
+};
+
+/// @brief Throttling counters.
+struct RateLimitStats {
+    /// Allowed requests
+    uint32_t allowed;
+    /// Requests rejected by the per connection limit
+    uint32_t throttledConnection;
+    /// Requests rejected by the per client IP limit
+    uint32_t throttledIp;
+};
+
+/// @brief Request rate limiter for connection oriented network clients.
+///
+/// Every request has to pass the token bucket of its connection and the token bucket of its client IP address, which
+/// is shared by all connections from that address, e.g. GlobalCache and WebSocket connections. A request only takes a
+/// token if both buckets allow it.
+///
+/// The connection buckets are owned by the caller, the IP buckets by the limiter. If all `MAX_SOURCES` IP slots are
+/// used, the slot idle for the longest time is taken over.
+///
+/// Thread safe: a single instance can be shared between multiple server tasks.
+template <size_t MAX_SOURCES>
+class RateLimiter {
+ public:
+    RateLimiter() {
+        m_connectionLimit = {RATE_LIMIT_DEF_BURST, RATE_LIMIT_DEF_RATE};
+        m_ipLimit = {RATE_LIMIT_DEF_IP_BURST, RATE_LIMIT_DEF_IP_RATE};
+        m_stats = {0, 0, 0};
+        for (size_t i = 0; i < MAX_SOURCES; i++) {
+            m_sources[i].ip = 0;
+        }
+    }
+
+    void setConnectionLimit(RateLimit limit) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_connectionLimit = limit;
+    }
+    void setIpLimit(RateLimit limit) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_ipLimit = limit;
+    }
+    RateLimit connectionLimit() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_connectionLimit;
+    }
+    RateLimit ipLimit() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_ipLimit;
+    }
+
+    /// @brief Check if a request is allowed and take a token from the connection and IP bucket.
+    ///
+    /// This is meant to be called for every received request message, before any parsing.
+    /// @param connection token bucket of the client connection. Reset it for a new connection.
+    /// @param ip client IPv4 address.
+    /// @param nowUs current monotonic time in microseconds.
+    /// @return false if the request exceeds one of the limits and must be rejected.
+    bool allow(TokenBucket *connection, uint32_t ip, int64_t nowUs) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (m_connectionLimit.isEnabled()) {
+            connection->refill(m_connectionLimit, nowUs);
+            if (!connection->hasToken()) {
+                m_stats.throttledConnection++;
+                return false;
+            }
+        }
+        if (m_ipLimit.isEnabled()) {
+            TokenBucket *source = findSource(ip);
+            source->refill(m_ipLimit, nowUs);
+            if (!source->hasToken()) {
+                m_stats.throttledIp++;
+                return false;
+            }
+            source->take();
+        }
+        if (m_connectionLimit.isEnabled()) {
+            connection->take();
+        }
+
+        m_stats.allowed++;
+        return true;
+    }
+
+    RateLimitStats stats() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+    void resetStats() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats = {0, 0, 0};
+    }
+
+ private:
+    struct Source {
+        uint32_t    ip;
+        TokenBucket bucket;
+    };
+
+    /// @brief Get the bucket of an IP address. A new or taken over bucket is full.
+    TokenBucket *findSource(uint32_t ip) {
+        Source *oldest = &m_sources[0];
+        for (size_t i = 0; i < MAX_SOURCES; i++) {
+            Source &source = m_sources[i];
+            if (source.bucket.lastUs() >= 0 && source.ip == ip) {
+                return &source.bucket;
+            }
+            if (source.bucket.lastUs() < oldest->bucket.lastUs()) {
+                oldest = &source;
+            }
+        }
+        oldest->ip = ip;
+        oldest->bucket.reset();
+        return &oldest->bucket;
+    }
+
+    std::mutex     m_mutex;
+    RateLimit      m_connectionLimit;
+    RateLimit      m_ipLimit;
+    RateLimitStats m_stats;
+    Source         m_sources[MAX_SOURCES];
+};
+
+typedef RateLimiter<RATE_LIMIT_MAX_SOURCES> ClientRateLimiter;
@@ -0,0 +1,175 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Non-blocking framing of API requests received on a serial transport like the UART.
+// Make sure this file also compiles natively and all functions are covered by unit tests.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "msgpack.hpp"
+#include "ring_buffer.hpp"
+
+/// @brief Incremental framer of API requests received in arbitrary chunks. Not synchronized.
+///
+/// A JSON request is terminated by a newline, a MessagePack request starts with a frame header, see
+/// `MSGPACK_FRAME_MARKER`. Received data is appended with `writePtr` and `commit`, or `write`, and complete requests
+/// are taken with `next`. Requests which don't fit into the buffer are discarded up to the end of the line or frame.
+template <size_t N>
+class RequestFramer {
+    static_assert(N > MSGPACK_FRAME_HEADER_SIZE, "buffer too small");
+
+ public:
+    /// @brief Get the contiguous free space for received data. See `RingBuffer::writePtr`.
+    char *writePtr(size_t *len) { return m_buffer.writePtr(len); }
+    /// @brief Append received data written to the pointer returned by `writePtr`.
+    void commit(size_t len) { m_buffer.commit(len); }
+
+    /// @brief Append received data.
+    /// @return number of appended bytes, less than `len` if the buffer is full. Call `next` to make space.
+    size_t write(const char *data, size_t len) { return m_buffer.write(data, len); }
+
+    /// @brief Read the available data of a stream without blocking, and handle all complete requests.
+    /// @param stream Arduino `Stream` like object with `available()` and `readBytes(char*, size_t)`. Only the
+    ///        available number of bytes is read, so `readBytes` returns without waiting for the stream timeout.
+    /// @param request request buffer, see `next`.
+    /// @param size size of the request buffer.
+    /// @param handler called for every complete request with `(char *request, size_t length, ApiEncoding encoding)`.
+    template <typename S, typename H>
+    void receive(S *stream, char *request, size_t size, H handler) {
+        while (true) {
+            size_t space;
+            char  *dst = writePtr(&space);
+            int    available = stream->available();
+            size_t count = 0;
+            if (space && available > 0) {
+                count = stream->readBytes(dst, space < static_cast<size_t>(available) ? space : available);
+                commit(count);
+            }
+
+            ApiEncoding encoding;
+            size_t      length;
+            while ((length = next(request, size, &encoding)) > 0) {
+                handler(request, length, encoding);
+            }
+
+            // continue if the buffer was full, `next` made space again
+            if (count == 0 && space > 0) {
+                break;
+            }
+        }
+    }
+
+    /// @brief Take the next complete request.
+    ///
+    /// Must be called until it returns 0 after appending data, otherwise a full buffer can't receive data anymore.
+    /// @param request request buffer. A JSON request is zero-terminated, without the line ending.
+    /// @param size size of the request buffer.
+    /// @param encoding encoding of the request.
+    /// @return request length, 0 if there's no complete request.
+    size_t next(char *request, size_t size, ApiEncoding *encoding) {
+        while (!m_buffer.empty()) {
+            if (m_skip) {
+                m_skip -= m_buffer.read(nullptr, m_skip);
+                continue;
+            }
+            if (m_skipLine) {
+                int end = m_buffer.indexOf('\n');
+                m_buffer.read(nullptr, end < 0 ? m_buffer.size() : end + 1);
+                m_skipLine = end < 0;
+                continue;
+            }
+
+            char first;
+            m_buffer.peek(&first, 1);
+            int length;
+            if (static_cast<uint8_t>(first) == MSGPACK_FRAME_MARKER) {
+                length = nextMsgPack(request, size);
+                *encoding = ApiEncoding::MsgPack;
+            } else {
+                length = nextJson(request, size);
+                *encoding = ApiEncoding::Json;
+            }
+            if (length > 0) {
+                return length;
+            }
+            if (length < 0) {
+                // incomplete request
+                break;
+            }
+        }
+        return 0;
+    }
+
+    /// @brief Number of discarded requests exceeding the buffer size.
+    uint32_t discarded() const { return m_discarded; }
+
+    /// @brief Discard all received data, e.g. after the transport reconnected.
+    void clear() {
+        m_buffer.clear();
+        m_skip = 0;
+        m_skipLine = false;
+    }
+
+ private:
+    // Returns the request length, 0 if data was discarded, or -1 if the request is incomplete.
+    int nextMsgPack(char *request, size_t size) {
+        uint8_t  header[MSGPACK_FRAME_HEADER_SIZE];
+        uint16_t length;
+        if (m_buffer.peek(reinterpret_cast<char *>(header), sizeof(header)) < sizeof(header)) {
+            return -1;
+        }
+        if (!decodeMsgPackFrameHeader(header, sizeof(header), &length)) {
+            m_buffer.read(nullptr, 1);
+            return 0;
+        }
+        if (length > size || length > N - MSGPACK_FRAME_HEADER_SIZE) {
+            // skip the frame to stay in sync with the next request
+            m_buffer.read(nullptr, sizeof(header));
+            m_skip = length;
+            m_discarded++;
+            return 0;
+        }
+        if (m_buffer.size() < sizeof(header) + length) {
+            return -1;
+        }
+        m_buffer.read(nullptr, sizeof(header));
+        return static_cast<int>(m_buffer.read(request, length));
+    }
+
+    // Returns the request length, 0 if data was discarded or the line is empty, or -1 if the request is incomplete.
+    int nextJson(char *request, size_t size) {
+        int end = m_buffer.indexOf('\n');
+        if (end < 0) {
+            if (m_buffer.full()) {
+                m_buffer.clear();
+                m_skipLine = true;
+                m_discarded++;
+                return 0;
+            }
+            return -1;
+        }
+        size_t length = static_cast<size_t>(end);
+        if (length >= size) {
+            m_buffer.read(nullptr, length + 1);
+            m_discarded++;
+            return 0;
+        }
+        m_buffer.read(request, length);
+        m_buffer.read(nullptr, 1);
+        if (length && request[length - 1] == '\r') {
+            length--;
+        }
+        request[length] = 0;
+        return static_cast<int>(length);
+    }
+
+    RingBuffer<N> m_buffer;
+    // remaining bytes of a discarded MessagePack request
+    size_t        m_skip = 0;
+    // discard data up to the next newline of a discarded JSON request
+    bool          m_skipLine = false;
+    uint32_t      m_discarded = 0;
+};
@@ -0,0 +1,130 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Fixed size byte ring buffer, e.g. for carrying over partial messages between socket reads.
+// Make sure this file also compiles natively and all functions are covered by unit tests.
+
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+
+/// @brief Byte ring buffer with a fixed capacity of `N` bytes. Not synchronized.
+///
+/// Data can be written directly into the buffer with `writePtr` and `commit`, e.g. with `recv()`, without an
+/// intermediate copy.
+template <size_t N>
+class RingBuffer {
+ public:
+    /// Number of stored bytes.
+    size_t size() const { return m_size; }
+    /// Number of free bytes.
+    size_t available() const { return N - m_size; }
+    bool   empty() const { return m_size == 0; }
+    bool   full() const { return m_size == N; }
+    static constexpr size_t capacity() { return N; }
+
+    void clear() {
+        m_head = 0;
+        m_size = 0;
+    }
+
+    /// @brief Get the contiguous free space at the end of the buffer.
+    /// @param len returns the number of bytes which can be written to the returned pointer. 0 if the buffer is full.
+    /// @return write position. Call `commit` after writing.
+    char *writePtr(size_t *len) {
+        size_t tail = (m_head + m_size) % N;
+        if (m_size == N) {
+            *len = 0;
+        } else if (tail >= m_head) {
+            *len = N - tail;
+        } else {
+            *len = m_head - tail;
+        }
+        return m_buf + tail;
+    }
+
+    /// @brief Get the contiguous stored data at the start of the buffer.
+    /// @param len returns the number of bytes which can be read from the returned pointer. 0 if the buffer is empty.
+    /// @return read position. Call `read(nullptr, n)` to remove the processed data.
+    const char *readPtr(size_t *len) const {
+        size_t first = N - m_head;
+        *len = m_size < first ? m_size : first;
+        return m_buf + m_head;
+    }
+
+    /// @brief Append bytes written to the pointer returned by `writePtr`.
+    void commit(size_t len) {
+        if (len > available()) {
+            len = available();
+        }
+        m_size += len;
+    }
+
+    /// @brief Append data.
+    /// @return number of appended bytes, less than `len` if the buffer is full.
+    size_t write(const char *data, size_t len) {
+        size_t written = 0;
+        while (written < len) {
+            size_t space;
+            char  *dst = writePtr(&space);
+            if (space == 0) {
+                break;
+            }
+            if (space > len - written) {
+                space = len - written;
+            }
+            memcpy(dst, data + written, space);
+            commit(space);
+            written += space;
+        }
+        return written;
+    }
+
+    /// @brief Find the first occurrence of a byte.
+    /// @return offset from the start of the stored data, -1 if not found.
+    int indexOf(char c) const {
+        for (size_t i = 0; i < m_size; i++) {
+            if (m_buf[(m_head + i) % N] == c) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    /// @brief Copy data from the start of the buffer without removing it.
+    /// @return number of copied bytes.
+    size_t peek(char *dst, size_t len) const {
+        if (len > m_size) {
+            len = m_size;
+        }
+        size_t first = N - m_head;
+        if (first > len) {
+            first = len;
+        }
+        memcpy(dst, m_buf + m_head, first);
+        memcpy(dst + first, m_buf, len - first);
+        return len;
+    }
+
+    /// @brief Remove data from the start of the buffer.
+    /// @param dst destination, nullptr to discard the data.
+    /// @param len number of bytes to remove.
+    /// @return number of removed bytes.
+    size_t read(char *dst, size_t len) {
+        if (dst) {
+            len = peek(dst, len);
+        } else if (len > m_size) {
+            len = m_size;
+        }
+        m_size -= len;
+        // start over at the beginning to maximize the contiguous space for the next write
+        m_head = m_size ? (m_head + len) % N : 0;
+        return len;
+    }
+
+ private:
+    char   m_buf[N];
+    size_t m_head = 0;
+    size_t m_size = 0;
+};
@@ -0,0 +1,99 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// SipHash-2-4 keyed hash function, used as message authentication code for small network datagrams.
+// Reference: https://www.aumasson.jp/siphash/siphash.pdf
+// Make sure this file also compiles natively and all functions are covered by unit tests.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// 128 bit SipHash key
+struct SipHashKey {
+    uint64_t k0;
+    uint64_t k1;
+};
+
+inline uint64_t sipRotl(uint64_t x, int b) {
+    return (x << b) | (x >> (64 - b));
+}
+
+inline uint64_t sipLoad64(const uint8_t *p) {
+    return static_cast<uint64_t>(p[0]) | (static_cast<uint64_t>(p[1]) << 8) | (static_cast<uint64_t>(p[2]) << 16) |
+           (static_cast<uint64_t>(p[3]) << 24) | (static_cast<uint64_t>(p[4]) << 32) |
+           (static_cast<uint64_t>(p[5]) << 40) | (static_cast<uint64_t>(p[6]) << 48) |
+           (static_cast<uint64_t>(p[7]) << 56);
+}
+
+inline void sipRound(uint64_t *v) {
+    v[0] += v[1];
+    v[1] = sipRotl(v[1], 13);
+    v[1] ^= v[0];
+    v[0] = sipRotl(v[0], 32);
+    v[2] += v[3];
+    v[3] = sipRotl(v[3], 16);
+    v[3] ^= v[2];
+    v[0] += v[3];
+    v[3] = sipRotl(v[3], 21);
+    v[3] ^= v[0];
+    v[2] += v[1];
+    v[1] = sipRotl(v[1], 17);
+    v[1] ^= v[2];
+    v[2] = sipRotl(v[2], 32);
+}
+
+/// @brief Calculate SipHash-2-4 of the given data.
+/// @param key 128 bit key.
+/// @param data input data.
+/// @param len length of input data.
+/// @return 64 bit hash value.
+inline uint64_t sipHash24(const SipHashKey &key, const uint8_t *data, size_t len) {
+    uint64_t v[4] = {key.k0 ^ 0x736f6d6570736575ULL, key.k1 ^ 0x646f72616e646f6dULL, key.k0 ^ 0x6c7967656e657261ULL,
+                     key.k1 ^ 0x7465646279746573ULL};
+
+    const uint8_t *end = data + len - (len % 8);
+    for (const uint8_t *p = data; p != end; p += 8) {
+        uint64_t m = sipLoad64(p);
+        v[3] ^= m;
+        sipRound(v);
+        sipRound(v);
+        v[0] ^= m;
+    }
+
+    uint64_t b = static_cast<uint64_t>(len) << 56;
+    for (size_t i = len & 7; i > 0; i--) {
+        b |= static_cast<uint64_t>(end[i - 1]) << (8 * (i - 1));
+    }
+
+    v[3] ^= b;
+    sipRound(v);
+    sipRound(v);
+    v[0] ^= b;
+
+    v[2] ^= 0xff;
+    sipRound(v);
+    sipRound(v);
+    sipRound(v);
+    sipRound(v);
+
+    return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
+
+/// @brief Derive a SipHash key from a shared secret, e.g. a configured token or group key.
+/// @param secret zero terminated secret string.
+/// @param context domain separation value, different for each protocol using the secret.
+inline SipHashKey sipDeriveKey(const char *secret, uint64_t context) {
+    SipHashKey key = {context, ~context};
+    size_t     len = 0;
+    while (secret && secret[len]) {
+        len++;
+    }
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(secret);
+    SipHashKey     derived;
+    derived.k0 = sipHash24(key, data, len);
+    key.k0 ^= derived.k0;
+    derived.k1 = sipHash24(key, data, len);
+    return derived;
+}
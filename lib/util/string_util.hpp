@@ -15,7 +15,7 @@
 /// @param orig character to replace
 /// @param rep replacement character
 /// @return number of characters replaced
-int replacechar(char *str, char orig, char rep) {
+inline int replacechar(char *str, char orig, char rep) {
     if (str == NULL) {
         return 0;
     }
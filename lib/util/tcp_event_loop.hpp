@@ -0,0 +1,505 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 Unfolded Circle ApS and/or its affiliates <hello@unfoldedcircle.com>
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Single threaded TCP server event loop multiplexing all client connections with `select()`.
+// Received data is split into delimiter terminated messages. Works with lwIP and POSIX sockets.
+// Make sure this file also compiles natively and all functions are covered by unit tests.
+
+#pragma once
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+#include "event_queue.hpp"
+#include "rate_limiter.hpp"
+#include "ring_buffer.hpp"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/// Receive buffer size of a client connection. Limits the maximum request message size.
+#define TCP_RX_BUFFER_SIZE 1024
+/// Output buffer size of a client connection for data the socket didn't accept yet. Fits a message of the maximum
+/// request size, e.g. a learned IR code a client could send back.
+#define TCP_TX_BUFFER_SIZE TCP_RX_BUFFER_SIZE
+/// Maximum number of messages posted from other tasks, which are not yet processed by the event loop.
+#define TCP_POST_QUEUE_SIZE 16
+/// Maximum size of a posted message.
+#define TCP_POST_MESSAGE_SIZE 32
+
+/// Fixed state of a client connection.
+struct TcpConnection {
+    /// Client socket, -1 if the connection slot is unused
+    int      fd;
+    /// Unique connection identifier. Other than the socket, it's never reused for a new connection.
+    uint32_t id;
+    /// Client IPv4 address
+    char     addr[16];
+    /// Client IPv4 address in network byte order
+    uint32_t ip;
+    /// Request rate limit of the connection, reset for a new connection
+    TokenBucket rateLimit;
+    /// Time of the last received data or the accepted connection in milliseconds, see `TcpEventLoop::nowMs`
+    int64_t     lastActivityMs;
+    /// Current message, including the delimiter. Always zero-terminated.
+    char     rx[TCP_RX_BUFFER_SIZE];
+    /// Received data not yet processed: partial message is carried over to the next read
+    RingBuffer<TCP_RX_BUFFER_SIZE - 1> pending;
+    /// Data to send, which didn't fit into the socket send buffer
+    RingBuffer<TCP_TX_BUFFER_SIZE> outgoing;
+};
+
+/// @brief Connection churn counters of a `TcpEventLoop`.
+struct TcpLoopStats {
+    /// Accepted client connections
+    uint32_t accepted;
+    /// Closed client connections, including evicted connections
+    uint32_t closed;
+    /// Connections closed to make room for a new client
+    uint32_t evicted;
+    /// New clients closed right after accepting because all connections were active
+    uint32_t rejected;
+    /// Maximum number of concurrent connections
+    uint32_t peakConnections;
+};
+
+/// @brief TCP server handling up to `MAX_CONNECTIONS` clients in a single task.
+///
+/// By default, if all connection slots are in use, the listen socket isn't polled anymore and new clients remain in the
+/// listen backlog until a slot is available. With `setEviction` enabled, new clients are always accepted: the least
+/// recently active connection is closed if it has been idle for the configured time, otherwise the new client is
+/// closed right away. This prevents dead connections, e.g. after a router reboot, from blocking reconnecting clients
+/// until the TCP keepalive detects them.
+///
+/// Clients may send multiple messages in one TCP segment, or split a message over multiple segments. Every complete
+/// message is handed over to the receive handler in order. A message exceeding the receive buffer size is handed over
+/// without delimiter.
+///
+/// Client sockets are non-blocking. Data which can't be sent immediately is buffered per connection and sent once the
+/// socket is writable again. A client not reading its data is disconnected when the output buffer overflows.
+///
+/// Other tasks can send data to a client with `post`, which never blocks. The message is queued and the event loop is
+/// woken up over a loopback UDP socket.
+template <size_t MAX_CONNECTIONS>
+class TcpEventLoop {
+ public:
+    /// Connection opened or closed
+    typedef std::function<void(TcpConnection &conn)> ConnectionHandler;
+    /// Message received and stored in `conn.rx`, zero-terminated. Return false to close the connection.
+    typedef std::function<bool(TcpConnection &conn, size_t len)> ReceiveHandler;
+
+    /// @param delimiter message terminator.
+    explicit TcpEventLoop(char delimiter = '\r') : m_delimiter(delimiter) {
+        for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+            m_connections[i].fd = -1;
+            m_connections[i].id = 0;
+        }
+    }
+    ~TcpEventLoop() { stop(); }
+
+    TcpEventLoop(const TcpEventLoop &) = delete;  // no copying
+    TcpEventLoop &operator=(const TcpEventLoop &) = delete;
+
+    void onOpen(ConnectionHandler handler) { m_onOpen = handler; }
+    void onReceive(ReceiveHandler handler) { m_onReceive = handler; }
+    void onClose(ConnectionHandler handler) { m_onClose = handler; }
+
+    /// @brief Configure the connection handling if all connection slots are in use.
+    /// @param enabled true to evict idle connections, false to keep new clients waiting in the listen backlog.
+    /// @param minIdleMs minimum time without received data for a connection to be evicted.
+    void setEviction(bool enabled, uint32_t minIdleMs) {
+        m_evict = enabled;
+        m_evictIdleMs = minIdleMs;
+    }
+
+    /// @brief Start listening for client connections.
+    /// @param port TCP port.
+    /// @param bindAddr optional IPv4 address to bind to, e.g. 127.0.0.1 for testing. Default: any.
+    /// @param backlog listen backlog.
+    /// @return errno value of the failed operation, 0 if successful.
+    int listen(uint16_t port, const char *bindAddr = nullptr, int backlog = 1) {
+        stop();
+        int err = m_posted.open();
+        if (err) {
+            stop();
+            return err;
+        }
+
+        m_listenFd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (m_listenFd < 0) {
+            err = errno;
+            stop();
+            return err;
+        }
+        int opt = 1;
+        setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        // drain all waiting clients without blocking
+        setNonBlocking(m_listenFd);
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = bindAddr ? inet_addr(bindAddr) : htonl(INADDR_ANY);
+        addr.sin_port = htons(port);
+        if (bind(m_listenFd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 ||
+            ::listen(m_listenFd, backlog) != 0) {
+            err = errno;
+            stop();
+            return err ? err : -1;
+        }
+        return 0;
+    }
+
+    /// @brief Close the listen socket and all client connections.
+    void stop() {
+        for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+            close(m_connections[i]);
+        }
+        if (m_listenFd >= 0) {
+            ::close(m_listenFd);
+            m_listenFd = -1;
+        }
+        m_posted.close();
+    }
+
+    /// @brief Wait for socket events and process them: accept new clients, read client data, send buffered data and
+    ///        deliver posted messages.
+    /// @param timeoutMs maximum wait time in milliseconds, negative value to wait forever.
+    /// @return number of processed events, 0 if timed out, negative value on error.
+    int runOnce(int timeoutMs) {
+        if (m_listenFd < 0) {
+            return -1;
+        }
+
+        fd_set readSet;
+        fd_set writeSet;
+        FD_ZERO(&readSet);
+        FD_ZERO(&writeSet);
+        int maxFd = m_posted.addTo(&readSet, -1);
+        if (m_evict || connectionCount() < MAX_CONNECTIONS) {
+            FD_SET(m_listenFd, &readSet);
+            maxFd = m_listenFd > maxFd ? m_listenFd : maxFd;
+        }
+        for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+            const TcpConnection &conn = m_connections[i];
+            if (conn.fd >= 0) {
+                FD_SET(conn.fd, &readSet);
+                if (!conn.outgoing.empty()) {
+                    FD_SET(conn.fd, &writeSet);
+                }
+                maxFd = conn.fd > maxFd ? conn.fd : maxFd;
+            }
+        }
+
+        struct timeval  tv;
+        struct timeval *timeout = nullptr;
+        if (timeoutMs >= 0) {
+            tv.tv_sec = timeoutMs / 1000;
+            tv.tv_usec = (timeoutMs % 1000) * 1000;
+            timeout = &tv;
+        }
+
+        int ready = select(maxFd + 1, &readSet, &writeSet, nullptr, timeout);
+        if (ready <= 0) {
+            return ready;
+        }
+
+        int events = 0;
+        for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+            TcpConnection &conn = m_connections[i];
+            if (conn.fd >= 0 && FD_ISSET(conn.fd, &writeSet)) {
+                if (!flush(conn)) {
+                    close(conn);
+                }
+                events++;
+            }
+            if (conn.fd >= 0 && FD_ISSET(conn.fd, &readSet)) {
+                read(conn);
+                events++;
+            }
+        }
+        if (m_posted.woken(&readSet)) {
+            deliverPosted();
+            events++;
+        }
+        if (FD_ISSET(m_listenFd, &readSet)) {
+            // accept a limited number of clients per iteration to keep serving the connected clients in a storm
+            for (size_t i = 0; i < MAX_CONNECTIONS && accept(); i++) {
+                events++;
+            }
+        }
+
+        return events;
+    }
+
+    /// @brief Send data to a client without blocking. Must only be called from the event loop task, e.g. in a handler.
+    ///
+    /// Data which can't be sent immediately is buffered and sent in order once the socket is writable again.
+    /// @return false if the output buffer overflowed or sending failed. The connection should be closed.
+    bool send(TcpConnection &conn, const char *data, size_t len) {
+        if (conn.fd < 0) {
+            return false;
+        }
+        if (conn.outgoing.empty()) {
+            ssize_t sent = ::send(conn.fd, data, len, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    return false;
+                }
+                sent = 0;
+            }
+            data += sent;
+            len -= sent;
+        }
+        if (len > conn.outgoing.available()) {
+            // slow or dead client
+            return false;
+        }
+        conn.outgoing.write(data, len);
+        return true;
+    }
+
+    /// @brief Send a message to a client from any task. Never blocks.
+    ///
+    /// The message is dropped if the client disconnected in the meantime.
+    /// @param connectionId identifier of the client connection `TcpConnection::id`.
+    /// @param msg zero-terminated message, maximum size is `TCP_POST_MESSAGE_SIZE`.
+    /// @return false if the message is too long, the queue is full, or the event loop isn't running.
+    bool post(uint32_t connectionId, const char *msg) {
+        size_t len = strlen(msg);
+        if (len > TCP_POST_MESSAGE_SIZE) {
+            return false;
+        }
+
+        PostedMessage entry;
+        entry.connectionId = connectionId;
+        entry.len = len;
+        memcpy(entry.data, msg, len);
+        return m_posted.post(entry);
+    }
+
+    /// @brief Find a client connection. Must only be called from the event loop task.
+    /// @param connectionId identifier of the client connection `TcpConnection::id`.
+    /// @return nullptr if the client disconnected.
+    TcpConnection *connection(uint32_t connectionId) {
+        for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+            TcpConnection &conn = m_connections[i];
+            if (conn.fd >= 0 && conn.id == connectionId) {
+                return &conn;
+            }
+        }
+        return nullptr;
+    }
+
+    /// @brief Close a client connection.
+    void close(TcpConnection &conn) {
+        if (conn.fd < 0) {
+            return;
+        }
+        if (m_onClose) {
+            m_onClose(conn);
+        }
+        shutdown(conn.fd, SHUT_RDWR);
+        ::close(conn.fd);
+        conn.fd = -1;
+        conn.id = 0;
+        m_closed++;
+    }
+
+    size_t connectionCount() const {
+        size_t count = 0;
+        for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+            if (m_connections[i].fd >= 0) {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    bool isListening() const { return m_listenFd >= 0; }
+
+    /// @brief Get the connection churn counters. Can be called from any task.
+    TcpLoopStats stats() const { return {m_accepted, m_closed, m_evicted, m_rejected, m_peakConnections}; }
+
+    /// Monotonic time in milliseconds used for the connection activity.
+    static int64_t nowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+ private:
+    struct PostedMessage {
+        uint32_t connectionId;
+        uint8_t  len;
+        char     data[TCP_POST_MESSAGE_SIZE];
+    };
+
+    static void setNonBlocking(int fd) {
+        int flags = fcntl(fd, F_GETFL, 0);
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    }
+
+    void deliverPosted() {
+        PostedMessage msg;
+        while (m_posted.pop(&msg)) {
+            TcpConnection *conn = connection(msg.connectionId);
+            if (conn && !send(*conn, msg.data, msg.len)) {
+                close(*conn);
+            }
+        }
+    }
+
+    /// Accept a waiting client.
+    /// @return false if no client is waiting.
+    bool accept() {
+        if (!m_evict && connectionCount() >= MAX_CONNECTIONS) {
+            // keep waiting in the listen backlog
+            return false;
+        }
+        struct sockaddr_in source;
+        socklen_t          sourceLen = sizeof(source);
+        int fd = ::accept(m_listenFd, reinterpret_cast<struct sockaddr *>(&source), &sourceLen);
+        if (fd < 0) {
+            return false;
+        }
+
+        int64_t        now = nowMs();
+        TcpConnection *slot = nullptr;
+        TcpConnection *leastRecent = nullptr;
+        size_t         count = 0;
+        for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+            TcpConnection &conn = m_connections[i];
+            if (conn.fd < 0) {
+                if (!slot) {
+                    slot = &conn;
+                }
+            } else {
+                count++;
+                if (!leastRecent || conn.lastActivityMs < leastRecent->lastActivityMs) {
+                    leastRecent = &conn;
+                }
+            }
+        }
+        if (!slot) {
+            if (!m_evict || now - leastRecent->lastActivityMs < m_evictIdleMs) {
+                // all connections are active
+                ::close(fd);
+                m_rejected++;
+                return true;
+            }
+            close(*leastRecent);
+            m_evicted++;
+            slot = leastRecent;
+            count--;
+        }
+
+        TcpConnection &conn = *slot;
+        setNonBlocking(fd);
+        conn.fd = fd;
+        if (++m_lastId == 0) {
+            m_lastId = 1;
+        }
+        conn.id = m_lastId;
+        inet_ntop(AF_INET, &source.sin_addr, conn.addr, sizeof(conn.addr));
+        conn.ip = source.sin_addr.s_addr;
+        conn.rateLimit.reset();
+        conn.lastActivityMs = now;
+        conn.rx[0] = 0;
+        conn.pending.clear();
+        conn.outgoing.clear();
+        m_accepted++;
+        if (count + 1 > m_peakConnections) {
+            m_peakConnections = count + 1;
+        }
+        if (m_onOpen) {
+            m_onOpen(conn);
+        }
+        return true;
+    }
+
+    void read(TcpConnection &conn) {
+        // Read directly into the ring buffer. If the free space wraps around, the remaining data is read in the next
+        // loop iteration.
+        size_t  space;
+        char   *buf = conn.pending.writePtr(&space);
+        ssize_t len = recv(conn.fd, buf, space, 0);
+        if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (len <= 0) {
+            close(conn);
+            return;
+        }
+        conn.pending.commit(len);
+        conn.lastActivityMs = nowMs();
+
+        // process all complete messages in order, a partial message remains in the buffer
+        while (true) {
+            int    pos = conn.pending.indexOf(m_delimiter);
+            size_t msgLen;
+            if (pos >= 0) {
+                msgLen = pos + 1;
+            } else if (conn.pending.full()) {
+                // message too long, hand it over without delimiter
+                msgLen = conn.pending.size();
+            } else {
+                break;
+            }
+            conn.pending.read(conn.rx, msgLen);
+            conn.rx[msgLen] = 0;
+            if (m_onReceive && !m_onReceive(conn, msgLen)) {
+                close(conn);
+                return;
+            }
+        }
+    }
+
+    /// Send buffered data.
+    /// @return false if sending failed.
+    bool flush(TcpConnection &conn) {
+        while (!conn.outgoing.empty()) {
+            size_t      len;
+            const char *data = conn.outgoing.readPtr(&len);
+            ssize_t     sent = ::send(conn.fd, data, len, MSG_NOSIGNAL);
+            if (sent < 0) {
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+            conn.outgoing.read(nullptr, sent);
+        }
+        return true;
+    }
+
+    char              m_delimiter;
+    int               m_listenFd = -1;
+    uint32_t          m_lastId = 0;
+    TcpConnection     m_connections[MAX_CONNECTIONS];
+    ConnectionHandler m_onOpen;
+    ConnectionHandler m_onClose;
+    ReceiveHandler    m_onReceive;
+    bool              m_evict = false;
+    uint32_t          m_evictIdleMs = 0;
+
+    // Connection churn counters, only written by the event loop task
+    std::atomic<uint32_t> m_accepted{0};
+    std::atomic<uint32_t> m_closed{0};
+    std::atomic<uint32_t> m_evicted{0};
+    std::atomic<uint32_t> m_rejected{0};
+    std::atomic<uint32_t> m_peakConnections{0};
+
+    // Messages posted from other tasks
+    SocketEventQueue<PostedMessage, TCP_POST_QUEUE_SIZE> m_posted;
+};
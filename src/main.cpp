@@ -16,11 +16,18 @@
 
 #include "board.h"
 #include "globalcache_server.h"
+#include "ir_group_server.h"
+#include "interval_timer.hpp"
+#include "ir_udp_server.h"
+#include "rate_limiter.hpp"
 
 // Services
 Config*            config = nullptr;
 State*             state = nullptr;
 GlobalCacheServer* gcServer = nullptr;
+IrGroupServer*     irGroupServer = nullptr;
+IrUdpServer*       irUdpServer = nullptr;
+ClientRateLimiter* rateLimiter = nullptr;
 NetworkService*    networkService = nullptr;
 BluetoothService*  bluetoothService = nullptr;
 OtaService*        otaService = nullptr;
@@ -32,9 +39,14 @@ bool resetMarker = false;
 const int64_t TIMER_RESET_TIME = 9223372036854775807;
 int64_t       buttonTimerSet = TIMER_RESET_TIME;
 
-int         counter = 0;
 const char* ctx = "MAIN";
 
+// Service intervals of the main loop. The API runs in its own task and doesn't depend on the main loop.
+IntervalTimer chargingTimer(250);
+IntervalTimer networkTimer(100);
+IntervalTimer stateTimer(20);
+IntervalTimer serviceTimer(10);  // Bluetooth, mDNS & OTA
+
 // in case we ever have to increase the stack size: https://github.com/espressif/arduino-esp32/pull/5173
 // SET_LOOP_TASK_STACK_SIZE( 16*1024 ); // 16KB
 
@@ -43,21 +55,16 @@ const char* ctx = "MAIN";
 ////////////////////////////////////////////////////////////////
 // charging pin loop handle
 void handleCharging() {
-    // TODO(marton) use millis() timeout
-    counter++;
-    if (counter == 4000) {
-        int value = analogRead(CHARGE_SENSE_GPIO);
-
-        // Log.logf(Log.DEBUG, ctx, "Charge sense pin value: %d", value);
-
-        if (value > 300 && state->getState() != States::NORMAL_CHARGING) {
-            Log.info(ctx, "Remote is charging");
-            state->setState(States::NORMAL_CHARGING);
-        } else if (value < 300 && state->getState() == States::NORMAL_CHARGING) {
-            Log.info(ctx, "Remote is not charging");
-            state->setState(States::NORMAL);
-        }
-        counter = 0;
+    int value = analogRead(CHARGE_SENSE_GPIO);
+
+    // Log.logf(Log.DEBUG, ctx, "Charge sense pin value: %d", value);
+
+    if (value > 300 && state->getState() != States::NORMAL_CHARGING) {
+        Log.info(ctx, "Remote is charging");
+        state->setState(States::NORMAL_CHARGING);
+    } else if (value < 300 && state->getState() == States::NORMAL_CHARGING) {
+        Log.info(ctx, "Remote is not charging");
+        state->setState(States::NORMAL);
     }
 }
 
@@ -156,9 +163,16 @@ void setup() {
     irService.init(config->getIrSendCore(), config->getIrSendPriority(), config->getIrLearnCore(),
                    config->getIrLearnPriority(), state);
 
-    gcServer = new GlobalCacheServer(state, &irService, config);
+    // shared request rate limit of GlobalCache and WebSocket clients
+    rateLimiter = new ClientRateLimiter();
+    rateLimiter->setConnectionLimit(config->getRateLimit());
+    rateLimiter->setIpLimit(config->getIpRateLimit());
 
-    api = new API(config, state, networkService, &irService, &ledControl);
+    gcServer = new GlobalCacheServer(state, &irService, config, rateLimiter);
+    irGroupServer = new IrGroupServer(&irService, config);
+    irUdpServer = new IrUdpServer(&irService, config);
+
+    api = new API(config, state, networkService, &irService, irGroupServer, &ledControl, rateLimiter, gcServer);
     api->init();
 
     bluetoothService = new BluetoothService(state, config, api);
@@ -206,24 +220,31 @@ void setup() {
 // Main LOOP
 ////////////////////////////////////////////////////////////////
 void loop() {
-    // handle charging
-    handleCharging();
+    uint32_t now = millis();
 
-    // Handle api calls
-    api->loop();
+    // handle charging
+    if (chargingTimer.expired(now)) {
+        handleCharging();
+    }
 
     if (state->getState() == States::SETUP) {
         // Handle incoming bluetooth serial data
-        bluetoothService->handle();
+        if (serviceTimer.expired(now)) {
+            bluetoothService->handle();
+        }
     } else {
         // Handle wifi disconnects.
-        networkService->handleLoop();
+        if (networkTimer.expired(now)) {
+            networkService->handleLoop();
+        }
 
-        // handle MDNS
-        MdnsService.loop();
+        if (serviceTimer.expired(now)) {
+            // handle MDNS
+            MdnsService.loop();
 
-        // Handle OTA updates.
-        otaService->loop();
+            // Handle OTA updates.
+            otaService->loop();
+        }
     }
 
     // reset if marker is set
@@ -234,5 +255,16 @@ void loop() {
         config->reset();
     }
 
-    state->loop();
+    if (stateTimer.expired(now)) {
+        state->loop();
+    }
+
+    // sleep until the next service is due. Services may block, so they run in the loop task and not in timer
+    // callbacks.
+    now = millis();
+    uint32_t idle = serviceTimer.remaining(now);
+    if (stateTimer.remaining(now) < idle) {
+        idle = stateTimer.remaining(now);
+    }
+    vTaskDelay(pdMS_TO_TICKS(idle > 0 ? idle : 1));
 }
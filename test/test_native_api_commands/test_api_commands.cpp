@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <unity.h>
+
+#include <chrono>
+#include <string>
+
+#include "api_commands.hpp"
+
+#define COMMAND_COUNT (sizeof(API_COMMAND_TABLE) / sizeof(API_COMMAND_TABLE[0]) - 1)
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+void test_findApiCommand_allCommands(void) {
+    TEST_ASSERT_EQUAL(24, COMMAND_COUNT);
+    for (size_t i = 1; i <= COMMAND_COUNT; i++) {
+        const ApiCommandInfo &info = API_COMMAND_TABLE[i];
+        // table is in enum order
+        TEST_ASSERT_EQUAL(i, static_cast<size_t>(info.command));
+        TEST_ASSERT_TRUE(findApiCommand(info.name) == info.command);
+        TEST_ASSERT_TRUE(&apiCommandInfo(info.command) == &info);
+    }
+    TEST_ASSERT_TRUE(findApiCommand("get_sysinfo") == ApiCommand::GetSysinfo);
+    TEST_ASSERT_TRUE(findApiCommand("ir_send") == ApiCommand::IrSend);
+    TEST_ASSERT_TRUE(findApiCommand("ir_send_group") == ApiCommand::IrSendGroup);
+    TEST_ASSERT_TRUE(findApiCommand("get_ir_config") == ApiCommand::GetIrConfig);
+    TEST_ASSERT_TRUE(findApiCommand("subscribe") == ApiCommand::Subscribe);
+    TEST_ASSERT_TRUE(findApiCommand("unsubscribe") == ApiCommand::Unsubscribe);
+}
+
+void test_findApiCommand_unknown(void) {
+    TEST_ASSERT_TRUE(findApiCommand(nullptr) == ApiCommand::Unknown);
+    TEST_ASSERT_TRUE(findApiCommand("") == ApiCommand::Unknown);
+    TEST_ASSERT_TRUE(findApiCommand("ir_sen") == ApiCommand::Unknown);
+    TEST_ASSERT_TRUE(findApiCommand("ir_sendx") == ApiCommand::Unknown);
+    TEST_ASSERT_TRUE(findApiCommand("IR_SEND") == ApiCommand::Unknown);
+    TEST_ASSERT_TRUE(findApiCommand(" ir_send") == ApiCommand::Unknown);
+    TEST_ASSERT_TRUE(findApiCommand("auth") == ApiCommand::Unknown);
+    TEST_ASSERT_TRUE(findApiCommand("ping") == ApiCommand::Unknown);
+
+    const ApiCommandInfo &info = apiCommandInfo(ApiCommand::Unknown);
+    TEST_ASSERT_TRUE(info.command == ApiCommand::Unknown);
+    TEST_ASSERT_EQUAL(0, info.flags);
+    // out of range identifiers return the unknown entry
+    TEST_ASSERT_TRUE(&apiCommandInfo(static_cast<ApiCommand>(200)) == &info);
+}
+
+void test_apiCommandHash(void) {
+    // FNV-1a reference values
+    TEST_ASSERT_EQUAL_HEX32(0x811c9dc5, apiCommandHash(""));
+    TEST_ASSERT_EQUAL_HEX32(0xe40c292c, apiCommandHash("a"));
+    TEST_ASSERT_EQUAL_HEX32(0xbf9cf968, apiCommandHash("foobar"));
+
+    // usable as constant expression
+    static_assert(apiCommandHash("ir_send") != apiCommandHash("ir_stop"), "hash must be constexpr");
+}
+
+void test_isApiCommandAllowed(void) {
+    const ApiCommandInfo &sysinfo = apiCommandInfo(ApiCommand::GetSysinfo);
+    const ApiCommandInfo &irSend = apiCommandInfo(ApiCommand::IrSend);
+
+    // get_sysinfo is the only public command
+    for (size_t i = 1; i <= COMMAND_COUNT; i++) {
+        TEST_ASSERT_EQUAL(API_COMMAND_TABLE[i].command == ApiCommand::GetSysinfo,
+                          (API_COMMAND_TABLE[i].flags & API_CMD_PUBLIC) != 0);
+    }
+
+    TEST_ASSERT_TRUE(isApiCommandAllowed(sysinfo, API_CMD_SRC_WS, false));
+    TEST_ASSERT_TRUE(isApiCommandAllowed(sysinfo, API_CMD_SRC_UART, true));
+    TEST_ASSERT_FALSE(isApiCommandAllowed(irSend, API_CMD_SRC_WS, false));
+    TEST_ASSERT_TRUE(isApiCommandAllowed(irSend, API_CMD_SRC_WS, true));
+    TEST_ASSERT_TRUE(isApiCommandAllowed(irSend, API_CMD_SRC_UART, true));
+    TEST_ASSERT_TRUE(isApiCommandAllowed(irSend, API_CMD_SRC_BT, true));
+    TEST_ASSERT_FALSE(isApiCommandAllowed(apiCommandInfo(ApiCommand::Unknown), API_CMD_SRC_WS, true));
+
+    ApiCommandInfo wsOnly = {"ws_only", ApiCommand::Unknown, API_CMD_SRC_WS};
+    TEST_ASSERT_TRUE(isApiCommandAllowed(wsOnly, API_CMD_SRC_WS, true));
+    TEST_ASSERT_FALSE(isApiCommandAllowed(wsOnly, API_CMD_SRC_UART, true));
+    TEST_ASSERT_FALSE(isApiCommandAllowed(wsOnly, API_CMD_SRC_BT, true));
+}
+
+// Previous dispatch: copy the command into a string and compare it against every command name in turn.
+static int findWithStringChain(const char *name) {
+    std::string command = name;
+    if (command == "get_sysinfo") return 1;
+    if (command == "set_config") return 2;
+    if (command == "set_brightness") return 3;
+    if (command == "test_mode") return 4;
+    if (command == "rgb_test") return 5;
+    if (command == "rgb_test_stop") return 6;
+    if (command == "ir_test") return 7;
+    if (command == "ir_send") return 8;
+    if (command == "ir_send_group") return 9;
+    if (command == "ir_stop") return 10;
+    if (command == "ir_receive_on") return 11;
+    if (command == "ir_receive_off") return 12;
+    if (command == "remote_charged") return 13;
+    if (command == "remote_lowbattery") return 14;
+    if (command == "remote_normal") return 15;
+    if (command == "identify") return 16;
+    if (command == "set_logging") return 17;
+    if (command == "set_sntp") return 18;
+    if (command == "reboot") return 19;
+    if (command == "reset") return 20;
+    if (command == "set_ir_config") return 21;
+    if (command == "get_ir_config") return 22;
+    if (command == "subscribe") return 23;
+    if (command == "unsubscribe") return 24;
+    return 0;
+}
+
+template <typename F>
+static double nsPerLookup(F lookup, const char *const *names, size_t count, int rounds) {
+    volatile int sink = 0;
+    auto         start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < count; i++) {
+            sink = sink + lookup(names[i]);
+        }
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    return static_cast<double>(elapsed.count()) / (rounds * count);
+}
+
+void test_benchmarkDispatch(void) {
+    const char *names[COMMAND_COUNT];
+    for (size_t i = 0; i < COMMAND_COUNT; i++) {
+        names[i] = API_COMMAND_TABLE[i + 1].name;
+        // both lookups must agree before comparing them
+        TEST_ASSERT_EQUAL(static_cast<int>(findApiCommand(names[i])), findWithStringChain(names[i]));
+    }
+    const char *irSend[] = {"ir_send"};
+    const int   rounds = 100000;
+
+    auto table = [](const char *name) { return static_cast<int>(findApiCommand(name)); };
+    double tableAll = nsPerLookup(table, names, COMMAND_COUNT, rounds);
+    double chainAll = nsPerLookup(findWithStringChain, names, COMMAND_COUNT, rounds);
+    double tableIrSend = nsPerLookup(table, irSend, 1, rounds * 10);
+    double chainIrSend = nsPerLookup(findWithStringChain, irSend, 1, rounds * 10);
+
+    char msg[200];
+    snprintf(msg, sizeof(msg),
+             "all commands: table %.1fns, string chain %.1fns. ir_send: table %.1fns, string chain %.1fns", tableAll,
+             chainAll, tableIrSend, chainIrSend);
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_findApiCommand_allCommands);
+    RUN_TEST(test_findApiCommand_unknown);
+    RUN_TEST(test_apiCommandHash);
+    RUN_TEST(test_isApiCommandAllowed);
+    RUN_TEST(test_benchmarkDispatch);
+
+    UNITY_END();
+}
@@ -0,0 +1,403 @@
+#include <stdio.h>
+#include <unity.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#if __has_include(<ArduinoJson.h>)
+#include <ArduinoJson.h>
+#define HAVE_ARDUINOJSON 1
+#endif
+
+#include "api_request.hpp"
+
+#define FIELD_COUNT static_cast<size_t>(ApiField::Count)
+
+// Parse a copy of the request, the tokenizer modifies the buffer
+struct Parsed {
+    std::vector<char> buf;
+    ApiRequest        req;
+    ApiParseError     error;
+
+    explicit Parsed(const char *json) : buf(json, json + strlen(json) + 1) {
+        error = parseApiRequest(buf.data(), &req);
+    }
+};
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+void test_findApiField(void) {
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+        const char *key = API_FIELD_KEYS[i];
+        TEST_ASSERT_EQUAL(i, static_cast<size_t>(findApiField(key, strlen(key))));
+    }
+    TEST_ASSERT_TRUE(findApiField("", 0) == ApiField::Count);
+    TEST_ASSERT_TRUE(findApiField("typ", 3) == ApiField::Count);
+    TEST_ASSERT_TRUE(findApiField("types", 5) == ApiField::Count);
+    TEST_ASSERT_TRUE(findApiField("TYPE", 4) == ApiField::Count);
+    // key doesn't need to be zero-terminated
+    TEST_ASSERT_TRUE(findApiField("command_x", 7) == ApiField::Command);
+}
+
+// Requests sent by the Remote Two and the integration library
+void test_parse_dockRequests(void) {
+    Parsed auth("{\"type\":\"auth\",\"token\":\"0815\",\"id\":1}");
+    TEST_ASSERT_TRUE(auth.error == ApiParseError::Ok);
+    TEST_ASSERT_EQUAL_STRING("auth", auth.req.getString(ApiField::Type));
+    TEST_ASSERT_EQUAL_STRING("0815", auth.req.getString(ApiField::Token));
+    TEST_ASSERT_EQUAL(1, auth.req.getInt<int>(ApiField::Id));
+    TEST_ASSERT_FALSE(auth.req.has(ApiField::Command));
+
+    Parsed irSend(
+        "{\"type\":\"dock\",\"id\":123,\"command\":\"ir_send\",\"code\":\"3;0x20DF10EF;32;0\",\"format\":\"hex\","
+        "\"repeat\":2,\"int_side\":true,\"int_top\":false,\"ext1\":false,\"ext2\":true,"
+        "\"send_at\":1718000000123456,\"priority\":\"preempt\",\"resume\":true}");
+    TEST_ASSERT_TRUE(irSend.error == ApiParseError::Ok);
+    const ApiRequest &req = irSend.req;
+    TEST_ASSERT_EQUAL_STRING("dock", req.getString(ApiField::Type));
+    TEST_ASSERT_EQUAL_STRING("ir_send", req.getString(ApiField::Command));
+    TEST_ASSERT_EQUAL_STRING("3;0x20DF10EF;32;0", req.getString(ApiField::Code));
+    TEST_ASSERT_EQUAL(17, req.getStringLength(ApiField::Code));
+    TEST_ASSERT_EQUAL_STRING("hex", req.getString(ApiField::Format));
+    TEST_ASSERT_EQUAL(2, req.getInt<uint16_t>(ApiField::Repeat));
+    TEST_ASSERT_TRUE(req.getBool(ApiField::IntSide));
+    TEST_ASSERT_FALSE(req.getBool(ApiField::IntTop));
+    TEST_ASSERT_FALSE(req.getBool(ApiField::Ext1));
+    TEST_ASSERT_TRUE(req.getBool(ApiField::Ext2));
+    TEST_ASSERT_TRUE(req.getInt<int64_t>(ApiField::SendAt) == 1718000000123456LL);
+    TEST_ASSERT_EQUAL_STRING("preempt", req.getString(ApiField::Priority));
+    TEST_ASSERT_TRUE(req.getBool(ApiField::Resume));
+    TEST_ASSERT_EQUAL(123, req.getInt<int>(ApiField::Id));
+
+    Parsed config(
+        "{\n  \"type\": \"dock\",\n  \"id\": 7,\n  \"command\": \"set_ir_config\",\n  \"irlearn_core\": 1,\n"
+        "  \"group_key\": \"secret\",\n  \"ratelimit_burst\": 30,\n  \"ratelimit_rate\": 0,\n"
+        "  \"gc_learn_compressed\": true\n}\n");
+    TEST_ASSERT_TRUE(config.error == ApiParseError::Ok);
+    TEST_ASSERT_EQUAL(1, config.req.getInt<uint16_t>(ApiField::IrlearnCore));
+    TEST_ASSERT_EQUAL_STRING("secret", config.req.getString(ApiField::GroupKey));
+    TEST_ASSERT_EQUAL(30, config.req.getInt<uint16_t>(ApiField::RatelimitBurst, 20));
+    TEST_ASSERT_EQUAL(0, config.req.getInt<uint16_t>(ApiField::RatelimitRate, 10));
+    TEST_ASSERT_EQUAL(40, config.req.getInt<uint16_t>(ApiField::RatelimitIpBurst, 40));
+    TEST_ASSERT_TRUE(config.req.getBool(ApiField::GcLearnCompressed));
+    TEST_ASSERT_FALSE(config.req.has(ApiField::IrsendCore));
+
+    Parsed ping("{\"type\":\"dock\",\"msg\":\"ping\"}");
+    TEST_ASSERT_TRUE(ping.error == ApiParseError::Ok);
+    TEST_ASSERT_EQUAL_STRING("ping", ping.req.getString(ApiField::Msg));
+    TEST_ASSERT_NULL(ping.req.getString(ApiField::Command));
+    TEST_ASSERT_EQUAL_STRING("", ping.req.getString(ApiField::Command, ""));
+}
+
+void test_parse_unknownFields(void) {
+    Parsed p(
+        "{\"extra\":{\"type\":\"nested\",\"command\":[1,{\"id\":5}]},\"type\":\"dock\",\"list\":[true,null,-1.5e3,"
+        "\"x\"],\"command\":\"identify\",\"empty\":{},\"none\":[]}");
+    TEST_ASSERT_TRUE(p.error == ApiParseError::Ok);
+    // nested keys are not request fields
+    TEST_ASSERT_EQUAL_STRING("dock", p.req.getString(ApiField::Type));
+    TEST_ASSERT_EQUAL_STRING("identify", p.req.getString(ApiField::Command));
+    TEST_ASSERT_FALSE(p.req.has(ApiField::Id));
+
+    // known field with a structured value
+    Parsed obj("{\"code\":{\"a\":1},\"format\":[\"hex\"]}");
+    TEST_ASSERT_TRUE(obj.error == ApiParseError::Ok);
+    TEST_ASSERT_TRUE(obj.req.has(ApiField::Code));
+    TEST_ASSERT_TRUE(obj.req.type(ApiField::Code) == ApiValueType::Object);
+    TEST_ASSERT_TRUE(obj.req.type(ApiField::Format) == ApiValueType::Array);
+    TEST_ASSERT_NULL(obj.req.getString(ApiField::Code));
+    TEST_ASSERT_EQUAL(0, obj.req.getStringLength(ApiField::Code));
+
+    // repeated key: last value wins
+    Parsed dup("{\"id\":1,\"id\":2}");
+    TEST_ASSERT_EQUAL(2, dup.req.getInt<int>(ApiField::Id));
+
+    // other root values don't have fields
+    Parsed array("[{\"type\":\"dock\"}]");
+    TEST_ASSERT_TRUE(array.error == ApiParseError::Ok);
+    TEST_ASSERT_FALSE(array.req.has(ApiField::Type));
+    Parsed str("\"type\"");
+    TEST_ASSERT_TRUE(str.error == ApiParseError::Ok);
+    Parsed num("42");
+    TEST_ASSERT_TRUE(num.error == ApiParseError::Ok);
+
+    // trailing data is ignored
+    Parsed trailing("{\"id\":3}\r\n{\"id\":4}");
+    TEST_ASSERT_TRUE(trailing.error == ApiParseError::Ok);
+    TEST_ASSERT_EQUAL(3, trailing.req.getInt<int>(ApiField::Id));
+
+    // fields of a previous request are cleared
+    ApiRequest req;
+    char       buf1[] = "{\"id\":1,\"token\":\"t\"}";
+    char       buf2[] = "{\"id\":2}";
+    parseApiRequest(buf1, &req);
+    parseApiRequest(buf2, &req);
+    TEST_ASSERT_EQUAL(2, req.getInt<int>(ApiField::Id));
+    TEST_ASSERT_FALSE(req.has(ApiField::Token));
+}
+
+void test_parse_strings(void) {
+    Parsed p(
+        "{\"code\":\"a\\\"b\\\\c\\/d\\b\\f\\n\\r\\t\",\"color\":\"\\u0041\\u00e4\\u20ac\\ud83d\\ude00\","
+        "\"msg\":\"\"}");
+    TEST_ASSERT_TRUE(p.error == ApiParseError::Ok);
+    TEST_ASSERT_EQUAL_STRING("a\"b\\c/d\b\f\n\r\t", p.req.getString(ApiField::Code));
+    TEST_ASSERT_EQUAL(12, p.req.getStringLength(ApiField::Code));
+    TEST_ASSERT_EQUAL_STRING("A\xC3\xA4\xE2\x82\xAC\xF0\x9F\x98\x80", p.req.getString(ApiField::Color));
+    TEST_ASSERT_EQUAL(10, p.req.getStringLength(ApiField::Color));
+    TEST_ASSERT_EQUAL_STRING("", p.req.getString(ApiField::Msg));
+    TEST_ASSERT_TRUE(p.req.has(ApiField::Msg));
+
+    // zero-copy: strings point into the request buffer
+    const char *code = p.req.getString(ApiField::Code);
+    TEST_ASSERT_TRUE(code > p.buf.data() && code < p.buf.data() + p.buf.size());
+
+    // escaped keys are decoded before matching
+    Parsed key("{\"ty\\u0070e\":\"dock\"}");
+    TEST_ASSERT_EQUAL_STRING("dock", key.req.getString(ApiField::Type));
+
+    // UTF-8 is passed through
+    Parsed utf8("{\"friendly_name\":\"K\xC3\xBC" "che\"}");
+    TEST_ASSERT_EQUAL_STRING("K\xC3\xBC" "che", utf8.req.getString(ApiField::FriendlyName));
+}
+
+void test_parse_numbers(void) {
+    Parsed p(
+        "{\"id\":-7,\"repeat\":70000,\"send_at\":9223372036854775807,\"delay\":1.9,\"log_level\":2e1,"
+        "\"status_led\":true,\"eth_led\":\"5\",\"syslog_port\":-1,\"irlearn_core\":0,\"irsend_core\":"
+        "18446744073709551616,\"irsend_prio\":null}");
+    TEST_ASSERT_TRUE(p.error == ApiParseError::Ok);
+    const ApiRequest &req = p.req;
+    TEST_ASSERT_EQUAL(-7, req.getInt<int>(ApiField::Id));
+    TEST_ASSERT_EQUAL(0, req.getInt<uint16_t>(ApiField::Id));
+    // out of range values return the default
+    TEST_ASSERT_EQUAL(0, req.getInt<uint16_t>(ApiField::Repeat));
+    TEST_ASSERT_EQUAL(5, req.getInt<uint16_t>(ApiField::Repeat, 5));
+    TEST_ASSERT_EQUAL(70000, req.getInt<uint32_t>(ApiField::Repeat));
+    TEST_ASSERT_TRUE(req.getInt<int64_t>(ApiField::SendAt) == INT64_MAX);
+    TEST_ASSERT_EQUAL(0, req.getInt<int32_t>(ApiField::SendAt));
+    TEST_ASSERT_EQUAL(0, req.getInt<uint16_t>(ApiField::SyslogPort));
+    // floating point numbers are truncated
+    TEST_ASSERT_TRUE(req.type(ApiField::Delay) == ApiValueType::Float);
+    TEST_ASSERT_EQUAL(1, req.getInt<uint32_t>(ApiField::Delay));
+    TEST_ASSERT_EQUAL(20, req.getInt<uint16_t>(ApiField::LogLevel));
+    // overflowing integers become floating point numbers
+    TEST_ASSERT_TRUE(req.type(ApiField::IrsendCore) == ApiValueType::Float);
+    TEST_ASSERT_EQUAL(3, req.getInt<int64_t>(ApiField::IrsendCore, 3));
+    // booleans are numbers, strings and null are not
+    TEST_ASSERT_EQUAL(1, req.getInt<int>(ApiField::StatusLed));
+    TEST_ASSERT_EQUAL(9, req.getInt<int>(ApiField::EthLed, 9));
+    TEST_ASSERT_EQUAL(9, req.getInt<int>(ApiField::IrsendPrio, 9));
+    TEST_ASSERT_TRUE(req.has(ApiField::IrsendPrio));
+    TEST_ASSERT_TRUE(req.type(ApiField::IrsendPrio) == ApiValueType::Null);
+    // numbers are booleans
+    TEST_ASSERT_TRUE(req.getBool(ApiField::Id));
+    TEST_ASSERT_FALSE(req.getBool(ApiField::IrlearnCore));
+    TEST_ASSERT_TRUE(req.getBool(ApiField::Delay));
+    TEST_ASSERT_FALSE(req.getBool(ApiField::EthLed));
+    TEST_ASSERT_TRUE(req.getBool(ApiField::EthLed, true));
+    TEST_ASSERT_FALSE(req.getBool(ApiField::Ext1));
+
+    Parsed minInt("{\"send_at\":-9223372036854775808,\"id\":-0,\"repeat\":0.0}");
+    TEST_ASSERT_TRUE(minInt.error == ApiParseError::Ok);
+    TEST_ASSERT_TRUE(minInt.req.getInt<int64_t>(ApiField::SendAt) == INT64_MIN);
+    TEST_ASSERT_TRUE(minInt.req.type(ApiField::Id) == ApiValueType::Integer);
+    TEST_ASSERT_EQUAL(0, minInt.req.getInt<int>(ApiField::Id, 1));
+    TEST_ASSERT_EQUAL(0, minInt.req.getInt<int>(ApiField::Repeat, 1));
+}
+
+static ApiParseError parseError(const char *json) {
+    Parsed p(json);
+    return p.error;
+}
+
+#define TEST_ASSERT_PARSE_ERROR(expected, json) TEST_ASSERT_EQUAL_STRING(expected, apiParseErrorName(parseError(json)))
+
+void test_parse_errors(void) {
+    ApiRequest req;
+    TEST_ASSERT_TRUE(parseApiRequest(nullptr, &req) == ApiParseError::EmptyInput);
+    TEST_ASSERT_PARSE_ERROR("EmptyInput", "");
+    TEST_ASSERT_PARSE_ERROR("EmptyInput", " \r\n\t");
+
+    TEST_ASSERT_PARSE_ERROR("IncompleteInput", "{");
+    TEST_ASSERT_PARSE_ERROR("IncompleteInput", "{\"type\"");
+    TEST_ASSERT_PARSE_ERROR("IncompleteInput", "{\"type\":");
+    TEST_ASSERT_PARSE_ERROR("IncompleteInput", "{\"type\":\"do");
+    TEST_ASSERT_PARSE_ERROR("IncompleteInput", "{\"type\":\"dock\"");
+    TEST_ASSERT_PARSE_ERROR("IncompleteInput", "{\"type\":\"dock\",");
+    TEST_ASSERT_PARSE_ERROR("IncompleteInput", "{\"id\":-");
+    TEST_ASSERT_PARSE_ERROR("IncompleteInput", "{\"id\":1.");
+    TEST_ASSERT_PARSE_ERROR("IncompleteInput", "{\"id\":1e");
+    TEST_ASSERT_PARSE_ERROR("IncompleteInput", "{\"resume\":tr");
+    TEST_ASSERT_PARSE_ERROR("IncompleteInput", "{\"code\":\"\\u00");
+    TEST_ASSERT_PARSE_ERROR("IncompleteInput", "{\"code\":\"\\ud83d");
+    TEST_ASSERT_PARSE_ERROR("IncompleteInput", "{\"code\":\"\\");
+    TEST_ASSERT_PARSE_ERROR("IncompleteInput", "[1,[2,");
+
+    TEST_ASSERT_PARSE_ERROR("InvalidInput", "garbage");
+    TEST_ASSERT_PARSE_ERROR("InvalidInput", "{type:\"dock\"}");
+    TEST_ASSERT_PARSE_ERROR("InvalidInput", "{'type':'dock'}");
+    TEST_ASSERT_PARSE_ERROR("InvalidInput", "{\"type\" \"dock\"}");
+    TEST_ASSERT_PARSE_ERROR("InvalidInput", "{\"type\":\"dock\" \"id\":1}");
+    TEST_ASSERT_PARSE_ERROR("InvalidInput", "{\"type\":\"dock\",}");
+    TEST_ASSERT_PARSE_ERROR("InvalidInput", "{\"id\":01}");
+    TEST_ASSERT_PARSE_ERROR("InvalidInput", "{\"id\":+1}");
+    TEST_ASSERT_PARSE_ERROR("InvalidInput", "{\"id\":.5}");
+    TEST_ASSERT_PARSE_ERROR("InvalidInput", "{\"id\":1.e3}");
+    TEST_ASSERT_PARSE_ERROR("InvalidInput", "{\"resume\":True}");
+    TEST_ASSERT_PARSE_ERROR("InvalidInput", "{\"resume\":nul}");
+    TEST_ASSERT_PARSE_ERROR("InvalidInput", "{\"code\":\"\\x\"}");
+    TEST_ASSERT_PARSE_ERROR("InvalidInput", "{\"code\":\"\\u12g4\"}");
+    TEST_ASSERT_PARSE_ERROR("InvalidInput", "{\"code\":\"\\udc00\"}");
+    TEST_ASSERT_PARSE_ERROR("InvalidInput", "{\"code\":\"\\ud83dx\\ude00\"}");
+    TEST_ASSERT_PARSE_ERROR("InvalidInput", "{\"code\":\"a\nb\"}");
+    TEST_ASSERT_PARSE_ERROR("InvalidInput", "[1 2]");
+    TEST_ASSERT_PARSE_ERROR("InvalidInput", "[1,]");
+
+    // nesting limit, including the root object
+    TEST_ASSERT_PARSE_ERROR("Ok", "{\"a\":[[[[[[[[{}]]]]]]]]}");
+    TEST_ASSERT_PARSE_ERROR("TooDeep", "{\"a\":[[[[[[[[[{}]]]]]]]]]}");
+    TEST_ASSERT_PARSE_ERROR("TooDeep", "[[[[[[[[[[[");
+}
+
+// Response code of the request header checks in API::processRequest: auth, message type, command and source.
+static int responseCode(const char *json, uint8_t source, bool authenticated) {
+    Parsed p(json);
+    if (p.error != ApiParseError::Ok) {
+        return 500;
+    }
+    const ApiRequest &req = p.req;
+    const char       *type = req.getString(ApiField::Type);
+    const char       *command = req.getString(ApiField::Command, "");
+    if (type && strcmp(type, "auth") == 0) {
+        return strcmp(req.getString(ApiField::Token, ""), "0815") == 0 ? 200 : 401;
+    }
+    const ApiCommandInfo &info = apiCommandInfo(findApiCommand(command));
+    bool                  isDock = type && strcmp(type, "dock") == 0;
+    if (!authenticated && !(isDock && (info.flags & API_CMD_PUBLIC))) {
+        return 401;
+    }
+    if (!isDock) {
+        return 400;
+    }
+    if (*command == '\0' && strcmp(req.getString(ApiField::Msg, ""), "ping") == 0) {
+        return 0;
+    }
+    if (info.command == ApiCommand::Unknown) {
+        return 400;
+    }
+    if (!isApiCommandAllowed(info, source, true)) {
+        return 403;
+    }
+    return 200;
+}
+
+void test_responseCodes(void) {
+    TEST_ASSERT_EQUAL(200, responseCode("{\"type\":\"auth\",\"token\":\"0815\"}", API_CMD_SRC_WS, false));
+    TEST_ASSERT_EQUAL(401, responseCode("{\"type\":\"auth\",\"token\":\"0816\"}", API_CMD_SRC_WS, false));
+    TEST_ASSERT_EQUAL(401, responseCode("{\"type\":\"auth\",\"token\":815}", API_CMD_SRC_WS, false));
+    TEST_ASSERT_EQUAL(401, responseCode("{\"type\":\"auth\"}", API_CMD_SRC_WS, false));
+    TEST_ASSERT_EQUAL(200, responseCode("{\"type\":\"dock\",\"command\":\"get_sysinfo\"}", API_CMD_SRC_WS, false));
+    TEST_ASSERT_EQUAL(401, responseCode("{\"type\":\"dock\",\"command\":\"ir_send\"}", API_CMD_SRC_WS, false));
+    TEST_ASSERT_EQUAL(200, responseCode("{\"type\":\"dock\",\"command\":\"ir_send\"}", API_CMD_SRC_WS, true));
+    TEST_ASSERT_EQUAL(200, responseCode("{\"command\":\"ir_send\",\"type\":\"dock\"}", API_CMD_SRC_BT, true));
+    TEST_ASSERT_EQUAL(400, responseCode("{\"type\":\"other\",\"command\":\"ir_send\"}", API_CMD_SRC_WS, true));
+    TEST_ASSERT_EQUAL(400, responseCode("{\"command\":\"ir_send\"}", API_CMD_SRC_WS, true));
+    TEST_ASSERT_EQUAL(400, responseCode("{\"type\":\"dock\",\"command\":\"ir_sendx\"}", API_CMD_SRC_WS, true));
+    TEST_ASSERT_EQUAL(400, responseCode("{\"type\":\"dock\"}", API_CMD_SRC_WS, true));
+    TEST_ASSERT_EQUAL(400, responseCode("{\"type\":\"dock\",\"command\":7}", API_CMD_SRC_WS, true));
+    TEST_ASSERT_EQUAL(0, responseCode("{\"type\":\"dock\",\"msg\":\"ping\"}", API_CMD_SRC_WS, true));
+    TEST_ASSERT_EQUAL(500, responseCode("{\"type\":\"dock\",", API_CMD_SRC_WS, true));
+    TEST_ASSERT_EQUAL(200, responseCode("{\"type\":\"dock\",\"command\":\"reboot\",\"x\":{\"type\":\"auth\"}}",
+                                        API_CMD_SRC_UART, true));
+}
+
+static const char *benchmarkRequest =
+    "{\"type\":\"dock\",\"id\":123,\"command\":\"ir_send\",\"code\":\"3;0x20DF10EF;32;0\",\"format\":\"hex\","
+    "\"repeat\":2,\"int_side\":true,\"int_top\":false,\"ext1\":false,\"ext2\":true}";
+
+// Lookups of processRequest for an ir_send request
+static int readWithTokenizer(char *buf) {
+    ApiRequest req;
+    if (parseApiRequest(buf, &req) != ApiParseError::Ok) {
+        return -1;
+    }
+    int sum = req.getInt<int>(ApiField::Id) + req.getInt<uint16_t>(ApiField::Repeat);
+    sum += strlen(req.getString(ApiField::Type, "")) + strlen(req.getString(ApiField::Command, ""));
+    sum += req.getStringLength(ApiField::Code) + strlen(req.getString(ApiField::Format, ""));
+    sum += req.getBool(ApiField::IntSide) + req.getBool(ApiField::IntTop) + req.getBool(ApiField::Ext1) +
+           req.getBool(ApiField::Ext2) + req.getInt<int64_t>(ApiField::SendAt);
+    return sum;
+}
+
+#ifdef HAVE_ARDUINOJSON
+static int readWithArduinoJson(char *buf) {
+    StaticJsonDocument<200> doc;
+    if (deserializeJson(doc, buf)) {
+        return -1;
+    }
+    int sum = doc["id"].as<int>() + doc["repeat"].as<uint16_t>();
+    sum += strlen(doc["type"] | "") + strlen(doc["command"] | "");
+    sum += doc["code"].as<JsonString>().size() + strlen(doc["format"] | "");
+    sum += doc["int_side"].as<bool>() + doc["int_top"].as<bool>() + doc["ext1"].as<bool>() + doc["ext2"].as<bool>() +
+           doc["send_at"].as<int64_t>();
+    return sum;
+}
+#endif
+
+template <typename F>
+static double nsPerRequest(F read, int rounds) {
+    size_t        len = strlen(benchmarkRequest) + 1;
+    char          buf[512];
+    volatile long sink = 0;
+    auto          start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        // the parsers modify the buffer
+        memcpy(buf, benchmarkRequest, len);
+        sink = sink + read(buf);
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    return static_cast<double>(elapsed.count()) / rounds;
+}
+
+void test_benchmarkParsing(void) {
+    const int rounds = 200000;
+    char      buf[512];
+    strcpy(buf, benchmarkRequest);
+    TEST_ASSERT_EQUAL(123 + 2 + 4 + 7 + 17 + 3 + 2, readWithTokenizer(buf));
+
+    char msg[120];
+#ifdef HAVE_ARDUINOJSON
+    strcpy(buf, benchmarkRequest);
+    TEST_ASSERT_EQUAL(123 + 2 + 4 + 7 + 17 + 3 + 2, readWithArduinoJson(buf));
+    double tokenizer = nsPerRequest(readWithTokenizer, rounds);
+    double arduinoJson = nsPerRequest(readWithArduinoJson, rounds);
+    snprintf(msg, sizeof(msg), "ir_send request: tokenizer %.1fns, ArduinoJson %.1fns", tokenizer, arduinoJson);
+#else
+    double tokenizer = nsPerRequest(readWithTokenizer, rounds);
+    snprintf(msg, sizeof(msg), "ir_send request: tokenizer %.1fns, ArduinoJson not available", tokenizer);
+#endif
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_findApiField);
+    RUN_TEST(test_parse_dockRequests);
+    RUN_TEST(test_parse_unknownFields);
+    RUN_TEST(test_parse_strings);
+    RUN_TEST(test_parse_numbers);
+    RUN_TEST(test_parse_errors);
+    RUN_TEST(test_responseCodes);
+    RUN_TEST(test_benchmarkParsing);
+
+    UNITY_END();
+}
@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <unity.h>
+
+#include "api_topics.hpp"
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+void test_parseApiTopics(void) {
+    uint8_t topics = 0xFF;
+    TEST_ASSERT_TRUE(parseApiTopics("ir_receive", &topics));
+    TEST_ASSERT_EQUAL(apiTopicBit(ApiTopic::IrReceive), topics);
+    TEST_ASSERT_TRUE(parseApiTopics("state, metrics", &topics));
+    TEST_ASSERT_EQUAL(apiTopicBit(ApiTopic::State) | apiTopicBit(ApiTopic::Metrics), topics);
+    TEST_ASSERT_TRUE(parseApiTopics(" metrics ,ir_receive,metrics", &topics));
+    TEST_ASSERT_EQUAL(apiTopicBit(ApiTopic::IrReceive) | apiTopicBit(ApiTopic::Metrics), topics);
+    TEST_ASSERT_TRUE(parseApiTopics("", &topics));
+    TEST_ASSERT_EQUAL(0, topics);
+}
+
+void test_parseApiTopics_invalid(void) {
+    uint8_t topics = 0x55;
+    TEST_ASSERT_FALSE(parseApiTopics(nullptr, &topics));
+    TEST_ASSERT_FALSE(parseApiTopics("foo", &topics));
+    TEST_ASSERT_FALSE(parseApiTopics("stat", &topics));
+    TEST_ASSERT_FALSE(parseApiTopics("states", &topics));
+    TEST_ASSERT_FALSE(parseApiTopics("state,,metrics", &topics));
+    TEST_ASSERT_FALSE(parseApiTopics("state,", &topics));
+    TEST_ASSERT_FALSE(parseApiTopics("state metrics", &topics));
+    TEST_ASSERT_EQUAL(0x55, topics);
+}
+
+void test_formatApiTopics(void) {
+    char buffer[32];
+    TEST_ASSERT_TRUE(formatApiTopics(0, buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_STRING("", buffer);
+    TEST_ASSERT_TRUE(formatApiTopics(apiTopicBit(ApiTopic::Metrics) | apiTopicBit(ApiTopic::IrReceive), buffer,
+                                     sizeof(buffer)));
+    TEST_ASSERT_EQUAL_STRING("ir_receive,metrics", buffer);
+
+    uint8_t topics;
+    TEST_ASSERT_TRUE(formatApiTopics(0xFF, buffer, sizeof(buffer)));
+    TEST_ASSERT_TRUE(parseApiTopics(buffer, &topics));
+    TEST_ASSERT_EQUAL((1 << static_cast<int>(ApiTopic::Count)) - 1, topics);
+
+    // "ir_receive,state" doesn't fit with the terminator
+    TEST_ASSERT_FALSE(formatApiTopics(apiTopicBit(ApiTopic::IrReceive) | apiTopicBit(ApiTopic::State), buffer, 16));
+    TEST_ASSERT_TRUE(formatApiTopics(apiTopicBit(ApiTopic::IrReceive) | apiTopicBit(ApiTopic::State), buffer, 17));
+    TEST_ASSERT_FALSE(formatApiTopics(0, buffer, 0));
+}
+
+void test_clientSet(void) {
+    ClientSet<5> set;
+    TEST_ASSERT_TRUE(set.empty());
+    set.insert(0);
+    set.insert(4);
+    set.insert(4);
+    set.insert(5);  // ignored
+    TEST_ASSERT_EQUAL(2, set.size());
+    TEST_ASSERT_TRUE(set.contains(4));
+    TEST_ASSERT_FALSE(set.contains(1));
+    TEST_ASSERT_FALSE(set.contains(5));
+    set.erase(0);
+    set.erase(200);
+    TEST_ASSERT_EQUAL(1, set.size());
+
+    ClientSet<5> both = ClientSet<5>::all() & ClientSet<5>::of(4);
+    TEST_ASSERT_EQUAL(1, both.size());
+    TEST_ASSERT_TRUE(both.contains(4));
+    TEST_ASSERT_EQUAL(5, ClientSet<5>::all().size());
+    TEST_ASSERT_EQUAL(32, ClientSet<32>::all().size());
+    set.clear();
+    TEST_ASSERT_TRUE(set.empty());
+}
+
+void test_topicSubscriptions(void) {
+    TopicSubscriptions<5> subscriptions;
+    subscriptions.subscribe(1, apiTopicBit(ApiTopic::IrReceive) | apiTopicBit(ApiTopic::State));
+    subscriptions.subscribe(3, apiTopicBit(ApiTopic::State));
+    TEST_ASSERT_EQUAL(1, subscriptions.subscribers(ApiTopic::IrReceive).size());
+    TEST_ASSERT_EQUAL(2, subscriptions.subscribers(ApiTopic::State).size());
+    TEST_ASSERT_TRUE(subscriptions.subscribers(ApiTopic::Metrics).empty());
+    TEST_ASSERT_EQUAL(apiTopicBit(ApiTopic::IrReceive) | apiTopicBit(ApiTopic::State), subscriptions.topics(1));
+
+    subscriptions.unsubscribe(1, apiTopicBit(ApiTopic::State));
+    TEST_ASSERT_EQUAL(apiTopicBit(ApiTopic::IrReceive), subscriptions.topics(1));
+    TEST_ASSERT_FALSE(subscriptions.subscribers(ApiTopic::State).contains(1));
+
+    subscriptions.removeClient(3);
+    TEST_ASSERT_EQUAL(0, subscriptions.topics(3));
+    TEST_ASSERT_TRUE(subscriptions.subscribers(ApiTopic::State).empty());
+    TEST_ASSERT_EQUAL(0, subscriptions.topics(4));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_parseApiTopics);
+    RUN_TEST(test_parseApiTopics_invalid);
+    RUN_TEST(test_formatApiTopics);
+    RUN_TEST(test_clientSet);
+    RUN_TEST(test_topicSubscriptions);
+
+    UNITY_END();
+
+    return 0;
+}
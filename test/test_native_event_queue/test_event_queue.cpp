@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <unity.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "event_queue.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+void test_postPop(void) {
+    SocketEventQueue<int, 4> queue;
+    TEST_ASSERT_EQUAL(0, queue.open());
+    TEST_ASSERT_TRUE(queue.isOpen());
+    TEST_ASSERT_TRUE(queue.post(1));
+    TEST_ASSERT_TRUE(queue.post(2));
+    TEST_ASSERT_EQUAL(2, queue.pending());
+
+    int event = 0;
+    TEST_ASSERT_TRUE(queue.pop(&event));
+    TEST_ASSERT_EQUAL(1, event);
+    TEST_ASSERT_TRUE(queue.post(3));
+    TEST_ASSERT_TRUE(queue.pop(&event));
+    TEST_ASSERT_EQUAL(2, event);
+    TEST_ASSERT_TRUE(queue.pop(&event));
+    TEST_ASSERT_EQUAL(3, event);
+    TEST_ASSERT_FALSE(queue.pop(&event));
+    TEST_ASSERT_EQUAL(0, queue.pending());
+}
+
+void test_postFull(void) {
+    SocketEventQueue<int, 2> queue;
+    TEST_ASSERT_EQUAL(0, queue.open());
+    TEST_ASSERT_TRUE(queue.post(1));
+    TEST_ASSERT_TRUE(queue.post(2));
+    TEST_ASSERT_FALSE(queue.post(3));
+    TEST_ASSERT_EQUAL(2, queue.pending());
+
+    int event = 0;
+    TEST_ASSERT_TRUE(queue.pop(&event));
+    TEST_ASSERT_TRUE(queue.post(4));
+    TEST_ASSERT_TRUE(queue.pop(&event));
+    TEST_ASSERT_EQUAL(2, event);
+    TEST_ASSERT_TRUE(queue.pop(&event));
+    TEST_ASSERT_EQUAL(4, event);
+}
+
+void test_postClosed(void) {
+    SocketEventQueue<int, 2> queue;
+    TEST_ASSERT_FALSE(queue.isOpen());
+    TEST_ASSERT_FALSE(queue.post(1));
+
+    TEST_ASSERT_EQUAL(0, queue.open());
+    TEST_ASSERT_TRUE(queue.post(1));
+    queue.close();
+    TEST_ASSERT_FALSE(queue.isOpen());
+    TEST_ASSERT_EQUAL(0, queue.pending());
+    TEST_ASSERT_FALSE(queue.post(2));
+
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    TEST_ASSERT_EQUAL(-1, queue.addTo(&readSet, -1));
+    TEST_ASSERT_FALSE(queue.woken(&readSet));
+}
+
+void test_waitTimeout(void) {
+    SocketEventQueue<int, 2> queue;
+    TEST_ASSERT_EQUAL(0, queue.open());
+
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    auto start = Clock::now();
+    TEST_ASSERT_EQUAL(0, queue.wait(&readSet, -1, 20));
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+    TEST_ASSERT_TRUE(elapsed.count() >= 15);
+    TEST_ASSERT_FALSE(queue.woken(&readSet));
+}
+
+void test_wakeOnce(void) {
+    SocketEventQueue<int, 4> queue;
+    TEST_ASSERT_EQUAL(0, queue.open());
+    TEST_ASSERT_TRUE(queue.post(1));
+    TEST_ASSERT_TRUE(queue.post(2));
+
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    TEST_ASSERT_EQUAL(1, queue.wait(&readSet, -1, 1000));
+    TEST_ASSERT_TRUE(queue.woken(&readSet));
+    int event;
+    while (queue.pop(&event)) {
+    }
+
+    // the wake-up has been reset
+    FD_ZERO(&readSet);
+    TEST_ASSERT_EQUAL(0, queue.wait(&readSet, -1, 0));
+    TEST_ASSERT_FALSE(queue.woken(&readSet));
+}
+
+void test_waitSocket(void) {
+    SocketEventQueue<int, 2> queue;
+    TEST_ASSERT_EQUAL(0, queue.open());
+    int fds[2];
+    TEST_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    TEST_ASSERT_EQUAL(1, write(fds[1], "x", 1));
+
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(fds[0], &readSet);
+    TEST_ASSERT_EQUAL(1, queue.wait(&readSet, fds[0], 1000));
+    TEST_ASSERT_TRUE(FD_ISSET(fds[0], &readSet));
+    TEST_ASSERT_FALSE(queue.woken(&readSet));
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void test_waitWritable(void) {
+    SocketEventQueue<int, 2> queue;
+    TEST_ASSERT_EQUAL(0, queue.open());
+    int fds[2];
+    TEST_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL, 0) | O_NONBLOCK);
+
+    fd_set readSet;
+    fd_set writeSet;
+    FD_ZERO(&readSet);
+    FD_ZERO(&writeSet);
+    FD_SET(fds[1], &writeSet);
+    TEST_ASSERT_EQUAL(1, queue.wait(&readSet, fds[1], 1000, &writeSet));
+    TEST_ASSERT_TRUE(FD_ISSET(fds[1], &writeSet));
+    TEST_ASSERT_FALSE(queue.woken(&readSet));
+
+    // fill the send buffer: the socket isn't writable until the peer reads
+    char data[1024] = {};
+    while (write(fds[1], data, sizeof(data)) > 0) {
+    }
+    FD_ZERO(&readSet);
+    FD_SET(fds[1], &writeSet);
+    TEST_ASSERT_EQUAL(0, queue.wait(&readSet, fds[1], 10, &writeSet));
+    TEST_ASSERT_FALSE(FD_ISSET(fds[1], &writeSet));
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void test_wakeFromOtherThread(void) {
+    SocketEventQueue<int, 4> queue;
+    TEST_ASSERT_EQUAL(0, queue.open());
+
+    std::thread producer([&queue]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        queue.post(42);
+    });
+
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    TEST_ASSERT_EQUAL(1, queue.wait(&readSet, -1, 5000));
+    TEST_ASSERT_TRUE(queue.woken(&readSet));
+    int event = 0;
+    TEST_ASSERT_TRUE(queue.pop(&event));
+    TEST_ASSERT_EQUAL(42, event);
+    producer.join();
+}
+
+// Simulated work of the other services in the main loop, e.g. Wi-Fi checks, mDNS and OTA: mostly short, with an
+// occasional blocking call like a Wi-Fi reconnect or a serial read timeout.
+static void serviceWork(int iteration) {
+    std::this_thread::sleep_for(std::chrono::microseconds(iteration % 50 == 0 ? 20000 : 500));
+}
+
+static void runServices(std::atomic<bool> *done) {
+    for (int i = 0; !done->load(); i++) {
+        serviceWork(i);
+    }
+}
+
+static void reportLatency(const char *name, std::vector<int64_t> *latencies) {
+    std::sort(latencies->begin(), latencies->end());
+    size_t  count = latencies->size();
+    int64_t sum = 0;
+    for (int64_t latency : *latencies) {
+        sum += latency;
+    }
+    char msg[120];
+    snprintf(msg, sizeof(msg), "%s: avg=%lldus p50=%lldus p99=%lldus max=%lldus", name,
+             static_cast<long long>(sum / count), static_cast<long long>((*latencies)[count / 2]),
+             static_cast<long long>((*latencies)[count * 99 / 100]), static_cast<long long>(latencies->back()));
+    TEST_MESSAGE(msg);
+}
+
+#define LATENCY_EVENTS 300
+#define LATENCY_EVENT_INTERVAL_US 700
+
+// Post timestamped events in a fixed interval, like IR responses or received requests
+static void produceEvents(SocketEventQueue<Clock::time_point, 16> *queue, std::atomic<bool> *done) {
+    for (int i = 0; i < LATENCY_EVENTS; i++) {
+        while (!queue->post(Clock::now())) {
+            std::this_thread::yield();
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(LATENCY_EVENT_INTERVAL_US));
+    }
+    done->store(true);
+}
+
+static void popEvents(SocketEventQueue<Clock::time_point, 16> *queue, std::vector<int64_t> *latencies) {
+    Clock::time_point posted;
+    while (queue->pop(&posted)) {
+        latencies->push_back(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - posted).count());
+    }
+}
+
+// Event latency under load: polling the events in a loop together with the other services, compared to a dedicated
+// task waiting for the events.
+void test_latencyUnderLoad(void) {
+    std::vector<int64_t> polling;
+    std::vector<int64_t> dedicated;
+
+    {
+        SocketEventQueue<Clock::time_point, 16> queue;
+        TEST_ASSERT_EQUAL(0, queue.open());
+        std::atomic<bool> done(false);
+        std::thread       producer(produceEvents, &queue, &done);
+        for (int i = 0; !done.load() || queue.pending(); i++) {
+            popEvents(&queue, &polling);
+            serviceWork(i);
+        }
+        producer.join();
+    }
+
+    {
+        SocketEventQueue<Clock::time_point, 16> queue;
+        TEST_ASSERT_EQUAL(0, queue.open());
+        std::atomic<bool> done(false);
+        std::thread       producer(produceEvents, &queue, &done);
+        std::thread       services(runServices, &done);
+        while (!done.load() || queue.pending()) {
+            fd_set readSet;
+            FD_ZERO(&readSet);
+            if (queue.wait(&readSet, -1, 10) > 0 && queue.woken(&readSet)) {
+                popEvents(&queue, &dedicated);
+            }
+        }
+        producer.join();
+        services.join();
+    }
+
+    TEST_ASSERT_EQUAL(LATENCY_EVENTS, polling.size());
+    TEST_ASSERT_EQUAL(LATENCY_EVENTS, dedicated.size());
+    reportLatency("polling loop", &polling);
+    reportLatency("dedicated task", &dedicated);
+    // the polling loop waits for the services in every iteration
+    TEST_ASSERT_TRUE(dedicated[LATENCY_EVENTS / 2] < polling[LATENCY_EVENTS / 2]);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_postPop);
+    RUN_TEST(test_postFull);
+    RUN_TEST(test_postClosed);
+    RUN_TEST(test_waitTimeout);
+    RUN_TEST(test_wakeOnce);
+    RUN_TEST(test_waitSocket);
+    RUN_TEST(test_waitWritable);
+    RUN_TEST(test_wakeFromOtherThread);
+    RUN_TEST(test_latencyUnderLoad);
+
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,436 @@
+#include <stdio.h>
+#include <unity.h>
+
+#include <chrono>
+#include <string>
+#include <utility>
+
+#include "gc_ir_code.hpp"
+#include "globalcache.hpp"
+
+// NEC code with a repeat frame, 36 timing pairs
+static const char *SENDIR =
+    "sendir,1:2,42,38000,1,69,340,171,21,21,21,21,21,65,21,21,21,21,21,21,21,21,21,21,21,65,21,65,21,21,21,65,21,65,"
+    "21,65,21,65,21,65,21,21,21,65,21,21,21,21,21,21,21,21,21,21,21,21,21,65,21,21,21,65,21,65,21,65,21,65,21,65,21,"
+    "65,21,1555,340,86,21,3678";
+
+// same code in the compressed format: A=340,171 B=21,21 C=21,65
+static const char *SENDIR_COMPRESSED =
+    "sendir,1:2,42,38000,1,69,340,171,21,21,B,21,65,BBBBBCCBCCCCCBCBBBBBBCBCCCCCC,21,1555,340,86,21,3678";
+
+#define LEARN_BUFFER_SIZE 1024
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+void test_parseGcIrCode_nullInput(void) {
+    GCIrCode code;
+    TEST_ASSERT_EQUAL(1, parseGcIrCode(nullptr, &code));
+    TEST_ASSERT_EQUAL(1, parseGcIrCode(SENDIR, nullptr));
+}
+
+void test_parseGcIrCode_full(void) {
+    GCIrCode code;
+    int      memError = 1;
+    TEST_ASSERT_EQUAL(0, parseGcIrCode(SENDIR, &code, &memError));
+    TEST_ASSERT_EQUAL(0, memError);
+    TEST_ASSERT_TRUE(code.isValid());
+    TEST_ASSERT_EQUAL(1, code.module);
+    TEST_ASSERT_EQUAL(2, code.port);
+    TEST_ASSERT_EQUAL(42, code.id);
+    TEST_ASSERT_EQUAL(38000, code.frequency());
+    TEST_ASSERT_EQUAL(1, code.repeat());
+    TEST_ASSERT_EQUAL(69, code.offset());
+    TEST_ASSERT_EQUAL(72, code.timingCount());
+    TEST_ASSERT_EQUAL(75, code.count);
+    TEST_ASSERT_EQUAL(340, code.timings()[0]);
+    TEST_ASSERT_EQUAL(3678, code.data[code.count - 1]);
+}
+
+void test_parseGcIrCode_short(void) {
+    GCIrCode code;
+    TEST_ASSERT_EQUAL(0, parseGcIrCode("40000,3,1,100,200,300,400", &code));
+    TEST_ASSERT_EQUAL(1, code.module);
+    TEST_ASSERT_EQUAL(1, code.port);
+    TEST_ASSERT_EQUAL(0, code.id);
+    TEST_ASSERT_EQUAL(40000, code.frequency());
+    TEST_ASSERT_EQUAL(3, code.repeat());
+    TEST_ASSERT_EQUAL(4, code.timingCount());
+    TEST_ASSERT_EQUAL(400, code.timings()[3]);
+}
+
+void test_parseGcIrCode_errors(void) {
+    GCIrCode code;
+    TEST_ASSERT_EQUAL(2, parseGcIrCode("sendir,2:1,1,38000,1,1,10,10", &code));
+    TEST_ASSERT_EQUAL(3, parseGcIrCode("sendir,1:0,1,38000,1,1,10,10", &code));
+    TEST_ASSERT_EQUAL(3, parseGcIrCode("sendir,1:16,1,38000,1,1,10,10", &code));
+    TEST_ASSERT_EQUAL(3, parseGcIrCode("sendir,1:x,1,38000,1,1,10,10", &code));
+    TEST_ASSERT_EQUAL(4, parseGcIrCode("sendir,1:1,65536,38000,1,1,10,10", &code));
+    TEST_ASSERT_EQUAL(4, parseGcIrCode("sendir,1:1,abc,38000,1,1,10,10", &code));
+    TEST_ASSERT_EQUAL(5, parseGcIrCode("sendir,1:1,1,1000,1,1,10,10", &code));
+    TEST_ASSERT_EQUAL(5, parseGcIrCode("sendir,1:1,1,455000,1,1,10,10", &code));
+    TEST_ASSERT_EQUAL(6, parseGcIrCode("sendir,1:1,1,38000,0,1,10,10", &code));
+    TEST_ASSERT_EQUAL(6, parseGcIrCode("sendir,1:1,1,38000,51,1,10,10", &code));
+    TEST_ASSERT_EQUAL(7, parseGcIrCode("sendir,1:1,1,38000,1,2,10,10", &code));
+    TEST_ASSERT_EQUAL(7, parseGcIrCode("sendir,1:1,1,38000,1,3,10,10", &code));
+    TEST_ASSERT_EQUAL(8, parseGcIrCode("sendir,1:1,1,38000,1,1", &code));
+    TEST_ASSERT_EQUAL(9, parseGcIrCode("sendir,1:1,1,38000,1,1,10,0", &code));
+    TEST_ASSERT_EQUAL(9, parseGcIrCode("sendir,1:1,1,38000,1,1,10,10,", &code));
+    TEST_ASSERT_EQUAL(9, parseGcIrCode("sendir,1:1,1,38000,1,1,10,1x", &code));
+    TEST_ASSERT_EQUAL(10, parseGcIrCode("sendir,1:1,1,38000,1,1,10,10,10", &code));
+}
+
+void test_gcIrCode_move(void) {
+    GCIrCode code;
+    TEST_ASSERT_EQUAL(0, parseGcIrCode(SENDIR, &code));
+    uint16_t *data = code.data;
+
+    GCIrCode moved(std::move(code));
+    TEST_ASSERT_EQUAL_PTR(data, moved.data);
+    TEST_ASSERT_FALSE(code.isValid());
+    TEST_ASSERT_EQUAL(0, code.frequency());
+    TEST_ASSERT_NULL(code.timings());
+
+    GCIrCode assigned;
+    assigned = std::move(moved);
+    TEST_ASSERT_EQUAL_PTR(data, assigned.data);
+    TEST_ASSERT_EQUAL(42, assigned.id);
+}
+
+void test_gcIrCode_equals(void) {
+    GCIrCode a, b, c;
+    parseGcIrCode(SENDIR, &a);
+    parseGcIrCode(SENDIR, &b);
+    TEST_ASSERT_TRUE(a == b);
+    std::string other(SENDIR);
+    other[other.size() - 1] = '9';
+    parseGcIrCode(other.c_str(), &c);
+    TEST_ASSERT_TRUE(a != c);
+    TEST_ASSERT_TRUE(GCIrCode() == GCIrCode());
+}
+
+void test_parseGcIrCode_compressed(void) {
+    GCIrCode plain, compressed;
+    TEST_ASSERT_EQUAL(0, parseGcIrCode(SENDIR, &plain));
+    TEST_ASSERT_EQUAL(0, parseGcIrCode(SENDIR_COMPRESSED, &compressed));
+    TEST_ASSERT_EQUAL(75, compressed.count);
+    TEST_ASSERT_TRUE(plain == compressed);
+
+    // separators around symbols are optional
+    TEST_ASSERT_EQUAL(0, parseGcIrCode("40000,1,1,10,20,30,40,A,B,A,10,20", &compressed));
+    TEST_ASSERT_EQUAL(0, parseGcIrCode("40000,1,1,10,20,30,40ABA10,20", &plain));
+    TEST_ASSERT_TRUE(plain == compressed);
+    TEST_ASSERT_EQUAL(12, plain.timingCount());
+    TEST_ASSERT_EQUAL(30, plain.timings()[6]);
+    TEST_ASSERT_EQUAL(40, plain.timings()[7]);
+    TEST_ASSERT_EQUAL(10, plain.timings()[10]);
+}
+
+void test_parseGcIrCode_compressedErrors(void) {
+    GCIrCode code;
+    TEST_ASSERT_EQUAL(21, parseGcIrCode("40000,1,1,10,20,30,A,40", &code));
+    TEST_ASSERT_EQUAL(22, parseGcIrCode("40000,1,1,10,20,B", &code));
+    TEST_ASSERT_EQUAL(22, parseGcIrCode("40000,1,1,A,10,20", &code));
+    TEST_ASSERT_EQUAL(9, parseGcIrCode("40000,1,1,10,20,P", &code));
+    TEST_ASSERT_EQUAL(9, parseGcIrCode("40000,1,1,10,20,a", &code));
+    TEST_ASSERT_EQUAL(9, parseGcIrCode("40000,1,1,10,20,A,", &code));
+    TEST_ASSERT_EQUAL(9, parseGcIrCode("40000,1,1,10,20,,A", &code));
+}
+
+void test_parseGcIrCode_symbolLimit(void) {
+    // 16 unique pairs: only the first 15 get a symbol
+    std::string request = "40000,1,1";
+    for (int i = 1; i <= 16; i++) {
+        request += "," + std::to_string(i) + ",100";
+    }
+    GCIrCode code;
+    TEST_ASSERT_EQUAL(0, parseGcIrCode((request + ",O").c_str(), &code));
+    TEST_ASSERT_EQUAL(15, code.timings()[32]);
+    TEST_ASSERT_EQUAL(9, parseGcIrCode((request + ",P").c_str(), &code));
+
+    // the encoder writes the 16th pair explicitly
+    char buf[256];
+    TEST_ASSERT_EQUAL(0, parseGcIrCode((request + ",16,100,15,100").c_str(), &code));
+    TEST_ASSERT_TRUE(encodeGcIrCode(code, true, buf, sizeof(buf)) > 0);
+    std::string encoded = buf;
+    TEST_ASSERT_EQUAL_STRING("sendir,1:1,0,40000,1,1,1,100,2,100,3,100,4,100,5,100,6,100,7,100,8,100,9,100,10,100,"
+                             "11,100,12,100,13,100,14,100,15,100,16,100,16,100,O",
+                             encoded.c_str());
+}
+
+void test_encodeGcIrCode(void) {
+    GCIrCode code;
+    char     buf[512];
+    TEST_ASSERT_EQUAL(0, encodeGcIrCode(code, false, buf, sizeof(buf)));
+
+    TEST_ASSERT_EQUAL(0, parseGcIrCode(SENDIR, &code));
+    TEST_ASSERT_EQUAL(strlen(SENDIR), encodeGcIrCode(code, false, buf, sizeof(buf)));
+    std::string encoded = buf;
+    TEST_ASSERT_EQUAL_STRING(SENDIR, encoded.c_str());
+
+    TEST_ASSERT_EQUAL(strlen(SENDIR_COMPRESSED), encodeGcIrCode(code, true, buf, sizeof(buf)));
+    encoded = buf;
+    TEST_ASSERT_EQUAL_STRING(SENDIR_COMPRESSED, encoded.c_str());
+
+    // buffer too small
+    for (size_t size = 0; size <= strlen(SENDIR_COMPRESSED); size++) {
+        TEST_ASSERT_EQUAL(0, encodeGcIrCode(code, true, buf, size));
+    }
+    TEST_ASSERT_EQUAL(0, encodeGcIrCode(code, false, buf, strlen(SENDIR)));
+}
+
+void test_encodeGcSendir(void) {
+    const uint16_t data[] = {38000, 2, 1, 340, 171, 21, 21, 21, 65, 21, 21, 21, 1555};
+    char           buf[128];
+    size_t         len = encodeGcSendir(3, 7, data, 13, false, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("sendir,1:3,7,38000,2,1,340,171,21,21,21,65,21,21,21,1555", buf);
+    TEST_ASSERT_EQUAL(strlen(buf), len);
+    len = encodeGcSendir(3, 7, data, 13, true, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("sendir,1:3,7,38000,2,1,340,171,21,21,21,65,B,21,1555", buf);
+    TEST_ASSERT_EQUAL(strlen(buf), len);
+
+    TEST_ASSERT_EQUAL(0, encodeGcSendir(3, 7, nullptr, 13, false, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL(0, encodeGcSendir(3, 7, data, 3, false, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL(0, encodeGcSendir(3, 7, data, 13, false, buf, 40));
+}
+
+void test_convertToGcTimings(void) {
+    // 2us ticks: 9000us mark, 4500us space, 560us mark, 1690us space, 560us mark
+    const uint16_t raw[] = {4500, 2250, 280, 845, 280};
+    uint16_t       data[16];
+    uint16_t       count = convertToGcTimings(raw, 5, 2, 38000, 40000, data, 16);
+    TEST_ASSERT_EQUAL(GC_IR_TIMING_INDEX + 6, count);
+    TEST_ASSERT_EQUAL(38000, data[GC_IR_FREQ_INDEX]);
+    TEST_ASSERT_EQUAL(1, data[GC_IR_REPEAT_INDEX]);
+    TEST_ASSERT_EQUAL(1, data[GC_IR_OFFSET_INDEX]);
+    // rounded carrier cycles: 342, 171, 21.28, 64.22, 21.28 and the trailing gap
+    const uint16_t expected[] = {342, 171, 21, 64, 21, 1520};
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(expected, data + GC_IR_TIMING_INDEX, 6);
+
+    // no trailing gap for an even number of values
+    count = convertToGcTimings(raw, 4, 2, 38000, 40000, data, 16);
+    TEST_ASSERT_EQUAL(GC_IR_TIMING_INDEX + 4, count);
+    TEST_ASSERT_EQUAL(64, data[GC_IR_TIMING_INDEX + 3]);
+
+    // minimum of one cycle, maximum of 16 bit
+    const uint16_t extremes[] = {1, 65535};
+    count = convertToGcTimings(extremes, 2, 2, 56000, 0, data, 16);
+    TEST_ASSERT_EQUAL(GC_IR_TIMING_INDEX + 2, count);
+    TEST_ASSERT_EQUAL(1, data[GC_IR_TIMING_INDEX]);
+    TEST_ASSERT_EQUAL(7340, data[GC_IR_TIMING_INDEX + 1]);
+    count = convertToGcTimings(extremes, 2, 1000, 56000, 0, data, 16);
+    TEST_ASSERT_EQUAL(UINT16_MAX, data[GC_IR_TIMING_INDEX + 1]);
+
+    // invalid input or buffer too small
+    TEST_ASSERT_EQUAL(0, convertToGcTimings(nullptr, 5, 2, 38000, 40000, data, 16));
+    TEST_ASSERT_EQUAL(0, convertToGcTimings(raw, 0, 2, 38000, 40000, data, 16));
+    TEST_ASSERT_EQUAL(0, convertToGcTimings(raw, 5, 2, 0, 40000, data, 16));
+    TEST_ASSERT_EQUAL(0, convertToGcTimings(raw, 5, 2, 38000, 40000, data, 8));
+    TEST_ASSERT_EQUAL(0, convertToGcTimings(raw, 5, 2, 38000, 40000, nullptr, 16));
+}
+
+/// A learned code sent back with `sendir` reproduces the captured timings.
+void test_learnedCodeRoundTrip(void) {
+    // NEC capture in 2us ticks: header, 32 data bits, stop bit
+    uint16_t raw[67];
+    raw[0] = 4500;
+    raw[1] = 2250;
+    for (int i = 0; i < 32; i++) {
+        raw[2 + i * 2] = 280;
+        raw[3 + i * 2] = (0xA55A38C7 >> i) & 1 ? 845 : 280;
+    }
+    raw[66] = 280;
+
+    uint16_t data[80];
+    uint16_t count = convertToGcTimings(raw, 67, 2, 38000, 40000, data, 80);
+    TEST_ASSERT_EQUAL(GC_IR_TIMING_INDEX + 68, count);
+
+    for (int compress = 0; compress < 2; compress++) {
+        char   buf[LEARN_BUFFER_SIZE];
+        size_t len = encodeGcSendir(1, 0, data, count, compress, buf, sizeof(buf));
+        TEST_ASSERT_GREATER_THAN(0, len);
+
+        GCIrCode code;
+        TEST_ASSERT_EQUAL(0, parseGcIrCode(buf, &code));
+        TEST_ASSERT_EQUAL(1, code.port);
+        TEST_ASSERT_EQUAL(count, code.count);
+        TEST_ASSERT_EQUAL_UINT16_ARRAY(data, code.data, count);
+        for (int i = 0; i < 67; i++) {
+            // within one carrier cycle of the capture
+            int64_t us = static_cast<int64_t>(code.timings()[i]) * 1000000 / 38000;
+            TEST_ASSERT_INT_WITHIN(27, raw[i] * 2, us);
+        }
+    }
+    char buf[LEARN_BUFFER_SIZE];
+    std::string plain(buf, encodeGcSendir(1, 0, data, count, false, buf, sizeof(buf)));
+    std::string compressed(buf, encodeGcSendir(1, 0, data, count, true, buf, sizeof(buf)));
+    TEST_ASSERT_TRUE(compressed.size() < plain.size() / 2);
+}
+
+void test_gcIrCode_roundTrip(void) {
+    srand(42);
+    char buf[2048];
+    for (int n = 0; n < 500; n++) {
+        // random codes from a small set of timings to get repeated pairs
+        std::string request = "sendir,1:" + std::to_string(1 + rand() % 15) + "," + std::to_string(rand() % 65536) +
+                              "," + std::to_string(15000 + rand() % 50000) + "," + std::to_string(1 + rand() % 50);
+        int pairs = 1 + rand() % 100;
+        request += "," + std::to_string(1 + 2 * (rand() % pairs));
+        for (int i = 0; i < pairs; i++) {
+            request += "," + std::to_string(1 + rand() % 24) + "," + std::to_string(1 + rand() % 3 * 1000);
+        }
+
+        GCIrCode code, compressed, plain;
+        TEST_ASSERT_EQUAL(0, parseGcIrCode(request.c_str(), &code));
+        TEST_ASSERT_TRUE(encodeGcIrCode(code, true, buf, sizeof(buf)) > 0);
+        TEST_ASSERT_EQUAL(0, parseGcIrCode(buf, &compressed));
+        TEST_ASSERT_TRUE(code == compressed);
+        TEST_ASSERT_TRUE(encodeGcIrCode(code, false, buf, sizeof(buf)) > 0);
+        TEST_ASSERT_EQUAL(0, parseGcIrCode(buf, &plain));
+        TEST_ASSERT_TRUE(code == plain);
+        std::string encoded = buf;
+        TEST_ASSERT_EQUAL_STRING(request.c_str(), encoded.c_str());
+    }
+}
+
+/// Reference of the previous processing of a sendir command: parsed in the TCP server, scanned again in
+/// `sendGlobalCache`, copied twice into a string, converted to an array in the send task, and parsed again for the
+/// `completeir` response.
+static uint32_t legacyProcessing(const char *sendir) {
+    GCMsg req;
+    parseGcRequest(sendir, &req);
+    uint32_t msgId = atoi(req.param);
+
+    const char *next = strchr(sendir + 9, ',');
+    int         port = atoi(sendir + 9);
+    next = strchr(next + 1, ',');
+    next = strchr(next + 1, ',');
+    int repeat = atoi(next + 1);
+
+    std::string code = sendir;
+    std::string message = code;
+
+    // globalCacheBufferToArray
+    const char *msg = message.c_str();
+    uint16_t    count = 1;
+    for (const char *c = msg; *c; c++) {
+        if (*c == ',') {
+            count++;
+        }
+    }
+    count -= 3;
+    uint16_t *codeArray = reinterpret_cast<uint16_t *>(malloc(count * sizeof(uint16_t)));
+    int16_t   msgIndex = 0;
+    uint16_t  codeIndex = 0;
+    uint16_t  startFrom = 0;
+    count = 0;
+    while (msg[msgIndex] != 0) {
+        if (msg[msgIndex] == ',') {
+            if (count >= 3) {
+                codeArray[codeIndex++] = strtoul(msg + startFrom, NULL, 10);
+            }
+            startFrom = msgIndex + 1;
+            count++;
+        }
+        msgIndex++;
+    }
+    codeArray[codeIndex++] = strtoul(msg + startFrom, NULL, 10);
+    uint32_t result = codeArray[codeIndex - 1] + repeat + port + msgId;
+    free(codeArray);
+
+    parseGcRequest(message.c_str(), &req);
+    return result + req.port;
+}
+
+static uint32_t singleParse(const char *sendir) {
+    GCIrCode code;
+    parseGcIrCode(sendir, &code);
+    // move through the queue
+    GCIrCode queued(std::move(code));
+    return queued.data[queued.count - 1] + queued.repeat() + queued.port + queued.id + queued.port;
+}
+
+void test_benchmark(void) {
+    const int iterations = 20000;
+    uint32_t  check[2] = {0, 0};
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        check[0] += legacyProcessing(SENDIR);
+    }
+    auto legacy = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        check[1] += singleParse(SENDIR);
+    }
+    auto single = std::chrono::steady_clock::now() - start;
+
+    long long legacyNs = std::chrono::duration_cast<std::chrono::nanoseconds>(legacy).count() / iterations;
+    long long singleNs = std::chrono::duration_cast<std::chrono::nanoseconds>(single).count() / iterations;
+    char      msg[128];
+    snprintf(msg, sizeof(msg), "sendir processing: legacy=%lldns single parse=%lldns saved=%lldns per command",
+             legacyNs, singleNs, legacyNs - singleNs);
+    TEST_MESSAGE(msg);
+
+    // both read the same values
+    TEST_ASSERT_EQUAL(check[0], check[1]);
+    TEST_ASSERT_LESS_THAN(legacyNs, singleNs);
+}
+
+void test_benchmarkCompressed(void) {
+    const int iterations = 20000;
+    uint32_t  check[2] = {0, 0};
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        check[0] += singleParse(SENDIR);
+    }
+    auto plain = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        check[1] += singleParse(SENDIR_COMPRESSED);
+    }
+    auto compressed = std::chrono::steady_clock::now() - start;
+
+    long long plainNs = std::chrono::duration_cast<std::chrono::nanoseconds>(plain).count() / iterations;
+    long long compressedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(compressed).count() / iterations;
+    char      msg[160];
+    snprintf(msg, sizeof(msg), "sendir size: plain=%zu compressed=%zu bytes, parse: plain=%lldns compressed=%lldns",
+             strlen(SENDIR), strlen(SENDIR_COMPRESSED), plainNs, compressedNs);
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_EQUAL(check[0], check[1]);
+    TEST_ASSERT_LESS_THAN(strlen(SENDIR) / 2, strlen(SENDIR_COMPRESSED));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_parseGcIrCode_nullInput);
+    RUN_TEST(test_parseGcIrCode_full);
+    RUN_TEST(test_parseGcIrCode_short);
+    RUN_TEST(test_parseGcIrCode_errors);
+    RUN_TEST(test_parseGcIrCode_compressed);
+    RUN_TEST(test_parseGcIrCode_compressedErrors);
+    RUN_TEST(test_parseGcIrCode_symbolLimit);
+    RUN_TEST(test_encodeGcIrCode);
+    RUN_TEST(test_encodeGcSendir);
+    RUN_TEST(test_convertToGcTimings);
+    RUN_TEST(test_learnedCodeRoundTrip);
+    RUN_TEST(test_gcIrCode_roundTrip);
+    RUN_TEST(test_gcIrCode_move);
+    RUN_TEST(test_gcIrCode_equals);
+    RUN_TEST(test_benchmark);
+    RUN_TEST(test_benchmarkCompressed);
+
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,640 @@
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gc_server.hpp"
+
+// Different port than on the device
+#define TEST_TCP_PORT 19996
+#define TEST_BEACON_PORT 19995
+
+/// IR service mock: IR codes are "sent" by a worker task, which posts the completion to the client connection.
+struct MockSink : public GCSink {
+    GCServer *server = nullptr;
+    /// Result of `sendIr` if not 0, the code isn't queued.
+    uint16_t  result = 0;
+    /// Simulated IR send duration
+    int       sendUs = 0;
+
+    std::atomic<int>  sent{0};
+    std::atomic<int>  stopped{0};
+    std::atomic<int>  learning{0};
+    std::atomic<int>  identifying{-1};
+    std::atomic<int>  lastPort{0};
+    std::atomic<int>  lastTimingCount{0};
+
+    MockSink() : m_running(true), m_worker(&MockSink::run, this) {}
+    ~MockSink() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running = false;
+        }
+        m_cv.notify_one();
+        m_worker.join();
+    }
+
+    uint16_t sendIr(GCIrCode *code, uint32_t connection) override {
+        if (result) {
+            return result;
+        }
+        lastPort = code->port;
+        lastTimingCount = code->timingCount();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back({connection, code->port, code->id});
+        m_cv.notify_one();
+        return 0;
+    }
+    void stopIr() override { stopped++; }
+    void startIrLearn() override { learning = 1; }
+    void stopIrLearn() override { learning = 0; }
+    void identify(bool enable) override { identifying = enable; }
+    bool localIp(char *buf, size_t size) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        snprintf(buf, size, "%s", ip.c_str());
+        return !ip.empty();
+    }
+    void setIp(const char *value) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ip = value;
+    }
+
+ private:
+    struct Job {
+        uint32_t connection;
+        uint8_t  port;
+        uint16_t id;
+    };
+
+    void run() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            m_cv.wait(lock, [this]() { return !m_running || !m_queue.empty(); });
+            if (!m_running) {
+                return;
+            }
+            Job job = m_queue.front();
+            m_queue.pop_front();
+            lock.unlock();
+            if (sendUs) {
+                std::this_thread::sleep_for(std::chrono::microseconds(sendUs));
+            }
+            char msg[32];
+            snprintf(msg, sizeof(msg), "completeir,1:%u,%u\r", job.port, job.id);
+            server->post(job.connection, msg);
+            sent++;
+            lock.lock();
+        }
+    }
+
+    /// Announced IP address, empty if not connected. Protected by `m_mutex`.
+    std::string             ip;
+    std::mutex              m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Job>         m_queue;
+    bool                    m_running;
+    std::thread             m_worker;
+};
+
+static GCDeviceInfo testInfo() {
+    GCDeviceInfo info;
+    memset(&info, 0, sizeof(info));
+    snprintf(info.version, sizeof(info.version), "1-2-3");
+    snprintf(info.mac, sizeof(info.mac), "AABBCCDDEEFF");
+    snprintf(info.uuid, sizeof(info.uuid), "UnfoldedCircle_AABBCCDDEEFF");
+    snprintf(info.model, sizeof(info.model), "UCD3");
+    snprintf(info.serial, sizeof(info.serial), "12345");
+    info.irPorts = 4;
+    info.ethernet = true;
+    return info;
+}
+
+static int connectClient() {
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = htons(TEST_TCP_PORT);
+    TEST_ASSERT_EQUAL(0, connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+    struct timeval tv = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    return fd;
+}
+
+static bool sendString(int fd, const char *msg) {
+    return send(fd, msg, strlen(msg), MSG_NOSIGNAL) == static_cast<ssize_t>(strlen(msg));
+}
+
+/// Receive until the expected number of carriage returns arrived or the receive timeout elapsed.
+static std::string receiveMessages(int fd, int count = 1) {
+    std::string result;
+    char        buf[256];
+    while (std::count(result.begin(), result.end(), '\r') < count) {
+        ssize_t len = recv(fd, buf, sizeof(buf), 0);
+        if (len <= 0) {
+            break;
+        }
+        result.append(buf, len);
+    }
+    return result;
+}
+
+static std::string request(int fd, const char *msg, int count = 1) {
+    TEST_ASSERT_TRUE(sendString(fd, msg));
+    return receiveMessages(fd, count);
+}
+
+static const char *SENDIR =
+    "sendir,1:2,42,38000,1,1,340,171,21,21,21,65,21,21,21,21,21,21,21,21,21,21,21,21,21,1555,340,86,21,3678\r";
+
+MockSink          *sink;
+ClientRateLimiter *limiter;
+GCServer          *server;
+
+void setUp(void) {
+    sink = new MockSink();
+    limiter = new ClientRateLimiter();
+    server = new GCServer(sink, testInfo(), limiter);
+    sink->server = server;
+    TEST_ASSERT_EQUAL_MESSAGE(0, server->start(TEST_TCP_PORT, "127.0.0.1"), "start failed");
+}
+
+void tearDown(void) {
+    server->stop();
+    delete server;
+    delete limiter;
+    delete sink;
+}
+
+void test_deviceInfo(void) {
+    int         client = connectClient();
+    std::string reply = request(client, "getversion\r");
+    TEST_ASSERT_EQUAL_STRING("1-2-3\r", reply.c_str());
+    reply = request(client, "getmac\r");
+    TEST_ASSERT_EQUAL_STRING("MACaddress,AABBCCDDEEFF\r", reply.c_str());
+    reply = request(client, "getdevices\r", 4);
+    TEST_ASSERT_EQUAL_STRING("device,0,0 ETHERNET\rdevice,0,0 WIFI\rdevice,1,4 IR\rendlistdevices\r", reply.c_str());
+    close(client);
+}
+
+void test_sendIr(void) {
+    int         client = connectClient();
+    std::string reply = request(client, SENDIR);
+    TEST_ASSERT_EQUAL_STRING("completeir,1:2,42\r", reply.c_str());
+    TEST_ASSERT_EQUAL(1, sink->sent.load());
+    TEST_ASSERT_EQUAL(2, sink->lastPort.load());
+    TEST_ASSERT_EQUAL(24, sink->lastTimingCount.load());
+
+    // compressed format
+    reply = request(client, "sendir,1:3,7,38000,1,1,340,171,21,21,AB,21,65,BBC\r");
+    TEST_ASSERT_EQUAL_STRING("completeir,1:3,7\r", reply.c_str());
+    TEST_ASSERT_EQUAL(3, sink->lastPort.load());
+    TEST_ASSERT_EQUAL(16, sink->lastTimingCount.load());
+    close(client);
+}
+
+void test_sendIr_invalidCode(void) {
+    int         client = connectClient();
+    std::string reply = request(client, "sendir,1:2,42,38000,1,1,340,x,21,21\r");
+    TEST_ASSERT_EQUAL_STRING("ERR_1:2,009\r", reply.c_str());
+    reply = request(client, "sendir,1:16,42,38000,1,1,340,171\r");
+    TEST_ASSERT_EQUAL_STRING("ERR_1:1,003\r", reply.c_str());
+    TEST_ASSERT_EQUAL(0, sink->sent.load());
+    close(client);
+}
+
+void test_sendIr_sinkResult(void) {
+    int client = connectClient();
+
+    sink->result = 429;
+    std::string reply = request(client, SENDIR);
+    TEST_ASSERT_EQUAL_STRING("busyir\r", reply.c_str());
+    sink->result = 500;
+    reply = request(client, SENDIR);
+    TEST_ASSERT_EQUAL_STRING("ERR_1:2,023\r", reply.c_str());
+    sink->result = 4;
+    reply = request(client, SENDIR);
+    TEST_ASSERT_EQUAL_STRING("ERR_1:2,004\r", reply.c_str());
+    sink->result = 404;
+    reply = request(client, SENDIR);
+    TEST_ASSERT_EQUAL_STRING("ERR_1:2,001\r", reply.c_str());
+
+    // accepted repeat: no reply, as the iTach device
+    sink->result = 202;
+    TEST_ASSERT_TRUE(sendString(client, SENDIR));
+    reply = request(client, "getversion\r");
+    TEST_ASSERT_EQUAL_STRING("1-2-3\r", reply.c_str());
+    close(client);
+}
+
+void test_stopIr(void) {
+    int         client = connectClient();
+    std::string reply = request(client, "stopir,1:1\r");
+    TEST_ASSERT_EQUAL_STRING("stopir,1:1\r", reply.c_str());
+    TEST_ASSERT_EQUAL(1, sink->stopped.load());
+    close(client);
+}
+
+void test_blink(void) {
+    int client = connectClient();
+    // the reply of the last request makes sure that all previous requests were processed
+    std::string reply = request(client, "blink,1\rgetversion\r");
+    TEST_ASSERT_EQUAL_STRING("1-2-3\r", reply.c_str());
+    TEST_ASSERT_EQUAL(1, sink->identifying.load());
+
+    reply = request(client, "blink,0\r\n\r\ngetversion\r");
+    TEST_ASSERT_EQUAL_STRING("1-2-3\r", reply.c_str());
+    TEST_ASSERT_EQUAL(0, sink->identifying.load());
+    close(client);
+}
+
+static const char *LEARNED = "sendir,1:1,0,38000,1,1,342,171,21,21,B,21,64,CCBBC,21,1520";
+
+void test_learnedCode(void) {
+    int learner1 = connectClient();
+    int learner2 = connectClient();
+    int other = connectClient();
+
+    // not delivered without a learning client
+    TEST_ASSERT_FALSE(server->hasLearners());
+    TEST_ASSERT_FALSE(server->postLearned(LEARNED));
+
+    std::string reply = request(learner1, "get_IRL\r");
+    TEST_ASSERT_EQUAL_STRING("IR Learner Enabled\r", reply.c_str());
+    TEST_ASSERT_EQUAL(1, sink->learning.load());
+    reply = request(learner2, "get_IRL\r");
+    TEST_ASSERT_EQUAL_STRING("IR Learner Enabled\r", reply.c_str());
+    TEST_ASSERT_TRUE(server->hasLearners());
+
+    TEST_ASSERT_TRUE(server->postLearned(LEARNED));
+    std::string expected = std::string(LEARNED) + "\r";
+    reply = receiveMessages(learner1);
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), reply.c_str());
+    reply = receiveMessages(learner2);
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), reply.c_str());
+
+    // learning continues until the last client disables the learner
+    reply = request(learner1, "stop_IRL\r");
+    TEST_ASSERT_EQUAL_STRING("IR Learner Disabled\r", reply.c_str());
+    TEST_ASSERT_EQUAL(1, sink->learning.load());
+    TEST_ASSERT_TRUE(server->postLearned(LEARNED));
+    reply = receiveMessages(learner2);
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), reply.c_str());
+
+    // a disconnected client no longer receives learned codes
+    close(learner2);
+    for (int i = 0; i < 100 && server->hasLearners(); i++) {
+        platformDelayMs(5);
+    }
+    TEST_ASSERT_FALSE(server->hasLearners());
+    TEST_ASSERT_FALSE(server->postLearned(LEARNED));
+    TEST_ASSERT_EQUAL(0, sink->learning.load());
+
+    // only the requesting clients receive learned codes
+    reply = request(learner1, "getversion\r");
+    TEST_ASSERT_EQUAL_STRING("1-2-3\r", reply.c_str());
+    reply = request(other, "getversion\r");
+    TEST_ASSERT_EQUAL_STRING("1-2-3\r", reply.c_str());
+
+    reply = request(other, "stop_IRL\r");
+    TEST_ASSERT_EQUAL_STRING("IR Learner Disabled\r", reply.c_str());
+    close(learner1);
+    close(other);
+}
+
+void test_learnedCodeTooLong(void) {
+    int client = connectClient();
+    std::string reply = request(client, "get_IRL\r");
+    TEST_ASSERT_EQUAL_STRING("IR Learner Enabled\r", reply.c_str());
+    std::string code(GC_LEARN_CODE_SIZE - 1, '1');
+    TEST_ASSERT_FALSE(server->postLearned(code.c_str()));
+    code.resize(GC_LEARN_CODE_SIZE - 2);
+    TEST_ASSERT_TRUE(server->postLearned(code.c_str()));
+    TEST_ASSERT_EQUAL(GC_LEARN_CODE_SIZE - 1, receiveMessages(client).size());
+    close(client);
+}
+
+// A learner not reading its learned codes fills up the socket and the output buffer. Codes which don't fit anymore
+// are dropped instead of closing the connection, and the client only receives complete codes.
+void test_learnedCodePendingOutput(void) {
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    int size = 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = htons(TEST_TCP_PORT);
+    TEST_ASSERT_EQUAL(0, connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+    struct timeval tv = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    std::string reply = request(fd, "get_IRL\r");
+    TEST_ASSERT_EQUAL_STRING("IR Learner Enabled\r", reply.c_str());
+
+    // more data than the socket buffers of the host can take
+    const int   codeCount = 8000;
+    std::string code(GC_LEARN_CODE_SIZE - 2, '1');
+    for (int i = 0; i < codeCount; i++) {
+        TEST_ASSERT_TRUE(server->postLearned(code.c_str()));
+        // let the server task deliver most codes before they're replaced by the next one
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    // still connected: read all buffered codes
+    TEST_ASSERT_TRUE(sendString(fd, "getversion\r"));
+    std::string received;
+    char        buf[4096];
+    while (received.size() < 6 || received.compare(received.size() - 6, 6, "1-2-3\r") != 0) {
+        ssize_t len = recv(fd, buf, sizeof(buf), 0);
+        if (len <= 0) {
+            break;
+        }
+        received.append(buf, len);
+    }
+    TEST_ASSERT_TRUE(received.size() >= 6);
+    reply = received.substr(received.size() - 6);
+    TEST_ASSERT_EQUAL_STRING("1-2-3\r", reply.c_str());
+    received.resize(received.size() - 6);
+
+    // only complete codes, some have been dropped
+    std::string expected = code + "\r";
+    TEST_ASSERT_EQUAL(0, received.size() % expected.size());
+    size_t count = received.size() / expected.size();
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_TRUE(received.compare(i * expected.size(), expected.size(), expected) == 0);
+    }
+    TEST_ASSERT_TRUE(count < codeCount);
+
+    char info[80];
+    snprintf(info, sizeof(info), "received %u of %d learned codes", static_cast<unsigned>(count), codeCount);
+    TEST_MESSAGE(info);
+    close(fd);
+}
+
+void test_invalidCommands(void) {
+    int         client = connectClient();
+    std::string reply = request(client, "foobar\r");
+    TEST_ASSERT_EQUAL_STRING("ERR_0:0,001\r", reply.c_str());
+    reply = request(client, "set_IR,1:3,IR\r");
+    TEST_ASSERT_EQUAL_STRING("ERR_1:3,001\r", reply.c_str());
+    reply = request(client, "stopir,2:1\r");
+    TEST_ASSERT_EQUAL_STRING("ERR_1:1,002\r", reply.c_str());
+    close(client);
+}
+
+void test_rateLimit(void) {
+    limiter->setConnectionLimit({3, 1});
+    int client = connectClient();
+    for (int i = 0; i < 3; i++) {
+        std::string reply = request(client, "getversion\r");
+        TEST_ASSERT_EQUAL_STRING("1-2-3\r", reply.c_str());
+    }
+    std::string reply = request(client, "getversion\r");
+    TEST_ASSERT_EQUAL_STRING("busyir\r", reply.c_str());
+    TEST_ASSERT_EQUAL(1, limiter->stats().throttledConnection);
+    close(client);
+}
+
+void test_stopClosesClients(void) {
+    int client = connectClient();
+    TEST_ASSERT_EQUAL_STRING("1-2-3\r", request(client, "getversion\r").c_str());
+    server->stop();
+    char buf[16];
+    TEST_ASSERT_EQUAL(0, recv(client, buf, sizeof(buf), 0));
+    close(client);
+
+    // restart
+    TEST_ASSERT_EQUAL(0, server->start(TEST_TCP_PORT, "127.0.0.1"));
+    client = connectClient();
+    TEST_ASSERT_EQUAL_STRING("1-2-3\r", request(client, "getversion\r").c_str());
+    close(client);
+}
+
+void test_formatBeacon(void) {
+    char   buf[250];
+    size_t len = server->formatBeacon(buf, sizeof(buf), "192.168.1.42");
+    TEST_ASSERT_EQUAL_STRING(
+        "AMXB<-UUID=UnfoldedCircle_AABBCCDDEEFF><-SDKClass=Utility><-Make=Unfolded Circle><-Model=UCD3>"
+        "<-Revision=1-2-3><-Config-URL=http://192.168.1.42><-PCB_PN=12345><-Status=Ready>",
+        buf);
+    TEST_ASSERT_EQUAL(strlen(buf), len);
+    TEST_ASSERT_EQUAL(0, server->formatBeacon(buf, 50, "192.168.1.42"));
+}
+
+static int openBeaconReceiver() {
+    int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = htons(TEST_BEACON_PORT);
+    TEST_ASSERT_EQUAL(0, bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+    struct timeval tv = {0, 300000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+static std::string receiveBeacon(int fd) {
+    char    buf[GC_BEACON_SIZE];
+    ssize_t len = recv(fd, buf, sizeof(buf), 0);
+    return len > 0 ? std::string(buf, len) : std::string();
+}
+
+void test_beaconOnNetworkChange(void) {
+    int receiver = openBeaconReceiver();
+    server->setBeaconTarget("127.0.0.1", TEST_BEACON_PORT, 0);
+    TEST_ASSERT_TRUE(server->startBeacon());
+
+    // no network connection: nothing announced until the next network change
+    std::string beacon = receiveBeacon(receiver);
+    TEST_ASSERT_TRUE(beacon.empty());
+
+    // link-up: announced immediately instead of after the 30 second interval
+    sink->setIp("192.168.1.10");
+    int64_t start = platformMicros();
+    server->networkChanged();
+    beacon = receiveBeacon(receiver);
+    int64_t latency = platformMicros() - start;
+    TEST_ASSERT_TRUE(beacon.find("<-Config-URL=http://192.168.1.10>") != std::string::npos);
+    TEST_ASSERT_TRUE(latency < 100000);
+
+    // same address: the prepared message is sent again
+    server->networkChanged();
+    std::string again = receiveBeacon(receiver);
+    TEST_ASSERT_EQUAL_STRING(beacon.c_str(), again.c_str());
+
+    // new address
+    sink->setIp("10.0.0.2");
+    server->networkChanged();
+    beacon = receiveBeacon(receiver);
+    TEST_ASSERT_TRUE(beacon.find("<-Config-URL=http://10.0.0.2>") != std::string::npos);
+
+    // link-down
+    sink->setIp("");
+    server->networkChanged();
+    beacon = receiveBeacon(receiver);
+    TEST_ASSERT_TRUE(beacon.empty());
+
+    // the beacon task ends without waiting for the interval
+    start = platformMicros();
+    server->stop();
+    TEST_ASSERT_TRUE(platformMicros() - start < 1000000);
+    close(receiver);
+
+    char msg[80];
+    snprintf(msg, sizeof(msg), "beacon after network change: %lldus", static_cast<long long>(latency));
+    TEST_MESSAGE(msg);
+}
+
+struct ClientResult {
+    int                  completed = 0;
+    int                  errors = 0;
+    std::vector<int64_t> latencies;
+};
+
+/// Client sending IR codes back to back: every request waits for its `completeir` response.
+static void benchmarkClient(int fd, int requests, ClientResult *result) {
+    char buf[256];
+    for (int i = 0; i < requests; i++) {
+        int64_t start = platformMicros();
+        if (!sendString(fd, SENDIR)) {
+            result->errors++;
+            return;
+        }
+        ssize_t len = recv(fd, buf, sizeof(buf) - 1, 0);
+        if (len <= 0) {
+            result->errors++;
+            return;
+        }
+        buf[len] = 0;
+        if (strncmp(buf, "completeir,1:2,42\r", len) != 0) {
+            result->errors++;
+            continue;
+        }
+        result->completed++;
+        result->latencies.push_back(platformMicros() - start);
+    }
+}
+
+/// Throughput and latency of the iTach protocol handling with all client connections in use.
+void test_benchmarkManyClients(void) {
+    // disable rate limiting: measure the server, not the limiter
+    limiter->setConnectionLimit({0, 0});
+    limiter->setIpLimit({0, 0});
+    const int requests = 500;
+
+    int clients[GC_MAX_CLIENTS];
+    for (int i = 0; i < GC_MAX_CLIENTS; i++) {
+        clients[i] = connectClient();
+    }
+
+    std::vector<ClientResult> results(GC_MAX_CLIENTS);
+    std::vector<std::thread>  threads;
+    int64_t                   start = platformMicros();
+    for (int i = 0; i < GC_MAX_CLIENTS; i++) {
+        threads.push_back(std::thread(benchmarkClient, clients[i], requests, &results[i]));
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    int64_t elapsed = platformMicros() - start;
+
+    std::vector<int64_t> latencies;
+    int                  errors = 0;
+    for (auto &r : results) {
+        latencies.insert(latencies.end(), r.latencies.begin(), r.latencies.end());
+        errors += r.errors;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    TEST_ASSERT_EQUAL(0, errors);
+    TEST_ASSERT_EQUAL(GC_MAX_CLIENTS * requests, latencies.size());
+    TEST_ASSERT_EQUAL(GC_MAX_CLIENTS * requests, sink->sent.load());
+
+    char msg[200];
+    snprintf(msg, sizeof(msg), "%d clients x %d sendir: %.0f req/s, latency p50=%lldus p99=%lldus max=%lldus",
+             GC_MAX_CLIENTS, requests, latencies.size() * 1000000.0 / elapsed,
+             static_cast<long long>(latencies[latencies.size() / 2]),
+             static_cast<long long>(latencies[latencies.size() * 99 / 100]),
+             static_cast<long long>(latencies.back()));
+    TEST_MESSAGE(msg);
+
+    for (int i = 0; i < GC_MAX_CLIENTS; i++) {
+        close(clients[i]);
+    }
+}
+
+void test_platformSemaphore(void) {
+    PlatformSemaphore semaphore;
+    int64_t           start = platformMicros();
+    TEST_ASSERT_FALSE(semaphore.take(20));
+    TEST_ASSERT_GREATER_OR_EQUAL(20000, platformMicros() - start);
+
+    std::atomic<int> value{0};
+    struct Param {
+        PlatformSemaphore *semaphore;
+        std::atomic<int>  *value;
+    } param = {&semaphore, &value};
+    TEST_ASSERT_TRUE(platformCreateTask(
+        [](void *p) {
+            Param *param = reinterpret_cast<Param *>(p);
+            platformDelayMs(10);
+            *param->value = 42;
+            param->semaphore->give();
+            platformExitTask();
+        },
+        "test", 2000, &param, 1, 0));
+    TEST_ASSERT_TRUE(semaphore.take(1000));
+    TEST_ASSERT_EQUAL(42, value.load());
+    // binary semaphore: taken
+    TEST_ASSERT_FALSE(semaphore.take(0));
+}
+
+void test_platformLocalIp(void) {
+    char ip[16];
+    if (platformLocalIp(ip, sizeof(ip))) {
+        struct in_addr addr;
+        TEST_ASSERT_EQUAL(1, inet_pton(AF_INET, ip, &addr));
+        TEST_ASSERT_TRUE(std::string(ip) != "127.0.0.1");
+    } else {
+        TEST_MESSAGE("No network interface with an IPv4 address");
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_deviceInfo);
+    RUN_TEST(test_sendIr);
+    RUN_TEST(test_sendIr_invalidCode);
+    RUN_TEST(test_sendIr_sinkResult);
+    RUN_TEST(test_stopIr);
+    RUN_TEST(test_blink);
+    RUN_TEST(test_learnedCode);
+    RUN_TEST(test_learnedCodeTooLong);
+    RUN_TEST(test_learnedCodePendingOutput);
+    RUN_TEST(test_invalidCommands);
+    RUN_TEST(test_rateLimit);
+    RUN_TEST(test_stopClosesClients);
+    RUN_TEST(test_formatBeacon);
+    RUN_TEST(test_beaconOnNetworkChange);
+    RUN_TEST(test_benchmarkManyClients);
+    RUN_TEST(test_platformSemaphore);
+    RUN_TEST(test_platformLocalIp);
+
+    UNITY_END();
+}
@@ -0,0 +1,99 @@
+#include <unity.h>
+
+#include "interval_timer.hpp"
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+void test_firstCallExpires(void) {
+    IntervalTimer timer(100);
+    TEST_ASSERT_EQUAL(100, timer.interval());
+    TEST_ASSERT_EQUAL(0, timer.remaining(5000));
+    TEST_ASSERT_TRUE(timer.expired(5000));
+    TEST_ASSERT_EQUAL(100, timer.remaining(5000));
+}
+
+void test_expired(void) {
+    IntervalTimer timer(100);
+    TEST_ASSERT_TRUE(timer.expired(1000));
+    TEST_ASSERT_FALSE(timer.expired(1001));
+    TEST_ASSERT_EQUAL(40, timer.remaining(1060));
+    TEST_ASSERT_FALSE(timer.expired(1099));
+    TEST_ASSERT_EQUAL(0, timer.remaining(1100));
+    TEST_ASSERT_TRUE(timer.expired(1100));
+    TEST_ASSERT_FALSE(timer.expired(1150));
+}
+
+void test_missedIntervalNotCaughtUp(void) {
+    IntervalTimer timer(100);
+    TEST_ASSERT_TRUE(timer.expired(0));
+    TEST_ASSERT_TRUE(timer.expired(450));
+    TEST_ASSERT_FALSE(timer.expired(500));
+    TEST_ASSERT_EQUAL(50, timer.remaining(500));
+    TEST_ASSERT_TRUE(timer.expired(550));
+}
+
+void test_clockOverflow(void) {
+    IntervalTimer timer(100);
+    TEST_ASSERT_TRUE(timer.expired(0xFFFFFFF0));
+    TEST_ASSERT_FALSE(timer.expired(0x00000010));
+    TEST_ASSERT_EQUAL(68, timer.remaining(0x00000010));
+    TEST_ASSERT_TRUE(timer.expired(0x00000054));
+}
+
+void test_zeroInterval(void) {
+    IntervalTimer timer(0);
+    TEST_ASSERT_TRUE(timer.expired(10));
+    TEST_ASSERT_EQUAL(0, timer.remaining(10));
+    TEST_ASSERT_TRUE(timer.expired(10));
+}
+
+void test_oneShot(void) {
+    OneShotTimer timer(2500);
+    TEST_ASSERT_FALSE(timer.running());
+    TEST_ASSERT_FALSE(timer.expired(10000));
+
+    timer.start(1000);
+    TEST_ASSERT_TRUE(timer.running());
+    TEST_ASSERT_FALSE(timer.expired(3499));
+    TEST_ASSERT_TRUE(timer.expired(3500));
+    TEST_ASSERT_FALSE(timer.running());
+    // only expires once
+    TEST_ASSERT_FALSE(timer.expired(5000));
+}
+
+void test_oneShotRestartStop(void) {
+    OneShotTimer timer(100);
+    timer.start(0xFFFFFFA0);
+    TEST_ASSERT_FALSE(timer.expired(0x00000000));
+    // restart extends the time
+    timer.start(0x00000000);
+    TEST_ASSERT_FALSE(timer.expired(0x00000063));
+    TEST_ASSERT_TRUE(timer.expired(0x00000064));
+
+    timer.start(200);
+    timer.stop();
+    TEST_ASSERT_FALSE(timer.running());
+    TEST_ASSERT_FALSE(timer.expired(1000));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_firstCallExpires);
+    RUN_TEST(test_expired);
+    RUN_TEST(test_missedIntervalNotCaughtUp);
+    RUN_TEST(test_clockOverflow);
+    RUN_TEST(test_zeroInterval);
+    RUN_TEST(test_oneShot);
+    RUN_TEST(test_oneShotRestartStop);
+
+    UNITY_END();
+
+    return 0;
+}
@@ -14,7 +14,7 @@ void tearDown(void) {
 
 void test_buildIRHexData(void) {
     struct IRHexData data;
-    String           msg = "4;0x640C;15;1";
+    const char      *msg = "4;0x640C;15;1";
     TEST_ASSERT_EQUAL(true, buildIRHexData(msg, &data));
     TEST_ASSERT_EQUAL(4, data.protocol);
     TEST_ASSERT_EQUAL(0x640C, data.command);
@@ -24,73 +24,74 @@ void test_buildIRHexData(void) {
 
 void test_buildIRHexData_empty_string(void) {
     struct IRHexData data;
-    String           msg;
+    const char      *msg = "";
     TEST_ASSERT_EQUAL(false, buildIRHexData(msg, &data));
+    TEST_ASSERT_EQUAL(false, buildIRHexData(NULL, &data));
 }
 
 void test_buildIRHexData_invalid_separator(void) {
     struct IRHexData data;
-    String           msg = "4,0x640C,15,0";
+    const char      *msg = "4,0x640C,15,0";
     TEST_ASSERT_EQUAL(false, buildIRHexData(msg, &data));
 }
 
 void test_buildIRHexData_missing_protocol_value(void) {
     struct IRHexData data;
-    String           msg = ";0x640C;15;1";
+    const char      *msg = ";0x640C;15;1";
     TEST_ASSERT_EQUAL(false, buildIRHexData(msg, &data));
 }
 
 void test_buildIRHexData_missing_command_value(void) {
     struct IRHexData data;
-    String           msg = "4;;15;1";
+    const char      *msg = "4;;15;1";
     TEST_ASSERT_EQUAL(false, buildIRHexData(msg, &data));
 }
 
 void test_buildIRHexData_missing_bits_value(void) {
     struct IRHexData data;
-    String           msg = "4;0x640C;;1";
+    const char      *msg = "4;0x640C;;1";
     TEST_ASSERT_EQUAL(false, buildIRHexData(msg, &data));
 }
 
 void test_buildIRHexData_missing_repeat_value(void) {
     struct IRHexData data;
-    String           msg = "4;0x640C;15;";
+    const char      *msg = "4;0x640C;15;";
     TEST_ASSERT_EQUAL(false, buildIRHexData(msg, &data));
 }
 
 void test_buildIRHexData_missing_repeat(void) {
     struct IRHexData data;
-    String           msg = "4;0x640C;15";
+    const char      *msg = "4;0x640C;15";
     TEST_ASSERT_EQUAL(false, buildIRHexData(msg, &data));
 }
 
 void test_buildIRHexData_invalid_protocol_value(void) {
     struct IRHexData data;
-    String           msg = "z;0x640C;15;1";
+    const char      *msg = "z;0x640C;15;1";
     TEST_ASSERT_EQUAL(false, buildIRHexData(msg, &data));
 }
 
 void test_buildIRHexData_invalid_command_value(void) {
     struct IRHexData data;
-    String           msg = "4;hello;15;1";
+    const char      *msg = "4;hello;15;1";
     TEST_ASSERT_EQUAL(false, buildIRHexData(msg, &data));
 }
 
 void test_buildIRHexData_invalid_bits_value(void) {
     struct IRHexData data;
-    String           msg = "4;0x640C;2tt;1";
+    const char      *msg = "4;0x640C;2tt;1";
     TEST_ASSERT_EQUAL(false, buildIRHexData(msg, &data));
 }
 
 void test_buildIRHexData_invalid_repeat_value(void) {
     struct IRHexData data;
-    String           msg = "4;0x640C;15;z1";
+    const char      *msg = "4;0x640C;15;z1";
     TEST_ASSERT_EQUAL(false, buildIRHexData(msg, &data));
 }
 
 void test_buildIRHexData_repeat_too_high(void) {
     struct IRHexData data;
-    String           msg = "4;0x640C;15;20";
+    const char      *msg = "4;0x640C;15;20";
     TEST_ASSERT_EQUAL(true, buildIRHexData(msg, &data));
     msg = "4;0x640C;15;21";
     TEST_ASSERT_EQUAL(false, buildIRHexData(msg, &data));
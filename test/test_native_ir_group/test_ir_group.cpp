@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <unity.h>
+
+#include "ir_group.hpp"
+
+// Different port than on the device, so the test doesn't interfere with docks on the same network
+#define TEST_GROUP_PORT 19132
+#define TEST_INSTANCES 8
+
+const char    *testCode = "sendir,1:1,1,38000,1,1,342,171,21,21,21,64,21,1517";
+const uint8_t  sender1[kIrGroupSenderLen] = {0x24, 0x6F, 0x28, 0x01, 0x02, 0x03};
+const uint8_t  sender2[kIrGroupSenderLen] = {0x24, 0x6F, 0x28, 0x04, 0x05, 0x06};
+const int64_t  testSendAt = 1700000000123456LL;
+IrGroupMessage testMsg;
+
+void setUp(void) {
+    memcpy(testMsg.sender, sender1, kIrGroupSenderLen);
+    testMsg.seq = 42;
+    testMsg.sendAt = testSendAt;
+    testMsg.repeat = 3;
+    testMsg.outputs = IR_GROUP_INT_SIDE | IR_GROUP_EXT_2;
+    testMsg.format = 3;
+    testMsg.code = testCode;
+    testMsg.codeLen = strlen(testCode);
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+void test_irGroupKey(void) {
+    IrGroupKey a = irGroupKey("venue-1");
+    IrGroupKey b = irGroupKey("venue-1");
+    IrGroupKey c = irGroupKey("venue-2");
+    TEST_ASSERT_EQUAL_UINT32(a.groupId, b.groupId);
+    TEST_ASSERT_TRUE(a.groupId != c.groupId);
+}
+
+void test_irGroupEncode_roundTrip(void) {
+    IrGroupKey key = irGroupKey("venue-1");
+    uint8_t    buf[kIrGroupMaxPacketLen];
+
+    size_t len = irGroupEncode(key, testMsg, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL(kIrGroupHeaderLen + strlen(testCode) + kIrGroupMacLen, len);
+
+    IrGroupMessage msg;
+    TEST_ASSERT_EQUAL(IrGroupResult::OK, irGroupDecode(key, buf, len, &msg));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(sender1, msg.sender, kIrGroupSenderLen);
+    TEST_ASSERT_EQUAL(42, msg.seq);
+    TEST_ASSERT_EQUAL_INT64(testSendAt, msg.sendAt);
+    TEST_ASSERT_EQUAL(3, msg.repeat);
+    TEST_ASSERT_EQUAL(IR_GROUP_INT_SIDE | IR_GROUP_EXT_2, msg.outputs);
+    TEST_ASSERT_EQUAL(3, msg.format);
+    TEST_ASSERT_EQUAL(strlen(testCode), msg.codeLen);
+    TEST_ASSERT_EQUAL_STRING_LEN(testCode, msg.code, msg.codeLen);
+}
+
+void test_irGroupEncode_bufferTooSmall(void) {
+    IrGroupKey key = irGroupKey("venue-1");
+    uint8_t    buf[kIrGroupMaxPacketLen];
+
+    TEST_ASSERT_EQUAL(0, irGroupEncode(key, testMsg, buf, kIrGroupHeaderLen + testMsg.codeLen));
+
+    testMsg.codeLen = kIrGroupMaxCodeLen + 1;
+    TEST_ASSERT_EQUAL(0, irGroupEncode(key, testMsg, buf, sizeof(buf)));
+}
+
+void test_irGroupDecode_invalidInput(void) {
+    IrGroupKey     key = irGroupKey("venue-1");
+    IrGroupMessage msg;
+    uint8_t        buf[kIrGroupMaxPacketLen];
+
+    size_t len = irGroupEncode(key, testMsg, buf, sizeof(buf));
+
+    TEST_ASSERT_EQUAL(IrGroupResult::TOO_SHORT, irGroupDecode(key, nullptr, len, &msg));
+    TEST_ASSERT_EQUAL(IrGroupResult::TOO_SHORT, irGroupDecode(key, buf, kIrGroupHeaderLen, &msg));
+    TEST_ASSERT_EQUAL(IrGroupResult::BAD_LENGTH, irGroupDecode(key, buf, len - 1, &msg));
+    TEST_ASSERT_EQUAL(IrGroupResult::WRONG_GROUP, irGroupDecode(irGroupKey("venue-2"), buf, len, &msg));
+
+    buf[3] = 2;
+    TEST_ASSERT_EQUAL(IrGroupResult::BAD_VERSION, irGroupDecode(key, buf, len, &msg));
+    buf[0] = 'X';
+    TEST_ASSERT_EQUAL(IrGroupResult::BAD_MAGIC, irGroupDecode(key, buf, len, &msg));
+}
+
+void test_irGroupDecode_tampered(void) {
+    IrGroupKey     key = irGroupKey("venue-1");
+    IrGroupMessage msg;
+    uint8_t        buf[kIrGroupMaxPacketLen];
+
+    size_t len = irGroupEncode(key, testMsg, buf, sizeof(buf));
+
+    // every modified byte after the group id must be detected
+    for (size_t i = 8; i < len; i++) {
+        buf[i] ^= 0x01;
+        // modified code length is detected before the MAC check
+        auto expected = (i == 28 || i == 29) ? IrGroupResult::BAD_LENGTH : IrGroupResult::BAD_MAC;
+        TEST_ASSERT_EQUAL(expected, irGroupDecode(key, buf, len, &msg));
+        buf[i] ^= 0x01;
+    }
+    TEST_ASSERT_EQUAL(IrGroupResult::OK, irGroupDecode(key, buf, len, &msg));
+}
+
+void test_irGroupDecode_forgedGroupId(void) {
+    // an attacker knowing the public group id but not the secret
+    IrGroupKey     key = irGroupKey("venue-1");
+    IrGroupKey     forged = irGroupKey("guess");
+    IrGroupMessage msg;
+    uint8_t        buf[kIrGroupMaxPacketLen];
+
+    forged.groupId = key.groupId;
+    size_t len = irGroupEncode(forged, testMsg, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL(IrGroupResult::BAD_MAC, irGroupDecode(key, buf, len, &msg));
+}
+
+void test_seqFilter_duplicates(void) {
+    IrGroupSeqFilter<> filter;
+    TEST_ASSERT_TRUE(filter.accept(sender1, 1));
+    TEST_ASSERT_FALSE(filter.accept(sender1, 1));
+    TEST_ASSERT_TRUE(filter.accept(sender2, 1));
+    TEST_ASSERT_FALSE(filter.accept(sender2, 1));
+    TEST_ASSERT_TRUE(filter.accept(sender1, 2));
+    TEST_ASSERT_FALSE(filter.accept(sender1, 1));
+}
+
+void test_seqFilter_senderRestart(void) {
+    IrGroupSeqFilter<> filter;
+    for (uint16_t i = 1000; i < 1010; i++) {
+        TEST_ASSERT_TRUE(filter.accept(sender1, i));
+    }
+    // rebooted sender starts again with a low sequence number
+    TEST_ASSERT_TRUE(filter.accept(sender1, 1));
+    TEST_ASSERT_TRUE(filter.accept(sender1, 2));
+}
+
+void test_seqFilter_evictsLeastRecentlyUsedSender(void) {
+    IrGroupSeqFilter<2, 4> filter;
+    uint8_t                sender3[kIrGroupSenderLen] = {1, 2, 3, 4, 5, 6};
+
+    TEST_ASSERT_TRUE(filter.accept(sender1, 1));
+    TEST_ASSERT_TRUE(filter.accept(sender2, 1));
+    TEST_ASSERT_FALSE(filter.accept(sender1, 1));
+    // evicts sender2
+    TEST_ASSERT_TRUE(filter.accept(sender3, 1));
+    TEST_ASSERT_FALSE(filter.accept(sender1, 1));
+    TEST_ASSERT_TRUE(filter.accept(sender2, 1));
+}
+
+void test_irGroupFormat(void) {
+    TEST_ASSERT_EQUAL(1, irGroupFormat("hex"));
+    TEST_ASSERT_EQUAL(2, irGroupFormat("pronto"));
+    TEST_ASSERT_EQUAL(3, irGroupFormat("gc"));
+    TEST_ASSERT_EQUAL(0, irGroupFormat("foo"));
+    TEST_ASSERT_EQUAL(0, irGroupFormat(nullptr));
+    TEST_ASSERT_EQUAL_STRING("gc", irGroupFormatName(3));
+    TEST_ASSERT_NULL(irGroupFormatName(0));
+    TEST_ASSERT_NULL(irGroupFormatName(4));
+}
+
+/// Multiple dock instances on the loopback interface: one sends, all others must receive the message exactly once.
+void test_multicast_loopback(void) {
+    IrGroupKey    key = irGroupKey("venue-1");
+    IrGroupSocket instances[TEST_INSTANCES];
+    uint8_t       senders[TEST_INSTANCES][kIrGroupSenderLen];
+
+    for (int i = 0; i < TEST_INSTANCES; i++) {
+        int err = instances[i].open(TEST_GROUP_PORT, IR_GROUP_ADDR, "127.0.0.1");
+        if (err) {
+            char buf[80];
+            snprintf(buf, sizeof(buf), "Multicast on loopback not available: errno %d", err);
+            TEST_IGNORE_MESSAGE(buf);
+        }
+        memcpy(senders[i], sender1, kIrGroupSenderLen);
+        senders[i][5] = i;
+    }
+
+    // every instance sends one message, including a retransmission
+    for (int i = 0; i < TEST_INSTANCES; i++) {
+        uint8_t buf[kIrGroupMaxPacketLen];
+        memcpy(testMsg.sender, senders[i], kIrGroupSenderLen);
+        testMsg.seq = 100 + i;
+        size_t len = irGroupEncode(key, testMsg, buf, sizeof(buf));
+        TEST_ASSERT_TRUE(instances[i].send(buf, len));
+        TEST_ASSERT_TRUE(instances[i].send(buf, len));
+    }
+
+    for (int i = 0; i < TEST_INSTANCES; i++) {
+        IrGroupSeqFilter<> filter;
+        int                received[TEST_INSTANCES] = {0};
+        uint8_t            buf[kIrGroupMaxPacketLen];
+        int                len;
+
+        while ((len = instances[i].receive(buf, sizeof(buf), 200)) > 0) {
+            IrGroupMessage msg;
+            TEST_ASSERT_EQUAL(IrGroupResult::OK, irGroupDecode(key, buf, len, &msg));
+            if (memcmp(msg.sender, senders[i], kIrGroupSenderLen) == 0) {
+                // own message
+                continue;
+            }
+            if (filter.accept(msg.sender, msg.seq)) {
+                received[msg.sender[5]]++;
+                TEST_ASSERT_EQUAL(100 + msg.sender[5], msg.seq);
+                TEST_ASSERT_EQUAL_INT64(testSendAt, msg.sendAt);
+            }
+        }
+
+        for (int j = 0; j < TEST_INSTANCES; j++) {
+            TEST_ASSERT_EQUAL(i == j ? 0 : 1, received[j]);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_irGroupKey);
+    RUN_TEST(test_irGroupEncode_roundTrip);
+    RUN_TEST(test_irGroupEncode_bufferTooSmall);
+    RUN_TEST(test_irGroupDecode_invalidInput);
+    RUN_TEST(test_irGroupDecode_tampered);
+    RUN_TEST(test_irGroupDecode_forgedGroupId);
+    RUN_TEST(test_seqFilter_duplicates);
+    RUN_TEST(test_seqFilter_senderRestart);
+    RUN_TEST(test_seqFilter_evictsLeastRecentlyUsedSender);
+    RUN_TEST(test_irGroupFormat);
+    RUN_TEST(test_multicast_loopback);
+
+    UNITY_END();
+
+    return 0;
+}
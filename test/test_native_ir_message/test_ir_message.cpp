@@ -0,0 +1,313 @@
+#include <stdio.h>
+#include <unity.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ir_message.hpp"
+
+// Count heap allocations of the code under test. glibc's internal functions are used to allocate the memory.
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+static std::atomic<bool> countAllocations(false);
+static std::atomic<int>  allocations(0);
+
+extern "C" void *malloc(size_t size) {
+    if (countAllocations) {
+        allocations++;
+    }
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+    if (countAllocations) {
+        allocations++;
+    }
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) {
+    if (countAllocations) {
+        allocations++;
+    }
+    return __libc_realloc(ptr, size);
+}
+
+static void startCounting() {
+    allocations = 0;
+    countAllocations = true;
+}
+
+static int stopCounting() {
+    countAllocations = false;
+    return allocations;
+}
+
+static const char *hexCode = "4;0x640C;15;0";
+static const char *prontoCode =
+    "0000 006D 0000 0022 00AC 00AB 0015 0041 0015 0041 0015 0041 0015 0016 0015 0016 0015 0016 0015 0016 0015 0016 "
+    "0015 0041 0015 0041 0015 0041 0015 0016 0015 0016 0015 0016 0015 0016 0015 0016 0015 0016 0015 0041 0015 0016 "
+    "0015 0016 0015 0016 0015 0016 0015 0016 0015 0016 0015 0041 0015 0016 0015 0041 0015 0041 0015 0041 0015 0041 "
+    "0015 0041 0015 0041 0015 0689";
+static const char *gcCode = "38000,1,1,172,171,21,64,21,64,21,21,21,21,21,1673";
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+void test_parseIrFormat(void) {
+    TEST_ASSERT_TRUE(parseIrFormat("hex") == IRFormat::UNFOLDED_CIRCLE);
+    TEST_ASSERT_TRUE(parseIrFormat("pronto") == IRFormat::PRONTO);
+    TEST_ASSERT_TRUE(parseIrFormat("gc") == IRFormat::GLOBAL_CACHE);
+    TEST_ASSERT_TRUE(parseIrFormat(nullptr) == IRFormat::UNKNOWN);
+    TEST_ASSERT_TRUE(parseIrFormat("") == IRFormat::UNKNOWN);
+    TEST_ASSERT_TRUE(parseIrFormat("HEX") == IRFormat::UNKNOWN);
+    TEST_ASSERT_TRUE(parseIrFormat("gcx") == IRFormat::UNKNOWN);
+}
+
+void test_irCodeBuffer(void) {
+    IrCodeBuffer buffer;
+    TEST_ASSERT_EQUAL_STRING("", buffer.c_str());
+    TEST_ASSERT_EQUAL(0, buffer.length());
+
+    // not zero-terminated input
+    TEST_ASSERT_TRUE(buffer.assign("4;0x640C;15;0garbage", 13));
+    TEST_ASSERT_EQUAL_STRING("4;0x640C;15;0", buffer.c_str());
+    TEST_ASSERT_EQUAL(13, buffer.length());
+    size_t capacity = buffer.capacity();
+
+    // a shorter code reuses the buffer
+    startCounting();
+    TEST_ASSERT_TRUE(buffer.assign("abc", 3));
+    TEST_ASSERT_EQUAL(0, stopCounting());
+    TEST_ASSERT_EQUAL_STRING("abc", buffer.c_str());
+    TEST_ASSERT_EQUAL(capacity, buffer.capacity());
+
+    IrCodeBuffer other;
+    TEST_ASSERT_TRUE(other.assign("abc", 3));
+    TEST_ASSERT_TRUE(buffer == other);
+    TEST_ASSERT_TRUE(other.assign("abd", 3));
+    TEST_ASSERT_FALSE(buffer == other);
+    TEST_ASSERT_TRUE(other.assign("abcd", 3));
+    TEST_ASSERT_TRUE(buffer == other);
+
+    // a larger code grows the buffer
+    TEST_ASSERT_TRUE(buffer.assign(prontoCode, strlen(prontoCode)));
+    TEST_ASSERT_EQUAL_STRING(prontoCode, buffer.c_str());
+    TEST_ASSERT_TRUE(buffer.capacity() > strlen(prontoCode));
+
+    // small buffers are kept when cleared
+    buffer.clear(1024);
+    TEST_ASSERT_EQUAL_STRING("", buffer.c_str());
+    TEST_ASSERT_EQUAL(0, buffer.length());
+    TEST_ASSERT_TRUE(buffer.capacity() > 0);
+    buffer.clear(10);
+    TEST_ASSERT_EQUAL(0, buffer.capacity());
+    TEST_ASSERT_EQUAL_STRING("", buffer.c_str());
+
+    TEST_ASSERT_TRUE(buffer.assign("", 0));
+    TEST_ASSERT_EQUAL_STRING("", buffer.c_str());
+}
+
+void test_setIrSendCode(void) {
+    IRSendMessage msg;
+    TEST_ASSERT_TRUE(setIrSendCode(&msg, IRFormat::UNFOLDED_CIRCLE, hexCode, strlen(hexCode)));
+    TEST_ASSERT_TRUE(msg.format == IRFormat::UNFOLDED_CIRCLE);
+    TEST_ASSERT_EQUAL_STRING(hexCode, msg.message.c_str());
+    TEST_ASSERT_FALSE(msg.gcCode.isValid());
+
+    TEST_ASSERT_TRUE(setIrSendCode(&msg, IRFormat::GLOBAL_CACHE, gcCode, strlen(gcCode)));
+    TEST_ASSERT_TRUE(msg.format == IRFormat::GLOBAL_CACHE);
+    TEST_ASSERT_TRUE(msg.gcCode.isValid());
+    TEST_ASSERT_EQUAL(38000, msg.gcCode.frequency());
+    TEST_ASSERT_EQUAL(12, msg.gcCode.timingCount());
+
+    // a following code of another format doesn't keep the parsed GlobalCache code
+    TEST_ASSERT_TRUE(setIrSendCode(&msg, IRFormat::PRONTO, prontoCode, strlen(prontoCode)));
+    TEST_ASSERT_FALSE(msg.gcCode.isValid());
+    TEST_ASSERT_EQUAL_STRING(prontoCode, msg.message.c_str());
+
+    // GlobalCache code from a buffer which isn't zero-terminated
+    std::string datagram = std::string(gcCode) + ",garbage";
+    TEST_ASSERT_TRUE(setIrSendCode(&msg, IRFormat::GLOBAL_CACHE, datagram.c_str(), strlen(gcCode)));
+    TEST_ASSERT_EQUAL(12, msg.gcCode.timingCount());
+
+    int memError = -1;
+    TEST_ASSERT_FALSE(setIrSendCode(&msg, IRFormat::GLOBAL_CACHE, "38000,1,1,172", 13, &memError));
+    TEST_ASSERT_EQUAL(0, memError);
+    TEST_ASSERT_FALSE(setIrSendCode(&msg, IRFormat::UNKNOWN, hexCode, strlen(hexCode)));
+    TEST_ASSERT_FALSE(setIrSendCode(&msg, IRFormat::UNFOLDED_CIRCLE, hexCode, 0));
+    TEST_ASSERT_FALSE(setIrSendCode(&msg, IRFormat::UNFOLDED_CIRCLE, nullptr, 5));
+}
+
+void test_gcCodeReusesBuffer(void) {
+    GCIrCode code;
+    TEST_ASSERT_EQUAL(0, parseGcIrCode(gcCode, &code));
+    uint16_t *data = code.data;
+    TEST_ASSERT_EQUAL(code.count, code.capacity);
+
+    // same or shorter code: no allocation
+    startCounting();
+    TEST_ASSERT_EQUAL(0, parseGcIrCode("40000,2,1,100,200,300,400", &code));
+    TEST_ASSERT_EQUAL(0, stopCounting());
+    TEST_ASSERT_TRUE(code.data == data);
+    TEST_ASSERT_EQUAL(40000, code.frequency());
+    TEST_ASSERT_EQUAL(4, code.timingCount());
+
+    // invalid code doesn't lose the buffer
+    TEST_ASSERT_EQUAL(5, parseGcIrCode("100,1,1,100,200", &code));
+    TEST_ASSERT_TRUE(code.data == data);
+
+    // moved code takes the buffer along
+    GCIrCode other = static_cast<GCIrCode &&>(code);
+    TEST_ASSERT_TRUE(other.data == data);
+    TEST_ASSERT_EQUAL(0, code.capacity);
+    TEST_ASSERT_TRUE(code.data == nullptr);
+}
+
+void test_pool_acquireRelease(void) {
+    IrMessagePool<4> pool;
+    TEST_ASSERT_EQUAL(4, pool.available());
+
+    IRSendMessage *msgs[5];
+    for (int i = 0; i < 4; i++) {
+        msgs[i] = pool.acquire();
+        TEST_ASSERT_NOT_NULL(msgs[i]);
+    }
+    TEST_ASSERT_EQUAL(0, pool.available());
+    for (int i = 0; i < 4; i++) {
+        for (int j = i + 1; j < 4; j++) {
+            TEST_ASSERT_TRUE(msgs[i] != msgs[j]);
+        }
+    }
+
+    // exhausted pool allocates on the heap
+    startCounting();
+    msgs[4] = pool.acquire();
+    TEST_ASSERT_EQUAL(1, stopCounting());
+    TEST_ASSERT_NOT_NULL(msgs[4]);
+    pool.release(msgs[4]);
+    TEST_ASSERT_EQUAL(0, pool.available());
+
+    pool.release(msgs[2]);
+    TEST_ASSERT_EQUAL(1, pool.available());
+    TEST_ASSERT_TRUE(pool.acquire() == msgs[2]);
+
+    for (int i = 0; i < 4; i++) {
+        pool.release(msgs[i]);
+    }
+    TEST_ASSERT_EQUAL(4, pool.available());
+    pool.release(nullptr);
+    TEST_ASSERT_EQUAL(4, pool.available());
+}
+
+void test_pool_releaseTrimsLargeBuffers(void) {
+    IrMessagePool<1> pool;
+    IRSendMessage   *msg = pool.acquire();
+
+    std::string large(IR_MESSAGE_KEEP_SIZE + 1, '1');
+    TEST_ASSERT_TRUE(msg->message.assign(large.c_str(), large.size()));
+    pool.release(msg);
+    msg = pool.acquire();
+    TEST_ASSERT_EQUAL(0, msg->message.capacity());
+    TEST_ASSERT_EQUAL(0, msg->message.length());
+
+    TEST_ASSERT_TRUE(setIrSendCode(msg, IRFormat::PRONTO, prontoCode, strlen(prontoCode)));
+    pool.release(msg);
+    msg = pool.acquire();
+    TEST_ASSERT_TRUE(msg->message.capacity() > strlen(prontoCode));
+    TEST_ASSERT_EQUAL_STRING("", msg->message.c_str());
+    pool.release(msg);
+}
+
+void test_pool_concurrent(void) {
+    IrMessagePool<8>  pool;
+    std::atomic<int>  errors(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.push_back(std::thread([&pool, &errors, t]() {
+            for (int i = 0; i < 10000; i++) {
+                IRSendMessage *msg = pool.acquire();
+                if (msg == nullptr) {
+                    errors++;
+                    continue;
+                }
+                // nobody else may use the message at the same time
+                msg->msgId = t;
+                std::this_thread::yield();
+                if (msg->msgId != static_cast<uint32_t>(t)) {
+                    errors++;
+                }
+                pool.release(msg);
+            }
+        }));
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    TEST_ASSERT_EQUAL(0, errors.load());
+    TEST_ASSERT_EQUAL(8, pool.available());
+}
+
+// Same steps as `InfraredService::send` for an `ir_send` request.
+static bool submitIrSend(IrMessagePool<> *pool, const char *code, size_t length, const char *format) {
+    IRSendMessage *msg = pool->acquire();
+    if (msg == nullptr) {
+        return false;
+    }
+    msg->clientId = 1;
+    msg->msgId = 2;
+    msg->repeat = 0;
+    msg->pin_mask = 1;
+    msg->gcConnection = 0;
+    msg->sendAt = 0;
+    bool ok = setIrSendCode(msg, parseIrFormat(format), code, length);
+    // the IR send task releases the message after sending
+    pool->release(msg);
+    return ok;
+}
+
+void test_irSend_noHeapAllocation(void) {
+    IrMessagePool<> pool;
+    const char     *codes[] = {hexCode, prontoCode, gcCode};
+    const char     *formats[] = {"hex", "pronto", "gc"};
+
+    // first use of the pooled message allocates the buffers
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_TRUE(submitIrSend(&pool, codes[i], strlen(codes[i]), formats[i]));
+    }
+
+    startCounting();
+    bool ok = true;
+    for (int n = 0; n < 1000; n++) {
+        for (int i = 0; i < 3; i++) {
+            ok &= submitIrSend(&pool, codes[i], strlen(codes[i]), formats[i]);
+        }
+    }
+    int count = stopCounting();
+    TEST_ASSERT_TRUE(ok);
+    TEST_ASSERT_EQUAL(0, count);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_parseIrFormat);
+    RUN_TEST(test_irCodeBuffer);
+    RUN_TEST(test_setIrSendCode);
+    RUN_TEST(test_gcCodeReusesBuffer);
+    RUN_TEST(test_pool_acquireRelease);
+    RUN_TEST(test_pool_releaseTrimsLargeBuffers);
+    RUN_TEST(test_pool_concurrent);
+    RUN_TEST(test_irSend_noHeapAllocation);
+
+    UNITY_END();
+}
@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <unity.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "ir_response_queue.hpp"
+
+// Response with an instance counter to detect leaked or double deleted responses
+struct Response {
+    static int instances;
+
+    Response(int16_t clientId, const std::string &message) : clientId(clientId), message(message) { instances++; }
+    ~Response() { instances--; }
+
+    int16_t     clientId;
+    std::string message;
+};
+
+int Response::instances = 0;
+
+void setUp(void) {
+    Response::instances = 0;
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+void test_pushPop(void) {
+    IrResponseQueue<Response, 4> queue;
+    int                          wakeups = 0;
+    queue.onPush([&wakeups]() { wakeups++; });
+
+    TEST_ASSERT_NULL(queue.pop());
+    TEST_ASSERT_TRUE(queue.push(new Response(1, "first")));
+    TEST_ASSERT_TRUE(queue.push(new Response(-5, "second")));
+    TEST_ASSERT_EQUAL(2, queue.pending());
+    TEST_ASSERT_EQUAL(2, wakeups);
+
+    Response *response = queue.pop();
+    TEST_ASSERT_NOT_NULL(response);
+    TEST_ASSERT_EQUAL(1, response->clientId);
+    TEST_ASSERT_EQUAL_STRING("first", response->message.c_str());
+    delete response;
+
+    response = queue.pop();
+    TEST_ASSERT_NOT_NULL(response);
+    TEST_ASSERT_EQUAL(-5, response->clientId);
+    delete response;
+
+    TEST_ASSERT_NULL(queue.pop());
+    TEST_ASSERT_EQUAL(0, queue.pending());
+    TEST_ASSERT_EQUAL(0, Response::instances);
+
+    TEST_ASSERT_FALSE(queue.push(nullptr));
+    TEST_ASSERT_EQUAL(2, wakeups);
+}
+
+void test_pushFull(void) {
+    IrResponseQueue<Response, 2> queue;
+    int                          wakeups = 0;
+    queue.onPush([&wakeups]() { wakeups++; });
+
+    TEST_ASSERT_TRUE(queue.push(new Response(1, "a")));
+    TEST_ASSERT_TRUE(queue.push(new Response(2, "b")));
+    // deleted by the queue without waking up the consumer
+    TEST_ASSERT_FALSE(queue.push(new Response(3, "c")));
+    TEST_ASSERT_EQUAL(2, Response::instances);
+    TEST_ASSERT_EQUAL(2, wakeups);
+    TEST_ASSERT_EQUAL(1, queue.dropped());
+
+    delete queue.pop();
+    TEST_ASSERT_TRUE(queue.push(new Response(4, "d")));
+    Response *response = queue.pop();
+    TEST_ASSERT_EQUAL(2, response->clientId);
+    delete response;
+    response = queue.pop();
+    TEST_ASSERT_EQUAL(4, response->clientId);
+    delete response;
+    TEST_ASSERT_EQUAL(0, Response::instances);
+}
+
+void test_clear(void) {
+    {
+        IrResponseQueue<Response, 3> queue;
+        queue.push(new Response(1, "a"));
+        queue.push(new Response(2, "b"));
+        queue.clear();
+        TEST_ASSERT_EQUAL(0, queue.pending());
+        TEST_ASSERT_EQUAL(0, Response::instances);
+        TEST_ASSERT_NULL(queue.pop());
+
+        // pending responses are deleted with the queue
+        queue.push(new Response(3, "c"));
+        queue.push(new Response(4, "d"));
+        delete queue.pop();
+        queue.push(new Response(5, "e"));
+        queue.push(new Response(6, "f"));
+        TEST_ASSERT_EQUAL(3, Response::instances);
+    }
+    TEST_ASSERT_EQUAL(0, Response::instances);
+}
+
+// IR send and learn tasks queue responses while the API task drains the queue whenever it's woken up: every queued
+// response is received once and in order, responses of a full queue are deleted.
+void test_producersConsumer(void) {
+    const int                    count = 5000;
+    IrResponseQueue<Response, 5> queue;
+    std::mutex                   mutex;
+    std::condition_variable      wake;
+    bool                         woken = false;
+    std::atomic<int>             queued(0);
+    std::atomic<int>             producers(2);
+    queue.onPush([&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        woken = true;
+        wake.notify_one();
+    });
+
+    auto producer = [&](int16_t clientId) {
+        for (int i = 0; i < count; i++) {
+            if (queue.push(new Response(clientId, std::to_string(i)))) {
+                queued++;
+            }
+            if (i % 64 == 0) {
+                std::this_thread::yield();
+            }
+        }
+        producers--;
+        std::lock_guard<std::mutex> lock(mutex);
+        woken = true;
+        wake.notify_one();
+    };
+
+    int         received = 0;
+    int         last[2] = {-1, -1};
+    bool        ordered = true;
+    std::thread send(producer, 0);
+    std::thread learn(producer, 1);
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return woken || producers == 0; });
+            woken = false;
+        }
+        bool done = producers == 0;
+        Response *response;
+        while ((response = queue.pop()) != nullptr) {
+            int number = std::stoi(response->message);
+            ordered = ordered && number > last[response->clientId];
+            last[response->clientId] = number;
+            received++;
+            delete response;
+        }
+        if (done) {
+            break;
+        }
+    }
+    send.join();
+    learn.join();
+    // responses queued after the last wake-up
+    Response *response;
+    while ((response = queue.pop()) != nullptr) {
+        received++;
+        delete response;
+    }
+
+    TEST_ASSERT_TRUE(ordered);
+    TEST_ASSERT_EQUAL(queued.load(), received);
+    TEST_ASSERT_EQUAL(2 * count, received + static_cast<int>(queue.dropped()));
+    TEST_ASSERT_EQUAL(0, Response::instances);
+
+    char msg[80];
+    snprintf(msg, sizeof(msg), "received %d/%d responses", received, 2 * count);
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_pushPop);
+    RUN_TEST(test_pushFull);
+    RUN_TEST(test_clear);
+    RUN_TEST(test_producersConsumer);
+
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,285 @@
+#include <unity.h>
+
+#include <vector>
+
+#include "ir_send_scheduler.hpp"
+
+/// Simulated IR send command
+struct SimCmd {
+    int id;
+    int repeat;
+};
+
+/// Simulated IR send backend with the same repeat callback logic as the IR send task: after every IR frame, the
+/// callback decides if the code is repeated, or ended early because of a preemption request.
+struct SimBackend {
+    IrSendScheduler<SimCmd> scheduler;
+    /// Log of sent frames: command id per frame
+    std::vector<int> frames;
+    /// Completed commands
+    std::vector<int> completed;
+    /// Cancelled commands
+    std::vector<int> cancelled;
+
+    /// Send one frame of the active command, or pick up the next command.
+    /// @return false if idle.
+    bool step() {
+        SimCmd *cmd = scheduler.current();
+        if (cmd == nullptr) {
+            cmd = scheduler.next();
+            if (cmd == nullptr) {
+                return false;
+            }
+            sendFrame(cmd);
+            return true;
+        }
+        // repeat callback
+        if (scheduler.preemptRequested() && cmd->repeat > 0) {
+            // a resumed command starts with a frame
+            cmd->repeat--;
+            SimCmd *cancel = scheduler.finish(true);
+            if (cancel) {
+                cancelled.push_back(cancel->id);
+            }
+            return true;
+        }
+        if (cmd->repeat > 0) {
+            cmd->repeat--;
+            sendFrame(cmd);
+            return true;
+        }
+        scheduler.finish(false);
+        completed.push_back(cmd->id);
+        return true;
+    }
+
+    void sendFrame(SimCmd *cmd) { frames.push_back(cmd->id); }
+
+    void steps(int count) {
+        for (int i = 0; i < count; i++) {
+            step();
+        }
+    }
+
+    void runUntilIdle() {
+        while (step()) {
+        }
+    }
+
+    int framesOf(int id) {
+        int count = 0;
+        for (int frame : frames) {
+            if (frame == id) {
+                count++;
+            }
+        }
+        return count;
+    }
+};
+
+void setUp(void) {}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+void test_parseIrSendPriority(void) {
+    IrSendPriority priority = IrSendPriority::PREEMPT;
+    TEST_ASSERT_TRUE(parseIrSendPriority(nullptr, &priority));
+    TEST_ASSERT_EQUAL(IrSendPriority::NORMAL, priority);
+    TEST_ASSERT_TRUE(parseIrSendPriority("", &priority));
+    TEST_ASSERT_EQUAL(IrSendPriority::NORMAL, priority);
+    TEST_ASSERT_TRUE(parseIrSendPriority("high", &priority));
+    TEST_ASSERT_EQUAL(IrSendPriority::HIGH, priority);
+    TEST_ASSERT_TRUE(parseIrSendPriority("preempt", &priority));
+    TEST_ASSERT_EQUAL(IrSendPriority::PREEMPT, priority);
+    TEST_ASSERT_FALSE(parseIrSendPriority("urgent", &priority));
+}
+
+void test_normal_busy(void) {
+    SimBackend backend;
+    SimCmd     ramp = {1, 10};
+    SimCmd     other = {2, 0};
+
+    TEST_ASSERT_TRUE(backend.scheduler.submit(&ramp, IrSendPriority::NORMAL));
+    TEST_ASSERT_FALSE(backend.scheduler.submit(&other, IrSendPriority::NORMAL));
+    backend.steps(3);
+    TEST_ASSERT_FALSE(backend.scheduler.submit(&other, IrSendPriority::NORMAL));
+    backend.runUntilIdle();
+
+    TEST_ASSERT_EQUAL(11, backend.framesOf(1));
+    TEST_ASSERT_TRUE(backend.scheduler.submit(&other, IrSendPriority::NORMAL));
+    backend.runUntilIdle();
+    TEST_ASSERT_EQUAL(2, backend.completed.size());
+}
+
+void test_high_queuedAfterActive(void) {
+    SimBackend backend;
+    SimCmd     ramp = {1, 10};
+    SimCmd     power = {2, 0};
+    SimCmd     other = {3, 0};
+
+    backend.scheduler.submit(&ramp, IrSendPriority::NORMAL);
+    backend.steps(3);
+    TEST_ASSERT_TRUE(backend.scheduler.submit(&power, IrSendPriority::HIGH));
+    TEST_ASSERT_FALSE(backend.scheduler.preemptRequested());
+    // pending slot in use
+    TEST_ASSERT_FALSE(backend.scheduler.submit(&other, IrSendPriority::HIGH));
+    backend.runUntilIdle();
+
+    TEST_ASSERT_EQUAL(11, backend.framesOf(1));
+    TEST_ASSERT_EQUAL(1, backend.framesOf(2));
+    TEST_ASSERT_EQUAL(2, backend.completed.size());
+    TEST_ASSERT_EQUAL(1, backend.completed[0]);
+    TEST_ASSERT_EQUAL(2, backend.completed[1]);
+    TEST_ASSERT_EQUAL(0, backend.cancelled.size());
+}
+
+void test_preempt_cancel(void) {
+    SimBackend backend;
+    SimCmd     ramp = {1, 50};
+    SimCmd     mute = {2, 1};
+
+    backend.scheduler.submit(&ramp, IrSendPriority::NORMAL);
+    backend.steps(3);
+    TEST_ASSERT_TRUE(backend.scheduler.submit(&mute, IrSendPriority::PREEMPT, false));
+    TEST_ASSERT_TRUE(backend.scheduler.preemptRequested());
+    backend.runUntilIdle();
+
+    // the frame being sent is finished, then the mute command follows immediately
+    TEST_ASSERT_EQUAL(3, backend.framesOf(1));
+    TEST_ASSERT_EQUAL(2, backend.framesOf(2));
+    TEST_ASSERT_EQUAL(2, backend.frames[3]);
+    TEST_ASSERT_EQUAL(1, backend.cancelled.size());
+    TEST_ASSERT_EQUAL(1, backend.cancelled[0]);
+    TEST_ASSERT_EQUAL(1, backend.completed.size());
+    TEST_ASSERT_EQUAL(2, backend.completed[0]);
+    TEST_ASSERT_FALSE(backend.scheduler.isBusy());
+}
+
+void test_preempt_resume(void) {
+    SimBackend backend;
+    SimCmd     ramp = {1, 50};
+    SimCmd     mute = {2, 0};
+
+    backend.scheduler.submit(&ramp, IrSendPriority::NORMAL);
+    backend.steps(10);
+    TEST_ASSERT_TRUE(backend.scheduler.submit(&mute, IrSendPriority::PREEMPT, true));
+    // normal commands are still rejected while a command is suspended
+    SimCmd other = {3, 0};
+    backend.steps(2);
+    TEST_ASSERT_FALSE(backend.scheduler.submit(&other, IrSendPriority::NORMAL));
+    backend.runUntilIdle();
+
+    // all ramp frames are sent, interrupted by the mute frame
+    TEST_ASSERT_EQUAL(51, backend.framesOf(1));
+    TEST_ASSERT_EQUAL(1, backend.framesOf(2));
+    TEST_ASSERT_EQUAL(2, backend.frames[10]);
+    TEST_ASSERT_EQUAL(0, backend.cancelled.size());
+    TEST_ASSERT_EQUAL(2, backend.completed.size());
+    TEST_ASSERT_EQUAL(2, backend.completed[0]);
+    TEST_ASSERT_EQUAL(1, backend.completed[1]);
+}
+
+void test_preempt_lastFrameCompletesNormally(void) {
+    SimBackend backend;
+    SimCmd     cmd = {1, 0};
+    SimCmd     mute = {2, 0};
+
+    backend.scheduler.submit(&cmd, IrSendPriority::NORMAL);
+    backend.step();
+    backend.scheduler.submit(&mute, IrSendPriority::PREEMPT);
+    backend.runUntilIdle();
+
+    TEST_ASSERT_EQUAL(0, backend.cancelled.size());
+    TEST_ASSERT_EQUAL(2, backend.completed.size());
+}
+
+void test_preempt_doesNotInterruptPreempt(void) {
+    SimBackend backend;
+    SimCmd     first = {1, 5};
+    SimCmd     second = {2, 0};
+
+    backend.scheduler.submit(&first, IrSendPriority::PREEMPT);
+    backend.step();
+    TEST_ASSERT_TRUE(backend.scheduler.submit(&second, IrSendPriority::PREEMPT));
+    TEST_ASSERT_FALSE(backend.scheduler.preemptRequested());
+    backend.runUntilIdle();
+
+    TEST_ASSERT_EQUAL(6, backend.framesOf(1));
+    TEST_ASSERT_EQUAL(0, backend.cancelled.size());
+    TEST_ASSERT_EQUAL(2, backend.completed.size());
+}
+
+void test_preempt_beforeSendTaskPickedUp(void) {
+    SimBackend backend;
+    SimCmd     ramp = {1, 20};
+    SimCmd     mute = {2, 0};
+
+    backend.scheduler.submit(&ramp, IrSendPriority::NORMAL);
+    TEST_ASSERT_TRUE(backend.scheduler.submit(&mute, IrSendPriority::PREEMPT));
+    // nothing active yet
+    TEST_ASSERT_FALSE(backend.scheduler.preemptRequested());
+    backend.runUntilIdle();
+
+    TEST_ASSERT_EQUAL(1, backend.framesOf(1));
+    TEST_ASSERT_EQUAL(1, backend.cancelled.size());
+}
+
+void test_nestedPreemption_displacesSuspended(void) {
+    SimBackend backend;
+    SimCmd     ramp = {1, 50};
+    SimCmd     high = {2, 20};
+    SimCmd     mute1 = {3, 0};
+    SimCmd     mute2 = {4, 0};
+
+    backend.scheduler.submit(&ramp, IrSendPriority::NORMAL);
+    backend.steps(2);
+    backend.scheduler.submit(&mute1, IrSendPriority::PREEMPT, true);
+    backend.step();  // ramp interrupted and suspended
+    backend.step();  // mute1 started
+    TEST_ASSERT_TRUE(backend.scheduler.submit(&high, IrSendPriority::HIGH));
+    backend.steps(2);  // mute1 done, high started
+    TEST_ASSERT_EQUAL(&high, backend.scheduler.current());
+    backend.scheduler.submit(&mute2, IrSendPriority::PREEMPT, true);
+    backend.runUntilIdle();
+
+    TEST_ASSERT_EQUAL(1, backend.cancelled.size());
+    TEST_ASSERT_EQUAL(1, backend.cancelled[0]);
+    TEST_ASSERT_EQUAL(21, backend.framesOf(2));
+}
+
+void test_cancelSuspended(void) {
+    SimBackend backend;
+    SimCmd     ramp = {1, 50};
+    SimCmd     mute = {2, 0};
+
+    backend.scheduler.submit(&ramp, IrSendPriority::NORMAL);
+    backend.steps(2);
+    backend.scheduler.submit(&mute, IrSendPriority::PREEMPT, true);
+    backend.step();
+    TEST_ASSERT_EQUAL(&ramp, backend.scheduler.cancelSuspended());
+    TEST_ASSERT_NULL(backend.scheduler.cancelSuspended());
+    backend.runUntilIdle();
+    TEST_ASSERT_EQUAL(2, backend.framesOf(1));
+    TEST_ASSERT_FALSE(backend.scheduler.isBusy());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_parseIrSendPriority);
+    RUN_TEST(test_normal_busy);
+    RUN_TEST(test_high_queuedAfterActive);
+    RUN_TEST(test_preempt_cancel);
+    RUN_TEST(test_preempt_resume);
+    RUN_TEST(test_preempt_lastFrameCompletesNormally);
+    RUN_TEST(test_preempt_doesNotInterruptPreempt);
+    RUN_TEST(test_preempt_beforeSendTaskPickedUp);
+    RUN_TEST(test_nestedPreemption_displacesSuspended);
+    RUN_TEST(test_cancelSuspended);
+
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,468 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <unity.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "ir_udp.hpp"
+
+// Different port than on the device
+#define TEST_UDP_PORT 19947
+
+const char  *testCode = "4;0x640C;15;0";
+const char  *testToken = "secret-token";
+IrUdpCommand testCmd;
+
+// The replay window started 10 seconds before the test time
+const int64_t testStartUs = kMinPlausibleEpochUs + 1000000000LL;
+const int64_t testNowUs = testStartUs + 10000000LL;
+
+void setUp(void) {
+    testCmd.flags = IR_UDP_FLAG_ACK;
+    testCmd.clientId = 0xCAFE0001;
+    testCmd.seq = 1;
+    testCmd.sentAt = testNowUs;
+    testCmd.outputs = IR_GROUP_INT_SIDE | IR_GROUP_INT_TOP;
+    testCmd.format = 1;
+    testCmd.repeat = 2;
+    testCmd.code = testCode;
+    testCmd.codeLen = strlen(testCode);
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+void test_irUdpCommand_roundTrip(void) {
+    SipHashKey key = irUdpKey(testToken);
+    uint8_t    buf[kIrUdpMaxPacketLen];
+
+    size_t len = irUdpEncodeCommand(key, testCmd, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL(kIrUdpHeaderLen + strlen(testCode) + kIrUdpMacLen, len);
+
+    IrUdpCommand cmd;
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, irUdpDecodeCommand(key, buf, len, &cmd));
+    TEST_ASSERT_EQUAL(IR_UDP_FLAG_ACK, cmd.flags);
+    TEST_ASSERT_EQUAL_UINT32(0xCAFE0001, cmd.clientId);
+    TEST_ASSERT_EQUAL_UINT32(1, cmd.seq);
+    TEST_ASSERT_TRUE(cmd.sentAt == testNowUs);
+    TEST_ASSERT_EQUAL(IR_GROUP_INT_SIDE | IR_GROUP_INT_TOP, cmd.outputs);
+    TEST_ASSERT_EQUAL(1, cmd.format);
+    TEST_ASSERT_EQUAL(2, cmd.repeat);
+    TEST_ASSERT_EQUAL_STRING_LEN(testCode, cmd.code, cmd.codeLen);
+}
+
+void test_irUdpCommand_invalid(void) {
+    SipHashKey   key = irUdpKey(testToken);
+    IrUdpCommand cmd;
+    uint8_t      buf[kIrUdpMaxPacketLen];
+
+    size_t len = irUdpEncodeCommand(key, testCmd, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL(IrUdpResult::TOO_SHORT, irUdpDecodeCommand(key, buf, kIrUdpHeaderLen, &cmd));
+    TEST_ASSERT_EQUAL(IrUdpResult::BAD_LENGTH, irUdpDecodeCommand(key, buf, len + 1, &cmd));
+    TEST_ASSERT_EQUAL(IrUdpResult::BAD_MAC, irUdpDecodeCommand(irUdpKey("0000"), buf, len, &cmd));
+
+    for (size_t i = 4; i < len; i++) {
+        buf[i] ^= 0x80;
+        // modified code length is detected before the MAC check
+        auto expected = (i == 25 || i == 26) ? IrUdpResult::BAD_LENGTH : IrUdpResult::BAD_MAC;
+        TEST_ASSERT_EQUAL(expected, irUdpDecodeCommand(key, buf, len, &cmd));
+        buf[i] ^= 0x80;
+    }
+
+    buf[3] = 1;
+    TEST_ASSERT_EQUAL(IrUdpResult::BAD_VERSION, irUdpDecodeCommand(key, buf, len, &cmd));
+    buf[2] = 'G';
+    TEST_ASSERT_EQUAL(IrUdpResult::BAD_MAGIC, irUdpDecodeCommand(key, buf, len, &cmd));
+
+    testCmd.codeLen = kIrUdpMaxCodeLen + 1;
+    TEST_ASSERT_EQUAL(0, irUdpEncodeCommand(key, testCmd, buf, sizeof(buf)));
+}
+
+void test_irUdpAck_roundTrip(void) {
+    SipHashKey key = irUdpKey(testToken);
+    uint8_t    buf[kIrUdpAckLen];
+    uint32_t   clientId, seq;
+    uint16_t   status;
+
+    TEST_ASSERT_EQUAL(0, irUdpEncodeAck(key, 1, 2, 200, buf, sizeof(buf) - 1));
+    TEST_ASSERT_EQUAL(kIrUdpAckLen, irUdpEncodeAck(key, 1, 2, 429, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, irUdpDecodeAck(key, buf, sizeof(buf), &clientId, &seq, &status));
+    TEST_ASSERT_EQUAL_UINT32(1, clientId);
+    TEST_ASSERT_EQUAL_UINT32(2, seq);
+    TEST_ASSERT_EQUAL(429, status);
+
+    buf[12] ^= 1;
+    TEST_ASSERT_EQUAL(IrUdpResult::BAD_MAC, irUdpDecodeAck(key, buf, sizeof(buf), &clientId, &seq, &status));
+}
+
+static IrUdpReplayWindow<> startedWindow() {
+    IrUdpReplayWindow<> window;
+    window.start(testStartUs);
+    return window;
+}
+
+void test_replayWindow(void) {
+    IrUdpReplayWindow<> window = startedWindow();
+    int64_t             now = testNowUs;
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, window.check(1, 100, now, now));
+    TEST_ASSERT_EQUAL(IrUdpResult::DUPLICATE, window.check(1, 100, now, now));
+    // out of order within window
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, window.check(1, 102, now, now));
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, window.check(1, 101, now, now));
+    TEST_ASSERT_EQUAL(IrUdpResult::DUPLICATE, window.check(1, 101, now, now));
+    TEST_ASSERT_EQUAL(IrUdpResult::REPLAY, window.check(1, 102 - 64, now, now));
+    // large jump resets the window
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, window.check(1, 1000, now, now));
+    TEST_ASSERT_EQUAL(IrUdpResult::REPLAY, window.check(1, 102, now, now));
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, window.check(1, 999, now, now));
+    // independent clients
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, window.check(2, 100, now, now));
+}
+
+void test_replayWindow_sendTime(void) {
+    IrUdpReplayWindow<> window;
+    int64_t             now = testNowUs;
+    // not started
+    TEST_ASSERT_FALSE(window.started());
+    TEST_ASSERT_EQUAL(IrUdpResult::CLOCK_NOT_SET, window.check(1, 1, now, now));
+    TEST_ASSERT_FALSE(window.start(kMinPlausibleEpochUs - 1));
+    TEST_ASSERT_FALSE(window.started());
+
+    TEST_ASSERT_TRUE(window.start(testStartUs));
+    TEST_ASSERT_TRUE(window.started());
+    TEST_ASSERT_EQUAL(IrUdpResult::CLOCK_NOT_SET, window.check(1, 1, now, kMinPlausibleEpochUs - 1));
+
+    // accepted clock skew
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, window.check(1, 1, now - kIrUdpMaxClockSkewUs, now));
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, window.check(1, 2, now + kIrUdpMaxClockSkewUs, now));
+    TEST_ASSERT_EQUAL(IrUdpResult::STALE, window.check(1, 3, now - kIrUdpMaxClockSkewUs - 1, now));
+    TEST_ASSERT_EQUAL(IrUdpResult::STALE, window.check(1, 4, now + kIrUdpMaxClockSkewUs + 1, now));
+    // a stale retransmission isn't a duplicate anymore
+    TEST_ASSERT_EQUAL(IrUdpResult::STALE, window.check(1, 1, now - kIrUdpMaxClockSkewUs, now + 1));
+
+    // commands sent before the window started, e.g. captured before a reboot
+    TEST_ASSERT_EQUAL(IrUdpResult::STALE, window.check(2, 1, testStartUs, testStartUs));
+    TEST_ASSERT_EQUAL(IrUdpResult::STALE,
+                      window.check(2, 1, testStartUs + kIrUdpMaxClockSkewUs - 1, testStartUs + kIrUdpMaxClockSkewUs));
+    TEST_ASSERT_EQUAL(IrUdpResult::OK,
+                      window.check(2, 1, testStartUs + kIrUdpMaxClockSkewUs, testStartUs + kIrUdpMaxClockSkewUs));
+}
+
+void test_replayWindow_eviction(void) {
+    IrUdpReplayWindow<2> window;
+    window.start(testStartUs);
+    int64_t now = testNowUs;
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, window.check(1, 10, now, now));
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, window.check(2, 10, now, now));
+    TEST_ASSERT_EQUAL(IrUdpResult::DUPLICATE, window.check(1, 10, now, now));
+    // both clients sent fresh commands: a replay would be accepted after evicting one of them
+    TEST_ASSERT_EQUAL(IrUdpResult::BUSY, window.check(3, 10, now, now));
+
+    // client 1 stays active, client 2 is evicted once its commands are stale
+    now += kIrUdpMaxClockSkewUs;
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, window.check(1, 11, now, now));
+    now += 1;
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, window.check(3, 10, now, now));
+    TEST_ASSERT_EQUAL(IrUdpResult::DUPLICATE, window.check(1, 11, now, now));
+    TEST_ASSERT_EQUAL(IrUdpResult::DUPLICATE, window.check(3, 10, now, now));
+    TEST_ASSERT_EQUAL(IrUdpResult::STALE, window.check(2, 10, testNowUs, now));
+}
+
+void test_handler(void) {
+    int          calls = 0;
+    uint16_t     sendResult = 0;
+    IrUdpHandler handler([&](const IrUdpCommand &cmd) {
+        calls++;
+        return sendResult;
+    });
+    handler.setToken(testToken);
+    handler.start(testStartUs);
+
+    SipHashKey  key = irUdpKey(testToken);
+    uint8_t     in[kIrUdpMaxPacketLen];
+    uint8_t     ack[kIrUdpAckLen];
+    IrUdpResult result;
+    uint32_t    clientId, seq;
+    uint16_t    status;
+
+    size_t len = irUdpEncodeCommand(key, testCmd, in, sizeof(in));
+    size_t ackLen = handler.handle(in, len, testNowUs, ack, sizeof(ack), &result);
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, result);
+    TEST_ASSERT_EQUAL(1, calls);
+    TEST_ASSERT_EQUAL(kIrUdpAckLen, ackLen);
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, irUdpDecodeAck(key, ack, ackLen, &clientId, &seq, &status));
+    TEST_ASSERT_EQUAL(200, status);
+
+    // retransmission is acknowledged but not sent again
+    ackLen = handler.handle(in, len, testNowUs, ack, sizeof(ack), &result);
+    TEST_ASSERT_EQUAL(IrUdpResult::DUPLICATE, result);
+    TEST_ASSERT_EQUAL(1, calls);
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, irUdpDecodeAck(key, ack, ackLen, &clientId, &seq, &status));
+    TEST_ASSERT_EQUAL(208, status);
+
+    // IR service busy
+    sendResult = 429;
+    testCmd.seq = 2;
+    len = irUdpEncodeCommand(key, testCmd, in, sizeof(in));
+    ackLen = handler.handle(in, len, testNowUs, ack, sizeof(ack), &result);
+    TEST_ASSERT_EQUAL(IrUdpResult::REJECTED, result);
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, irUdpDecodeAck(key, ack, ackLen, &clientId, &seq, &status));
+    TEST_ASSERT_EQUAL(429, status);
+    TEST_ASSERT_EQUAL_UINT32(2, seq);
+
+    // fire and forget
+    sendResult = 0;
+    testCmd.seq = 3;
+    testCmd.flags = 0;
+    len = irUdpEncodeCommand(key, testCmd, in, sizeof(in));
+    TEST_ASSERT_EQUAL(0, handler.handle(in, len, testNowUs, ack, sizeof(ack), &result));
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, result);
+    TEST_ASSERT_EQUAL(3, calls);
+
+    TEST_ASSERT_EQUAL(2, handler.stats().queued);
+    TEST_ASSERT_EQUAL(1, handler.stats().rejected);
+    TEST_ASSERT_EQUAL(1, handler.stats().duplicates);
+}
+
+void test_handler_unauthenticatedIsDropped(void) {
+    int          calls = 0;
+    IrUdpHandler handler([&](const IrUdpCommand &cmd) {
+        calls++;
+        return 0;
+    });
+    handler.setToken(testToken);
+
+    uint8_t     in[kIrUdpMaxPacketLen];
+    uint8_t     ack[kIrUdpAckLen];
+    IrUdpResult result;
+
+    size_t len = irUdpEncodeCommand(irUdpKey("0000"), testCmd, in, sizeof(in));
+    TEST_ASSERT_EQUAL(0, handler.handle(in, len, testNowUs, ack, sizeof(ack), &result));
+    TEST_ASSERT_EQUAL(IrUdpResult::BAD_MAC, result);
+    TEST_ASSERT_EQUAL(0, handler.handle(in, 3, testNowUs, ack, sizeof(ack), &result));
+    TEST_ASSERT_EQUAL(IrUdpResult::TOO_SHORT, result);
+    TEST_ASSERT_EQUAL(0, calls);
+    TEST_ASSERT_EQUAL(2, handler.stats().invalid);
+}
+
+// A captured datagram replayed to a rebooted dock: the new replay window doesn't know the client
+void test_handler_replayAfterReboot(void) {
+    int          calls = 0;
+    IrUdpHandler handler([&](const IrUdpCommand &cmd) {
+        calls++;
+        return 0;
+    });
+    handler.setToken(testToken);
+    handler.start(testStartUs);
+
+    SipHashKey  key = irUdpKey(testToken);
+    uint8_t     captured[kIrUdpMaxPacketLen];
+    uint8_t     ack[kIrUdpAckLen];
+    IrUdpResult result;
+    uint32_t    clientId, seq;
+    uint16_t    status;
+
+    size_t len = irUdpEncodeCommand(key, testCmd, captured, sizeof(captured));
+    handler.handle(captured, len, testNowUs, ack, sizeof(ack), &result);
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, result);
+
+    // reboot within the accepted clock skew of the captured command
+    IrUdpHandler rebooted([&](const IrUdpCommand &cmd) {
+        calls++;
+        return 0;
+    });
+    rebooted.setToken(testToken);
+    size_t ackLen = rebooted.handle(captured, len, testNowUs + 1, ack, sizeof(ack), &result);
+    TEST_ASSERT_EQUAL(IrUdpResult::CLOCK_NOT_SET, result);
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, irUdpDecodeAck(key, ack, ackLen, &clientId, &seq, &status));
+    TEST_ASSERT_EQUAL(503, status);
+
+    TEST_ASSERT_TRUE(rebooted.start(testNowUs + 1));
+    uint32_t replays = 0;
+    for (int64_t delay = 1; delay <= 3 * kIrUdpMaxClockSkewUs; delay += kIrUdpMaxClockSkewUs / 4, replays++) {
+        ackLen = rebooted.handle(captured, len, testNowUs + delay, ack, sizeof(ack), &result);
+        TEST_ASSERT_EQUAL(IrUdpResult::STALE, result);
+    }
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, irUdpDecodeAck(key, ack, ackLen, &clientId, &seq, &status));
+    TEST_ASSERT_EQUAL(408, status);
+    TEST_ASSERT_EQUAL(1, calls);
+    TEST_ASSERT_EQUAL(replays, rebooted.stats().stale);
+
+    // new commands of the client are accepted once the window started
+    testCmd.seq = 2;
+    testCmd.sentAt = testNowUs + 1 + kIrUdpMaxClockSkewUs;
+    len = irUdpEncodeCommand(key, testCmd, captured, sizeof(captured));
+    rebooted.handle(captured, len, testCmd.sentAt, ack, sizeof(ack), &result);
+    TEST_ASSERT_EQUAL(IrUdpResult::OK, result);
+    TEST_ASSERT_EQUAL(2, calls);
+}
+
+// Captured datagrams of more clients than the replay window holds, replayed over and over: none is sent twice
+void test_handler_replayAfterEviction(void) {
+    const int    clients = 9;
+    int          calls = 0;
+    IrUdpHandler handler([&](const IrUdpCommand &cmd) {
+        calls++;
+        return 0;
+    });
+    handler.setToken(testToken);
+    handler.start(testStartUs);
+
+    SipHashKey  key = irUdpKey(testToken);
+    uint8_t     captured[clients][kIrUdpMaxPacketLen];
+    size_t      lengths[clients];
+    uint8_t     ack[kIrUdpAckLen];
+    IrUdpResult result;
+
+    for (int i = 0; i < clients; i++) {
+        testCmd.clientId = 0xCAFE0000 + i;
+        testCmd.sentAt = testNowUs + i;
+        lengths[i] = irUdpEncodeCommand(key, testCmd, captured[i], sizeof(captured[i]));
+        handler.handle(captured[i], lengths[i], testNowUs + i, ack, sizeof(ack), &result);
+        // the 9th client doesn't fit while the others are active
+        TEST_ASSERT_EQUAL(i < clients - 1 ? IrUdpResult::OK : IrUdpResult::BUSY, result);
+    }
+    TEST_ASSERT_EQUAL(clients - 1, calls);
+
+    for (int64_t now = testNowUs; now < testNowUs + 3 * kIrUdpMaxClockSkewUs; now += 100000) {
+        for (int i = 0; i < clients; i++) {
+            handler.handle(captured[i], lengths[i], now, ack, sizeof(ack), &result);
+            TEST_ASSERT_TRUE(result == IrUdpResult::DUPLICATE || result == IrUdpResult::BUSY ||
+                             result == IrUdpResult::STALE);
+        }
+    }
+    TEST_ASSERT_EQUAL(clients - 1, calls);
+}
+
+static int64_t nowUs() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return static_cast<int64_t>(tv.tv_sec) * 1000000LL + tv.tv_usec;
+}
+
+static int openUdpSocket(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = htons(port);
+    if (bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    struct timeval tv = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+/// Load generator: acknowledged commands over loopback, measuring the round trip through the datagram handler.
+void test_loopback_load(void) {
+    const int    requests = 2000;
+    int          calls = 0;
+    IrUdpHandler handler([&](const IrUdpCommand &cmd) {
+        calls++;
+        return 0;
+    });
+    handler.setToken(testToken);
+    handler.start(nowUs() - kIrUdpMaxClockSkewUs);
+    SipHashKey key = irUdpKey(testToken);
+
+    int server = openUdpSocket(TEST_UDP_PORT);
+    int client = openUdpSocket(0);
+    if (server < 0 || client < 0) {
+        TEST_IGNORE_MESSAGE("UDP on loopback not available");
+    }
+    struct sockaddr_in serverAddr;
+    memset(&serverAddr, 0, sizeof(serverAddr));
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    serverAddr.sin_port = htons(TEST_UDP_PORT);
+
+    std::vector<int64_t> latencies;
+    uint8_t              buf[kIrUdpMaxPacketLen];
+    uint8_t              ack[kIrUdpAckLen];
+
+    for (int i = 0; i < requests; i++) {
+        testCmd.seq = i + 1;
+        testCmd.sentAt = nowUs();
+        size_t  len = irUdpEncodeCommand(key, testCmd, buf, sizeof(buf));
+        int64_t start = nowUs();
+        TEST_ASSERT_EQUAL(len, sendto(client, buf, len, 0, reinterpret_cast<struct sockaddr *>(&serverAddr),
+                                      sizeof(serverAddr)));
+
+        // device side
+        struct sockaddr_in source;
+        socklen_t          sourceLen = sizeof(source);
+        ssize_t            received =
+            recvfrom(server, buf, sizeof(buf), 0, reinterpret_cast<struct sockaddr *>(&source), &sourceLen);
+        TEST_ASSERT_GREATER_THAN(0, received);
+        size_t ackLen = handler.handle(buf, received, nowUs(), ack, sizeof(ack));
+        TEST_ASSERT_EQUAL(kIrUdpAckLen, ackLen);
+        sendto(server, ack, ackLen, 0, reinterpret_cast<struct sockaddr *>(&source), sourceLen);
+
+        // client side
+        uint32_t clientId, seq;
+        uint16_t status;
+        TEST_ASSERT_EQUAL(kIrUdpAckLen, recv(client, ack, sizeof(ack), 0));
+        TEST_ASSERT_EQUAL(IrUdpResult::OK, irUdpDecodeAck(key, ack, kIrUdpAckLen, &clientId, &seq, &status));
+        TEST_ASSERT_EQUAL_UINT32(testCmd.seq, seq);
+        latencies.push_back(nowUs() - start);
+    }
+
+    // burst of fire and forget commands
+    testCmd.flags = 0;
+    const int burst = 100;
+    for (int i = 0; i < burst; i++) {
+        testCmd.seq = requests + i + 1;
+        testCmd.sentAt = nowUs();
+        size_t len = irUdpEncodeCommand(key, testCmd, buf, sizeof(buf));
+        sendto(client, buf, len, 0, reinterpret_cast<struct sockaddr *>(&serverAddr), sizeof(serverAddr));
+    }
+    for (int i = 0; i < burst; i++) {
+        ssize_t received = recv(server, buf, sizeof(buf), 0);
+        TEST_ASSERT_GREATER_THAN(0, received);
+        TEST_ASSERT_EQUAL(0, handler.handle(buf, received, nowUs(), ack, sizeof(ack)));
+    }
+
+    close(server);
+    close(client);
+
+    TEST_ASSERT_EQUAL(requests + burst, calls);
+
+    std::sort(latencies.begin(), latencies.end());
+    char msg[80];
+    snprintf(msg, sizeof(msg), "round trip: p50=%lldus p99=%lldus max=%lldus",
+             static_cast<long long>(latencies[requests / 2]), static_cast<long long>(latencies[requests * 99 / 100]),
+             static_cast<long long>(latencies.back()));
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_irUdpCommand_roundTrip);
+    RUN_TEST(test_irUdpCommand_invalid);
+    RUN_TEST(test_irUdpAck_roundTrip);
+    RUN_TEST(test_replayWindow);
+    RUN_TEST(test_replayWindow_sendTime);
+    RUN_TEST(test_replayWindow_eviction);
+    RUN_TEST(test_handler);
+    RUN_TEST(test_handler_unauthenticatedIsDropped);
+    RUN_TEST(test_handler_replayAfterReboot);
+    RUN_TEST(test_handler_replayAfterEviction);
+    RUN_TEST(test_loopback_load);
+
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <unity.h>
+
+#include <chrono>
+#include <string>
+
+#include "json_redact.hpp"
+
+static const char *const keys[] = {"wifi_password", "token", "group_key"};
+#define KEY_COUNT (sizeof(keys) / sizeof(keys[0]))
+
+struct StringWriter {
+    std::string text;
+    void        write(const char *data, size_t len) { text.append(data, len); }
+};
+
+static std::string redact(const char *json) {
+    StringWriter out;
+    redactJson(json, strlen(json), keys, KEY_COUNT, &out);
+    return out.text;
+}
+
+#define TEST_ASSERT_REDACTED(expected, json)                  \
+    do {                                                      \
+        std::string redacted = redact(json);                  \
+        TEST_ASSERT_EQUAL_STRING(expected, redacted.c_str()); \
+    } while (0)
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+void test_redactJson_noSensitiveKeys(void) {
+    TEST_ASSERT_REDACTED("", "");
+    TEST_ASSERT_REDACTED("{}", "{}");
+    TEST_ASSERT_REDACTED("{\"type\":\"dock\",\"id\":3,\"command\":\"ir_send\",\"code\":\"0x1234\"}",
+                         "{\"type\":\"dock\",\"id\":3,\"command\":\"ir_send\",\"code\":\"0x1234\"}");
+    // original whitespace is kept
+    TEST_ASSERT_REDACTED("{ \"a\" : [1, 2, {\"b\": null}] }\n", "{ \"a\" : [1, 2, {\"b\": null}] }\n");
+
+    StringWriter out;
+    redactJson(nullptr, 0, keys, KEY_COUNT, &out);
+    TEST_ASSERT_EQUAL(0, out.text.length());
+}
+
+void test_redactJson_stringValues(void) {
+    TEST_ASSERT_REDACTED("{\"type\":\"auth\",\"token\":\"****\"}", "{\"type\":\"auth\",\"token\":\"secret\"}");
+    TEST_ASSERT_REDACTED(
+        "{\"command\":\"set_config\",\"wifi_ssid\":\"home\",\"wifi_password\":\"****\",\"token\":\"****\"}",
+        "{\"command\":\"set_config\",\"wifi_ssid\":\"home\",\"wifi_password\":\"p4ss\",\"token\":\"1234\"}");
+    TEST_ASSERT_REDACTED("{ \"token\" :  \"****\" , \"id\": 1}", "{ \"token\" :  \"abc\" , \"id\": 1}");
+    TEST_ASSERT_REDACTED("{\"token\":\"****\"}", "{\"token\":\"\"}");
+    // escaped quotes and backslashes don't end the value
+    TEST_ASSERT_REDACTED("{\"token\":\"****\",\"id\":2}", "{\"token\":\"a\\\"b\\\\\",\"id\":2}");
+    TEST_ASSERT_REDACTED("{\"group_key\":\"****\",\"b\":\"\\\"token\\\"\"}",
+                         "{\"group_key\":\"x\\\\\\\"y\",\"b\":\"\\\"token\\\"\"}");
+}
+
+void test_redactJson_otherValues(void) {
+    TEST_ASSERT_REDACTED("{\"token\":\"****\",\"id\":1}", "{\"token\":12345,\"id\":1}");
+    TEST_ASSERT_REDACTED("{\"token\":\"****\"}", "{\"token\":null}");
+    TEST_ASSERT_REDACTED("{\"token\":\"****\" }", "{\"token\":-1.5e3 }");
+    TEST_ASSERT_REDACTED("{\"token\":\"****\",\"id\":1}", "{\"token\":[1,\"]\",[2]],\"id\":1}");
+    TEST_ASSERT_REDACTED("{\"token\":\"****\",\"id\":1}", "{\"token\":{\"a\":\"}\",\"b\":{}},\"id\":1}");
+}
+
+void test_redactJson_keyMatching(void) {
+    // nested keys are masked
+    TEST_ASSERT_REDACTED("{\"cfg\":{\"wifi_password\":\"****\"}}", "{\"cfg\":{\"wifi_password\":\"x\"}}");
+    TEST_ASSERT_REDACTED("[{\"token\":\"****\"},{\"token\":\"****\"}]", "[{\"token\":\"a\"},{\"token\":\"b\"}]");
+    // a sensitive key name as value isn't a key
+    TEST_ASSERT_REDACTED("{\"command\":\"token\",\"a\":[\"token\",\"group_key\"]}",
+                         "{\"command\":\"token\",\"a\":[\"token\",\"group_key\"]}");
+    // names must match exactly
+    TEST_ASSERT_REDACTED("{\"tokens\":\"a\",\"toke\":\"b\",\"Token\":\"c\"}",
+                         "{\"tokens\":\"a\",\"toke\":\"b\",\"Token\":\"c\"}");
+
+    // configurable key list
+    const char *const custom[] = {"ssid", nullptr};
+    StringWriter      out;
+    const char       *json = "{\"ssid\":\"home\",\"token\":\"t\"}";
+    redactJson(json, strlen(json), custom, 2, &out);
+    TEST_ASSERT_EQUAL_STRING("{\"ssid\":\"****\",\"token\":\"t\"}", out.text.c_str());
+}
+
+void test_redactJson_escapedKeys(void) {
+    // the API request parser decodes escaped keys: they must be masked as well
+    TEST_ASSERT_REDACTED("{\"type\":\"dock\",\"command\":\"set_config\",\"to\\u006ben\":\"****\"}",
+                         "{\"type\":\"dock\",\"command\":\"set_config\",\"to\\u006ben\":\"secret\"}");
+    TEST_ASSERT_REDACTED("{\"\\u0074\\u006F\\u006B\\u0065\\u006E\":\"****\"}",
+                         "{\"\\u0074\\u006F\\u006B\\u0065\\u006E\":\"secret\"}");
+    TEST_ASSERT_REDACTED("{\"wifi\\u005fpassword\":\"****\",\"wifi_ssid\":\"home\"}",
+                         "{\"wifi\\u005fpassword\":\"p4ss\",\"wifi_ssid\":\"home\"}");
+    TEST_ASSERT_REDACTED("{\"group\\u005Fkey\":\"****\"}", "{\"group\\u005Fkey\":\"k\"}");
+    TEST_ASSERT_REDACTED("{\"cfg\":{\"to\\u006B\\u0065n\" : \"****\"}}", "{\"cfg\":{\"to\\u006B\\u0065n\" : [1]}}");
+
+    // escapes which don't decode to the key name
+    TEST_ASSERT_REDACTED("{\"\\u0054oken\":\"t\",\"to\\u006Ben2\":\"t\",\"to\\u006\":\"t\"}",
+                         "{\"\\u0054oken\":\"t\",\"to\\u006Ben2\":\"t\",\"to\\u006\":\"t\"}");
+    TEST_ASSERT_REDACTED("{\"to\\u00e9en\":\"t\",\"to\\x6ben\":\"t\",\"to\\u006gen\":\"t\"}",
+                         "{\"to\\u00e9en\":\"t\",\"to\\x6ben\":\"t\",\"to\\u006gen\":\"t\"}");
+    TEST_ASSERT_FALSE(jsonStringEquals("tok\\", "tok\\" + 4, "tok"));
+    TEST_ASSERT_TRUE(jsonStringEquals("a\\nb", "a\\nb" + 4, "a\nb"));
+}
+
+void test_redactJson_invalidJson(void) {
+    // truncated messages never expose the value
+    TEST_ASSERT_REDACTED("{\"token\":\"****\"", "{\"token\":\"secr");
+    TEST_ASSERT_REDACTED("{\"token\":\"****\"", "{\"token\":{\"a\":1");
+    TEST_ASSERT_REDACTED("{\"token\":\"****\"", "{\"token\":");
+    TEST_ASSERT_REDACTED("{\"token", "{\"token");
+    TEST_ASSERT_REDACTED("garbage \" data", "garbage \" data");
+
+    // only the given length is processed
+    StringWriter out;
+    const char  *json = "{\"token\":\"abc\"}trailing";
+    redactJson(json, 15, keys, KEY_COUNT, &out);
+    TEST_ASSERT_EQUAL_STRING("{\"token\":\"****\"}", out.text.c_str());
+}
+
+void test_jsonLogBuffer(void) {
+    char          buf[16];
+    JsonLogBuffer out(buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("", out.c_str());
+
+    out.write("{\"id\":", 6);
+    out.write("1}", 2);
+    TEST_ASSERT_EQUAL_STRING("{\"id\":1}", out.c_str());
+    TEST_ASSERT_EQUAL(8, out.length());
+    TEST_ASSERT_FALSE(out.truncated());
+
+    // exact fit
+    out.write("1234567", 7);
+    TEST_ASSERT_EQUAL_STRING("{\"id\":1}1234567", out.c_str());
+    TEST_ASSERT_FALSE(out.truncated());
+
+    JsonLogBuffer out2(buf, sizeof(buf));
+    out2.write("{\"id\":1}", 8);
+    out2.write("12345678", 8);
+    TEST_ASSERT_TRUE(out2.truncated());
+    TEST_ASSERT_EQUAL_STRING("{\"id\":1}1234...", out2.c_str());
+    TEST_ASSERT_EQUAL(15, out2.length());
+    // further output is ignored
+    out2.write("x", 1);
+    TEST_ASSERT_EQUAL_STRING("{\"id\":1}1234...", out2.c_str());
+
+    // already past the marker position
+    JsonLogBuffer out3(buf, sizeof(buf));
+    out3.write("1234567890123", 13);
+    out3.write("456", 3);
+    TEST_ASSERT_EQUAL_STRING("123456789012...", out3.c_str());
+
+    // too small for the marker
+    char          small[3];
+    JsonLogBuffer out4(small, sizeof(small));
+    out4.write("abc", 3);
+    TEST_ASSERT_EQUAL_STRING("..", out4.c_str());
+    TEST_ASSERT_TRUE(out4.truncated());
+
+    char          large[512];
+    JsonLogBuffer out5(large, sizeof(large));
+    const char   *json = "{\"type\":\"auth\",\"token\":\"secret\"}";
+    redactJson(json, strlen(json), keys, KEY_COUNT, &out5);
+    TEST_ASSERT_EQUAL_STRING("{\"type\":\"auth\",\"token\":\"****\"}", out5.c_str());
+}
+
+// Previous masking: copy the request into a document, replace the values and serialize it again. Approximated with
+// a copy of the request, a string per field and a new output string.
+static size_t redactWithCopy(const char *json) {
+    std::string copy = json;
+    std::string result;
+    size_t      pos = 0;
+    while (pos < copy.size()) {
+        size_t keyStart = copy.find('"', pos);
+        if (keyStart == std::string::npos) {
+            break;
+        }
+        size_t      keyEnd = copy.find('"', keyStart + 1);
+        std::string key = copy.substr(keyStart + 1, keyEnd - keyStart - 1);
+        size_t      valueStart = copy.find_first_of("\"0123456789", copy.find(':', keyEnd));
+        size_t      valueEnd = copy[valueStart] == '"' ? copy.find('"', valueStart + 1) + 1
+                                                      : copy.find_first_of(",}", valueStart);
+        std::string value = copy.substr(valueStart, valueEnd - valueStart);
+        for (size_t i = 0; i < KEY_COUNT; i++) {
+            if (key == keys[i]) {
+                value = "\"****\"";
+            }
+        }
+        result += result.empty() ? "{" : ",";
+        result += "\"" + key + "\":" + value;
+        pos = valueEnd;
+    }
+    result += "}";
+    return result.size();
+}
+
+void test_benchmarkRedaction(void) {
+    const char *json =
+        "{\"type\":\"dock\",\"id\":42,\"command\":\"set_config\",\"wifi_ssid\":\"home\",\"wifi_password\":\"p4ss\","
+        "\"token\":\"1234\",\"friendly_name\":\"Living room\"}";
+    char          buf[512];
+    const int     rounds = 200000;
+    volatile long sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        JsonLogBuffer out(buf, sizeof(buf));
+        redactJson(json, strlen(json), keys, KEY_COUNT, &out);
+        sink = sink + out.length();
+    }
+    auto streaming = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        sink = sink + redactWithCopy(json);
+    }
+    auto copying = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+    char msg[120];
+    snprintf(msg, sizeof(msg), "set_config request: streaming %.1fns, copying %.1fns",
+             static_cast<double>(streaming.count()) / rounds, static_cast<double>(copying.count()) / rounds);
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_redactJson_noSensitiveKeys);
+    RUN_TEST(test_redactJson_stringValues);
+    RUN_TEST(test_redactJson_otherValues);
+    RUN_TEST(test_redactJson_keyMatching);
+    RUN_TEST(test_redactJson_escapedKeys);
+    RUN_TEST(test_redactJson_invalidJson);
+    RUN_TEST(test_jsonLogBuffer);
+    RUN_TEST(test_benchmarkRedaction);
+
+    UNITY_END();
+}
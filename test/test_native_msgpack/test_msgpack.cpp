@@ -0,0 +1,576 @@
+#include <stdio.h>
+#include <unity.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "ir_message.hpp"
+#include "msgpack.hpp"
+
+// Host-side MessagePack encoder, as used by a client
+struct Encoder {
+    std::vector<uint8_t> data;
+
+    void byte(uint8_t b) { data.push_back(b); }
+    void number(uint64_t value, uint8_t size) {
+        for (int i = size - 1; i >= 0; i--) {
+            data.push_back(value >> (i * 8));
+        }
+    }
+    Encoder &map(uint32_t count) {
+        if (count < 16) {
+            byte(0x80 | count);
+        } else {
+            byte(0xDE);
+            number(count, 2);
+        }
+        return *this;
+    }
+    Encoder &array(uint32_t count) {
+        if (count < 16) {
+            byte(0x90 | count);
+        } else if (count <= 0xFFFF) {
+            byte(0xDC);
+            number(count, 2);
+        } else {
+            byte(0xDD);
+            number(count, 4);
+        }
+        return *this;
+    }
+    Encoder &str(const char *s) {
+        size_t len = strlen(s);
+        if (len < 32) {
+            byte(0xA0 | len);
+        } else if (len <= 0xFF) {
+            byte(0xD9);
+            number(len, 1);
+        } else {
+            byte(0xDA);
+            number(len, 2);
+        }
+        data.insert(data.end(), s, s + len);
+        return *this;
+    }
+    Encoder &uint(uint64_t value) {
+        if (value < 128) {
+            byte(value);
+        } else if (value <= 0xFF) {
+            byte(0xCC);
+            number(value, 1);
+        } else if (value <= 0xFFFF) {
+            byte(0xCD);
+            number(value, 2);
+        } else if (value <= 0xFFFFFFFF) {
+            byte(0xCE);
+            number(value, 4);
+        } else {
+            byte(0xCF);
+            number(value, 8);
+        }
+        return *this;
+    }
+    Encoder &sint(int64_t value) {
+        if (value >= -32 && value < 0) {
+            byte(static_cast<uint8_t>(value));
+        } else {
+            byte(0xD3);
+            number(static_cast<uint64_t>(value), 8);
+        }
+        return *this;
+    }
+    Encoder &boolean(bool value) {
+        byte(value ? 0xC3 : 0xC2);
+        return *this;
+    }
+    Encoder &nil() {
+        byte(0xC0);
+        return *this;
+    }
+    Encoder &real(double value) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        byte(0xCB);
+        number(bits, 8);
+        return *this;
+    }
+};
+
+// Parse a copy of the request, the decoder modifies the buffer
+struct Parsed {
+    std::vector<uint8_t> buf;
+    ApiRequest           req;
+    ApiParseError        error;
+
+    explicit Parsed(const std::vector<uint8_t> &data) : buf(data) {
+        error = parseApiRequestMsgPack(buf.data(), buf.size(), &req);
+    }
+};
+
+// Reader over a fixed list of values for the IR code functions
+struct ValueReader {
+    std::vector<uint64_t> values;
+    size_t                pos = 0;
+
+    uint32_t size() const { return values.size(); }
+    bool     next(uint64_t *value) {
+        if (pos >= values.size()) {
+            return false;
+        }
+        *value = values[pos++];
+        return true;
+    }
+};
+
+// GlobalCache code with 68 timing values, same as the test_native_gc_ir_code samples
+static const char *gcCode =
+    "38000,1,1,342,171,21,21,21,21,21,64,21,21,21,21,21,21,21,21,21,21,21,64,21,64,21,21,21,64,21,64,21,64,21,64,21,"
+    "64,21,21,21,21,21,21,21,64,21,21,21,21,21,21,21,21,21,64,21,64,21,64,21,21,21,64,21,64,21,64,21,64,21,1527";
+
+static std::vector<uint64_t> gcValues() {
+    std::vector<uint64_t> values;
+    const char           *c = gcCode;
+    while (*c) {
+        values.push_back(strtoul(c, const_cast<char **>(&c), 10));
+        if (*c == ',') {
+            c++;
+        }
+    }
+    return values;
+}
+
+static std::vector<uint8_t> irSendRequest(const std::vector<uint64_t> &values, const char *format) {
+    Encoder enc;
+    enc.map(7).str("type").str("dock").str("id").uint(123).str("command").str("ir_send");
+    enc.str("format").str(format).str("repeat").uint(0).str("int_side").boolean(true);
+    enc.str("code").array(values.size());
+    for (uint64_t v : values) {
+        enc.uint(v);
+    }
+    return enc.data;
+}
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+void test_parse_types(void) {
+    Encoder enc;
+    enc.map(12);
+    enc.str("type").str("dock");
+    enc.str("id").uint(300);
+    enc.str("repeat").uint(0xFFFFFFFFULL);
+    enc.str("send_at").uint(1700000000000000ULL);
+    enc.str("delay").sint(-5);
+    enc.str("status_led").sint(-1000);
+    enc.str("int_side").boolean(true);
+    enc.str("ext1").boolean(false);
+    enc.str("msg").nil();
+    enc.str("eth_led").real(2.5);
+    enc.str("ratelimit_rate").uint(UINT64_MAX);
+    enc.str("friendly_name").str("A long friendly name with more than 31 characters");
+
+    Parsed p(enc.data);
+    TEST_ASSERT_TRUE(p.error == ApiParseError::Ok);
+    TEST_ASSERT_EQUAL_STRING("dock", p.req.getString(ApiField::Type));
+    TEST_ASSERT_EQUAL(4, p.req.getStringLength(ApiField::Type));
+    TEST_ASSERT_EQUAL(300, p.req.getInt<int>(ApiField::Id));
+    TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFF, p.req.getInt<uint32_t>(ApiField::Repeat));
+    TEST_ASSERT_TRUE(p.req.getInt<int64_t>(ApiField::SendAt) == 1700000000000000LL);
+    TEST_ASSERT_EQUAL(-5, p.req.getInt<int>(ApiField::Delay));
+    TEST_ASSERT_EQUAL(-1000, p.req.getInt<int>(ApiField::StatusLed));
+    TEST_ASSERT_TRUE(p.req.getBool(ApiField::IntSide));
+    TEST_ASSERT_FALSE(p.req.getBool(ApiField::Ext1, true));
+    TEST_ASSERT_TRUE(p.req.type(ApiField::Msg) == ApiValueType::Null);
+    TEST_ASSERT_EQUAL(2, p.req.getInt<int>(ApiField::EthLed));
+    // larger than int64: float, out of range for integers
+    TEST_ASSERT_TRUE(p.req.type(ApiField::RatelimitRate) == ApiValueType::Float);
+    TEST_ASSERT_EQUAL(7, p.req.getInt<int>(ApiField::RatelimitRate, 7));
+    TEST_ASSERT_EQUAL_STRING("A long friendly name with more than 31 characters",
+                             p.req.getString(ApiField::FriendlyName));
+
+    // fixed width integers and float32
+    const uint8_t ints[] = {0x85, 0xA2, 'i', 'd', 0xD0, 0xFE, 0xA6, 'r', 'e', 'p', 'e', 'a', 't', 0xCD, 0x12, 0x34,
+                            0xA5, 'd', 'e', 'l', 'a', 'y', 0xD1, 0x80, 0x00, 0xA7, 's', 'e', 'n', 'd', '_', 'a', 't',
+                            0xD2, 0xFF, 0xFF, 0xFF, 0xFF, 0xA7, 'e', 't', 'h', '_', 'l', 'e', 'd', 0xCA, 0x40, 0x40,
+                            0x00, 0x00};
+    Parsed        p2(std::vector<uint8_t>(ints, ints + sizeof(ints)));
+    TEST_ASSERT_TRUE(p2.error == ApiParseError::Ok);
+    TEST_ASSERT_EQUAL(-2, p2.req.getInt<int>(ApiField::Id));
+    TEST_ASSERT_EQUAL(0x1234, p2.req.getInt<int>(ApiField::Repeat));
+    TEST_ASSERT_EQUAL(-32768, p2.req.getInt<int>(ApiField::Delay));
+    TEST_ASSERT_EQUAL(-1, p2.req.getInt<int>(ApiField::SendAt));
+    TEST_ASSERT_TRUE(p2.req.type(ApiField::EthLed) == ApiValueType::Float);
+    TEST_ASSERT_EQUAL(3, p2.req.getInt<int>(ApiField::EthLed));
+}
+
+void test_parse_strings(void) {
+    // string values are zero-terminated in place, bin is accepted as string
+    Encoder enc;
+    enc.map(5).str("command").str("ir_send").str("token").str("");
+    enc.str("ssid").byte(0xC4);
+    enc.byte(4);
+    enc.data.insert(enc.data.end(), {'h', 'o', 'm', 'e'});
+    enc.str("format").byte(0xDA);
+    enc.number(3, 2);
+    enc.data.insert(enc.data.end(), {'h', 'e', 'x'});
+    enc.str("unknown").str("value");
+
+    Parsed p(enc.data);
+    TEST_ASSERT_TRUE(p.error == ApiParseError::Ok);
+    TEST_ASSERT_EQUAL_STRING("ir_send", p.req.getString(ApiField::Command));
+    TEST_ASSERT_EQUAL_STRING("", p.req.getString(ApiField::Token));
+    TEST_ASSERT_EQUAL_STRING("home", p.req.getString(ApiField::Ssid));
+    TEST_ASSERT_EQUAL_STRING("hex", p.req.getString(ApiField::Format));
+    TEST_ASSERT_EQUAL(3, p.req.getStringLength(ApiField::Format));
+    // views into the buffer
+    const char *command = p.req.getString(ApiField::Command);
+    TEST_ASSERT_TRUE(command >= reinterpret_cast<char *>(p.buf.data()) &&
+                     command < reinterpret_cast<char *>(p.buf.data() + p.buf.size()));
+
+    // keys must match exactly, nested maps are ignored
+    Encoder enc2;
+    enc2.map(3).str("typ").str("x").str("types").str("y");
+    enc2.str("cfg").map(1).str("type").str("nested");
+    Parsed p2(enc2.data);
+    TEST_ASSERT_TRUE(p2.error == ApiParseError::Ok);
+    TEST_ASSERT_FALSE(p2.req.has(ApiField::Type));
+
+    // last value wins
+    Encoder enc3;
+    enc3.map(2).str("id").uint(1).str("id").uint(2);
+    Parsed p3(enc3.data);
+    TEST_ASSERT_EQUAL(2, p3.req.getInt<int>(ApiField::Id));
+}
+
+void test_parse_arrays(void) {
+    Encoder enc;
+    enc.map(3).str("code").array(4).uint(3).uint(0x20DF10EF).uint(32).uint(0);
+    enc.str("msg").array(2).str("a").map(1).str("b").nil();
+    enc.str("format").str("hex");
+    Parsed p(enc.data);
+    TEST_ASSERT_TRUE(p.error == ApiParseError::Ok);
+    TEST_ASSERT_TRUE(p.req.type(ApiField::Code) == ApiValueType::Array);
+    TEST_ASSERT_NULL(p.req.getString(ApiField::Code));
+    TEST_ASSERT_EQUAL(0, p.req.getStringLength(ApiField::Code));
+
+    MsgPackUintReader reader;
+    TEST_ASSERT_TRUE(getMsgPackArray(p.req, ApiField::Code, &reader));
+    TEST_ASSERT_EQUAL(4, reader.size());
+    uint64_t v;
+    TEST_ASSERT_TRUE(reader.next(&v));
+    TEST_ASSERT_EQUAL(3, v);
+    TEST_ASSERT_TRUE(reader.next(&v));
+    TEST_ASSERT_EQUAL_UINT32(0x20DF10EF, v);
+    TEST_ASSERT_TRUE(reader.next(&v));
+    TEST_ASSERT_EQUAL(32, v);
+    TEST_ASSERT_TRUE(reader.next(&v));
+    TEST_ASSERT_EQUAL(0, v);
+    TEST_ASSERT_FALSE(reader.next(&v));
+
+    // not an array of unsigned integers
+    TEST_ASSERT_TRUE(getMsgPackArray(p.req, ApiField::Msg, &reader));
+    TEST_ASSERT_EQUAL(2, reader.size());
+    TEST_ASSERT_FALSE(reader.next(&v));
+    TEST_ASSERT_FALSE(getMsgPackArray(p.req, ApiField::Format, &reader));
+    TEST_ASSERT_FALSE(getMsgPackArray(p.req, ApiField::Id, &reader));
+
+    Encoder neg;
+    neg.map(1).str("code").array(3).sint(-1).byte(0xD0);
+    neg.byte(5);
+    neg.uint(UINT64_MAX);
+    Parsed p2(neg.data);
+    TEST_ASSERT_TRUE(p2.error == ApiParseError::Ok);
+    TEST_ASSERT_TRUE(getMsgPackArray(p2.req, ApiField::Code, &reader));
+    TEST_ASSERT_FALSE(reader.next(&v));
+
+    // positive signed integers are accepted
+    Encoder pos;
+    pos.map(1).str("code").array(2).byte(0xD0);
+    pos.byte(5);
+    pos.uint(UINT64_MAX);
+    Parsed p3(pos.data);
+    TEST_ASSERT_TRUE(getMsgPackArray(p3.req, ApiField::Code, &reader));
+    TEST_ASSERT_TRUE(reader.next(&v));
+    TEST_ASSERT_EQUAL(5, v);
+    TEST_ASSERT_TRUE(reader.next(&v));
+    TEST_ASSERT_TRUE(v == UINT64_MAX);
+
+    // JSON arrays have no elements to read
+    std::vector<char> json = {'{', '"', 'c', 'o', 'd', 'e', '"', ':', '[', '1', ']', '}', 0};
+    ApiRequest        req;
+    TEST_ASSERT_TRUE(parseApiRequest(json.data(), &req) == ApiParseError::Ok);
+    TEST_ASSERT_FALSE(getMsgPackArray(req, ApiField::Code, &reader));
+}
+
+void test_parse_errors(void) {
+    ApiRequest req;
+    TEST_ASSERT_TRUE(parseApiRequestMsgPack(nullptr, 0, &req) == ApiParseError::EmptyInput);
+
+    // root other than map: valid without fields
+    Encoder arr;
+    arr.array(2).str("type").str("dock");
+    Parsed p(arr.data);
+    TEST_ASSERT_TRUE(p.error == ApiParseError::Ok);
+    TEST_ASSERT_FALSE(p.req.has(ApiField::Type));
+
+    // every truncation of a valid request is incomplete
+    Encoder enc;
+    enc.map(4).str("type").str("dock").str("id").uint(70000).str("code").array(2).uint(1).uint(300);
+    enc.str("friendly_name").str("Living room");
+    for (size_t len = 1; len < enc.data.size(); len++) {
+        std::vector<uint8_t> buf(enc.data.begin(), enc.data.begin() + len);
+        TEST_ASSERT_TRUE_MESSAGE(parseApiRequestMsgPack(buf.data(), len, &req) == ApiParseError::IncompleteInput,
+                                 std::to_string(len).c_str());
+    }
+    Parsed full(enc.data);
+    TEST_ASSERT_TRUE(full.error == ApiParseError::Ok);
+
+    // announced counts larger than the data
+    const uint8_t bigMap[] = {0xDF, 0xFF, 0xFF, 0xFF, 0xFF, 0xA1, 'a', 0x01};
+    Parsed        p2(std::vector<uint8_t>(bigMap, bigMap + sizeof(bigMap)));
+    TEST_ASSERT_TRUE(p2.error == ApiParseError::IncompleteInput);
+    const uint8_t bigStr[] = {0x81, 0xA4, 't', 'y', 'p', 'e', 0xDB, 0xFF, 0xFF, 0xFF, 0xFF, 'x'};
+    Parsed        p3(std::vector<uint8_t>(bigStr, bigStr + sizeof(bigStr)));
+    TEST_ASSERT_TRUE(p3.error == ApiParseError::IncompleteInput);
+
+    // never used marker and extension types
+    const uint8_t unused[] = {0x81, 0xA2, 'i', 'd', 0xC1};
+    Parsed        p4(std::vector<uint8_t>(unused, unused + sizeof(unused)));
+    TEST_ASSERT_TRUE(p4.error == ApiParseError::InvalidInput);
+    const uint8_t ext[] = {0x81, 0xA2, 'i', 'd', 0xD4, 0x01, 0x02};
+    Parsed        p5(std::vector<uint8_t>(ext, ext + sizeof(ext)));
+    TEST_ASSERT_TRUE(p5.error == ApiParseError::InvalidInput);
+
+    // non-string keys
+    const uint8_t intKey[] = {0x81, 0x01, 0x02};
+    Parsed        p6(std::vector<uint8_t>(intKey, intKey + sizeof(intKey)));
+    TEST_ASSERT_TRUE(p6.error == ApiParseError::InvalidInput);
+
+    // nesting limit including the root map
+    Encoder deep;
+    deep.map(1).str("a");
+    for (int i = 1; i < API_REQUEST_NESTING_LIMIT - 1; i++) {
+        deep.array(1);
+    }
+    deep.array(0);
+    Parsed p7(deep.data);
+    TEST_ASSERT_TRUE(p7.error == ApiParseError::Ok);
+    deep.data.pop_back();
+    deep.array(1).array(0);
+    Parsed p8(deep.data);
+    TEST_ASSERT_TRUE(p8.error == ApiParseError::TooDeep);
+
+    // trailing data is ignored
+    Encoder trailing;
+    trailing.map(1).str("id").uint(1).str("garbage");
+    Parsed p9(trailing.data);
+    TEST_ASSERT_TRUE(p9.error == ApiParseError::Ok);
+    TEST_ASSERT_EQUAL(1, p9.req.getInt<int>(ApiField::Id));
+}
+
+void test_frameHeader(void) {
+    uint8_t header[MSGPACK_FRAME_HEADER_SIZE];
+    TEST_ASSERT_TRUE(encodeMsgPackFrameHeader(0x1234, header));
+    TEST_ASSERT_EQUAL_HEX8(MSGPACK_FRAME_MARKER, header[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x12, header[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x34, header[2]);
+    uint16_t length = 0;
+    TEST_ASSERT_TRUE(decodeMsgPackFrameHeader(header, sizeof(header), &length));
+    TEST_ASSERT_EQUAL(0x1234, length);
+
+    TEST_ASSERT_TRUE(encodeMsgPackFrameHeader(MSGPACK_FRAME_MAX_LENGTH, header));
+    TEST_ASSERT_FALSE(encodeMsgPackFrameHeader(MSGPACK_FRAME_MAX_LENGTH + 1, header));
+    TEST_ASSERT_FALSE(decodeMsgPackFrameHeader(header, 2, &length));
+    const uint8_t json[] = {'{', '"', 'a'};
+    TEST_ASSERT_FALSE(decodeMsgPackFrameHeader(json, sizeof(json), &length));
+}
+
+void test_encoding(void) {
+    ApiEncoding encoding = ApiEncoding::Json;
+    TEST_ASSERT_TRUE(parseApiEncoding("msgpack", &encoding));
+    TEST_ASSERT_TRUE(encoding == ApiEncoding::MsgPack);
+    TEST_ASSERT_TRUE(parseApiEncoding("json", &encoding));
+    TEST_ASSERT_TRUE(encoding == ApiEncoding::Json);
+    TEST_ASSERT_FALSE(parseApiEncoding("cbor", &encoding));
+    TEST_ASSERT_FALSE(parseApiEncoding(nullptr, &encoding));
+    TEST_ASSERT_EQUAL_STRING("msgpack", apiEncodingName(ApiEncoding::MsgPack));
+    TEST_ASSERT_EQUAL_STRING("json", apiEncodingName(ApiEncoding::Json));
+
+    // encoding field of the auth request
+    Encoder enc;
+    enc.map(3).str("type").str("auth").str("token").str("0815").str("encoding").str("msgpack");
+    Parsed p(enc.data);
+    TEST_ASSERT_TRUE(parseApiEncoding(p.req.getString(ApiField::Encoding), &encoding));
+    TEST_ASSERT_TRUE(encoding == ApiEncoding::MsgPack);
+}
+
+void test_setGcIrValues(void) {
+    ValueReader values;
+    values.values = gcValues();
+    GCIrCode code;
+    TEST_ASSERT_EQUAL(0, setGcIrValues(values, &code));
+    GCIrCode expected;
+    TEST_ASSERT_EQUAL(0, parseGcIrCode(gcCode, &expected));
+    TEST_ASSERT_TRUE(code == expected);
+
+    // same validation as the text format
+    struct {
+        std::vector<uint64_t> values;
+        uint8_t               error;
+    } invalid[] = {
+        {{38000, 1, 1}, 8},
+        {{14999, 1, 1, 10, 10}, 5},
+        {{65536, 1, 1, 10, 10}, 5},
+        {{38000, 0, 1, 10, 10}, 6},
+        {{38000, 51, 1, 10, 10}, 6},
+        {{38000, 1, 65536, 10, 10}, 7},
+        {{38000, 1, 2, 10, 10}, 7},
+        {{38000, 1, 3, 10, 10}, 7},
+        {{38000, 1, 1, 0, 10}, 9},
+        {{38000, 1, 1, 10, 65536}, 9},
+        {{38000, 1, 1, 10, 10, 10}, 10},
+    };
+    for (auto &test : invalid) {
+        ValueReader reader;
+        reader.values = test.values;
+        TEST_ASSERT_EQUAL(test.error, setGcIrValues(reader, &code));
+    }
+
+    // invalid value type
+    Encoder enc;
+    enc.map(1).str("code").array(5).uint(38000).uint(1).uint(1).str("x").uint(10);
+    Parsed            p(enc.data);
+    MsgPackUintReader reader;
+    TEST_ASSERT_TRUE(getMsgPackArray(p.req, ApiField::Code, &reader));
+    TEST_ASSERT_EQUAL(9, setGcIrValues(reader, &code));
+
+    TEST_ASSERT_EQUAL(1, setGcIrValues(reader, nullptr));
+}
+
+void test_setIrSendValues(void) {
+    IRSendMessage msg;
+    TEST_ASSERT_TRUE(setIrSendCode(&msg, IRFormat::UNFOLDED_CIRCLE, "4;0x640C;15;0", 13));
+
+    ValueReader hex;
+    hex.values = {3, 0x20DF10EF, 32, 1};
+    TEST_ASSERT_TRUE(setIrSendValues(&msg, IRFormat::UNFOLDED_CIRCLE, hex));
+    TEST_ASSERT_TRUE(msg.format == IRFormat::UNFOLDED_CIRCLE);
+    TEST_ASSERT_EQUAL(3, msg.hexCode.protocol);
+    TEST_ASSERT_TRUE(msg.hexCode.command == 0x20DF10EF);
+    TEST_ASSERT_EQUAL(32, msg.hexCode.bits);
+    TEST_ASSERT_EQUAL(1, msg.hexCode.repeat);
+    TEST_ASSERT_EQUAL(0, msg.message.length());
+
+    // the text code resets the binary code
+    TEST_ASSERT_TRUE(setIrSendCode(&msg, IRFormat::UNFOLDED_CIRCLE, "4;0x640C;15;0", 13));
+    TEST_ASSERT_EQUAL(0, msg.hexCode.protocol);
+
+    // same limits as the text format
+    std::vector<uint64_t> invalid[] = {
+        {0, 0x1234, 16, 0}, {70000, 0x1234, 16, 0}, {3, 0x1234, 0, 0}, {3, 0x1234, 16, 21}, {3, 0x1234, 16},
+        {3, 0x1234, 16, 0, 0},
+    };
+    for (auto &values : invalid) {
+        ValueReader reader;
+        reader.values = values;
+        TEST_ASSERT_FALSE(setIrSendValues(&msg, IRFormat::UNFOLDED_CIRCLE, reader));
+    }
+    ValueReader pronto;
+    pronto.values = {0, 0x6D, 0, 1};
+    TEST_ASSERT_FALSE(setIrSendValues(&msg, IRFormat::PRONTO, pronto));
+
+    ValueReader gc;
+    gc.values = gcValues();
+    TEST_ASSERT_TRUE(setIrSendValues(&msg, IRFormat::GLOBAL_CACHE, gc));
+    TEST_ASSERT_TRUE(msg.format == IRFormat::GLOBAL_CACHE);
+    TEST_ASSERT_EQUAL(0, msg.hexCode.protocol);
+    TEST_ASSERT_EQUAL(gc.values.size(), msg.gcCode.count);
+    TEST_ASSERT_EQUAL(38000, msg.gcCode.frequency());
+
+    // from a decoded request
+    Parsed            p(irSendRequest({3, 0x20DF10EF, 32, 0}, "hex"));
+    MsgPackUintReader reader;
+    TEST_ASSERT_TRUE(p.error == ApiParseError::Ok);
+    TEST_ASSERT_TRUE(getMsgPackArray(p.req, ApiField::Code, &reader));
+    TEST_ASSERT_TRUE(setIrSendValues(&msg, parseIrFormat(p.req.getString(ApiField::Format)), reader));
+    TEST_ASSERT_TRUE(msg.hexCode.command == 0x20DF10EF);
+    TEST_ASSERT_EQUAL(0, msg.gcCode.count);
+}
+
+// ir_send with a GlobalCache timing array: JSON request with the code text vs MessagePack request with the values
+void test_benchmarkIrSend(void) {
+    std::string json =
+        "{\"type\":\"dock\",\"id\":123,\"command\":\"ir_send\",\"format\":\"gc\",\"repeat\":0,\"int_side\":true,"
+        "\"code\":\"";
+    json += gcCode;
+    json += "\"}";
+    std::vector<uint8_t> msgpack = irSendRequest(gcValues(), "gc");
+
+    std::vector<uint8_t> hexMsgpack = irSendRequest({3, 0x20DF10EF, 32, 0}, "hex");
+    const char          *hexJson =
+        "{\"type\":\"dock\",\"id\":123,\"command\":\"ir_send\",\"format\":\"hex\",\"repeat\":0,\"int_side\":true,"
+        "\"code\":\"3;0x20DF10EF;32;0\"}";
+
+    const int            rounds = 20000;
+    std::vector<char>    jsonBuf(json.size() + 1);
+    std::vector<uint8_t> msgpackBuf(msgpack.size());
+    ApiRequest           req;
+    IRSendMessage        msg;
+    volatile long        sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        memcpy(jsonBuf.data(), json.c_str(), json.size() + 1);
+        parseApiRequest(jsonBuf.data(), &req);
+        setIrSendCode(&msg, IRFormat::GLOBAL_CACHE, req.getString(ApiField::Code),
+                      req.getStringLength(ApiField::Code));
+        sink = sink + msg.gcCode.count;
+    }
+    auto jsonTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    TEST_ASSERT_EQUAL(71, msg.gcCode.count);
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        memcpy(msgpackBuf.data(), msgpack.data(), msgpack.size());
+        parseApiRequestMsgPack(msgpackBuf.data(), msgpackBuf.size(), &req);
+        MsgPackUintReader reader;
+        getMsgPackArray(req, ApiField::Code, &reader);
+        setIrSendValues(&msg, IRFormat::GLOBAL_CACHE, reader);
+        sink = sink + msg.gcCode.count;
+    }
+    auto msgpackTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    TEST_ASSERT_EQUAL(71, msg.gcCode.count);
+
+    char out[160];
+    snprintf(out, sizeof(out), "ir_send gc: JSON %u bytes %.1fns, MessagePack %u bytes %.1fns",
+             static_cast<unsigned>(json.size()), static_cast<double>(jsonTime.count()) / rounds,
+             static_cast<unsigned>(msgpack.size()), static_cast<double>(msgpackTime.count()) / rounds);
+    TEST_MESSAGE(out);
+    snprintf(out, sizeof(out), "ir_send hex: JSON %u bytes, MessagePack %u bytes",
+             static_cast<unsigned>(strlen(hexJson)), static_cast<unsigned>(hexMsgpack.size()));
+    TEST_MESSAGE(out);
+    TEST_ASSERT_TRUE(msgpack.size() < json.size());
+    TEST_ASSERT_TRUE(hexMsgpack.size() < strlen(hexJson));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_parse_types);
+    RUN_TEST(test_parse_strings);
+    RUN_TEST(test_parse_arrays);
+    RUN_TEST(test_parse_errors);
+    RUN_TEST(test_frameHeader);
+    RUN_TEST(test_encoding);
+    RUN_TEST(test_setGcIrValues);
+    RUN_TEST(test_setIrSendValues);
+    RUN_TEST(test_benchmarkIrSend);
+
+    UNITY_END();
+}
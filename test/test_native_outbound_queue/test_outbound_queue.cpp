@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <unity.h>
+
+#include <string>
+
+#include "outbound_queue.hpp"
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+template <size_t N>
+static OutboundResult push(OutboundQueue<N> *queue, OutboundKind kind, const std::string &msg, uint32_t nowMs = 0,
+                           bool binary = false) {
+    return queue->push(kind, binary, msg.data(), msg.size(), nowMs);
+}
+
+// Take the next message, returns an empty string if the queue is empty
+template <size_t N>
+static std::string take(OutboundQueue<N> *queue, bool *binary = nullptr, uint32_t nowMs = 0) {
+    char        scratch[N];
+    const char *data;
+    size_t      length;
+    bool        isBinary;
+    if (!queue->front(scratch, &data, &length, &isBinary)) {
+        return std::string();
+    }
+    std::string msg(data, length);
+    queue->pop(nowMs);
+    if (binary) {
+        *binary = isBinary;
+    }
+    return msg;
+}
+
+void test_order(void) {
+    OutboundQueue<64> queue;
+    TEST_ASSERT_TRUE(queue.empty());
+    TEST_ASSERT_TRUE(push(&queue, OutboundKind::Response, "{\"a\":1}") == OutboundResult::Queued);
+    TEST_ASSERT_TRUE(push(&queue, OutboundKind::Event, "\x81\xa1", 0, true) == OutboundResult::Queued);
+    TEST_ASSERT_TRUE(push(&queue, OutboundKind::Response, "") == OutboundResult::Queued);
+    TEST_ASSERT_EQUAL(3, queue.messages());
+    TEST_ASSERT_EQUAL(3 * OutboundQueue<64>::HEADER_SIZE + 7 + 2, queue.bytes());
+
+    bool binary;
+    TEST_ASSERT_EQUAL_STRING("{\"a\":1}", take(&queue, &binary).c_str());
+    TEST_ASSERT_FALSE(binary);
+    TEST_ASSERT_TRUE(take(&queue, &binary) == "\x81\xa1");
+    TEST_ASSERT_TRUE(binary);
+    TEST_ASSERT_EQUAL(1, queue.messages());
+    TEST_ASSERT_TRUE(take(&queue).empty());
+    TEST_ASSERT_TRUE(queue.empty());
+    TEST_ASSERT_EQUAL(0, queue.bytes());
+    TEST_ASSERT_EQUAL(3, queue.stats().sent);
+
+    // empty queue
+    queue.pop(0);
+    TEST_ASSERT_EQUAL(3, queue.stats().sent);
+    char        scratch[64];
+    const char *data;
+    size_t      length;
+    TEST_ASSERT_FALSE(queue.front(scratch, &data, &length, &binary));
+}
+
+void test_wrapAround(void) {
+    // messages wrap around the end of the buffer and are returned from the scratch buffer
+    OutboundQueue<32> queue;
+    for (int i = 0; i < 100; i++) {
+        std::string first = "msg" + std::to_string(i);
+        std::string second(i % 20, static_cast<char>('a' + i % 26));
+        TEST_ASSERT_TRUE(push(&queue, OutboundKind::Response, first) == OutboundResult::Queued);
+        TEST_ASSERT_TRUE(push(&queue, OutboundKind::Response, second) == OutboundResult::Queued);
+        TEST_ASSERT_TRUE(take(&queue) == first);
+        TEST_ASSERT_TRUE(take(&queue) == second);
+    }
+    TEST_ASSERT_EQUAL(200, queue.stats().sent);
+    TEST_ASSERT_EQUAL(0, queue.stats().droppedEvents);
+}
+
+void test_eventsDroppedResponsesKept(void) {
+    OutboundQueue<64> queue;
+    std::string       msg(10, 'x');  // 13 bytes queued
+    // events up to half of the queue
+    TEST_ASSERT_TRUE(push(&queue, OutboundKind::Event, msg) == OutboundResult::Queued);
+    TEST_ASSERT_TRUE(push(&queue, OutboundKind::Event, msg) == OutboundResult::Queued);
+    TEST_ASSERT_TRUE(push(&queue, OutboundKind::Event, msg) == OutboundResult::Dropped);
+    TEST_ASSERT_EQUAL(1, queue.stats().droppedEvents);
+    TEST_ASSERT_EQUAL(1, queue.droppedSinceSent());
+
+    // responses use the reserved space
+    TEST_ASSERT_TRUE(push(&queue, OutboundKind::Response, msg) == OutboundResult::Queued);
+    TEST_ASSERT_TRUE(push(&queue, OutboundKind::Response, msg) == OutboundResult::Queued);
+    TEST_ASSERT_TRUE(push(&queue, OutboundKind::Event, "") == OutboundResult::Dropped);
+    TEST_ASSERT_EQUAL(4 * 13, queue.stats().peakBytes);
+    TEST_ASSERT_EQUAL(2, queue.droppedSinceSent());
+
+    // a response which doesn't fit anymore
+    TEST_ASSERT_TRUE(push(&queue, OutboundKind::Response, msg) == OutboundResult::Overflow);
+    TEST_ASSERT_EQUAL(4, queue.messages());
+
+    take(&queue);
+    TEST_ASSERT_EQUAL(0, queue.droppedSinceSent());
+    TEST_ASSERT_EQUAL(2, queue.stats().droppedEvents);
+}
+
+void test_largeEventEmptyQueue(void) {
+    // an event larger than the event limit is only queued if the client keeps up
+    OutboundQueue<64> queue;
+    std::string       large(40, 'e');
+    TEST_ASSERT_TRUE(push(&queue, OutboundKind::Event, large) == OutboundResult::Queued);
+    TEST_ASSERT_TRUE(push(&queue, OutboundKind::Event, large) == OutboundResult::Dropped);
+    TEST_ASSERT_TRUE(take(&queue) == large);
+    TEST_ASSERT_TRUE(push(&queue, OutboundKind::Event, large) == OutboundResult::Queued);
+
+    // never fits
+    const size_t maxSize = OutboundQueue<64>::MAX_MESSAGE_SIZE;
+    TEST_ASSERT_EQUAL(61, maxSize);
+    queue.reset();
+    TEST_ASSERT_TRUE(push(&queue, OutboundKind::Event, std::string(maxSize + 1, 'e')) == OutboundResult::Dropped);
+    TEST_ASSERT_TRUE(push(&queue, OutboundKind::Response, std::string(maxSize + 1, 'r')) == OutboundResult::Overflow);
+    TEST_ASSERT_TRUE(push(&queue, OutboundKind::Response, std::string(maxSize, 'r')) == OutboundResult::Queued);
+    TEST_ASSERT_TRUE(take(&queue) == std::string(maxSize, 'r'));
+}
+
+void test_stalled(void) {
+    OutboundQueue<64> queue;
+    TEST_ASSERT_EQUAL(0, queue.stalledMs(1000));
+    push(&queue, OutboundKind::Response, "a", 1000);
+    push(&queue, OutboundKind::Response, "b", 1500);
+    TEST_ASSERT_EQUAL(0, queue.stalledMs(1000));
+    TEST_ASSERT_EQUAL(2000, queue.stalledMs(3000));
+    take(&queue, nullptr, 3000);
+    TEST_ASSERT_EQUAL(500, queue.stalledMs(3500));
+    take(&queue, nullptr, 3600);
+    TEST_ASSERT_EQUAL(0, queue.stalledMs(9000));
+
+    // the time starts with the first message of an empty queue
+    push(&queue, OutboundKind::Event, "c", 10000);
+    TEST_ASSERT_EQUAL(100, queue.stalledMs(10100));
+
+    // wraps around with the millisecond counter
+    queue.reset();
+    push(&queue, OutboundKind::Event, "d", 0xFFFFFF00);
+    TEST_ASSERT_EQUAL(0x200, queue.stalledMs(0x100));
+}
+
+void test_reset(void) {
+    OutboundQueue<32> queue;
+    push(&queue, OutboundKind::Event, std::string(20, 'x'));
+    push(&queue, OutboundKind::Event, "y");
+    take(&queue);
+    push(&queue, OutboundKind::Response, "z");
+    queue.reset();
+    TEST_ASSERT_TRUE(queue.empty());
+    TEST_ASSERT_EQUAL(0, queue.bytes());
+    TEST_ASSERT_EQUAL(0, queue.droppedSinceSent());
+    TEST_ASSERT_EQUAL(0, queue.stats().sent);
+    TEST_ASSERT_EQUAL(0, queue.stats().droppedEvents);
+    TEST_ASSERT_EQUAL(0, queue.stats().peakBytes);
+}
+
+void test_closeAfterDrain(void) {
+    OutboundQueue<64> queue;
+    TEST_ASSERT_FALSE(queue.drained());
+    push(&queue, OutboundKind::Event, "event", 100);
+    push(&queue, OutboundKind::Response, "bye", 100);
+    queue.closeAfterDrain();
+    TEST_ASSERT_TRUE(queue.closing());
+    TEST_ASSERT_FALSE(queue.drained());
+
+    // nothing is queued behind the last response
+    TEST_ASSERT_TRUE(push(&queue, OutboundKind::Event, "late") == OutboundResult::Closing);
+    TEST_ASSERT_TRUE(push(&queue, OutboundKind::Response, "late") == OutboundResult::Closing);
+    TEST_ASSERT_EQUAL(2, queue.messages());
+    TEST_ASSERT_EQUAL(0, queue.stats().droppedEvents);
+
+    // pending messages are still sent, and a stuck client is detected
+    TEST_ASSERT_EQUAL(400, queue.stalledMs(500));
+    TEST_ASSERT_TRUE(take(&queue) == "event");
+    TEST_ASSERT_FALSE(queue.drained());
+    TEST_ASSERT_TRUE(take(&queue) == "bye");
+    TEST_ASSERT_TRUE(queue.drained());
+
+    // a new connection
+    queue.reset();
+    TEST_ASSERT_FALSE(queue.closing());
+    TEST_ASSERT_FALSE(queue.drained());
+    TEST_ASSERT_TRUE(push(&queue, OutboundKind::Response, "hello") == OutboundResult::Queued);
+
+    // an empty queue is drained immediately
+    take(&queue);
+    queue.closeAfterDrain();
+    TEST_ASSERT_TRUE(queue.drained());
+}
+
+// Connection accepting a limited number of messages per loop iteration
+struct Client {
+    OutboundQueue<256> queue;
+    int                messagesPerLoop;
+    int                received = 0;
+    bool               disconnected = false;
+};
+
+// Broadcast events and responses to a fast and a slow client: the fast client receives every message without delay,
+// the slow client loses events and is disconnected after too many dropped events.
+void test_slowConsumer(void) {
+    Client      fast;
+    Client      slow;
+    std::string event(30, 'e');
+    std::string response(20, 'r');
+    fast.messagesPerLoop = 4;
+    slow.messagesPerLoop = 0;
+    Client  *clients[] = {&fast, &slow};
+    uint32_t now = 0;
+    int      sent = 0;
+
+    for (int loop = 0; loop < 100; loop++, now += 10) {
+        for (Client *client : clients) {
+            if (client->disconnected) {
+                continue;
+            }
+            bool isResponse = loop % 5 == 0;
+            OutboundResult result = push(&client->queue, isResponse ? OutboundKind::Response : OutboundKind::Event,
+                                         isResponse ? response : event, now);
+            TEST_ASSERT_TRUE(result != OutboundResult::Overflow);
+            for (int i = 0; i < client->messagesPerLoop && !take(&client->queue, nullptr, now).empty(); i++) {
+                client->received++;
+            }
+            // slow consumer policy
+            if (client->queue.droppedSinceSent() >= 16) {
+                client->disconnected = true;
+                client->queue.reset();
+            }
+        }
+        sent++;
+        if (fast.queue.stalledMs(now) > 0) {
+            TEST_FAIL_MESSAGE("fast client delayed");
+        }
+    }
+
+    TEST_ASSERT_EQUAL(sent, fast.received);
+    TEST_ASSERT_EQUAL(0, fast.queue.stats().droppedEvents);
+    TEST_ASSERT_TRUE(fast.queue.stats().peakBytes <= 23 + 33);
+    TEST_ASSERT_TRUE(slow.disconnected);
+    TEST_ASSERT_EQUAL(0, slow.received);
+
+    char msg[80];
+    snprintf(msg, sizeof(msg), "fast client: %d/%d messages, slow client disconnected", fast.received, sent);
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_order);
+    RUN_TEST(test_wrapAround);
+    RUN_TEST(test_eventsDroppedResponsesKept);
+    RUN_TEST(test_largeEventEmptyQueue);
+    RUN_TEST(test_stalled);
+    RUN_TEST(test_reset);
+    RUN_TEST(test_closeAfterDrain);
+    RUN_TEST(test_slowConsumer);
+
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,384 @@
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "rate_limiter.hpp"
+#include "tcp_event_loop.hpp"
+
+#define MS 1000LL
+#define SEC 1000000LL
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+void test_tokenBucket_burst(void) {
+    RateLimit   limit = {3, 1};
+    TokenBucket bucket;
+    int64_t     now = 5 * SEC;
+    // a new bucket is full
+    TEST_ASSERT_TRUE(bucket.tryTake(limit, now));
+    TEST_ASSERT_TRUE(bucket.tryTake(limit, now));
+    TEST_ASSERT_TRUE(bucket.tryTake(limit, now));
+    TEST_ASSERT_FALSE(bucket.tryTake(limit, now));
+    TEST_ASSERT_FALSE(bucket.tryTake(limit, now + 999 * MS));
+    TEST_ASSERT_TRUE(bucket.tryTake(limit, now + 1 * SEC));
+    TEST_ASSERT_FALSE(bucket.tryTake(limit, now + 1 * SEC));
+
+    bucket.reset();
+    TEST_ASSERT_TRUE(bucket.tryTake(limit, now + 1 * SEC));
+}
+
+void test_tokenBucket_refillRate(void) {
+    RateLimit   limit = {1, 10};
+    TokenBucket bucket;
+    int64_t     now = 0;
+    TEST_ASSERT_TRUE(bucket.tryTake(limit, now));
+    int allowed = 0;
+    // 10 requests per second over 2 seconds with a request every millisecond
+    for (int i = 1; i <= 2000; i++) {
+        if (bucket.tryTake(limit, now + i * MS)) {
+            allowed++;
+        }
+    }
+    TEST_ASSERT_EQUAL(20, allowed);
+}
+
+void test_tokenBucket_cappedAtBurst(void) {
+    RateLimit   limit = {5, 100};
+    TokenBucket bucket;
+    TEST_ASSERT_TRUE(bucket.tryTake(limit, 0));
+    // long idle time refills the bucket only up to the burst size
+    int64_t now = 365LL * 24 * 3600 * SEC;
+    for (int i = 0; i < 5; i++) {
+        TEST_ASSERT_TRUE(bucket.tryTake(limit, now));
+    }
+    TEST_ASSERT_FALSE(bucket.tryTake(limit, now));
+}
+
+void test_rateLimiter_connectionLimit(void) {
+    ClientRateLimiter limiter;
+    limiter.setConnectionLimit({2, 1});
+    limiter.setIpLimit({100, 100});
+    TokenBucket conn1, conn2;
+    TEST_ASSERT_TRUE(limiter.allow(&conn1, 1, 0));
+    TEST_ASSERT_TRUE(limiter.allow(&conn1, 1, 0));
+    TEST_ASSERT_FALSE(limiter.allow(&conn1, 1, 0));
+    // other connection from the same address has its own bucket
+    TEST_ASSERT_TRUE(limiter.allow(&conn2, 1, 0));
+
+    RateLimitStats stats = limiter.stats();
+    TEST_ASSERT_EQUAL(3, stats.allowed);
+    TEST_ASSERT_EQUAL(1, stats.throttledConnection);
+    TEST_ASSERT_EQUAL(0, stats.throttledIp);
+
+    limiter.resetStats();
+    TEST_ASSERT_EQUAL(0, limiter.stats().allowed);
+}
+
+void test_rateLimiter_ipLimit(void) {
+    ClientRateLimiter limiter;
+    limiter.setConnectionLimit({10, 1});
+    limiter.setIpLimit({3, 1});
+    TokenBucket conn1, conn2, conn3;
+    // all connections from the same address share the IP bucket
+    TEST_ASSERT_TRUE(limiter.allow(&conn1, 1, 0));
+    TEST_ASSERT_TRUE(limiter.allow(&conn1, 1, 0));
+    TEST_ASSERT_TRUE(limiter.allow(&conn2, 1, 0));
+    TEST_ASSERT_FALSE(limiter.allow(&conn2, 1, 0));
+    TEST_ASSERT_FALSE(limiter.allow(&conn1, 1, 0));
+    // other address
+    TEST_ASSERT_TRUE(limiter.allow(&conn3, 2, 0));
+
+    RateLimitStats stats = limiter.stats();
+    TEST_ASSERT_EQUAL(4, stats.allowed);
+    TEST_ASSERT_EQUAL(0, stats.throttledConnection);
+    TEST_ASSERT_EQUAL(2, stats.throttledIp);
+
+    // a rejected request doesn't take a token from the connection bucket: 8 left
+    limiter.setIpLimit({0, 0});
+    int allowed = 0;
+    while (limiter.allow(&conn1, 1, 0)) {
+        allowed++;
+    }
+    TEST_ASSERT_EQUAL(8, allowed);
+}
+
+void test_rateLimiter_disabled(void) {
+    ClientRateLimiter limiter;
+    limiter.setConnectionLimit({0, 0});
+    limiter.setIpLimit({10, 0});
+    TokenBucket conn;
+    for (int i = 0; i < 1000; i++) {
+        TEST_ASSERT_TRUE(limiter.allow(&conn, 1, 0));
+    }
+    TEST_ASSERT_EQUAL(1000, limiter.stats().allowed);
+}
+
+void test_rateLimiter_sourceTableFull(void) {
+    RateLimiter<2> limiter;
+    limiter.setConnectionLimit({0, 0});
+    limiter.setIpLimit({1, 1});
+    TokenBucket conn;
+    TEST_ASSERT_TRUE(limiter.allow(&conn, 1, 0));
+    TEST_ASSERT_TRUE(limiter.allow(&conn, 2, 1));
+    TEST_ASSERT_FALSE(limiter.allow(&conn, 2, 2));
+    // takes over the slot idle for the longest time
+    TEST_ASSERT_TRUE(limiter.allow(&conn, 3, 3));
+    TEST_ASSERT_FALSE(limiter.allow(&conn, 2, 4));
+    TEST_ASSERT_FALSE(limiter.allow(&conn, 3, 5));
+    TEST_ASSERT_TRUE(limiter.allow(&conn, 1, 6));
+}
+
+// Host load test ----------------------------------------------------------------------------------------------------
+
+#define TEST_TCP_PORT 19997
+#define IR_SEND_US 5000
+#define IR_QUEUE_SIZE 8
+
+static int64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/// GlobalCache server simulation: rate limited requests are queued for a single IR sender, which takes `IR_SEND_US`
+/// per code and posts a `completeir` response.
+struct IrServer {
+    TcpEventLoop<4>   loop;
+    ClientRateLimiter limiter;
+    std::atomic<bool> running;
+
+    std::mutex                                 mutex;
+    std::condition_variable                    cv;
+    std::deque<std::pair<uint32_t, uint32_t> > queue;
+
+    std::thread loopThread;
+    std::thread senderThread;
+
+    explicit IrServer(bool limit) : running(true) {
+        if (limit) {
+            limiter.setConnectionLimit({5, 20});
+            limiter.setIpLimit({10, 40});
+        } else {
+            limiter.setConnectionLimit({0, 0});
+            limiter.setIpLimit({0, 0});
+        }
+        loop.onReceive([this](TcpConnection &conn, size_t len) {
+            if (!limiter.allow(&conn.rateLimit, conn.ip, nowUs())) {
+                return loop.send(conn, "busyir\r", 7);
+            }
+            uint32_t id = atoi(conn.rx + 11);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (queue.size() < IR_QUEUE_SIZE) {
+                    queue.push_back(std::make_pair(conn.id, id));
+                    cv.notify_one();
+                    return true;
+                }
+            }
+            return loop.send(conn, "busyir\r", 7);
+        });
+        TEST_ASSERT_EQUAL(0, loop.listen(TEST_TCP_PORT, "127.0.0.1", 4));
+
+        loopThread = std::thread([this]() {
+            while (running) {
+                loop.runOnce(10);
+            }
+        });
+        senderThread = std::thread([this]() {
+            while (running) {
+                std::pair<uint32_t, uint32_t> code;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if (!cv.wait_for(lock, std::chrono::milliseconds(10), [this]() { return !queue.empty(); })) {
+                        continue;
+                    }
+                    code = queue.front();
+                    queue.pop_front();
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(IR_SEND_US));
+                char msg[TCP_POST_MESSAGE_SIZE];
+                snprintf(msg, sizeof(msg), "completeir,1:1,%u\r", code.second);
+                while (!loop.post(code.first, msg) && running) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                }
+            }
+        });
+    }
+
+    ~IrServer() {
+        running = false;
+        loopThread.join();
+        senderThread.join();
+        loop.stop();
+    }
+};
+
+static int connectFrom(const char *source) {
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr(source);
+    TEST_ASSERT_EQUAL(0, bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = htons(TEST_TCP_PORT);
+    TEST_ASSERT_EQUAL(0, connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+    struct timeval tv = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    return fd;
+}
+
+/// Client flooding the server with sendir requests as fast as possible, discarding all replies.
+struct Flooder {
+    int               fd;
+    std::atomic<bool> running;
+    std::atomic<int>  sent;
+    std::thread       writer;
+    std::thread       reader;
+
+    Flooder() : fd(connectFrom("127.0.0.2")), running(true), sent(0) {
+        writer = std::thread([this]() {
+            const char *msg = "sendir,1:1,99999,38000,1,1,10,10\r";
+            while (running && send(fd, msg, strlen(msg), MSG_NOSIGNAL) > 0) {
+                sent++;
+            }
+        });
+        reader = std::thread([this]() {
+            char buf[1024];
+            while (running && recv(fd, buf, sizeof(buf), 0) != 0) {
+            }
+        });
+    }
+
+    ~Flooder() {
+        running = false;
+        shutdown(fd, SHUT_RDWR);
+        writer.join();
+        reader.join();
+        close(fd);
+    }
+};
+
+struct LatencyResult {
+    long long medianUs;
+    long long maxUs;
+    int       busy;
+};
+
+/// Well-behaved client: sends a code every 60 ms and waits for its completion.
+static LatencyResult measureLatency() {
+    const int              samples = 15;
+    int                    fd = connectFrom("127.0.0.1");
+    std::vector<long long> latencies;
+    int                    busy = 0;
+    for (int i = 0; i < samples; i++) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "sendir,1:1,%d,38000,1,1,10,10\r", i);
+        int64_t start = nowUs();
+        TEST_ASSERT_EQUAL(strlen(msg), send(fd, msg, strlen(msg), 0));
+        std::string reply;
+        while (reply.find('\r') == std::string::npos) {
+            char    buf[64];
+            ssize_t len = recv(fd, buf, sizeof(buf), 0);
+            TEST_ASSERT_GREATER_THAN(0, len);
+            reply.append(buf, len);
+        }
+        if (reply.compare(0, 10, "completeir") == 0) {
+            latencies.push_back(nowUs() - start);
+        } else {
+            busy++;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    }
+    close(fd);
+
+    LatencyResult result = {0, 0, busy};
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        result.medianUs = latencies[latencies.size() / 2];
+        result.maxUs = latencies.back();
+    }
+    return result;
+}
+
+static void printResult(const char *name, const LatencyResult &result, const RateLimitStats &stats, int flooded) {
+    char msg[200];
+    snprintf(msg, sizeof(msg),
+             "%s: latency median=%lldus max=%lldus busyir=%d | flood requests=%d throttled: conn=%u ip=%u", name,
+             result.medianUs, result.maxUs, result.busy, flooded, stats.throttledConnection, stats.throttledIp);
+    TEST_MESSAGE(msg);
+}
+
+void test_loadTest_floodingClient(void) {
+    LatencyResult baseline, limited, unlimited;
+    {
+        IrServer server(true);
+        baseline = measureLatency();
+        printResult("no flood", baseline, server.limiter.stats(), 0);
+    }
+    int            flooded;
+    RateLimitStats stats;
+    {
+        IrServer server(true);
+        Flooder  flooder;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        limited = measureLatency();
+        flooded = flooder.sent;
+        stats = server.limiter.stats();
+        printResult("flood, rate limited", limited, stats, flooded);
+    }
+    {
+        IrServer server(false);
+        Flooder  flooder;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        unlimited = measureLatency();
+        printResult("flood, no limit", unlimited, server.limiter.stats(), flooder.sent);
+    }
+
+    TEST_ASSERT_EQUAL(0, baseline.busy);
+    // the well-behaved client is never rejected and its latency stays flat: at most one code of the flooding client
+    // is sent before
+    TEST_ASSERT_EQUAL(0, limited.busy);
+    TEST_ASSERT_LESS_OR_EQUAL(baseline.medianUs + IR_SEND_US, limited.medianUs);
+    // the flooding client was throttled by its connection limit
+    TEST_ASSERT_GREATER_THAN(0, stats.throttledConnection);
+    TEST_ASSERT_EQUAL(0, stats.throttledIp);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_tokenBucket_burst);
+    RUN_TEST(test_tokenBucket_refillRate);
+    RUN_TEST(test_tokenBucket_cappedAtBurst);
+    RUN_TEST(test_rateLimiter_connectionLimit);
+    RUN_TEST(test_rateLimiter_ipLimit);
+    RUN_TEST(test_rateLimiter_disabled);
+    RUN_TEST(test_rateLimiter_sourceTableFull);
+    RUN_TEST(test_loadTest_floodingClient);
+
+    UNITY_END();
+
+    return 0;
+}
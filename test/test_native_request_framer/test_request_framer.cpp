@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "request_framer.hpp"
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+struct Request {
+    ApiEncoding encoding;
+    std::string data;
+};
+
+// Feed the data in chunks of `chunk` bytes and collect all complete requests
+template <size_t N>
+static std::vector<Request> feed(RequestFramer<N> *framer, const std::string &data, size_t chunk,
+                                 size_t requestSize = 64) {
+    std::vector<Request> requests;
+    char                 request[256];
+    size_t               pos = 0;
+    while (pos < data.size()) {
+        size_t len = data.size() - pos < chunk ? data.size() - pos : chunk;
+        size_t written = framer->write(data.data() + pos, len);
+        pos += written;
+        ApiEncoding encoding;
+        size_t      length;
+        while ((length = framer->next(request, requestSize, &encoding)) > 0) {
+            requests.push_back({encoding, std::string(request, length)});
+        }
+    }
+    return requests;
+}
+
+static std::string msgPackFrame(const std::string &msg) {
+    uint8_t header[MSGPACK_FRAME_HEADER_SIZE];
+    encodeMsgPackFrameHeader(msg.size(), header);
+    return std::string(reinterpret_cast<char *>(header), sizeof(header)) + msg;
+}
+
+void test_byteByByte(void) {
+    RequestFramer<64> framer;
+    auto requests = feed(&framer, "{\"command\":\"get_sysinfo\"}\n{\"command\":\"reboot\"}\n", 1);
+    TEST_ASSERT_EQUAL(2, requests.size());
+    TEST_ASSERT_TRUE(requests[0].encoding == ApiEncoding::Json);
+    TEST_ASSERT_EQUAL_STRING("{\"command\":\"get_sysinfo\"}", requests[0].data.c_str());
+    TEST_ASSERT_EQUAL_STRING("{\"command\":\"reboot\"}", requests[1].data.c_str());
+}
+
+void test_burst(void) {
+    RequestFramer<128> framer;
+    std::string        data = "{\"a\":1}\n{\"b\":2}\r\n\n\r\n{\"c\":3}\n{\"d\":";
+    auto               requests = feed(&framer, data, data.size());
+    TEST_ASSERT_EQUAL(3, requests.size());
+    TEST_ASSERT_EQUAL_STRING("{\"a\":1}", requests[0].data.c_str());
+    TEST_ASSERT_EQUAL_STRING("{\"b\":2}", requests[1].data.c_str());
+    TEST_ASSERT_EQUAL_STRING("{\"c\":3}", requests[2].data.c_str());
+
+    // the partial request is completed by the next chunk
+    requests = feed(&framer, "4}\n", 3);
+    TEST_ASSERT_EQUAL(1, requests.size());
+    TEST_ASSERT_EQUAL_STRING("{\"d\":4}", requests[0].data.c_str());
+    TEST_ASSERT_EQUAL(0, framer.discarded());
+}
+
+void test_zeroTerminated(void) {
+    RequestFramer<32> framer;
+    char              request[16];
+    memset(request, 'x', sizeof(request));
+    ApiEncoding encoding;
+    framer.write("{}\n", 3);
+    TEST_ASSERT_EQUAL(2, framer.next(request, sizeof(request), &encoding));
+    TEST_ASSERT_EQUAL(0, request[2]);
+    TEST_ASSERT_EQUAL(0, framer.next(request, sizeof(request), &encoding));
+}
+
+void test_wrapAround(void) {
+    // requests wrap around the end of the ring buffer
+    RequestFramer<16> framer;
+    std::string       data;
+    for (int i = 0; i < 20; i++) {
+        data += "{\"i\":" + std::to_string(i) + "}\n";
+    }
+    for (size_t chunk : {1, 3, 7, 16}) {
+        auto requests = feed(&framer, data, chunk);
+        TEST_ASSERT_EQUAL(20, requests.size());
+        TEST_ASSERT_EQUAL_STRING("{\"i\":19}", requests[19].data.c_str());
+    }
+}
+
+void test_lineExceedsBuffer(void) {
+    RequestFramer<16> framer;
+    auto requests = feed(&framer, std::string(40, 'x') + "\n{\"ok\":1}\n", 5);
+    TEST_ASSERT_EQUAL(1, requests.size());
+    TEST_ASSERT_EQUAL_STRING("{\"ok\":1}", requests[0].data.c_str());
+    TEST_ASSERT_EQUAL(1, framer.discarded());
+}
+
+void test_lineExceedsRequestBuffer(void) {
+    RequestFramer<64> framer;
+    auto requests = feed(&framer, "0123456789\n{\"ok\":1}\n", 64, 10);
+    TEST_ASSERT_EQUAL(1, requests.size());
+    TEST_ASSERT_EQUAL_STRING("{\"ok\":1}", requests[0].data.c_str());
+    TEST_ASSERT_EQUAL(1, framer.discarded());
+}
+
+void test_msgPack(void) {
+    RequestFramer<64> framer;
+    // MessagePack data may contain newlines
+    std::string msg = std::string("\x81\xa7" "command\xa2\n\n", 12);
+    std::string data = msgPackFrame(msg) + "{\"a\":1}\n" + msgPackFrame(msg);
+    for (size_t chunk : {size_t(1), size_t(2), data.size()}) {
+        auto requests = feed(&framer, data, chunk);
+        TEST_ASSERT_EQUAL(3, requests.size());
+        TEST_ASSERT_TRUE(requests[0].encoding == ApiEncoding::MsgPack);
+        TEST_ASSERT_TRUE(requests[0].data == msg);
+        TEST_ASSERT_TRUE(requests[1].encoding == ApiEncoding::Json);
+        TEST_ASSERT_EQUAL_STRING("{\"a\":1}", requests[1].data.c_str());
+        TEST_ASSERT_TRUE(requests[2].encoding == ApiEncoding::MsgPack);
+        TEST_ASSERT_TRUE(requests[2].data == msg);
+    }
+}
+
+void test_msgPackExceedsBuffer(void) {
+    RequestFramer<32> framer;
+    // the skipped frame contains a newline and a frame marker
+    std::string large = std::string(50, 'x') + "\n\xc1" + std::string(20, 'y');
+    std::string data = msgPackFrame(large) + "{}\n" + msgPackFrame(std::string(40, 'z')) + msgPackFrame("\x90");
+    auto        requests = feed(&framer, data, 7);
+    TEST_ASSERT_EQUAL(2, requests.size());
+    TEST_ASSERT_EQUAL_STRING("{}", requests[0].data.c_str());
+    TEST_ASSERT_TRUE(requests[1].data == "\x90");
+    TEST_ASSERT_EQUAL(2, framer.discarded());
+}
+
+void test_writePtrCommit(void) {
+    RequestFramer<16> framer;
+    size_t            space;
+    char             *ptr = framer.writePtr(&space);
+    TEST_ASSERT_EQUAL(16, space);
+    memcpy(ptr, "{}\n{", 4);
+    framer.commit(4);
+
+    char        request[16];
+    ApiEncoding encoding;
+    TEST_ASSERT_EQUAL(2, framer.next(request, sizeof(request), &encoding));
+    TEST_ASSERT_EQUAL(0, framer.next(request, sizeof(request), &encoding));
+    // discard the partial request
+    framer.clear();
+    framer.writePtr(&space);
+    TEST_ASSERT_EQUAL(16, space);
+    TEST_ASSERT_EQUAL(0, framer.next(request, sizeof(request), &encoding));
+}
+
+void test_clear(void) {
+    RequestFramer<16> framer;
+    feed(&framer, std::string(20, 'x'), 20);
+    framer.clear();
+    auto requests = feed(&framer, "{}\n", 3);
+    TEST_ASSERT_EQUAL(1, requests.size());
+}
+
+// Serial stream receiving data in chunks, like a slow Bluetooth or UART client. Reading more than the available data
+// would block until the stream timeout on the device.
+struct FakeStream {
+    std::vector<std::string> chunks;
+    std::string              received;
+    size_t                   pos = 0;
+    int                      blockingReads = 0;
+
+    // make the next chunk available
+    bool arrive() {
+        if (chunks.empty()) {
+            return false;
+        }
+        received += chunks.front();
+        chunks.erase(chunks.begin());
+        return true;
+    }
+
+    int available() { return static_cast<int>(received.size() - pos); }
+
+    size_t readBytes(char *buffer, size_t length) {
+        if (length > received.size() - pos) {
+            blockingReads++;
+            length = received.size() - pos;
+        }
+        memcpy(buffer, received.data() + pos, length);
+        pos += length;
+        return length;
+    }
+};
+
+// Receive all chunks of the stream, one chunk per call
+template <size_t N>
+static std::vector<Request> receiveAll(RequestFramer<N> *framer, FakeStream *stream) {
+    std::vector<Request> requests;
+    char                 request[64];
+    auto                 handler = [&requests](char *request, size_t length, ApiEncoding encoding) {
+        requests.push_back({encoding, std::string(request, length)});
+    };
+    // nothing available yet
+    framer->receive(stream, request, sizeof(request), handler);
+    while (stream->arrive()) {
+        framer->receive(stream, request, sizeof(request), handler);
+    }
+    return requests;
+}
+
+void test_receiveByteByByte(void) {
+    RequestFramer<32> framer;
+    FakeStream        stream;
+    std::string       data = "{\"command\":\"get_sysinfo\"}\n" + msgPackFrame("\x80") + "{}\r\n";
+    for (char c : data) {
+        stream.chunks.push_back(std::string(1, c));
+    }
+    auto requests = receiveAll(&framer, &stream);
+    TEST_ASSERT_EQUAL(3, requests.size());
+    TEST_ASSERT_EQUAL_STRING("{\"command\":\"get_sysinfo\"}", requests[0].data.c_str());
+    TEST_ASSERT_TRUE(requests[1].encoding == ApiEncoding::MsgPack);
+    TEST_ASSERT_TRUE(requests[1].data == "\x80");
+    TEST_ASSERT_EQUAL_STRING("{}", requests[2].data.c_str());
+    TEST_ASSERT_EQUAL(0, stream.blockingReads);
+    TEST_ASSERT_EQUAL(data.size(), stream.pos);
+}
+
+void test_receiveBurstLargerThanBuffer(void) {
+    // the buffer is filled and emptied several times in one call
+    RequestFramer<32> framer;
+    FakeStream        stream;
+    std::string       data;
+    for (int i = 0; i < 50; i++) {
+        data += "{\"req_id\":" + std::to_string(i) + "}\n";
+    }
+    stream.chunks.push_back(data.substr(0, 5));
+    stream.chunks.push_back(data.substr(5));
+    auto requests = receiveAll(&framer, &stream);
+    TEST_ASSERT_EQUAL(50, requests.size());
+    TEST_ASSERT_EQUAL_STRING("{\"req_id\":49}", requests[49].data.c_str());
+    TEST_ASSERT_EQUAL(0, stream.blockingReads);
+    TEST_ASSERT_EQUAL(0, framer.discarded());
+}
+
+void test_receiveOverflow(void) {
+    RequestFramer<32> framer;
+    FakeStream        stream;
+    stream.chunks.push_back("{\"a\":\"" + std::string(100, 'x'));
+    stream.chunks.push_back(std::string(100, 'x') + "\"}\n{\"b\":1}\n");
+    auto requests = receiveAll(&framer, &stream);
+    TEST_ASSERT_EQUAL(1, requests.size());
+    TEST_ASSERT_EQUAL_STRING("{\"b\":1}", requests[0].data.c_str());
+    TEST_ASSERT_EQUAL(1, framer.discarded());
+    TEST_ASSERT_EQUAL(0, stream.blockingReads);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_byteByByte);
+    RUN_TEST(test_burst);
+    RUN_TEST(test_zeroTerminated);
+    RUN_TEST(test_wrapAround);
+    RUN_TEST(test_lineExceedsBuffer);
+    RUN_TEST(test_lineExceedsRequestBuffer);
+    RUN_TEST(test_msgPack);
+    RUN_TEST(test_msgPackExceedsBuffer);
+    RUN_TEST(test_writePtrCommit);
+    RUN_TEST(test_clear);
+    RUN_TEST(test_receiveByteByByte);
+    RUN_TEST(test_receiveBurstLargerThanBuffer);
+    RUN_TEST(test_receiveOverflow);
+
+    UNITY_END();
+
+    return 0;
+}
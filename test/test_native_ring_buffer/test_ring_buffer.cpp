@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <unity.h>
+
+#include <string>
+
+#include "ring_buffer.hpp"
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+static std::string readString(RingBuffer<8> *rb, size_t len) {
+    char buf[16];
+    len = rb->read(buf, len);
+    return std::string(buf, len);
+}
+
+void test_empty(void) {
+    RingBuffer<8> rb;
+    TEST_ASSERT_TRUE(rb.empty());
+    TEST_ASSERT_FALSE(rb.full());
+    TEST_ASSERT_EQUAL(0, rb.size());
+    TEST_ASSERT_EQUAL(8, rb.available());
+    TEST_ASSERT_EQUAL(-1, rb.indexOf('a'));
+    TEST_ASSERT_EQUAL(0, rb.read(nullptr, 4));
+}
+
+void test_writeRead(void) {
+    RingBuffer<8> rb;
+    TEST_ASSERT_EQUAL(3, rb.write("abc", 3));
+    TEST_ASSERT_EQUAL(3, rb.size());
+    TEST_ASSERT_EQUAL(1, rb.indexOf('b'));
+    std::string data = readString(&rb, 2);
+    TEST_ASSERT_EQUAL_STRING("ab", data.c_str());
+    data = readString(&rb, 10);
+    TEST_ASSERT_EQUAL_STRING("c", data.c_str());
+    TEST_ASSERT_TRUE(rb.empty());
+}
+
+void test_writeFull(void) {
+    RingBuffer<8> rb;
+    TEST_ASSERT_EQUAL(8, rb.write("0123456789", 10));
+    TEST_ASSERT_TRUE(rb.full());
+    TEST_ASSERT_EQUAL(0, rb.write("x", 1));
+    size_t space = 99;
+    rb.writePtr(&space);
+    TEST_ASSERT_EQUAL(0, space);
+    std::string data = readString(&rb, 8);
+    TEST_ASSERT_EQUAL_STRING("01234567", data.c_str());
+}
+
+void test_wrapAround(void) {
+    RingBuffer<8> rb;
+    rb.write("012345", 6);
+    rb.read(nullptr, 4);
+    TEST_ASSERT_EQUAL(2, rb.size());
+
+    // contiguous space up to the end of the buffer
+    size_t space;
+    char  *ptr = rb.writePtr(&space);
+    TEST_ASSERT_EQUAL(2, space);
+    memcpy(ptr, "ab", 2);
+    rb.commit(2);
+    // then from the beginning up to the read position
+    ptr = rb.writePtr(&space);
+    TEST_ASSERT_EQUAL(4, space);
+    memcpy(ptr, "cd", 2);
+    rb.commit(2);
+
+    TEST_ASSERT_EQUAL(5, rb.indexOf('d'));
+    std::string data = readString(&rb, 6);
+    TEST_ASSERT_EQUAL_STRING("45abcd", data.c_str());
+}
+
+void test_readPtr(void) {
+    RingBuffer<8> rb;
+    size_t        len;
+    rb.readPtr(&len);
+    TEST_ASSERT_EQUAL(0, len);
+
+    rb.write("012345", 6);
+    rb.read(nullptr, 4);
+    rb.write("abcd", 4);
+    // contiguous data up to the end of the buffer
+    const char *ptr = rb.readPtr(&len);
+    TEST_ASSERT_EQUAL(4, len);
+    TEST_ASSERT_EQUAL(0, memcmp(ptr, "45ab", 4));
+    rb.read(nullptr, len);
+    ptr = rb.readPtr(&len);
+    TEST_ASSERT_EQUAL(2, len);
+    TEST_ASSERT_EQUAL(0, memcmp(ptr, "cd", 2));
+}
+
+void test_peek(void) {
+    RingBuffer<8> rb;
+    rb.write("012345", 6);
+    rb.read(nullptr, 4);
+    rb.write("abcd", 4);
+
+    // wrapped data is copied, but not removed
+    char buf[16];
+    TEST_ASSERT_EQUAL(3, rb.peek(buf, 3));
+    TEST_ASSERT_EQUAL_STRING_LEN("45a", buf, 3);
+    TEST_ASSERT_EQUAL(6, rb.peek(buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING_LEN("45abcd", buf, 6);
+    TEST_ASSERT_EQUAL(6, rb.size());
+}
+
+void test_emptyBufferRestartsAtBeginning(void) {
+    RingBuffer<8> rb;
+    rb.write("0123", 4);
+    rb.read(nullptr, 4);
+    size_t space;
+    rb.writePtr(&space);
+    TEST_ASSERT_EQUAL(8, space);
+}
+
+void test_commitLimitedToAvailable(void) {
+    RingBuffer<8> rb;
+    rb.write("0123", 4);
+    rb.commit(10);
+    TEST_ASSERT_TRUE(rb.full());
+    rb.clear();
+    TEST_ASSERT_TRUE(rb.empty());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_empty);
+    RUN_TEST(test_writeRead);
+    RUN_TEST(test_writeFull);
+    RUN_TEST(test_wrapAround);
+    RUN_TEST(test_readPtr);
+    RUN_TEST(test_peek);
+    RUN_TEST(test_emptyBufferRestartsAtBeginning);
+    RUN_TEST(test_commitLimitedToAvailable);
+
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include "ir_schedule.hpp"
+
+/// Simulated FreeRTOS clock:
+/// - every `nowUs` call costs `readCostUs`, like reading `esp_timer_get_time` in a busy loop.
+/// - `sleepMs` is rounded up to full ticks and oversleeps up to one tick.
+struct SimClock {
+    int64_t  now;
+    int64_t  readCostUs;
+    int64_t  tickUs;
+    uint32_t sleepCalls;
+    uint32_t readCalls;
+    int      abortAfter;
+    // fixed oversleep time, random up to one tick if negative
+    int64_t  oversleepUs;
+
+    explicit SimClock(int64_t start, int64_t readCost = 3, int64_t tick = 1000)
+        : now(start),
+          readCostUs(readCost),
+          tickUs(tick),
+          sleepCalls(0),
+          readCalls(0),
+          abortAfter(-1),
+          oversleepUs(-1) {}
+
+    int64_t nowUs() {
+        readCalls++;
+        now += readCostUs;
+        return now;
+    }
+
+    bool sleepMs(uint32_t ms) {
+        if (abortAfter >= 0 && sleepCalls >= static_cast<uint32_t>(abortAfter)) {
+            return true;
+        }
+        sleepCalls++;
+        int64_t ticks = (ms * 1000 + tickUs - 1) / tickUs;
+        now += ticks * tickUs + (oversleepUs < 0 ? rand() % tickUs : oversleepUs);
+        return false;
+    }
+};
+
+const int64_t kNow = 1700000000LL * 1000000LL;
+
+void setUp(void) {
+    srand(42);
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+void test_checkSendAt_clockNotSet(void) {
+    // ESP32 starts at epoch 0 without SNTP
+    TEST_ASSERT_EQUAL(ScheduleCheck::CLOCK_NOT_SET, checkSendAt(kNow, 5000000));
+    TEST_ASSERT_EQUAL(ScheduleCheck::CLOCK_NOT_SET, checkSendAt(kNow, kMinPlausibleEpochUs - 1));
+}
+
+void test_checkSendAt_range(void) {
+    TEST_ASSERT_EQUAL(ScheduleCheck::OK, checkSendAt(kNow, kNow));
+    TEST_ASSERT_EQUAL(ScheduleCheck::OK, checkSendAt(kNow + kMaxScheduleAheadUs, kNow));
+    TEST_ASSERT_EQUAL(ScheduleCheck::OK, checkSendAt(kNow - kMaxScheduleLateUs, kNow));
+    TEST_ASSERT_EQUAL(ScheduleCheck::TOO_FAR, checkSendAt(kNow + kMaxScheduleAheadUs + 1, kNow));
+    TEST_ASSERT_EQUAL(ScheduleCheck::TOO_LATE, checkSendAt(kNow - kMaxScheduleLateUs - 1, kNow));
+}
+
+void test_waitUntil_targetInPast(void) {
+    SimClock clock(kNow);
+    int64_t  late = -1;
+    TEST_ASSERT_TRUE(waitUntil(clock, kNow - 10000, &late));
+    TEST_ASSERT_EQUAL(0, clock.sleepCalls);
+    TEST_ASSERT_GREATER_OR_EQUAL(10000, late);
+}
+
+void test_waitUntil_shortWaitIsBusyWait(void) {
+    SimClock clock(kNow);
+    int64_t  late = -1;
+    TEST_ASSERT_TRUE(waitUntil(clock, kNow + kScheduleSpinUs, &late));
+    TEST_ASSERT_EQUAL(0, clock.sleepCalls);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, late);
+    TEST_ASSERT_LESS_OR_EQUAL(clock.readCostUs, late);
+}
+
+void test_waitUntil_neverEarlyAndSubMillisecond(void) {
+    int64_t maxLate = 0;
+    int64_t sumLate = 0;
+    int     runs = 1000;
+
+    for (int i = 0; i < runs; i++) {
+        SimClock clock(kNow + (rand() % 1000000));
+        int64_t  target = clock.now + 1 + (rand() % 5000000);
+        int64_t  late = -1;
+
+        TEST_ASSERT_TRUE(waitUntil(clock, target, &late));
+        TEST_ASSERT_GREATER_OR_EQUAL(0, late);
+        TEST_ASSERT_GREATER_OR_EQUAL(target, clock.now);
+        if (late > maxLate) {
+            maxLate = late;
+        }
+        sumLate += late;
+        // the coarse phase must not spin for long
+        TEST_ASSERT_LESS_THAN(2 * (kScheduleSpinUs + clock.tickUs) / clock.readCostUs, clock.readCalls);
+    }
+
+    char buf[80];
+    snprintf(buf, sizeof(buf), "scheduling error: max=%lldus avg=%lldus", static_cast<long long>(maxLate),
+             static_cast<long long>(sumLate / runs));
+    TEST_MESSAGE(buf);
+    TEST_ASSERT_LESS_THAN(1000, maxLate);
+}
+
+void test_waitUntil_worstCaseOversleep(void) {
+    // every sleep wakes up almost one full tick too late: must still be compensated by the spin phase
+    SimClock clock(kNow);
+    clock.oversleepUs = clock.tickUs - 1;
+    int64_t late = -1;
+    TEST_ASSERT_TRUE(waitUntil(clock, kNow + 1000000, &late));
+    TEST_ASSERT_GREATER_OR_EQUAL(0, late);
+    TEST_ASSERT_LESS_THAN(1000, late);
+}
+
+void test_waitUntil_abort(void) {
+    SimClock clock(kNow);
+    clock.abortAfter = 0;
+    TEST_ASSERT_FALSE(waitUntil(clock, kNow + 1000000));
+    TEST_ASSERT_LESS_THAN(kNow + 1000000, clock.now);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_checkSendAt_clockNotSet);
+    RUN_TEST(test_checkSendAt_range);
+    RUN_TEST(test_waitUntil_targetInPast);
+    RUN_TEST(test_waitUntil_shortWaitIsBusyWait);
+    RUN_TEST(test_waitUntil_neverEarlyAndSubMillisecond);
+    RUN_TEST(test_waitUntil_worstCaseOversleep);
+    RUN_TEST(test_waitUntil_abort);
+
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include <unity.h>
+
+#include "siphash.hpp"
+
+// Test key & vectors from the SipHash reference implementation: key = 00 01 02 ... 0f, message = 00 01 02 ... (len-1)
+const SipHashKey testKey = {0x0706050403020100ULL, 0x0f0e0d0c0b0a0908ULL};
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+void test_sipHash24_emptyInput(void) {
+    TEST_ASSERT_EQUAL_UINT64(0x726fdb47dd0e0e31ULL, sipHash24(testKey, nullptr, 0));
+}
+
+void test_sipHash24_referenceVectors(void) {
+    uint8_t msg[64];
+    for (int i = 0; i < 64; i++) {
+        msg[i] = i;
+    }
+    TEST_ASSERT_EQUAL_UINT64(0x74f839c593dc67fdULL, sipHash24(testKey, msg, 1));
+    TEST_ASSERT_EQUAL_UINT64(0x93f5f5799a932462ULL, sipHash24(testKey, msg, 8));
+    TEST_ASSERT_EQUAL_UINT64(0xa129ca6149be45e5ULL, sipHash24(testKey, msg, 15));
+    TEST_ASSERT_EQUAL_UINT64(0x958a324ceb064572ULL, sipHash24(testKey, msg, 63));
+}
+
+void test_sipDeriveKey(void) {
+    SipHashKey a = sipDeriveKey("secret", 1);
+    SipHashKey b = sipDeriveKey("secret", 1);
+    SipHashKey c = sipDeriveKey("secret", 2);
+    SipHashKey d = sipDeriveKey("Secret", 1);
+
+    TEST_ASSERT_EQUAL_UINT64(a.k0, b.k0);
+    TEST_ASSERT_EQUAL_UINT64(a.k1, b.k1);
+    TEST_ASSERT_TRUE(a.k0 != c.k0 && a.k1 != c.k1);
+    TEST_ASSERT_TRUE(a.k0 != d.k0 && a.k1 != d.k1);
+    TEST_ASSERT_TRUE(a.k0 != a.k1);
+}
+
+void test_sipDeriveKey_nullInput(void) {
+    SipHashKey a = sipDeriveKey(nullptr, 1);
+    SipHashKey b = sipDeriveKey("", 1);
+    TEST_ASSERT_EQUAL_UINT64(a.k0, b.k0);
+    TEST_ASSERT_EQUAL_UINT64(a.k1, b.k1);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_sipHash24_emptyInput);
+    RUN_TEST(test_sipHash24_referenceVectors);
+    RUN_TEST(test_sipDeriveKey);
+    RUN_TEST(test_sipDeriveKey_nullInput);
+
+    UNITY_END();
+
+    return 0;
+}
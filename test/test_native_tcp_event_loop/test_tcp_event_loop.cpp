@@ -0,0 +1,744 @@
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tcp_event_loop.hpp"
+
+// Different port than on the device
+#define TEST_TCP_PORT 19998
+#define TEST_CONNECTIONS 8
+
+typedef TcpEventLoop<TEST_CONNECTIONS> TestLoop;
+
+/// Echo server: replies every received message with a `ok,<message>` message
+struct EchoServer {
+    TestLoop loop;
+    int      opened = 0;
+    int      closed = 0;
+    int      requests = 0;
+    bool     echo = true;
+    /// Connection identifiers in order of accepted connections
+    std::vector<uint32_t> ids;
+    /// Received messages per client socket
+    std::map<int, std::vector<std::string>> messages;
+
+    EchoServer() {
+        loop.onOpen([this](TcpConnection &conn) {
+            opened++;
+            ids.push_back(conn.id);
+        });
+        loop.onClose([this](TcpConnection &conn) { closed++; });
+        loop.onReceive([this](TcpConnection &conn, size_t len) {
+            requests++;
+            TEST_ASSERT_EQUAL(strlen(conn.rx), len);
+            messages[conn.fd].push_back(conn.rx);
+            if (strcmp(conn.rx, "quit\r") == 0) {
+                return false;
+            }
+            if (!echo) {
+                return true;
+            }
+            std::string reply = std::string("ok,") + conn.rx;
+            return loop.send(conn, reply.c_str(), reply.size());
+        });
+    }
+
+    /// Process events until there's nothing to do
+    void runUntilIdle() {
+        while (loop.runOnce(20) > 0) {
+        }
+    }
+};
+
+static int connectClient() {
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = htons(TEST_TCP_PORT);
+    // the listen backlog completes the TCP handshake, even before the server accepts the connection
+    TEST_ASSERT_EQUAL(0, connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+    struct timeval tv = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    // send small segments immediately
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    return fd;
+}
+
+static void sendString(int fd, const char *msg) {
+    TEST_ASSERT_EQUAL(strlen(msg), send(fd, msg, strlen(msg), 0));
+}
+
+static void sendAll(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t sent = send(fd, data, len, 0);
+        TEST_ASSERT_GREATER_THAN(0, sent);
+        data += sent;
+        len -= sent;
+    }
+}
+
+static std::string receiveString(int fd) {
+    char    buf[256];
+    ssize_t len = recv(fd, buf, sizeof(buf) - 1, 0);
+    if (len <= 0) {
+        return std::string();
+    }
+    buf[len] = 0;
+    return std::string(buf);
+}
+
+static bool isClosedByPeer(int fd) {
+    char buf[16];
+    return recv(fd, buf, sizeof(buf), 0) == 0;
+}
+
+EchoServer *server;
+
+void setUp(void) {
+    server = new EchoServer();
+    int err = server->loop.listen(TEST_TCP_PORT, "127.0.0.1", TEST_CONNECTIONS);
+    TEST_ASSERT_EQUAL_MESSAGE(0, err, "listen failed");
+}
+
+void tearDown(void) {
+    delete server;
+}
+
+void test_requestReply(void) {
+    int client = connectClient();
+    server->runUntilIdle();
+    TEST_ASSERT_EQUAL(1, server->opened);
+    TEST_ASSERT_EQUAL(1, server->loop.connectionCount());
+
+    sendString(client, "getversion\r");
+    server->runUntilIdle();
+    std::string reply = receiveString(client);
+    TEST_ASSERT_EQUAL_STRING("ok,getversion\r", reply.c_str());
+
+    close(client);
+    server->runUntilIdle();
+    TEST_ASSERT_EQUAL(1, server->closed);
+    TEST_ASSERT_EQUAL(0, server->loop.connectionCount());
+}
+
+void test_handlerClosesConnection(void) {
+    int client = connectClient();
+    sendString(client, "quit\r");
+    server->runUntilIdle();
+    TEST_ASSERT_TRUE(isClosedByPeer(client));
+    TEST_ASSERT_EQUAL(0, server->loop.connectionCount());
+    close(client);
+}
+
+void test_connectionLimit(void) {
+    int clients[TEST_CONNECTIONS + 1];
+    for (int i = 0; i < TEST_CONNECTIONS + 1; i++) {
+        clients[i] = connectClient();
+    }
+    server->runUntilIdle();
+    TEST_ASSERT_EQUAL(TEST_CONNECTIONS, server->loop.connectionCount());
+
+    // last client waits in the backlog
+    sendString(clients[TEST_CONNECTIONS], "waiting\r");
+    server->runUntilIdle();
+    TEST_ASSERT_EQUAL(0, server->requests);
+
+    close(clients[0]);
+    server->runUntilIdle();
+    TEST_ASSERT_EQUAL(TEST_CONNECTIONS, server->loop.connectionCount());
+    TEST_ASSERT_EQUAL(1, server->requests);
+    std::string reply = receiveString(clients[TEST_CONNECTIONS]);
+    TEST_ASSERT_EQUAL_STRING("ok,waiting\r", reply.c_str());
+
+    for (int i = 1; i < TEST_CONNECTIONS + 1; i++) {
+        close(clients[i]);
+    }
+    server->runUntilIdle();
+    TEST_ASSERT_EQUAL(0, server->loop.connectionCount());
+    TEST_ASSERT_EQUAL(TEST_CONNECTIONS + 1, server->closed);
+}
+
+/// All connection slots in use, interleaved requests from every client.
+void test_multiConnectionLoad(void) {
+    const int rounds = 500;
+    int       clients[TEST_CONNECTIONS];
+    for (int i = 0; i < TEST_CONNECTIONS; i++) {
+        clients[i] = connectClient();
+    }
+    server->runUntilIdle();
+
+    for (int round = 0; round < rounds; round++) {
+        char msg[TEST_CONNECTIONS][32];
+        for (int i = 0; i < TEST_CONNECTIONS; i++) {
+            snprintf(msg[i], sizeof(msg[i]), "sendir,1:1,%d\r", round * TEST_CONNECTIONS + i);
+            sendString(clients[i], msg[i]);
+        }
+        // one select call serves multiple clients
+        while (server->requests < (round + 1) * TEST_CONNECTIONS) {
+            TEST_ASSERT_GREATER_THAN(0, server->loop.runOnce(1000));
+        }
+        for (int i = 0; i < TEST_CONNECTIONS; i++) {
+            std::string expected = std::string("ok,") + msg[i];
+            std::string reply = receiveString(clients[i]);
+            TEST_ASSERT_EQUAL_STRING(expected.c_str(), reply.c_str());
+        }
+    }
+
+    for (int i = 0; i < TEST_CONNECTIONS; i++) {
+        close(clients[i]);
+    }
+    server->runUntilIdle();
+    TEST_ASSERT_EQUAL(rounds * TEST_CONNECTIONS, server->requests);
+    TEST_ASSERT_EQUAL(TEST_CONNECTIONS, server->closed);
+}
+
+void test_pipelinedMessages(void) {
+    int client = connectClient();
+    sendString(client, "sendir,1:1,1,38000,1,1,10,10\rstopir,1:1\rgetversion\r");
+    server->runUntilIdle();
+    TEST_ASSERT_EQUAL(3, server->requests);
+
+    std::string expected = "ok,sendir,1:1,1,38000,1,1,10,10\rok,stopir,1:1\rok,getversion\r";
+    std::string reply;
+    while (reply.size() < expected.size()) {
+        std::string part = receiveString(client);
+        TEST_ASSERT_FALSE(part.empty());
+        reply += part;
+    }
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), reply.c_str());
+    close(client);
+}
+
+void test_partialMessageCarriedOver(void) {
+    int client = connectClient();
+    sendString(client, "getdevices\rgetv");
+    server->runUntilIdle();
+    TEST_ASSERT_EQUAL(1, server->requests);
+    sendString(client, "ers");
+    server->runUntilIdle();
+    TEST_ASSERT_EQUAL(1, server->requests);
+    sendString(client, "ion\r");
+    server->runUntilIdle();
+    TEST_ASSERT_EQUAL(2, server->requests);
+
+    auto &messages = server->messages.begin()->second;
+    TEST_ASSERT_EQUAL_STRING("getdevices\r", messages[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("getversion\r", messages[1].c_str());
+    close(client);
+}
+
+void test_messageTooLong(void) {
+    server->echo = false;
+    int         client = connectClient();
+    std::string longMsg(TCP_RX_BUFFER_SIZE + 10, 'x');
+    longMsg += "\rok\r";
+    sendAll(client, longMsg.c_str(), longMsg.size());
+    server->runUntilIdle();
+
+    // buffer size - 1 bytes without delimiter, then the remaining part and the next message
+    auto &messages = server->messages.begin()->second;
+    TEST_ASSERT_EQUAL(3, messages.size());
+    TEST_ASSERT_EQUAL(TCP_RX_BUFFER_SIZE - 1, messages[0].size());
+    TEST_ASSERT_EQUAL(std::string::npos, messages[0].find('\r'));
+    TEST_ASSERT_EQUAL(12, messages[1].size());
+    TEST_ASSERT_EQUAL_STRING("ok\r", messages[2].c_str());
+    close(client);
+}
+
+/// Random message sizes, split and merged over random TCP segments from multiple clients.
+void test_randomSegmentation(void) {
+    const int    clientCount = 3;
+    const int    messageCount = 2000;
+    unsigned int seed = 42;
+    srand(seed);
+    server->echo = false;
+
+    int                      clients[clientCount];
+    std::vector<std::string> expected[clientCount];
+    std::string              stream[clientCount];
+    for (int c = 0; c < clientCount; c++) {
+        clients[c] = connectClient();
+        for (int i = 0; i < messageCount; i++) {
+            char prefix[32];
+            snprintf(prefix, sizeof(prefix), "sendir,1:%d,%d,", c + 1, i);
+            std::string msg(prefix);
+            // timing pairs of random length, up to about a quarter of the buffer size
+            int pairs = rand() % 30;
+            for (int p = 0; p < pairs; p++) {
+                msg += std::to_string(rand() % 1000) + "," + std::to_string(rand() % 1000) + ",";
+            }
+            msg += "1\r";
+            expected[c].push_back(msg);
+            stream[c] += msg;
+        }
+    }
+    server->runUntilIdle();
+
+    size_t offset[clientCount] = {0};
+    bool   done = false;
+    while (!done) {
+        done = true;
+        for (int c = 0; c < clientCount; c++) {
+            size_t remaining = stream[c].size() - offset[c];
+            if (remaining == 0) {
+                continue;
+            }
+            done = false;
+            // random segment: split within a message or merge multiple messages
+            size_t len = 1 + rand() % 600;
+            if (len > remaining) {
+                len = remaining;
+            }
+            sendAll(clients[c], stream[c].data() + offset[c], len);
+            offset[c] += len;
+        }
+        if (rand() % 3 == 0) {
+            server->runUntilIdle();
+        }
+    }
+    server->runUntilIdle();
+
+    TEST_ASSERT_EQUAL(clientCount * messageCount, server->requests);
+    for (int c = 0; c < clientCount; c++) {
+        // accepted in order of connection attempts, but don't rely on the socket numbers
+        const std::vector<std::string> *received = nullptr;
+        for (auto &entry : server->messages) {
+            if (!entry.second.empty() && entry.second[0] == expected[c][0]) {
+                received = &entry.second;
+            }
+        }
+        TEST_ASSERT_NOT_NULL(received);
+        TEST_ASSERT_EQUAL(messageCount, received->size());
+        for (int i = 0; i < messageCount; i++) {
+            TEST_ASSERT_EQUAL_STRING(expected[c][i].c_str(), (*received)[i].c_str());
+        }
+        close(clients[c]);
+    }
+}
+
+void test_postToConnection(void) {
+    int client1 = connectClient();
+    server->runUntilIdle();
+    int client2 = connectClient();
+    server->runUntilIdle();
+    TEST_ASSERT_EQUAL(2, server->ids.size());
+
+    // from another task
+    std::thread poster([]() {
+        server->loop.post(server->ids[1], "completeir,1:1,2\r");
+        server->loop.post(server->ids[0], "completeir,1:1,1\r");
+    });
+    poster.join();
+    server->runUntilIdle();
+
+    std::string reply = receiveString(client1);
+    TEST_ASSERT_EQUAL_STRING("completeir,1:1,1\r", reply.c_str());
+    reply = receiveString(client2);
+    TEST_ASSERT_EQUAL_STRING("completeir,1:1,2\r", reply.c_str());
+    close(client1);
+    close(client2);
+}
+
+void test_postInvalid(void) {
+    int client = connectClient();
+    server->runUntilIdle();
+    uint32_t id = server->ids[0];
+
+    std::string tooLong(TCP_POST_MESSAGE_SIZE + 1, 'x');
+    TEST_ASSERT_FALSE(server->loop.post(id, tooLong.c_str()));
+    // queue full
+    for (int i = 0; i < TCP_POST_QUEUE_SIZE; i++) {
+        TEST_ASSERT_TRUE(server->loop.post(id, "x"));
+    }
+    TEST_ASSERT_FALSE(server->loop.post(id, "x"));
+    server->runUntilIdle();
+    TEST_ASSERT_TRUE(server->loop.post(id, "x"));
+
+    // message to a closed connection is dropped, a new connection never gets the same identifier
+    close(client);
+    server->runUntilIdle();
+    client = connectClient();
+    server->runUntilIdle();
+    TEST_ASSERT_TRUE(id != server->ids[1]);
+    TEST_ASSERT_TRUE(server->loop.post(id, "lost\r"));
+    TEST_ASSERT_TRUE(server->loop.post(server->ids[1], "ok\r"));
+    server->runUntilIdle();
+    std::string reply = receiveString(client);
+    TEST_ASSERT_EQUAL_STRING("ok\r", reply.c_str());
+    close(client);
+
+    server->loop.stop();
+    TEST_ASSERT_FALSE(server->loop.post(id, "x"));
+}
+
+/// A client stops reading while completions are posted at a high rate. Posting never blocks, the stalled client is
+/// disconnected when its output buffer overflows, and a well-behaved client receives all its messages.
+void test_stalledReader(void) {
+    const int messageCount = 2000;
+
+    // small socket buffers to fill them up quickly
+    int size = 1024;
+    server->loop.onOpen([&size](TcpConnection &conn) {
+        setsockopt(conn.fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+        server->ids.push_back(conn.id);
+    });
+    int stalled = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    setsockopt(stalled, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = htons(TEST_TCP_PORT);
+    TEST_ASSERT_EQUAL(0, connect(stalled, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+    server->runUntilIdle();
+    int reader = connectClient();
+    server->runUntilIdle();
+    TEST_ASSERT_EQUAL(2, server->loop.connectionCount());
+    uint32_t stalledId = server->ids[0];
+    uint32_t readerId = server->ids[1];
+
+    std::string expected;
+    char        msg[TCP_POST_MESSAGE_SIZE];
+    for (int i = 0; i < messageCount; i++) {
+        snprintf(msg, sizeof(msg), "completeir,1:1,%d\r", i);
+        expected += msg;
+    }
+
+    std::atomic<bool> running(true);
+    std::thread       loopThread([&running]() {
+        while (running) {
+            server->loop.runOnce(10);
+        }
+    });
+    std::string received;
+    std::thread readerThread([&received, &expected, reader]() {
+        while (received.size() < expected.size()) {
+            std::string part = receiveString(reader);
+            if (part.empty()) {
+                break;
+            }
+            received += part;
+        }
+    });
+
+    // completions in the order the IR task would post them
+    long long maxPostUs = 0;
+    int       readerPosted = 0;
+    for (int i = 0; i < messageCount; i++) {
+        snprintf(msg, sizeof(msg), "completeir,1:1,%d\r", i);
+        auto start = std::chrono::steady_clock::now();
+        server->loop.post(stalledId, msg);
+        bool posted = server->loop.post(readerId, msg);
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        if (duration.count() > maxPostUs) {
+            maxPostUs = duration.count();
+        }
+        if (posted) {
+            readerPosted++;
+        } else {
+            // queue full: give the event loop time to catch up
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            i--;
+        }
+    }
+
+    readerThread.join();
+    running = false;
+    loopThread.join();
+
+    char info[100];
+    snprintf(info, sizeof(info), "post: max=%lldus, reader messages=%d", maxPostUs, readerPosted);
+    TEST_MESSAGE(info);
+
+    TEST_ASSERT_EQUAL(messageCount, readerPosted);
+    // the reader gets every message in order
+    TEST_ASSERT_TRUE(received == expected);
+    // stalled client has been disconnected, the reader is still connected
+    TEST_ASSERT_EQUAL(1, server->loop.connectionCount());
+    TEST_ASSERT_EQUAL(1, server->closed);
+    // posting only queues the message
+    TEST_ASSERT_LESS_THAN(5000, maxPostUs);
+
+    close(stalled);
+    close(reader);
+}
+
+void test_evictIdleConnection(void) {
+    server->loop.setEviction(true, 50);
+    int clients[TEST_CONNECTIONS];
+    for (int i = 0; i < TEST_CONNECTIONS; i++) {
+        clients[i] = connectClient();
+    }
+    server->runUntilIdle();
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    // all but the first client are active
+    for (int i = 1; i < TEST_CONNECTIONS; i++) {
+        sendString(clients[i], "ping\r");
+    }
+    server->runUntilIdle();
+
+    int client = connectClient();
+    server->runUntilIdle();
+    TEST_ASSERT_EQUAL(TEST_CONNECTIONS, server->loop.connectionCount());
+    TEST_ASSERT_TRUE(isClosedByPeer(clients[0]));
+    sendString(client, "getversion\r");
+    server->runUntilIdle();
+    std::string reply = receiveString(client);
+    TEST_ASSERT_EQUAL_STRING("ok,getversion\r", reply.c_str());
+
+    TcpLoopStats stats = server->loop.stats();
+    TEST_ASSERT_EQUAL(TEST_CONNECTIONS + 1, stats.accepted);
+    TEST_ASSERT_EQUAL(1, stats.closed);
+    TEST_ASSERT_EQUAL(1, stats.evicted);
+    TEST_ASSERT_EQUAL(0, stats.rejected);
+    TEST_ASSERT_EQUAL(TEST_CONNECTIONS, stats.peakConnections);
+
+    close(client);
+    for (int i = 0; i < TEST_CONNECTIONS; i++) {
+        close(clients[i]);
+    }
+}
+
+void test_rejectIfAllConnectionsActive(void) {
+    server->loop.setEviction(true, 10000);
+    int clients[TEST_CONNECTIONS];
+    for (int i = 0; i < TEST_CONNECTIONS; i++) {
+        clients[i] = connectClient();
+    }
+    server->runUntilIdle();
+
+    // new client is closed right away instead of waiting in the backlog
+    int client = connectClient();
+    server->runUntilIdle();
+    TEST_ASSERT_TRUE(isClosedByPeer(client));
+    TEST_ASSERT_EQUAL(TEST_CONNECTIONS, server->loop.connectionCount());
+    TcpLoopStats stats = server->loop.stats();
+    TEST_ASSERT_EQUAL(TEST_CONNECTIONS, stats.accepted);
+    TEST_ASSERT_EQUAL(0, stats.evicted);
+    TEST_ASSERT_EQUAL(1, stats.rejected);
+
+    close(client);
+    for (int i = 0; i < TEST_CONNECTIONS; i++) {
+        close(clients[i]);
+    }
+}
+
+struct StormResult {
+    int       served;
+    long long maxUs;
+    long long totalUs;
+};
+
+/// Connect `count` clients at the same time while the event loop runs in its own thread. Every client sends a request
+/// and waits up to `timeoutMs` for the reply.
+static StormResult reconnectStorm(int count, int timeoutMs, std::vector<int> *fds) {
+    std::atomic<bool> running(true);
+    std::thread       loopThread([&running]() {
+        while (running) {
+            server->loop.runOnce(10);
+        }
+    });
+
+    std::vector<long long>   latencies(count, -1);
+    std::vector<std::thread> threads;
+    fds->assign(count, -1);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        threads.emplace_back([i, timeoutMs, &latencies, fds]() {
+            // no Unity assertions in threads
+            int                fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            struct sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+            addr.sin_port = htons(TEST_TCP_PORT);
+            struct timeval tv = {timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            (*fds)[i] = fd;
+            auto begin = std::chrono::steady_clock::now();
+            if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 ||
+                send(fd, "getversion\r", 11, MSG_NOSIGNAL) != 11) {
+                return;
+            }
+            if (receiveString(fd) == "ok,getversion\r") {
+                latencies[i] = std::chrono::duration_cast<std::chrono::microseconds>(
+                                   std::chrono::steady_clock::now() - begin)
+                                   .count();
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    StormResult result = {0, 0, 0};
+    result.totalUs =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    running = false;
+    loopThread.join();
+
+    for (long long latency : latencies) {
+        if (latency >= 0) {
+            result.served++;
+            result.maxUs = latency > result.maxUs ? latency : result.maxUs;
+        }
+    }
+    return result;
+}
+
+/// Reconnect storm after a router reboot: the old connections are dead, but still occupy all connection slots.
+static void reconnectStormBenchmark(bool evict) {
+    server->loop.setEviction(evict, 100);
+    int stale[TEST_CONNECTIONS];
+    for (int i = 0; i < TEST_CONNECTIONS; i++) {
+        stale[i] = connectClient();
+    }
+    server->runUntilIdle();
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+
+    std::vector<int> fds;
+    StormResult      result = reconnectStorm(TEST_CONNECTIONS, 300, &fds);
+    TcpLoopStats     stats = server->loop.stats();
+
+    char msg[200];
+    snprintf(msg, sizeof(msg),
+             "reconnect storm (%s): served=%d/%d max=%lldus total=%lldus | accepted=%u evicted=%u rejected=%u",
+             evict ? "evict" : "wait", result.served, TEST_CONNECTIONS, result.maxUs, result.totalUs, stats.accepted,
+             stats.evicted, stats.rejected);
+    TEST_MESSAGE(msg);
+
+    if (evict) {
+        // every reconnecting client takes over the slot of a dead connection
+        TEST_ASSERT_EQUAL(TEST_CONNECTIONS, result.served);
+        TEST_ASSERT_EQUAL(TEST_CONNECTIONS, stats.evicted);
+        TEST_ASSERT_EQUAL(0, stats.rejected);
+        for (int i = 0; i < TEST_CONNECTIONS; i++) {
+            TEST_ASSERT_TRUE(isClosedByPeer(stale[i]));
+        }
+    } else {
+        // reconnecting clients wait in the backlog until the dead connections time out
+        TEST_ASSERT_EQUAL(0, result.served);
+    }
+
+    for (int i = 0; i < TEST_CONNECTIONS; i++) {
+        close(stale[i]);
+        close(fds[i]);
+    }
+}
+
+void test_reconnectStorm_wait(void) {
+    reconnectStormBenchmark(false);
+}
+
+void test_reconnectStorm_evict(void) {
+    reconnectStormBenchmark(true);
+}
+
+/// Short-lived connections from multiple clients: connect, request, close.
+void test_connectionChurn(void) {
+    const int threadCount = 4;
+    const int cycles = 250;
+    // closed connections not yet processed by the event loop are evicted first
+    server->loop.setEviction(true, 0);
+
+    std::atomic<bool> running(true);
+    std::thread       loopThread([&running]() {
+        while (running) {
+            server->loop.runOnce(10);
+        }
+    });
+    std::atomic<int>         served(0);
+    std::vector<std::thread> threads;
+    auto                     start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back([&served]() {
+            for (int i = 0; i < cycles; i++) {
+                int                fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+                struct sockaddr_in addr;
+                memset(&addr, 0, sizeof(addr));
+                addr.sin_family = AF_INET;
+                addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+                addr.sin_port = htons(TEST_TCP_PORT);
+                struct timeval tv = {1, 0};
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+                if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == 0 &&
+                    send(fd, "getversion\r", 11, MSG_NOSIGNAL) == 11 && receiveString(fd) == "ok,getversion\r") {
+                    served++;
+                }
+                close(fd);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    auto duration = std::chrono::steady_clock::now() - start;
+    // process the remaining disconnects
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    running = false;
+    loopThread.join();
+    server->runUntilIdle();
+
+    long long    durationUs = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    TcpLoopStats stats = server->loop.stats();
+    char         msg[200];
+    snprintf(msg, sizeof(msg),
+             "connection churn: %d connections in %lldus, %lld connections/s | accepted=%u closed=%u evicted=%u "
+             "peak=%u",
+             threadCount * cycles, durationUs, threadCount * cycles * 1000000LL / durationUs, stats.accepted,
+             stats.closed, stats.evicted, stats.peakConnections);
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_EQUAL(threadCount * cycles, served.load());
+    TEST_ASSERT_EQUAL(threadCount * cycles, stats.accepted);
+    TEST_ASSERT_EQUAL(threadCount * cycles, stats.closed);
+    TEST_ASSERT_LESS_OR_EQUAL(TEST_CONNECTIONS, stats.peakConnections);
+}
+
+void test_stopClosesClients(void) {
+    int client = connectClient();
+    server->runUntilIdle();
+    server->loop.stop();
+    TEST_ASSERT_FALSE(server->loop.isListening());
+    TEST_ASSERT_EQUAL(1, server->closed);
+    TEST_ASSERT_TRUE(isClosedByPeer(client));
+    TEST_ASSERT_EQUAL(-1, server->loop.runOnce(0));
+    close(client);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_requestReply);
+    RUN_TEST(test_handlerClosesConnection);
+    RUN_TEST(test_connectionLimit);
+    RUN_TEST(test_multiConnectionLoad);
+    RUN_TEST(test_pipelinedMessages);
+    RUN_TEST(test_partialMessageCarriedOver);
+    RUN_TEST(test_messageTooLong);
+    RUN_TEST(test_randomSegmentation);
+    RUN_TEST(test_postToConnection);
+    RUN_TEST(test_postInvalid);
+    RUN_TEST(test_stalledReader);
+    RUN_TEST(test_evictIdleConnection);
+    RUN_TEST(test_rejectIfAllConnectionsActive);
+    RUN_TEST(test_reconnectStorm_wait);
+    RUN_TEST(test_reconnectStorm_evict);
+    RUN_TEST(test_connectionChurn);
+    RUN_TEST(test_stopClosesClients);
+
+    UNITY_END();
+
+    return 0;
+}